@@ -65,6 +65,24 @@ int aesni_crypt_ecb( aes_context *ctx,
                      const unsigned char input[16],
                      unsigned char output[16] );
 
+/**
+ * \brief          AES-NI encryption of 8 counter blocks, XORed with the
+ *                 input to produce the output (CTR-style)
+ *
+ * \note           The 8 blocks are processed in an interleaved way, which
+ *                 is much faster than 8 calls to aesni_crypt_ecb().
+ *                 The output may be the same buffer as the input.
+ *
+ * \param ctx      AES context, set up for encryption
+ * \param counters 8 consecutive 16-byte blocks to encrypt
+ * \param input    8 16-byte input blocks
+ * \param output   8 16-byte output blocks
+ */
+void aesni_crypt_ctr8( aes_context *ctx,
+                       const unsigned char counters[128],
+                       const unsigned char input[128],
+                       unsigned char output[128] );
+
 /**
  * \brief          GCM multiplication: c = a * b in GF(2^128)
  *
@@ -79,6 +97,29 @@ void aesni_gcm_mult( unsigned char c[16],
                      const unsigned char a[16],
                      const unsigned char b[16] );
 
+/**
+ * \brief          Precompute the powers of H used by aesni_gcm_mult8()
+ *
+ * \param hpow     Output: H^8, H^7, ..., H^1 in the internal format
+ * \param h        Hash subkey H
+ */
+void aesni_gcm_precompute( unsigned char hpow[128],
+                           const unsigned char h[16] );
+
+/**
+ * \brief          Aggregated GHASH of 8 blocks:
+ *                 y = ( ... ( ( y + x1 ) * H + x2 ) * H ... + x8 ) * H
+ *                 computed as ( y + x1 ) * H^8 + x2 * H^7 + ... + x8 * H
+ *                 with a single reduction.
+ *
+ * \param y        GHASH state, updated in place
+ * \param x        8 blocks of data to hash
+ * \param hpow     Powers of H, as computed by aesni_gcm_precompute()
+ */
+void aesni_gcm_mult8( unsigned char y[16],
+                      const unsigned char x[128],
+                      const unsigned char hpow[128] );
+
 /**
  * \brief           Compute decryption round keys from encryption round keys
  *
@@ -77,6 +77,28 @@ typedef UINT64 uint64_t;
  */
 #define POLARSSL_MPI_WINDOW_SIZE                           6        /**< Maximum windows size used. */
 
+/*
+ * Number of teeth of the comb used by mpi_exp_mod_fixed(). Default: 6
+ * Minimum value: 1. Maximum value: 8.
+ *
+ * Each mpi_fixed_base holds ( 1 << POLARSSL_MPI_FIXED_BASE_TEETH ) MPIs
+ * the size of the modulus, and an exponentiation with a n-bit exponent
+ * costs about 2n / POLARSSL_MPI_FIXED_BASE_TEETH multiplications.
+ */
+#define POLARSSL_MPI_FIXED_BASE_TEETH                      6        /**< Teeth of fixed-base combs. */
+
+/*
+ * Operand sizes, in limbs, from which squarings use the dedicated kernel
+ * rather than a general product, and from which balanced products and
+ * squarings use Karatsuba's method. Minimum value: 4.
+ *
+ * The best values depend on the platform and on the assembly used from
+ * bn_mul.h. Raise them to get the schoolbook method for all sizes.
+ */
+#define POLARSSL_MPI_SQR_THRESHOLD                         32       /**< Limbs from which squarings use the squaring kernel. */
+#define POLARSSL_MPI_KARATSUBA_THRESHOLD                   32       /**< Limbs from which products use Karatsuba. */
+#define POLARSSL_MPI_KARATSUBA_SQR_THRESHOLD               64       /**< Limbs from which squarings use Karatsuba. */
+
 /*
  * Maximum size of MPIs allowed in bits and bytes for user-MPIs.
  * ( Default: 512 bytes => 4096 bits, Maximum tested: 2048 bytes => 16384 bits )
@@ -182,6 +204,21 @@ typedef struct
 }
 mpi;
 
+/**
+ * \brief          Precomputed powers of a fixed base, for
+ *                 mpi_exp_mod_fixed()
+ */
+typedef struct
+{
+    mpi N;              /*!<  modulus                           */
+    t_uint mm;          /*!<  Montgomery constant for N         */
+    size_t h;           /*!<  number of teeth of the comb       */
+    size_t d;           /*!<  spacing of the teeth, in bits     */
+    mpi *T;             /*!<  2^h powers of the base, in
+                              Montgomery representation        */
+}
+mpi_fixed_base;
+
 /**
  * \brief           Initialize one MPI
  *
@@ -657,6 +694,83 @@ int mpi_mod_int( t_uint *r, const mpi *A, t_sint b );
  */
 int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR );
 
+/**
+ * \brief          Sliding-window exponentiation of several bases with the
+ *                 same exponent and modulus: X[k] = A[k]^E mod N
+ *
+ * \param X        Array of count destination MPIs
+ * \param A        Array of count left-hand MPIs
+ * \param count    Number of bases
+ * \param E        Exponent MPI
+ * \param N        Modular MPI
+ * \param _RR      Speed-up MPI used for recalculations
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if N is negative or even or if
+ *                 E is negative
+ *
+ * \note           All bases are processed step by step together, which
+ *                 shares the set-up work and keeps N and E hot in cache.
+ *                 X and A may be the same array. _RR is as in mpi_exp_mod().
+ */
+int mpi_exp_mod_batch( mpi *X, const mpi *A, size_t count,
+                       const mpi *E, const mpi *N, mpi *_RR );
+
+/**
+ * \brief          Initialize a fixed-base table
+ *
+ * \param B        Table to initialize
+ */
+void mpi_fixed_base_init( mpi_fixed_base *B );
+
+/**
+ * \brief          Precompute the powers of G needed for fast
+ *                 exponentiations G^E mod N with mpi_exp_mod_fixed()
+ *
+ * \param B        Table to fill (previous contents are freed)
+ * \param G        Base, 0 <= G
+ * \param N        Modular MPI
+ * \param ebits    Maximum size of the exponents, in bits
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if N is negative or even,
+ *                 G is negative or ebits is 0
+ *
+ * \note           The table is never modified by mpi_exp_mod_fixed(), so it
+ *                 can be shared by several threads once set up.
+ */
+int mpi_fixed_base_setup( mpi_fixed_base *B, const mpi *G, const mpi *N,
+                          size_t ebits );
+
+/**
+ * \brief          Unallocate a fixed-base table
+ *
+ * \param B        Table to free
+ */
+void mpi_fixed_base_free( mpi_fixed_base *B );
+
+/**
+ * \brief          Fixed-base comb exponentiation: X = G^E mod N, with G and N
+ *                 the values B was set up with
+ *
+ * \param X        Destination MPI
+ * \param B        Table of precomputed powers of G
+ * \param E        Exponent MPI
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if B is not set up, or if
+ *                 E is negative or larger than the ebits given to
+ *                 mpi_fixed_base_setup()
+ *
+ * \note           Costs about a third of mpi_exp_mod() with the default
+ *                 number of teeth. Like mpi_exp_mod(), the table access
+ *                 pattern depends on E.
+ */
+int mpi_exp_mod_fixed( mpi *X, const mpi_fixed_base *B, const mpi *E );
+
 /**
  * \brief          Fill an MPI X with size bytes of random
  *
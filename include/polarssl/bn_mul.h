@@ -202,6 +202,86 @@
         : "rax", "rcx", "rdx", "rbx", "rsi", "rdi", "r8"    \
     );
 
+/*
+ * Alternative for CPUs with BMI2 and ADX, only used when
+ * mpi_mul_hlp() finds them at runtime. mulx leaves the flags alone, so
+ * the high half of the previous product is added with adcx (CF chain)
+ * and the destination limb with adox (OF chain), with no adc in between.
+ * Pointers move with lea, which does not touch the flags either.
+ */
+#define MULADDC_MULX_INIT           \
+    asm(                            \
+        "                           \
+        movq   %3, %%rsi;           \
+        movq   %4, %%rdi;           \
+        movq   %5, %%rcx;           \
+        movq   %6, %%rdx;           \
+        xorq   %%r9, %%r9;          \
+        "
+
+#define MULADDC_MULX_CORE           \
+        "                           \
+        mulxq  (%%rsi), %%rax, %%r8;\
+        adcxq  %%rcx,   %%rax;      \
+        adoxq  (%%rdi), %%rax;      \
+        movq   %%rax,   (%%rdi);    \
+        movq   %%r8,    %%rcx;      \
+        leaq   8(%%rsi), %%rsi;     \
+        leaq   8(%%rdi), %%rdi;     \
+        "
+
+#define MULADDC_MULX_HUIT           \
+        "                           \
+        mulxq   0(%%rsi), %%rax, %%r8;  \
+        adcxq  %%rcx,     %%rax;        \
+        adoxq   0(%%rdi), %%rax;        \
+        movq   %%rax,      0(%%rdi);    \
+        mulxq   8(%%rsi), %%r10, %%rcx; \
+        adcxq  %%r8,      %%r10;        \
+        adoxq   8(%%rdi), %%r10;        \
+        movq   %%r10,      8(%%rdi);    \
+        mulxq  16(%%rsi), %%rax, %%r8;  \
+        adcxq  %%rcx,     %%rax;        \
+        adoxq  16(%%rdi), %%rax;        \
+        movq   %%rax,     16(%%rdi);    \
+        mulxq  24(%%rsi), %%r10, %%rcx; \
+        adcxq  %%r8,      %%r10;        \
+        adoxq  24(%%rdi), %%r10;        \
+        movq   %%r10,     24(%%rdi);    \
+        mulxq  32(%%rsi), %%rax, %%r8;  \
+        adcxq  %%rcx,     %%rax;        \
+        adoxq  32(%%rdi), %%rax;        \
+        movq   %%rax,     32(%%rdi);    \
+        mulxq  40(%%rsi), %%r10, %%rcx; \
+        adcxq  %%r8,      %%r10;        \
+        adoxq  40(%%rdi), %%r10;        \
+        movq   %%r10,     40(%%rdi);    \
+        mulxq  48(%%rsi), %%rax, %%r8;  \
+        adcxq  %%rcx,     %%rax;        \
+        adoxq  48(%%rdi), %%rax;        \
+        movq   %%rax,     48(%%rdi);    \
+        mulxq  56(%%rsi), %%r10, %%rcx; \
+        adcxq  %%r8,      %%r10;        \
+        adoxq  56(%%rdi), %%r10;        \
+        movq   %%r10,     56(%%rdi);    \
+        leaq   64(%%rsi), %%rsi;        \
+        leaq   64(%%rdi), %%rdi;        \
+        "
+
+#define MULADDC_MULX_STOP           \
+        "                           \
+        adcxq  %%r9,  %%rcx;        \
+        adoxq  %%r9,  %%rcx;        \
+        movq   %%rcx, %0;           \
+        movq   %%rdi, %1;           \
+        movq   %%rsi, %2;           \
+        "                           \
+        : "=m" (c), "=m" (d), "=m" (s)                      \
+        : "m" (s), "m" (d), "m" (c), "m" (b)                \
+        : "rax", "rcx", "rdx", "rsi", "rdi",                \
+          "r8", "r9", "r10", "cc", "memory"                 \
+    );
+
 #endif /* AMD64 */
 
 #if defined(__mc68020__) || defined(__mcpu32__)
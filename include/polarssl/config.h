@@ -212,6 +212,21 @@
  */
 //#define POLARSSL_AES_ROM_TABLES
 
+/**
+ * \def POLARSSL_GCM_8BIT_TABLES
+ *
+ * Use 8-bit tables (Shoup's method) for the portable GHASH implementation
+ * instead of the default 4-bit tables. This roughly halves the number of
+ * table lookups per block, at the cost of 4 KB of tables per GCM context
+ * instead of 256 bytes.
+ *
+ * The tables are not used when the CPU supports the PCLMULQDQ instruction
+ * and POLARSSL_AESNI_C is enabled.
+ *
+ * Uncomment this macro to use 8-bit GHASH tables.
+ */
+//#define POLARSSL_GCM_8BIT_TABLES
+
 /**
  * \def POLARSSL_CIPHER_MODE_CBC
  *
@@ -704,6 +719,22 @@
  */
 //#define POLARSSL_MEMORY_BACKTRACE
 
+/**
+ * \def POLARSSL_MEMORY_THREAD_CACHE
+ *
+ * Give each thread a cache of freed small and medium blocks, so that most
+ * allocations and frees from the buffer allocator do not take its mutex.
+ * Threads should call memory_buffer_alloc_thread_flush() before exiting.
+ *
+ * Requires: POLARSSL_MEMORY_BUFFER_ALLOC_C
+ *           POLARSSL_THREADING_C
+ *           Compiler support for thread-local variables (__thread or
+ *           __declspec(thread))
+ *
+ * Uncomment this macro to enable per-thread caches
+ */
+//#define POLARSSL_MEMORY_THREAD_CACHE
+
 /**
  * \def POLARSSL_PKCS1_V15
  *
@@ -860,6 +891,21 @@
  */
 #define POLARSSL_SSL_PROTO_TLS1_2
 
+/**
+ * \def POLARSSL_SSL_ASYNC_PRIVATE
+ *
+ * Enable asynchronous private key operations in SSL servers: callbacks
+ * set with ssl_set_async_private() can start the decryption of the
+ * premaster secret or the ServerKeyExchange signature elsewhere (worker
+ * thread, key server, hardware) and ssl_handshake() returns
+ * POLARSSL_ERR_SSL_PRIVATE_PENDING until they are done.
+ *
+ * Requires: POLARSSL_X509_CRT_PARSE_C
+ *
+ * Comment this macro to disable asynchronous private key operations.
+ */
+#define POLARSSL_SSL_ASYNC_PRIVATE
+
 /**
  * \def POLARSSL_SSL_ALPN
  *
@@ -1381,6 +1427,39 @@
  */
 #define POLARSSL_ECP_C
 
+/**
+ * \def POLARSSL_ECP_P256_C
+ *
+ * Enable the dedicated implementation of secp256r1 with fixed-size
+ * arithmetic. It is used automatically by ecp_mul() and ecp_muladd()
+ * for groups loaded with ecp_use_known_dp( POLARSSL_ECP_DP_SECP256R1 ).
+ *
+ * Module:  library/ecp_p256.c
+ * Caller:  library/ecp.c
+ *
+ * Requires: POLARSSL_ECP_C, POLARSSL_ECP_DP_SECP256R1_ENABLED
+ *
+ * Comment this macro to disable the dedicated secp256r1 implementation
+ */
+#define POLARSSL_ECP_P256_C
+
+/**
+ * \def POLARSSL_ECP_X25519_C
+ *
+ * Enable the dedicated implementation of Curve25519 with fixed-size
+ * field arithmetic. It is used automatically by ecp_mul(), hence by
+ * ecdh_compute_shared() and ecdh_calc_secret(), for groups loaded with
+ * ecp_use_known_dp( POLARSSL_ECP_DP_M255 ).
+ *
+ * Module:  library/ecp_x25519.c
+ * Caller:  library/ecp.c
+ *
+ * Requires: POLARSSL_ECP_C, POLARSSL_ECP_DP_M255_ENABLED
+ *
+ * Comment this macro to disable the dedicated Curve25519 implementation
+ */
+#define POLARSSL_ECP_X25519_C
+
 /**
  * \def POLARSSL_ENTROPY_C
  *
@@ -2045,6 +2124,10 @@
 // MPI / BIGNUM options
 //
 #define POLARSSL_MPI_WINDOW_SIZE            6 /**< Maximum windows size used. */
+#define POLARSSL_MPI_FIXED_BASE_TEETH       6 /**< Teeth of fixed-base combs. */
+#define POLARSSL_MPI_SQR_THRESHOLD         32 /**< Limbs from which squarings use the squaring kernel. */
+#define POLARSSL_MPI_KARATSUBA_THRESHOLD   32 /**< Limbs from which products use Karatsuba. */
+#define POLARSSL_MPI_KARATSUBA_SQR_THRESHOLD 64 /**< Limbs from which squarings use Karatsuba. */
 #define POLARSSL_MPI_MAX_SIZE             512 /**< Maximum number of bytes for usable MPIs. */
 
 // CTR_DRBG options
@@ -2067,6 +2150,7 @@
 #define POLARSSL_ECP_MAX_BITS             521 /**< Maximum bit size of groups */
 #define POLARSSL_ECP_WINDOW_SIZE            6 /**< Maximum window size used */
 #define POLARSSL_ECP_FIXED_POINT_OPTIM      1 /**< Enable fixed-point speed-up */
+#define POLARSSL_ECP_COMB_CACHE_WINDOW      7 /**< Window for cached generator tables */
 
 // Entropy options
 //
@@ -2075,6 +2159,7 @@
 
 // Memory buffer allocator options
 #define MEMORY_ALIGN_MULTIPLE               4 /**< Align on multiples of this value */
+#define POLARSSL_MEMORY_THREAD_CACHE_SIZE  16 /**< Blocks cached per size class and thread */
 
 // Platform options
 //
@@ -2084,15 +2169,24 @@
 #define POLARSSL_PLATFORM_STD_PRINTF   printf /**< Default printf to use, can be undefined */
 #define POLARSSL_PLATFORM_STD_FPRINTF fprintf /**< Default fprintf to use, can be undefined */
 
+// RSA options
+//
+#define POLARSSL_RSA_BLINDING_SLOTS         4 /**< Independent blinding pairs per context */
+
 // SSL Cache options
 //
 #define SSL_CACHE_DEFAULT_TIMEOUT       86400 /**< 1 day  */
 #define SSL_CACHE_DEFAULT_MAX_ENTRIES      50 /**< Maximum entries in cache */
+#define SSL_CACHE_DEFAULT_SHARDS            8 /**< Shards in a sharded cache */
+#define SSL_CACHE_DEFAULT_BUCKETS          64 /**< Hash buckets per shard */
 
 // SSL options
 //
 #define SSL_MAX_CONTENT_LEN             16384 /**< Size of the input / output buffer */
 #define SSL_DEFAULT_TICKET_LIFETIME     86400 /**< Lifetime of session tickets (if enabled) */
+#define SSL_TICKET_MAX_KEYS                 2 /**< Ticket keys kept for decryption (current and older) */
+#define SSL_MAX_OUT_RECORDS                16 /**< Maximum number of queued output records */
+#define SSL_MAX_RSA_BATCH                  16 /**< Maximum number of queued RSA private key operations */
 
 #endif /* POLARSSL_CONFIG_OPTIONS */
 
@@ -2148,6 +2242,16 @@
 #error "POLARSSL_ECP_C defined, but not all prerequisites"
 #endif
 
+#if defined(POLARSSL_ECP_P256_C) && ( !defined(POLARSSL_ECP_C) ||   \
+    !defined(POLARSSL_ECP_DP_SECP256R1_ENABLED) )
+#error "POLARSSL_ECP_P256_C defined, but not all prerequisites"
+#endif
+
+#if defined(POLARSSL_ECP_X25519_C) && ( !defined(POLARSSL_ECP_C) || \
+    !defined(POLARSSL_ECP_DP_M255_ENABLED) )
+#error "POLARSSL_ECP_X25519_C defined, but not all prerequisites"
+#endif
+
 #if defined(POLARSSL_ENTROPY_C) && (!defined(POLARSSL_SHA512_C) &&      \
                                     !defined(POLARSSL_SHA256_C))
 #error "POLARSSL_ENTROPY_C defined, but not all prerequisites"
@@ -2233,6 +2337,11 @@
 #error "POLARSSL_MEMORY_BUFFER_ALLOC_C defined, but not all prerequisites"
 #endif
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE) &&                            \
+    ( !defined(POLARSSL_MEMORY_BUFFER_ALLOC_C) || !defined(POLARSSL_THREADING_C) )
+#error "POLARSSL_MEMORY_THREAD_CACHE defined, but not all prerequisites"
+#endif
+
 #if defined(POLARSSL_PADLOCK_C) && !defined(POLARSSL_HAVE_ASM)
 #error "POLARSSL_PADLOCK_C defined, but not all prerequisites"
 #endif
@@ -2332,6 +2441,11 @@
 #error "POLARSSL_SSL_SERVER_NAME_INDICATION defined, but not all prerequisites"
 #endif
 
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE) && \
+        !defined(POLARSSL_X509_CRT_PARSE_C)
+#error "POLARSSL_SSL_ASYNC_PRIVATE defined, but not all prerequisites"
+#endif
+
 #if defined(POLARSSL_THREADING_PTHREAD)
 #if !defined(POLARSSL_THREADING_C) || defined(POLARSSL_THREADING_IMPL)
 #error "POLARSSL_THREADING_PTHREAD defined, but not all prerequisites"
@@ -246,6 +246,35 @@ int dhm_calc_secret( dhm_context *ctx,
  */
 void dhm_free( dhm_context *ctx );
 
+/**
+ * \brief          Pre-compute a fixed-base table for the group (P, G) and
+ *                 add it to the process-wide cache.
+ *
+ *                 Once a group is cached, dhm_make_params() and
+ *                 dhm_make_public() compute G^X with mpi_exp_mod_fixed()
+ *                 on the shared table in every context using the same P
+ *                 and G, which takes about a third of the time of
+ *                 mpi_exp_mod(). dhm_calc_secret() is not affected.
+ *
+ * \param P        Prime modulus
+ * \param G        Generator
+ *
+ * \return         0 if successful (or already cached),
+ *                 POLARSSL_ERR_DHM_BAD_INPUT_DATA if the cache is full,
+ *                 or a POLARSSL_ERR_MPI_XXX error code
+ *
+ * \note           Tables are immutable once added, so lookups need no
+ *                 locking. However this function and dhm_base_cache_free()
+ *                 are not thread-safe: call them at start-up and shutdown,
+ *                 while no other thread is using the DHM module.
+ */
+int dhm_base_cache_add( const mpi *P, const mpi *G );
+
+/**
+ * \brief          Free all tables in the fixed-base cache
+ */
+void dhm_base_cache_free( void );
+
 #if defined(POLARSSL_ASN1_PARSE_C)
 /** \ingroup x509_module */
 /**
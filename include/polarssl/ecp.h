@@ -212,6 +212,17 @@ ecp_keypair;
  * Change this value to 0 to reduce peak memory usage.
  */
 #define POLARSSL_ECP_FIXED_POINT_OPTIM  1   /**< Enable fixed-point speed-up */
+
+/*
+ * Window size used for the generator tables of ecp_comb_cache_add().
+ *
+ * These tables are computed once per curve and shared by all groups and
+ * threads, so a larger window than POLARSSL_ECP_WINDOW_SIZE usually pays
+ * off. Each table holds 2^(w-1) points.
+ *
+ * Range: 2 <= value <= 7
+ */
+#define POLARSSL_ECP_COMB_CACHE_WINDOW  7   /**< Window for cached tables */
 #endif
 
 /*
@@ -550,6 +561,65 @@ int ecp_mul( ecp_group *grp, ecp_point *R,
              const mpi *m, const ecp_point *P,
              int (*f_rng)(void *, unsigned char *, size_t), void *p_rng );
 
+/**
+ * \brief           Multiplication and addition of two points by integers:
+ *                  R = m * P + n * Q
+ *
+ * \param grp       ECP group
+ * \param R         Destination point
+ * \param m         Integer by which to multiply P
+ * \param P         Point to multiply by m
+ * \param n         Integer by which to multiply Q
+ * \param Q         Point to be multiplied by n
+ *
+ * \return          0 if successful,
+ *                  POLARSSL_ERR_ECP_INVALID_KEY if m or n is not in the
+ *                  range 0 .. N-1, or P or Q is not a valid pubkey,
+ *                  POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE if grp is not a
+ *                  short Weierstrass curve,
+ *                  POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
+ *
+ * \note            This function does NOT run in constant time and must
+ *                  only be used with public data, for example to verify
+ *                  signatures. It is much faster than two calls to ecp_mul()
+ *                  followed by ecp_add(), especially if P is the generator
+ *                  and a table for it is available (see ecp_comb_cache_add()).
+ */
+int ecp_muladd( const ecp_group *grp, ecp_point *R,
+                const mpi *m, const ecp_point *P,
+                const mpi *n, const ecp_point *Q );
+
+/**
+ * \brief           Pre-compute the table used for multiplications of the
+ *                  generator of a curve and add it to the process-wide
+ *                  comb cache.
+ *
+ *                  Once a curve is cached, every ecp_mul() of its generator
+ *                  (key generation, ECDSA signatures, ECDHE) uses the
+ *                  shared table in any group loaded with ecp_use_known_dp(),
+ *                  instead of building one per group, and leaves the group
+ *                  untouched.
+ *
+ * \param id        Curve identifier
+ *
+ * \return          0 if successful (or already cached),
+ *                  POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE if the curve is not
+ *                  supported or is not a short Weierstrass curve,
+ *                  POLARSSL_ERR_ECP_MALLOC_FAILED or a POLARSSL_ERR_MPI_XXX
+ *                  error code otherwise
+ *
+ * \note            Tables are immutable once added, so lookups need no
+ *                  locking. However this function and ecp_comb_cache_free()
+ *                  are not thread-safe: call them at start-up and shutdown,
+ *                  while no other thread is using the ECP module.
+ */
+int ecp_comb_cache_add( ecp_group_id id );
+
+/**
+ * \brief           Free all tables in the comb cache
+ */
+void ecp_comb_cache_free( void );
+
 /**
  * \brief           Check that a point is a valid public key on this curve
  *
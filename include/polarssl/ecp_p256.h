@@ -0,0 +1,80 @@
+/**
+ * \file ecp_p256.h
+ *
+ * \brief Dedicated implementation of secp256r1 with fixed-size arithmetic
+ *
+ *  Copyright (C) 2006-2014, Brainspark B.V.
+ *
+ *  This file is part of PolarSSL (http://www.polarssl.org)
+ *  Lead Maintainer: Paul Bakker <polarssl_maintainer at polarssl.org>
+ *
+ *  All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef POLARSSL_ECP_P256_H
+#define POLARSSL_ECP_P256_H
+
+#include "ecp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief           Multiplication by an integer on secp256r1: R = m * P
+ *                  (called by ecp_mul(), which checks its arguments)
+ *
+ * \param grp       ECP group, loaded with POLARSSL_ECP_DP_SECP256R1
+ * \param R         Destination point
+ * \param m         Integer by which to multiply, 0 <= m < N
+ * \param P         Point to multiply, a valid public key
+ * \param f_rng     RNG function for blinding, or NULL
+ * \param p_rng     RNG parameter
+ *
+ * \return          0 if successful,
+ *                  POLARSSL_ERR_ECP_RANDOM_FAILED if blinding failed,
+ *                  or a POLARSSL_ERR_MPI_XXX error code
+ *
+ * \note            Runs in constant time. Multiplications of the generator
+ *                  use an embedded table of precomputed points.
+ */
+int ecp_p256_mul( const ecp_group *grp, ecp_point *R,
+                  const mpi *m, const ecp_point *P,
+                  int (*f_rng)(void *, unsigned char *, size_t),
+                  void *p_rng );
+
+/**
+ * \brief           Linear combination on secp256r1: R = m * P + n * Q
+ *                  (called by ecp_muladd(), which checks its arguments)
+ *
+ * \param grp       ECP group, loaded with POLARSSL_ECP_DP_SECP256R1
+ * \param R         Destination point
+ * \param m         Integer by which to multiply P, 0 <= m < N
+ * \param P         Point to multiply by m, a valid public key
+ * \param n         Integer by which to multiply Q, 0 <= n < N
+ * \param Q         Point to multiply by n, a valid public key
+ *
+ * \return          0 if successful, or a POLARSSL_ERR_MPI_XXX error code
+ */
+int ecp_p256_muladd( const ecp_group *grp, ecp_point *R,
+                     const mpi *m, const ecp_point *P,
+                     const mpi *n, const ecp_point *Q );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POLARSSL_ECP_P256_H */
@@ -43,6 +43,12 @@ typedef UINT64 uint64_t;
 #define POLARSSL_ERR_GCM_AUTH_FAILED                       -0x0012  /**< Authenticated decryption failed. */
 #define POLARSSL_ERR_GCM_BAD_INPUT                         -0x0014  /**< Bad input parameters to function. */
 
+#if defined(POLARSSL_GCM_8BIT_TABLES)
+#define GCM_HTABLE_SIZE     256     /**< Entries in HTable (8-bit Shoup) */
+#else
+#define GCM_HTABLE_SIZE     16      /**< Entries in HTable (4-bit Shoup) */
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,8 +58,11 @@ extern "C" {
  */
 typedef struct {
     cipher_context_t cipher_ctx;/*!< cipher context used */
-    uint64_t HL[16];            /*!< Precalculated HTable */
-    uint64_t HH[16];            /*!< Precalculated HTable */
+    uint64_t HL[GCM_HTABLE_SIZE];/*!< Precalculated HTable */
+    uint64_t HH[GCM_HTABLE_SIZE];/*!< Precalculated HTable */
+#if defined(POLARSSL_AESNI_C)
+    unsigned char HP[128];      /*!< H^8..H^1 for aggregated CLMUL GHASH */
+#endif
     uint64_t len;               /*!< Total data length */
     uint64_t add_len;           /*!< Total add length */
     unsigned char base_ectr[16];/*!< First ECTR for tag */
@@ -33,6 +33,7 @@
 
 #if !defined(POLARSSL_CONFIG_OPTIONS)
 #define POLARSSL_MEMORY_ALIGN_MULTIPLE       4 /**< Align on multiples of this value */
+#define POLARSSL_MEMORY_THREAD_CACHE_SIZE   16 /**< Blocks cached per size class and thread */
 #endif /* POLARSSL_CONFIG_OPTIONS */
 
 #define MEMORY_VERIFY_NONE         0
@@ -53,8 +54,12 @@ extern "C" {
  *          (Provided polarssl_malloc() and polarssl_free() are thread-safe if
  *           POLARSSL_THREADING_C is defined)
  *
- * \note    This code is not optimized and provides a straight-forward
- *          implementation of a stack-based memory allocator.
+ * \note    Blocks up to 4096 bytes are rounded up to one of a few size
+ *          classes. When freed they are kept in a free list per class
+ *          (and in a per-thread cache if POLARSSL_MEMORY_THREAD_CACHE is
+ *          defined) and only merged back into the heap when an allocation
+ *          cannot be satisfied otherwise. Larger blocks are allocated with
+ *          a first-fit search.
  *
  * \param buf   buffer to use as heap
  * \param len   size of the buffer
@@ -78,6 +83,15 @@ void memory_buffer_alloc_free( void );
  */
 void memory_buffer_set_verify( int verify );
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+/**
+ * \brief   Give the blocks cached by the calling thread back to the heap.
+ *          Should be called by each thread using the allocator before it
+ *          exits, as its cached blocks are lost otherwise.
+ */
+void memory_buffer_alloc_thread_flush( void );
+#endif /* POLARSSL_MEMORY_THREAD_CACHE */
+
 #if defined(POLARSSL_MEMORY_DEBUG)
 /**
  * \brief   Print out the status of the allocated memory (primarily for use
@@ -42,11 +42,22 @@
 #define POLARSSL_ERR_NET_WANT_WRITE                        -0x0054  /**< Connection requires a write call. */
 
 #define POLARSSL_NET_LISTEN_BACKLOG         10 /**< The backlog that listen() should use. */
+#define POLARSSL_NET_MAX_IOV                16 /**< Maximum buffers per net_sendv() call. */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * \brief          Buffer descriptor for vectored writes
+ */
+typedef struct
+{
+    const unsigned char *buf;   /*!< start of the data                */
+    size_t len;                 /*!< length of the data               */
+}
+net_iovec;
+
 /**
  * \brief          Initiate a TCP connection with host:port
  *
@@ -146,6 +157,22 @@ int net_recv( void *ctx, unsigned char *buf, size_t len );
  */
 int net_send( void *ctx, const unsigned char *buf, size_t len );
 
+/**
+ * \brief          Write data from several buffers in one call, as writev()
+ *                 does. If no error occurs, the actual amount written is
+ *                 returned, which may end in the middle of any buffer.
+ *
+ * \param ctx      Socket
+ * \param iov      The buffers to write, in order
+ * \param iovcnt   The number of buffers (only the first
+ *                 POLARSSL_NET_MAX_IOV are used)
+ *
+ * \return         This function returns the number of bytes sent,
+ *                 or a non-zero error code; POLARSSL_ERR_NET_WANT_WRITE
+ *                 indicates write() is blocking.
+ */
+int net_sendv( void *ctx, const net_iovec *iov, size_t iovcnt );
+
 /**
  * \brief          Gracefully shutdown the connection
  *
@@ -61,6 +61,12 @@
 #define RSA_SIGN        1
 #define RSA_CRYPT       2
 
+#define POLARSSL_RSA_MAX_PRIMES     4   /**< Maximum number of prime factors */
+
+#if !defined(POLARSSL_CONFIG_OPTIONS)
+#define POLARSSL_RSA_BLINDING_SLOTS 4   /**< Independent blinding pairs per context */
+#endif /* !POLARSSL_CONFIG_OPTIONS */
+
 /*
  * The above constants may be used even if the RSA module is compile out,
  * eg for alternative (PKCS#11) RSA implemenations in the PK layers.
@@ -71,12 +77,41 @@
 extern "C" {
 #endif
 
+/**
+ * \brief          Additional prime factor of a multi-prime key,
+ *                 OtherPrimeInfo in PKCS#1 v2.1 (RFC 3447)
+ */
+typedef struct
+{
+    mpi R;                      /*!<  prime factor r_i  */
+    mpi D;                      /*!<  D % (r_i - 1)     */
+    mpi T;                      /*!<  1 / (P * Q * ... * r_(i-1)) % r_i */
+    mpi RR;                     /*!<  cached R^2 mod r_i */
+}
+rsa_prime_info;
+
+#if !defined(POLARSSL_RSA_NO_CRT)
+/**
+ * \brief          Pair of blinding values, used by one private
+ *                 operation at a time
+ */
+typedef struct
+{
+    mpi Vi;                     /*!<  cached blinding value     */
+    mpi Vf;                     /*!<  cached un-blinding value  */
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;    /*!<  Protects this pair        */
+#endif
+}
+rsa_blinding;
+#endif
+
 /**
  * \brief          RSA context structure
  */
 typedef struct
 {
-    int ver;                    /*!<  always 0          */
+    int ver;                    /*!<  0, or 1 for multi-prime keys */
     size_t len;                 /*!<  size(N) in chars  */
 
     mpi N;                      /*!<  public modulus    */
@@ -93,9 +128,14 @@ typedef struct
     mpi RP;                     /*!<  cached R^2 mod P  */
     mpi RQ;                     /*!<  cached R^2 mod Q  */
 
+    size_t others;              /*!<  number of additional primes  */
+    rsa_prime_info other[POLARSSL_RSA_MAX_PRIMES - 2];
+                                /*!<  additional primes r_3, ...    */
+
 #if !defined(POLARSSL_RSA_NO_CRT)
-    mpi Vi;                     /*!<  cached blinding value     */
-    mpi Vf;                     /*!<  cached un-blinding value  */
+    rsa_blinding blinding[POLARSSL_RSA_BLINDING_SLOTS];
+                                /*!<  independent blinding pairs    */
+    unsigned int next_blinding; /*!<  pair used by the next call    */
 #endif
 
     int padding;                /*!<  RSA_PKCS_V15 for 1.5 padding and
@@ -110,6 +150,23 @@ typedef struct
 }
 rsa_context;
 
+/**
+ * \brief          One private key operation of a batch, see rsa_pkcs1_batch()
+ */
+typedef struct
+{
+    int type;                   /*!<  RSA_SIGN or RSA_CRYPT (decryption)  */
+    md_type_t md_alg;           /*!<  RSA_SIGN: hash algorithm            */
+    unsigned int hashlen;       /*!<  RSA_SIGN: length for MD_NONE only   */
+    const unsigned char *input; /*!<  hash, or ctx->len bytes ciphertext  */
+    unsigned char *output;      /*!<  ctx->len bytes signature, or
+                                      plaintext                         */
+    size_t output_max_len;      /*!<  RSA_CRYPT: size of output         */
+    size_t olen;                /*!<  RSA_CRYPT: length of plaintext    */
+    int ret;                    /*!<  result of this operation          */
+}
+rsa_batch_op;
+
 /**
  * \brief          Initialize an RSA context
  *
@@ -161,6 +218,31 @@ int rsa_gen_key( rsa_context *ctx,
                  void *p_rng,
                  unsigned int nbits, int exponent );
 
+/**
+ * \brief          Generate a multi-prime RSA keypair (RFC 3447)
+ *
+ * \param ctx      RSA context that will hold the key
+ * \param f_rng    RNG function
+ * \param p_rng    RNG parameter
+ * \param nbits    size of the public key in bits
+ * \param exponent public exponent (e.g., 65537)
+ * \param nprimes  number of prime factors, from 2 to
+ *                 POLARSSL_RSA_MAX_PRIMES
+ *
+ * \note           rsa_init() must be called beforehand to setup
+ *                 the RSA context.
+ *
+ * \note           Each additional prime makes private operations cheaper,
+ *                 but the primes smaller. Three primes are commonly used
+ *                 with 2048 to 4096-bit keys, and four from 4096 bits.
+ *
+ * \return         0 if successful, or an POLARSSL_ERR_RSA_XXX error code
+ */
+int rsa_gen_key_multi( rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       unsigned int nbits, int exponent, int nprimes );
+
 /**
  * \brief          Check a public RSA key
  *
@@ -212,6 +294,10 @@ int rsa_public( rsa_context *ctx,
  *
  * \note           The input and output buffers must be large
  *                 enough (eg. 128 bytes if RSA-1024 is used).
+ *
+ * \note           Blinding values are taken in turn from
+ *                 POLARSSL_RSA_BLINDING_SLOTS independent pairs, so that
+ *                 threads sharing the context rarely wait on each other.
  */
 int rsa_private( rsa_context *ctx,
                  int (*f_rng)(void *, unsigned char *, size_t),
@@ -219,6 +305,36 @@ int rsa_private( rsa_context *ctx,
                  const unsigned char *input,
                  unsigned char *output );
 
+/**
+ * \brief          Do several RSA private key operations at once
+ *
+ * \param ctx      RSA context
+ * \param f_rng    RNG function (Needed for blinding)
+ * \param p_rng    RNG parameter
+ * \param count    number of operations
+ * \param input    count input buffers
+ * \param output   count output buffers
+ * \param result   count results, set to 0 for each operation that
+ *                 succeeded or POLARSSL_ERR_RSA_BAD_INPUT_DATA if its
+ *                 input is not smaller than N
+ *
+ * \return         0 if the batch was processed (see result), or an
+ *                 POLARSSL_ERR_RSA_XXX error code, in which case no
+ *                 output is valid
+ *
+ * \note           Every operation gets its own blinding values, and the
+ *                 exponentiations of all operations are done together
+ *                 with mpi_exp_mod_batch(). An input buffer may be the
+ *                 same as its output buffer.
+ */
+int rsa_private_batch( rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       size_t count,
+                       const unsigned char * const input[],
+                       unsigned char * const output[],
+                       int result[] );
+
 /**
  * \brief          Generic wrapper to perform a PKCS#1 encryption using the
  *                 mode from the context. Add the message padding, then do an
@@ -572,6 +688,31 @@ int rsa_rsassa_pss_verify( rsa_context *ctx,
                            const unsigned char *hash,
                            const unsigned char *sig );
 
+/**
+ * \brief          Perform several PKCS#1 private key operations (signatures
+ *                 and decryptions) with the same key, using the padding
+ *                 mode from the context
+ *
+ * \param ctx      RSA context
+ * \param f_rng    RNG function
+ * \param p_rng    RNG parameter
+ * \param ops      array of operations, each with its own result in ret
+ * \param count    number of operations
+ *
+ * \return         0 if the batch was processed (see each ops[i].ret), or
+ *                 an POLARSSL_ERR_RSA_XXX error code
+ *
+ * \note           With RSA_PKCS_V15 the RSA operations of the whole batch
+ *                 are done by rsa_private_batch(). With RSA_PKCS_V21 the
+ *                 operations are done one after the other with
+ *                 rsa_pkcs1_sign() and rsa_pkcs1_decrypt().
+ */
+int rsa_pkcs1_batch( rsa_context *ctx,
+                     int (*f_rng)(void *, unsigned char *, size_t),
+                     void *p_rng,
+                     rsa_batch_op *ops,
+                     size_t count );
+
 /**
  * \brief          Copy the components of an RSA context
  *
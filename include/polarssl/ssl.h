@@ -71,6 +71,10 @@
 #include "zlib.h"
 #endif
 
+#if defined(POLARSSL_THREADING_C)
+#include "threading.h"
+#endif
+
 #if defined(POLARSSL_HAVE_TIME)
 #include <time.h>
 #endif
@@ -140,6 +144,7 @@
 #define POLARSSL_ERR_SSL_UNKNOWN_IDENTITY                  -0x6C80  /**< Unknown identity received (eg, PSK identity) */
 #define POLARSSL_ERR_SSL_INTERNAL_ERROR                    -0x6C00  /**< Internal error (eg, unexpected failure in lower-level module) */
 #define POLARSSL_ERR_SSL_COUNTER_WRAPPING                  -0x6B80  /**< A counter would wrap (eg, too many messages exchanged). */
+#define POLARSSL_ERR_SSL_PRIVATE_PENDING                   -0x6B00  /**< A private key operation is queued or in progress, call the handshake again once it is done. */
 
 /*
  * Various constants
@@ -228,8 +233,16 @@
 #define SSL_SESSION_TICKETS_DISABLED     0
 #define SSL_SESSION_TICKETS_ENABLED      1
 
+#define SSL_PRIV_OP_NONE                0
+#define SSL_PRIV_OP_QUEUED              1   /* in a ssl_rsa_batch        */
+#define SSL_PRIV_OP_ASYNC               2   /* started by f_async_xxx    */
+#define SSL_PRIV_OP_DONE                3
+
 #if !defined(POLARSSL_CONFIG_OPTIONS)
 #define SSL_DEFAULT_TICKET_LIFETIME     86400 /**< Lifetime of session tickets (if enabled) */
+#define SSL_TICKET_MAX_KEYS                 2 /**< Ticket keys kept for decryption (current and older) */
+#define SSL_MAX_OUT_RECORDS                16 /**< Maximum number of queued output records */
+#define SSL_MAX_RSA_BATCH                  16 /**< Maximum number of queued RSA private key operations */
 #endif /* !POLARSSL_CONFIG_OPTIONS */
 
 /*
@@ -244,9 +257,9 @@
 #endif /* !POLARSSL_CONFIG_OPTIONS */
 
 /*
- * Allow an extra 301 bytes for the record header
- * and encryption overhead: counter (8) + header (5) + MAC (32) + padding (256)
- * and allow for a maximum of 1024 of compression expansion if
+ * Allow an extra 333 bytes for the record header
+ * and encryption overhead: counter (8) + header (5) + IV (16) + MAC (48) +
+ * padding (256) and allow for a maximum of 1024 of compression expansion if
  * enabled.
  */
 #if defined(POLARSSL_ZLIB_SUPPORT)
@@ -255,7 +268,10 @@
 #define SSL_COMPRESSION_ADD             0
 #endif
 
-#define SSL_BUFFER_LEN (SSL_MAX_CONTENT_LEN + SSL_COMPRESSION_ADD + 301)
+#define SSL_BUFFER_OVERHEAD (SSL_COMPRESSION_ADD + 333)
+#define SSL_BUFFER_LEN (SSL_MAX_CONTENT_LEN + SSL_BUFFER_OVERHEAD)
+
+#define SSL_MIN_CONTENT_LEN           512   /**< Smallest buffer content size (MFL 2^9) */
 
 #define SSL_EMPTY_RENEGOTIATION_INFO    0xFF   /**< renegotiation info ext */
 
@@ -420,10 +436,20 @@ typedef struct _ssl_transform ssl_transform;
 typedef struct _ssl_handshake_params ssl_handshake_params;
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
 typedef struct _ssl_ticket_keys ssl_ticket_keys;
+typedef struct _ssl_ticket_key_store ssl_ticket_key_store;
 #endif
 #if defined(POLARSSL_X509_CRT_PARSE_C)
 typedef struct _ssl_key_cert ssl_key_cert;
 #endif
+typedef struct _ssl_buffer_pool ssl_buffer_pool;
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+typedef struct _ssl_rsa_batch ssl_rsa_batch;
+#endif
+
+/*
+ * A buffer of application data, for ssl_writev() and f_send_vec
+ */
+typedef net_iovec ssl_iovec;
 
 /*
  * This structure is used for storing current session data.
@@ -571,6 +597,27 @@ struct _ssl_handshake_params
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
     int new_session_ticket;             /*!< use NewSessionTicket?    */
 #endif /* POLARSSL_SSL_SESSION_TICKETS */
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+    /*
+     * Private key operation done out of line (batch or async callbacks)
+     */
+    int priv_op_state;                  /*!<  SSL_PRIV_OP_XXX         */
+    int priv_op_ret;                    /*!<  result once done        */
+    unsigned char *priv_op_out;         /*!<  signature or plaintext  */
+    size_t priv_op_out_max;             /*!<  room at priv_op_out     */
+    size_t priv_op_len;                 /*!<  output length once done */
+    size_t priv_op_offset;              /*!<  ServerKeyExchange length
+                                              before the signature    */
+    unsigned char priv_op_hash[64];
+                                        /*!<  hash to sign            */
+#endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    rsa_batch_op rsa_op;                /*!<  queued operation        */
+    rsa_context *rsa_op_key;            /*!<  key of the operation    */
+    ssl_rsa_batch *rsa_op_batch;        /*!<  batch holding it        */
+    ssl_handshake_params **rsa_op_slot; /*!<  entry of the run doing it */
+#endif
 };
 
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
@@ -580,9 +627,31 @@ struct _ssl_handshake_params
 struct _ssl_ticket_keys
 {
     unsigned char key_name[16];     /*!< name to quickly discard bad tickets */
-    aes_context enc;                /*!< encryption context                  */
-    aes_context dec;                /*!< decryption context                  */
+    unsigned char aes_key[16];      /*!< encryption key                      */
     unsigned char mac_key[16];      /*!< authentication key                  */
+#if defined(POLARSSL_HAVE_TIME)
+    time_t generation_time;         /*!< time the keys were generated        */
+#endif
+};
+
+/*
+ * Set of ticket keys, possibly shared by several SSL contexts.
+ * New tickets are secured with the active keys, older keys are kept
+ * around so that tickets issued before a rotation can still be used.
+ */
+struct _ssl_ticket_key_store
+{
+    ssl_ticket_keys keys[SSL_TICKET_MAX_KEYS];  /*!< key slots           */
+    int active;                     /*!< slot of the keys for new tickets    */
+    int count;                      /*!< number of usable key slots          */
+    int rotation_interval;          /*!< seconds between rotations, 0: never */
+
+    int (*f_rng)(void *, unsigned char *, size_t);
+    void *p_rng;                    /*!< context for the RNG function        */
+
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;        /*!< mutex                               */
+#endif
 };
 #endif /* POLARSSL_SSL_SESSION_TICKETS */
 
@@ -599,6 +668,38 @@ struct _ssl_key_cert
 };
 #endif /* POLARSSL_X509_CRT_PARSE_C */
 
+/*
+ * Record buffers released by idle connections, shared between contexts
+ */
+struct _ssl_buffer_pool
+{
+    void *head;                 /*!< free buffers (linked in place)   */
+    size_t count;               /*!< number of free buffers           */
+    size_t max_count;           /*!< maximum number of free buffers   */
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;    /*!< mutex                            */
+#endif
+};
+
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+/*
+ * RSA private key operations queued by server handshakes, done together
+ * by ssl_rsa_batch_run()
+ */
+struct _ssl_rsa_batch
+{
+    ssl_handshake_params *queue[SSL_MAX_RSA_BATCH]; /*!< queued handshakes */
+    size_t count;               /*!< number of queued operations      */
+
+    int (*f_rng)(void *, unsigned char *, size_t);
+    void *p_rng;                /*!< context for the RNG function     */
+
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;    /*!< mutex                            */
+#endif
+};
+#endif /* POLARSSL_RSA_C && POLARSSL_X509_CRT_PARSE_C */
+
 struct _ssl_context
 {
     /*
@@ -622,6 +723,7 @@ struct _ssl_context
     void (*f_dbg)(void *, int, const char *);
     int (*f_recv)(void *, unsigned char *, size_t);
     int (*f_send)(void *, const unsigned char *, size_t);
+    int (*f_send_vec)(void *, const ssl_iovec *, size_t);
     int (*f_get_cache)(void *, ssl_session *);
     int (*f_set_cache)(void *, const ssl_session *);
 
@@ -696,6 +798,24 @@ struct _ssl_context
     size_t out_msglen;          /*!< record header: message length    */
     size_t out_left;            /*!< amount of data not yet written   */
 
+    unsigned char *out_buf;     /*!< output record slots (out_ctr is
+                                     at the start of the current one) */
+    size_t out_records;         /*!< number of output record slots    */
+    size_t out_queued;          /*!< sealed records not yet written   */
+
+    /*
+     * Record buffer sizing
+     */
+    size_t max_content_len;     /*!< configured buffer content size   */
+    size_t in_content_len;      /*!< content size of the input buffer */
+    size_t out_content_len;     /*!< content size of each output slot */
+    ssl_buffer_pool *buf_pool;  /*!< pool for buffers released while
+                                     idle (NULL: never release)       */
+    unsigned char in_ctr_idle[8];   /*!< in_ctr while released        */
+    unsigned char out_ctr_idle[8];  /*!< out_ctr while released       */
+    size_t in_msg_idle;         /*!< in_msg offset while released     */
+    size_t out_msg_idle;        /*!< out_msg offset while released    */
+
 #if defined(POLARSSL_ZLIB_SUPPORT)
     unsigned char *compress_buf;        /*!<  zlib data buffer        */
 #endif
@@ -712,13 +832,33 @@ struct _ssl_context
     x509_crt *ca_chain;                 /*!<  own trusted CA chain      */
     x509_crl *ca_crl;                   /*!<  trusted CA CRLs           */
     const char *peer_cn;                /*!<  expected peer CN          */
+#if defined(POLARSSL_SHA256_C)
+    x509_verify_cache *verify_cache;    /*!<  verified chains (or NULL) */
+#endif
 #endif /* POLARSSL_X509_CRT_PARSE_C */
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    ssl_rsa_batch *rsa_batch;           /*!<  queue for RSA private key
+                                              operations (NULL: none) */
+#endif
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+    int (*f_async_sign)(void *, ssl_context *, pk_context *, md_type_t,
+                        const unsigned char *, size_t);
+    int (*f_async_decrypt)(void *, ssl_context *, pk_context *,
+                           const unsigned char *, size_t);
+    int (*f_async_resume)(void *, ssl_context *, unsigned char *, size_t *,
+                          size_t);
+    void (*f_async_cancel)(void *, ssl_context *);
+    void *p_async;                      /*!<  context for async calls */
+    void *async_data;                   /*!<  data of the current
+                                              async operation         */
+#endif
 
     /*
      * Support for generating and checking session tickets
      */
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
-    ssl_ticket_keys *ticket_keys;       /*!<  keys for ticket encryption */
+    ssl_ticket_key_store *ticket_store; /*!<  keys for ticket encryption */
+    int ticket_store_own_alloc;         /*!<  did we allocate the store? */
 #endif /* POLARSSL_SSL_SESSION_TICKETS */
 
     /*
@@ -941,6 +1081,19 @@ void ssl_set_bio( ssl_context *ssl,
         int (*f_recv)(void *, unsigned char *, size_t), void *p_recv,
         int (*f_send)(void *, const unsigned char *, size_t), void *p_send );
 
+/**
+ * \brief          Set an optional vectored write callback (e.g. net_sendv()),
+ *                 used to send all queued records in one call (see
+ *                 ssl_set_output_queue()). It is called with the p_send
+ *                 parameter given to ssl_set_bio(), and must behave like
+ *                 the write callback apart from taking several buffers.
+ *
+ * \param ssl      SSL context
+ * \param f_send_vec vectored write callback, or NULL to use f_send only
+ */
+void ssl_set_bio_vec( ssl_context *ssl,
+        int (*f_send_vec)(void *, const ssl_iovec *, size_t) );
+
 /**
  * \brief          Set the session cache callbacks (server-side only)
  *                 If not set, no session resuming is done.
@@ -1033,6 +1186,10 @@ void ssl_set_ciphersuites_for_version( ssl_context *ssl,
 /**
  * \brief          Set the data required to verify peer certificate
  *
+ *                 Note: with many CAs, index ca_chain with
+ *                 x509_crt_index_build() so that issuers are not looked
+ *                 up by walking the chain.
+ *
  * \param ssl      SSL context
  * \param ca_chain trusted CA chain (meaning all fully trusted top-level CAs)
  * \param ca_crl   trusted CA CRLs
@@ -1041,6 +1198,23 @@ void ssl_set_ciphersuites_for_version( ssl_context *ssl,
 void ssl_set_ca_chain( ssl_context *ssl, x509_crt *ca_chain,
                        x509_crl *ca_crl, const char *peer_cn );
 
+#if defined(POLARSSL_SHA256_C)
+/**
+ * \brief          Set the cache of verified peer certificate chains.
+ *                 (Default: NULL = none)
+ *
+ *                 A peer chain already verified against the same CA chain
+ *                 and CRLs is accepted without checking its signatures
+ *                 again, as long as it is still within its validity period.
+ *                 The cache can be shared between contexts. It is not used
+ *                 when a verification callback is set with ssl_set_verify().
+ *
+ * \param ssl      SSL context
+ * \param cache    cache initialized with x509_verify_cache_init()
+ */
+void ssl_set_verify_cache( ssl_context *ssl, x509_verify_cache *cache );
+#endif
+
 /**
  * \brief          Set own certificate chain and private key
  *
@@ -1361,6 +1535,65 @@ int ssl_set_session_tickets( ssl_context *ssl, int use_tickets );
  * \param lifetime session ticket lifetime
  */
 void ssl_set_session_ticket_lifetime( ssl_context *ssl, int lifetime );
+
+/**
+ * \brief          Use a shared ticket key store (server only)
+ *                 (Default: a private store is generated for each context
+ *                 by ssl_set_session_tickets())
+ *
+ *                 Tickets issued by any context using the store can be
+ *                 used with any other context using it.
+ *
+ * \note           The store must outlive the SSL context, and is not freed
+ *                 by ssl_free().
+ *
+ * \param ssl      SSL context
+ * \param store    initialized ticket key store
+ */
+void ssl_set_session_ticket_store( ssl_context *ssl,
+                                   ssl_ticket_key_store *store );
+
+/**
+ * \brief          Initialize a ticket key store and generate its first keys
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled)
+ *
+ * \note           The RNG is only used, under the store mutex, when keys
+ *                 are (re)generated. It should not be used concurrently by
+ *                 other threads, so it is best to give the store its own.
+ *
+ * \param store    ticket key store
+ * \param f_rng    RNG function
+ * \param p_rng    RNG parameter
+ * \param rotation_interval    seconds after which the active keys are
+ *                 replaced when a new ticket is issued (0: never). A
+ *                 ticket stays decryptable across SSL_TICKET_MAX_KEYS - 1
+ *                 rotations.
+ *
+ * \return         0 if successful, or a specific RNG or AES error code
+ */
+int ssl_ticket_store_init( ssl_ticket_key_store *store,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng,
+                           int rotation_interval );
+
+/**
+ * \brief          Generate new active keys, dropping the oldest ones if
+ *                 SSL_TICKET_MAX_KEYS are already in use
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled)
+ *
+ * \param store    ticket key store
+ *
+ * \return         0 if successful, or a specific RNG or AES error code
+ */
+int ssl_ticket_store_rotate( ssl_ticket_key_store *store );
+
+/**
+ * \brief          Free referenced items in a ticket key store and clear
+ *                 memory
+ *
+ * \param store    ticket key store
+ */
+void ssl_ticket_store_free( ssl_ticket_key_store *store );
 #endif /* POLARSSL_SSL_SESSION_TICKETS */
 
 /**
@@ -1407,6 +1640,210 @@ void ssl_set_renegotiation( ssl_context *ssl, int renegotiation );
  */
 void ssl_legacy_renegotiation( ssl_context *ssl, int allow_legacy );
 
+/**
+ * \brief          Set the number of encrypted records that can be queued in
+ *                 the output buffer and sent by one ssl_flush_output()
+ *                 (Default: 1, i.e. every record is sent when written)
+ *
+ * \param ssl      SSL context
+ * \param records  number of record slots, at most SSL_MAX_OUT_RECORDS.
+ *                 Each slot uses SSL_BUFFER_OVERHEAD bytes plus the
+ *                 content size (see ssl_set_max_content_len()).
+ *
+ * \return         0 if successful, POLARSSL_ERR_SSL_BAD_INPUT_DATA if the
+ *                 value is out of range or output is still pending, or
+ *                 POLARSSL_ERR_SSL_MALLOC_FAILED
+ */
+int ssl_set_output_queue( ssl_context *ssl, size_t records );
+
+/**
+ * \brief          Set the maximum record content size the input and output
+ *                 buffers are allocated for
+ *                 (Default: SSL_MAX_CONTENT_LEN)
+ *
+ *                 Note: records or handshake messages larger than this
+ *                 cannot be received or sent. Only reduce it if the peer
+ *                 is known to send smaller records, for instance because
+ *                 a maximum fragment length has been negotiated.
+ *                 When a maximum fragment length is negotiated, the
+ *                 buffers are shrunk to it after the handshake anyway.
+ *
+ * \param ssl      SSL context
+ * \param len      content size, between SSL_MIN_CONTENT_LEN and
+ *                 SSL_MAX_CONTENT_LEN
+ *
+ * \return         0 if successful, POLARSSL_ERR_SSL_BAD_INPUT_DATA if the
+ *                 value is out of range or data is still pending, or
+ *                 POLARSSL_ERR_SSL_MALLOC_FAILED
+ */
+int ssl_set_max_content_len( ssl_context *ssl, size_t len );
+
+/**
+ * \brief          Release the input and output buffers while the
+ *                 connection is idle (handshake over, no data pending in
+ *                 either direction) and get them back from pool on the
+ *                 next read or write.
+ *                 (Default: NULL, buffers are kept for the lifetime of
+ *                 the context)
+ *
+ *                 Note: the pool must outlive every context using it.
+ *                 Data obtained with ssl_read_get_buf() keeps the buffers
+ *                 checked out until all of it is consumed by
+ *                 ssl_read_release().
+ *                 Do not call ssl_read() between ssl_write_get_buf() and
+ *                 ssl_write_commit(), the lent buffer could be released.
+ *
+ * \param ssl      SSL context
+ * \param pool     buffer pool, or NULL to keep the buffers
+ */
+void ssl_set_buffer_pool( ssl_context *ssl, ssl_buffer_pool *pool );
+
+/**
+ * \brief          Initialize a pool of record buffers
+ *
+ * \param pool     buffer pool
+ * \param max_count maximum number of free buffers kept in the pool,
+ *                 extra buffers are freed
+ */
+void ssl_buffer_pool_init( ssl_buffer_pool *pool, size_t max_count );
+
+/**
+ * \brief          Free all buffers held by the pool
+ *
+ * \param pool     buffer pool
+ */
+void ssl_buffer_pool_free( ssl_buffer_pool *pool );
+
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+/**
+ * \brief          Queue the RSA private key operations of the server
+ *                 handshake (premaster decryption, ServerKeyExchange
+ *                 signature) in a batch shared with other contexts,
+ *                 instead of doing them at once.
+ *                 (Default: NULL, operations are done at once)
+ *
+ *                 While its operation is queued, ssl_handshake() returns
+ *                 POLARSSL_ERR_SSL_PRIVATE_PENDING: call
+ *                 ssl_rsa_batch_run(), then ssl_handshake() again. A
+ *                 batch that gets full is run at once by the context
+ *                 that fills it.
+ *
+ *                 Note: only keys of type POLARSSL_PK_RSA are queued.
+ *                 The batch must outlive every context using it.
+ *
+ * \param ssl      SSL context
+ * \param batch    batch of operations, or NULL
+ */
+void ssl_set_rsa_batch( ssl_context *ssl, ssl_rsa_batch *batch );
+
+/**
+ * \brief          Initialize a batch of RSA private key operations
+ *
+ * \param batch    batch of operations
+ * \param f_rng    RNG function used for blinding
+ * \param p_rng    RNG parameter
+ */
+void ssl_rsa_batch_init( ssl_rsa_batch *batch,
+                         int (*f_rng)(void *, unsigned char *, size_t),
+                         void *p_rng );
+
+/**
+ * \brief          Do all queued operations, with one rsa_pkcs1_batch()
+ *                 call per key, and empty the batch
+ *
+ *                 The operations are done on copies of their data without
+ *                 holding the batch mutex, so that other contexts can queue
+ *                 new operations, or be freed, meanwhile.
+ *
+ * \param batch    batch of operations
+ *
+ * \return         0 if successful, or an POLARSSL_ERR_RSA_XXX error code
+ *                 (the handshakes of the failed operations then fail)
+ */
+int ssl_rsa_batch_run( ssl_rsa_batch *batch );
+
+/**
+ * \brief          Free a batch of operations
+ *
+ * \param batch    batch of operations
+ */
+void ssl_rsa_batch_free( ssl_rsa_batch *batch );
+#endif /* POLARSSL_RSA_C && POLARSSL_X509_CRT_PARSE_C */
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+/**
+ * \brief          Set callbacks doing the private key operations of the
+ *                 server handshake asynchronously, for instance in a
+ *                 worker thread or a separate key server.
+ *                 (Default: none, operations are done at once)
+ *
+ *                 f_async_sign (p_async, ssl, key, md_alg, hash, hash_len)
+ *                 and f_async_decrypt (p_async, ssl, key, input, len)
+ *                 start the signature of the ServerKeyExchange parameters
+ *                 hash (PKCS#1 v1.5 or ECDSA, as pk_sign() with key) or
+ *                 the decryption of the encrypted premaster secret (as
+ *                 pk_decrypt() with key). They return 0 once the
+ *                 operation is started, POLARSSL_ERR_SSL_HW_ACCEL_FALLTHROUGH
+ *                 to let it be done at once as usual, or an error code
+ *                 that aborts the handshake. Either may be NULL.
+ *
+ *                 While an operation is started, ssl_handshake() returns
+ *                 POLARSSL_ERR_SSL_PRIVATE_PENDING and, each time it is
+ *                 called again, calls f_async_resume (p_async, ssl,
+ *                 output, output_len, output_max_len). That returns
+ *                 POLARSSL_ERR_SSL_PRIVATE_PENDING if the operation is
+ *                 not done yet, otherwise the result of the operation,
+ *                 with the signature or plaintext written to output on
+ *                 success.
+ *
+ *                 f_async_cancel (p_async, ssl) is called if the context
+ *                 is reset or freed while an operation is started, and
+ *                 may be NULL.
+ *
+ *                 Note: ssl_set_async_operation_data() keeps a pointer
+ *                 per context for the callbacks to use.
+ *
+ * \param ssl              SSL context
+ * \param f_async_sign     start a signature, or NULL
+ * \param f_async_decrypt  start a decryption, or NULL
+ * \param f_async_resume   check an operation and get its result, or
+ *                         NULL if both f_async_sign and f_async_decrypt are
+ * \param f_async_cancel   abandon an operation, or NULL
+ * \param p_async          callbacks parameter
+ *
+ * \return                 0 if successful, or POLARSSL_ERR_SSL_BAD_INPUT_DATA
+ *                         if f_async_resume is NULL while a start callback
+ *                         is not
+ */
+int ssl_set_async_private( ssl_context *ssl,
+        int (*f_async_sign)(void *, ssl_context *, pk_context *, md_type_t,
+                            const unsigned char *, size_t),
+        int (*f_async_decrypt)(void *, ssl_context *, pk_context *,
+                               const unsigned char *, size_t),
+        int (*f_async_resume)(void *, ssl_context *, unsigned char *,
+                              size_t *, size_t),
+        void (*f_async_cancel)(void *, ssl_context *),
+        void *p_async );
+
+/**
+ * \brief          Set the data of the current asynchronous operation of
+ *                 this context, for the ssl_set_async_private() callbacks
+ *
+ * \param ssl      SSL context
+ * \param data     operation data (not freed by the library)
+ */
+void ssl_set_async_operation_data( ssl_context *ssl, void *data );
+
+/**
+ * \brief          Return the data set by ssl_set_async_operation_data()
+ *
+ * \param ssl      SSL context
+ *
+ * \return         operation data, or NULL
+ */
+void *ssl_get_async_operation_data( const ssl_context *ssl );
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
 /**
  * \brief          Return the number of data bytes available to read
  *
@@ -1544,9 +1981,103 @@ int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len );
  * \note           When this function returns POLARSSL_ERR_NET_WANT_WRITE,
  *                 it must be called later with the *same* arguments,
  *                 until it returns a positive value.
+ *
+ * \note           At most one record per output slot is written by each
+ *                 call (see ssl_set_output_queue()), so the value returned
+ *                 may be less than 'len'.
  */
 int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len );
 
+/**
+ * \brief          Write application data gathered from several buffers,
+ *                 packed into as few records as possible
+ *
+ * \param ssl      SSL context
+ * \param iov      array of buffers holding the data, in order
+ * \param iovcnt   number of buffers
+ *
+ * \return         This function returns the number of bytes written,
+ *                 or a negative error code.
+ *
+ * \note           At most one record per output slot (see
+ *                 ssl_set_output_queue()) is written by each call, and
+ *                 all these records are flushed together at the end.
+ *                 If less than the total length is written, call it again
+ *                 for the remaining data.
+ *
+ * \note           When this function returns POLARSSL_ERR_NET_WANT_WRITE,
+ *                 it must be called later with the *same* arguments,
+ *                 until it returns a positive value.
+ */
+int ssl_writev( ssl_context *ssl, const ssl_iovec *iov, size_t iovcnt );
+
+/**
+ * \brief          Access decrypted application data in place, without
+ *                 copying it (zero-copy alternative to ssl_read())
+ *
+ * \param ssl      SSL context
+ * \param buf      set to the start of the available data
+ * \param len      set to the number of bytes available, 0 for EOF
+ *
+ * \return         0 if successful, or a negative error code (same as
+ *                 ssl_read()).
+ *
+ * \note           The data stays valid until ssl_read_release() consumes
+ *                 all of it, or until any other read or handshake function
+ *                 is called on the context.
+ */
+int ssl_read_get_buf( ssl_context *ssl, const unsigned char **buf,
+                      size_t *len );
+
+/**
+ * \brief          Release application data obtained by ssl_read_get_buf()
+ *
+ * \param ssl      SSL context
+ * \param len      number of bytes consumed (at most the available length)
+ *
+ * \return         0 if successful, or POLARSSL_ERR_SSL_BAD_INPUT_DATA
+ */
+int ssl_read_release( ssl_context *ssl, size_t len );
+
+/**
+ * \brief          Get a writable slice of the outgoing record buffer, so
+ *                 that application data can be written directly where it
+ *                 will be encrypted (zero-copy alternative to ssl_write())
+ *
+ * \param ssl      SSL context
+ * \param buf      set to the start of the record payload
+ * \param len      set to the maximum payload length, taking a negotiated
+ *                 maximum fragment length into account
+ *
+ * \return         0 if successful, or a negative error code.
+ *
+ * \note           Any pending output is flushed first. When this function
+ *                 returns POLARSSL_ERR_NET_WANT_WRITE, it must be called
+ *                 again later.
+ *
+ * \note           The buffer must be filled and sealed with
+ *                 ssl_write_commit() before any other function writing to
+ *                 the context is called.
+ */
+int ssl_write_get_buf( ssl_context *ssl, unsigned char **buf, size_t *len );
+
+/**
+ * \brief          Encrypt and send, in place, 'len' bytes of application
+ *                 data written to the buffer from ssl_write_get_buf()
+ *
+ * \param ssl      SSL context
+ * \param len      payload length (at most the length of the slice)
+ *
+ * \return         This function returns the number of bytes written,
+ *                 or a negative error code.
+ *
+ * \note           When this function returns POLARSSL_ERR_NET_WANT_WRITE,
+ *                 the record is already sealed: it must be called later
+ *                 with the *same* length, until it returns a positive
+ *                 value.
+ */
+int ssl_write_commit( ssl_context *ssl, size_t len );
+
 /**
  * \brief           Send an alert message
  *
@@ -1628,6 +2159,10 @@ int ssl_write_change_cipher_spec( ssl_context *ssl );
 int ssl_parse_finished( ssl_context *ssl );
 int ssl_write_finished( ssl_context *ssl );
 
+#if defined(POLARSSL_SSL_SESSION_TICKETS)
+int ssl_ticket_store_refresh( ssl_ticket_key_store *store );
+#endif
+
 void ssl_optimize_checksum( ssl_context *ssl, const ssl_ciphersuite_t *ciphersuite_info );
 
 #if defined(POLARSSL_KEY_EXCHANGE__SOME__PSK_ENABLED)
@@ -1641,6 +2176,14 @@ pk_type_t ssl_pk_alg_from_sig( unsigned char sig );
 
 md_type_t ssl_md_alg_from_hash( unsigned char hash );
 
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+int ssl_rsa_batch_queue( ssl_context *ssl );
+#endif
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+int ssl_priv_op_state( ssl_context *ssl );
+#endif
+
 #if defined(POLARSSL_SSL_SET_CURVES)
 int ssl_curve_is_acceptable( const ssl_context *ssl, ecp_group_id grp_id );
 #endif
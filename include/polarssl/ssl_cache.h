@@ -36,6 +36,8 @@
 #if !defined(POLARSSL_CONFIG_OPTIONS)
 #define SSL_CACHE_DEFAULT_TIMEOUT       86400   /*!< 1 day  */
 #define SSL_CACHE_DEFAULT_MAX_ENTRIES      50   /*!< Maximum entries in cache */
+#define SSL_CACHE_DEFAULT_SHARDS            8   /*!< Shards in a sharded cache */
+#define SSL_CACHE_DEFAULT_BUCKETS          64   /*!< Hash buckets per shard */
 #endif /* !POLARSSL_CONFIG_OPTIONS */
 
 #ifdef __cplusplus
@@ -44,6 +46,7 @@ extern "C" {
 
 typedef struct _ssl_cache_context ssl_cache_context;
 typedef struct _ssl_cache_entry ssl_cache_entry;
+typedef struct _ssl_cache_sharded_entry ssl_cache_sharded_entry;
 
 /**
  * \brief   This structure is used for storing cache entries
@@ -73,6 +76,50 @@ struct _ssl_cache_context
 #endif
 };
 
+/**
+ * \brief   Entry of a sharded cache: a cache entry plus its hash bucket
+ *          and LRU list links
+ */
+struct _ssl_cache_sharded_entry
+{
+    ssl_cache_entry entry;              /*!< cached session             */
+    ssl_cache_sharded_entry *hnext;     /*!< next entry in hash bucket  */
+    ssl_cache_sharded_entry *lru_prev;  /*!< more recently used entry   */
+    ssl_cache_sharded_entry *lru_next;  /*!< less recently used entry   */
+};
+
+/**
+ * \brief   Independently locked part of a sharded cache
+ */
+typedef struct
+{
+    ssl_cache_sharded_entry **buckets;  /*!< hash table (by session id) */
+    ssl_cache_sharded_entry *lru_head;  /*!< most recently used entry   */
+    ssl_cache_sharded_entry *lru_tail;  /*!< least recently used entry  */
+    int entries;                        /*!< number of entries          */
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;            /*!< shard mutex                */
+#endif
+}
+ssl_cache_shard;
+
+/**
+ * \brief Sharded cache context
+ *
+ * Sessions are hashed by session ID to one of several shards, each
+ * with its own lock, hash table and LRU list, so lookups and evictions
+ * are O(1) and concurrent handshakes rarely contend for the same lock.
+ */
+typedef struct
+{
+    ssl_cache_shard *shards;    /*!< array of shards                */
+    unsigned int shard_count;   /*!< number of shards (power of 2)  */
+    unsigned int bucket_count;  /*!< buckets per shard (power of 2) */
+    int timeout;                /*!< cache entry timeout            */
+    int max_entries;            /*!< maximum entries (all shards)   */
+}
+ssl_cache_sharded_context;
+
 /**
  * \brief          Initialize an SSL cache context
  *
@@ -127,6 +174,75 @@ void ssl_cache_set_max_entries( ssl_cache_context *cache, int max );
  */
 void ssl_cache_free( ssl_cache_context *cache );
 
+/**
+ * \brief          Initialize a sharded SSL cache context
+ *
+ * \param cache    sharded SSL cache context
+ * \param shards   number of independently locked shards, rounded up to
+ *                 a power of 2 (0 means SSL_CACHE_DEFAULT_SHARDS)
+ * \param buckets  number of hash buckets per shard, rounded up to a
+ *                 power of 2 (0 means SSL_CACHE_DEFAULT_BUCKETS)
+ *
+ * \return         0 if successful, or POLARSSL_ERR_SSL_MALLOC_FAILED
+ */
+int ssl_cache_sharded_init( ssl_cache_sharded_context *cache,
+                            unsigned int shards, unsigned int buckets );
+
+/**
+ * \brief          Sharded cache get callback implementation
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled)
+ *
+ * \param data     sharded SSL cache context
+ * \param session  session to retrieve entry for
+ */
+int ssl_cache_sharded_get( void *data, ssl_session *session );
+
+/**
+ * \brief          Sharded cache set callback implementation
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled)
+ *
+ * \param data     sharded SSL cache context
+ * \param session  session to store entry for
+ */
+int ssl_cache_sharded_set( void *data, const ssl_session *session );
+
+#if defined(POLARSSL_HAVE_TIME)
+/**
+ * \brief          Set the sharded cache timeout
+ *                 (Default: SSL_CACHE_DEFAULT_TIMEOUT (1 day))
+ *
+ *                 A timeout of 0 indicates no timeout.
+ *
+ * \param cache    sharded SSL cache context
+ * \param timeout  cache entry timeout in seconds
+ */
+void ssl_cache_sharded_set_timeout( ssl_cache_sharded_context *cache,
+                                    int timeout );
+#endif /* POLARSSL_HAVE_TIME */
+
+/**
+ * \brief          Set the maximum number of entries of a sharded cache
+ *                 (Default: SSL_CACHE_DEFAULT_MAX_ENTRIES (50))
+ *
+ *                 The limit is split between the shards so that their
+ *                 shares add up to max, the first shards taking one more
+ *                 entry when it does not divide evenly. With a max smaller
+ *                 than the number of shards, some shards hold no entries.
+ *
+ * \param cache    sharded SSL cache context
+ * \param max      cache entry maximum
+ */
+void ssl_cache_sharded_set_max_entries( ssl_cache_sharded_context *cache,
+                                        int max );
+
+/**
+ * \brief          Free referenced items in a sharded cache context and
+ *                 clear memory
+ *
+ * \param cache    sharded SSL cache context
+ */
+void ssl_cache_sharded_free( ssl_cache_sharded_context *cache );
+
 #ifdef __cplusplus
 }
 #endif
@@ -268,8 +268,30 @@ int x509_self_test( int verbose );
  * Internal module functions. You probably do not want to use these unless you
  * know you do.
  */
+
+/**
+ * \brief          Parse a Name into cur and the nodes that follow it
+ *
+ * \note           The nodes after cur are allocated in one block: free with
+ *                 x509_free_name(), never node by node.
+ *
+ * \param p        position in the DER data, advanced past the name
+ * \param end      end of the name
+ * \param cur      first node, supplied by the caller
+ *
+ * \return         0 if successful, or a specific X509 or ASN1 error code
+ */
 int x509_get_name( unsigned char **p, const unsigned char *end,
                    x509_name *cur );
+
+/**
+ * \brief          Free the nodes that x509_get_name() allocated after the
+ *                 first one
+ *
+ * \param name     first node of the name
+ */
+void x509_free_name( x509_name *name );
+
 int x509_get_alg_null( unsigned char **p, const unsigned char *end,
                        x509_buf *alg );
 int x509_get_sig( unsigned char **p, const unsigned char *end, x509_buf *sig );
@@ -47,6 +47,7 @@ extern "C" {
 /**
  * Certificate revocation list entry.
  * Contains the CA-specific serial numbers and revocation dates.
+ * The entries following the first one are allocated in a single block.
  */
 typedef struct _x509_crl_entry
 {
@@ -82,6 +83,8 @@ typedef struct _x509_crl
     x509_time next_update;
 
     x509_crl_entry entry;   /**< The CRL entries containing the certificate revocation times for this CA. */
+    x509_crl_entry **entry_index;   /**< The entries sorted by serial, for x509_crt_revoked(). */
+    size_t entry_count;     /**< Number of entries. */
 
     x509_buf crl_ext;
 
@@ -90,6 +93,11 @@ typedef struct _x509_crl
     md_type_t sig_md;           /**< Internal representation of the MD algorithm of the signature algorithm, e.g. POLARSSL_MD_SHA256 */
     pk_type_t sig_pk            /**< Internal representation of the Public Key algorithm of the signature algorithm, e.g. POLARSSL_PK_RSA */;
 
+#if defined(POLARSSL_SHA256_C)
+    unsigned char raw_sha256[32];   /**< SHA-256 of raw, set by x509_crt_verify_cached() on first use. */
+    int raw_sha256_set;             /**< Whether raw_sha256 has been computed. */
+#endif
+
     struct _x509_crl *next;
 }
 x509_crl;
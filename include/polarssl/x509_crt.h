@@ -33,6 +33,10 @@
 
 #include "x509_crl.h"
 
+#if defined(POLARSSL_THREADING_C)
+#include "threading.h"
+#endif
+
 /**
  * \addtogroup x509_module
  * \{
@@ -47,6 +51,39 @@ extern "C" {
  * \{
  */
 
+struct _x509_crt_index;
+
+/**
+ * Entry of the verified chain cache: a chain that x509_crt_verify()
+ * accepted, and the time window in which that result holds.
+ */
+typedef struct
+{
+    unsigned char fingerprint[32];  /**< SHA-256 of the chain and trust store */
+    unsigned int generation;        /**< Cache generation of the entry */
+    x509_time valid_from;           /**< Latest start of validity in the path */
+    x509_time valid_to;             /**< Earliest end of validity in the path */
+}
+x509_verify_cache_entry;
+
+/**
+ * Bounded cache of verified certificate chains, see
+ * x509_crt_verify_cached(). Each chain has a single slot, and a new entry
+ * replaces the one in its slot.
+ */
+typedef struct
+{
+    x509_verify_cache_entry *entries;   /**< Table of entries */
+    size_t size;                        /**< Number of entries */
+    unsigned int generation;            /**< Current generation */
+    size_t hits;                        /**< Lookups answered by the cache */
+    size_t misses;                      /**< Lookups that ran a full verify */
+#if defined(POLARSSL_THREADING_C)
+    threading_mutex_t mutex;            /**< mutex */
+#endif
+}
+x509_verify_cache;
+
 /**
  * Container for an X.509 certificate. The certificate may be chained.
  */
@@ -74,6 +111,8 @@ typedef struct _x509_crt
     x509_buf subject_id;        /**< Optional X.509 v2/v3 subject unique identifier. */
     x509_buf v3_ext;            /**< Optional X.509 v3 extensions.  */
     x509_sequence subject_alt_names;    /**< Optional list of Subject Alternative Names (Only dNSName supported). */
+    x509_buf subject_key_id;    /**< Optional subject key identifier extension value. */
+    x509_buf authority_key_id;  /**< Optional keyIdentifier of the authority key identifier extension. */
 
     int ext_types;              /**< Bit string containing detected and parsed extensions */
     int ca_istrue;              /**< Optional Basic Constraint extension value: 1 if this certificate belongs to a CA, 0 otherwise. */
@@ -90,10 +129,32 @@ typedef struct _x509_crt
     md_type_t sig_md;           /**< Internal representation of the MD algorithm of the signature algorithm, e.g. POLARSSL_MD_SHA256 */
     pk_type_t sig_pk            /**< Internal representation of the Public Key algorithm of the signature algorithm, e.g. POLARSSL_PK_RSA */;
 
+    int own_buffer;             /**< Indicates if raw is owned by the structure (and freed with it) or borrowed from the caller. */
+
+    struct _x509_crt_index *index;  /**< Issuer lookup index of the chain (first certificate only), see x509_crt_index_build(). */
+
+#if defined(POLARSSL_SHA256_C)
+    unsigned char raw_sha256[32];   /**< SHA-256 of raw, set by x509_crt_verify_cached() when this is a trusted CA. */
+    int raw_sha256_set;             /**< Whether raw_sha256 has been computed. */
+#endif
+
     struct _x509_crt *next;     /**< Next certificate in the CA-chain. */
 }
 x509_crt;
 
+/**
+ * Hash index over a chain of trusted CA certificates, by subject name and by
+ * subject key identifier. Both tables use open addressing with linear
+ * probing, so certificates with the same key are found in chain order.
+ */
+typedef struct _x509_crt_index
+{
+    x509_crt **subject;         /**< Table by subject_raw */
+    x509_crt **key_id;          /**< Table by subject_key_id */
+    size_t size;                /**< Number of slots of each table (power of 2) */
+}
+x509_crt_index;
+
 #define X509_CRT_VERSION_1              0
 #define X509_CRT_VERSION_2              1
 #define X509_CRT_VERSION_3              2
@@ -133,6 +194,21 @@ x509write_cert;
 int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
                         size_t buflen );
 
+/**
+ * \brief          Parse a single DER formatted certificate and add it
+ *                 to the chained list, without copying it: the certificate
+ *                 references buf, which is not freed with it.
+ *
+ * \param chain    points to the start of the chain
+ * \param buf      buffer holding the certificate DER data, which must
+ *                 remain valid and unmodified until the certificate is freed
+ * \param buflen   size of the buffer
+ *
+ * \return         0 if successful, or a specific X509 or PEM error code
+ */
+int x509_crt_parse_der_nocopy( x509_crt *chain, const unsigned char *buf,
+                               size_t buflen );
+
 /**
  * \brief          Parse one or more certificates and add them
  *                 to the chained list. Parses permissively. If some
@@ -184,8 +260,73 @@ int x509_crt_parse_file( x509_crt *chain, const char *path );
  *                 if partly successful or a specific X509 or PEM error code
  */
 int x509_crt_parse_path( x509_crt *chain, const char *path );
+
+/**
+ * \brief          Load the certificate files of a path like
+ *                 x509_crt_parse_path(), parsing them in several threads.
+ *                 The files are split in contiguous ranges, one per thread,
+ *                 and the results are added to the chained list in the
+ *                 same order as x509_crt_parse_path() would.
+ *
+ * \note           Threads are only used if POLARSSL_THREADING_PTHREAD is
+ *                 defined, otherwise this is x509_crt_parse_path().
+ *
+ * \param chain    points to the start of the chain
+ * \param path     directory / folder to read the certificate files from
+ * \param threads  number of threads to parse with (including the calling
+ *                 one)
+ *
+ * \return         same as x509_crt_parse_path()
+ */
+int x509_crt_parse_path_parallel( x509_crt *chain, const char *path,
+                                  int threads );
+
+/**
+ * \brief          Save the certificates of a chain to a file, as the
+ *                 concatenation of their DER encodings, to be loaded with
+ *                 x509_crt_parse_bundle().
+ *
+ * \param chain    the chain to save
+ * \param path     filename to write the bundle to
+ *
+ * \return         0 if successful, or POLARSSL_ERR_X509_FILE_IO_ERROR
+ */
+int x509_crt_save_bundle( const x509_crt *chain, const char *path );
+
+/**
+ * \brief          Load a bundle written by x509_crt_save_bundle() and add
+ *                 its certificates to the chained list.
+ *
+ *                 The file is read in a single buffer, which the
+ *                 certificates reference instead of copying it (see
+ *                 x509_crt_parse_der_nocopy()) and which is freed with them.
+ *
+ * \param chain    points to the start of the chain
+ * \param path     filename to read the bundle from
+ *
+ * \return         0 if successful, or a specific X509 error code. On error
+ *                 the certificates parsed so far are left in the chain.
+ */
+int x509_crt_parse_bundle( x509_crt *chain, const char *path );
 #endif /* POLARSSL_FS_IO */
 
+/**
+ * \brief          Index a chain of trusted CA certificates by subject name
+ *                 and by subject key identifier, so that x509_crt_verify()
+ *                 (and hence the SSL layer, through ssl_set_ca_chain())
+ *                 finds the issuer of a certificate in constant time
+ *                 instead of walking the chain.
+ *
+ *                 The index is attached to the chain and freed with it.
+ *                 Adding certificates to the chain drops it: call this
+ *                 function again once the chain is complete.
+ *
+ * \param chain    trusted CA chain
+ *
+ * \return         0 if successful, or POLARSSL_ERR_X509_MALLOC_FAILED
+ */
+int x509_crt_index_build( x509_crt *chain );
+
 /**
  * \brief          Returns an informational string about the
  *                 certificate.
@@ -244,6 +385,79 @@ int x509_crt_verify( x509_crt *crt,
                      int (*f_vrfy)(void *, x509_crt *, int, int *),
                      void *p_vrfy );
 
+#if defined(POLARSSL_SHA256_C)
+/**
+ * \brief          Verify the certificate signature, reusing the result of an
+ *                 earlier successful verification of the same chain.
+ *
+ *                 The cache is keyed by the SHA-256 of every certificate of
+ *                 crt, and by the trust_ca and ca_crl chains used. An entry
+ *                 is only used within the validity period of all the
+ *                 certificates of the chain, of the trusted CA that signed
+ *                 it and of the CRLs in ca_crl, so expiry is still detected.
+ *                 On a hit the signatures and CRLs are not checked again,
+ *                 only the expected CN.
+ *
+ *                 Only results without any flag set are cached.
+ *
+ * \param crt      a certificate to be verified
+ * \param trust_ca the trusted CA chain
+ * \param ca_crl   the CRL chain for trusted CA's
+ * \param cn       expected Common Name (can be set to
+ *                 NULL if the CN must not be verified)
+ * \param flags    result of the verification
+ * \param f_vrfy   verification function
+ * \param p_vrfy   verification parameter
+ * \param cache    verified chain cache, or NULL
+ *
+ * \return         same as x509_crt_verify()
+ *
+ * \note           The cache is not used if f_vrfy is set, as the callback
+ *                 expects to see every certificate of the chain.
+ *
+ * \note           Entries are keyed by the contents of trust_ca and ca_crl
+ *                 (digests taken the first time they are used here, under
+ *                 the cache mutex), so an entry made before CAs or CRLs
+ *                 were reloaded, even into the same objects, is not used
+ *                 again.
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled, as long
+ *                 as a given trust_ca and ca_crl are used with one cache)
+ */
+int x509_crt_verify_cached( x509_crt *crt,
+                            x509_crt *trust_ca,
+                            x509_crl *ca_crl,
+                            const char *cn, int *flags,
+                            int (*f_vrfy)(void *, x509_crt *, int, int *),
+                            void *p_vrfy,
+                            x509_verify_cache *cache );
+
+/**
+ * \brief          Initialize a verified chain cache
+ *
+ * \param cache    cache to initialize
+ * \param size     maximum number of entries
+ *
+ * \return         0 if successful, or POLARSSL_ERR_X509_MALLOC_FAILED
+ */
+int x509_verify_cache_init( x509_verify_cache *cache, size_t size );
+
+/**
+ * \brief          Start a new generation of the cache, so that no existing
+ *                 entry is used again.
+ *                 (Thread-safe if POLARSSL_THREADING_C is enabled)
+ *
+ * \param cache    cache to flush
+ */
+void x509_verify_cache_flush( x509_verify_cache *cache );
+
+/**
+ * \brief          Free referenced items in a cache context and clear memory
+ *
+ * \param cache    cache to free
+ */
+void x509_verify_cache_free( x509_verify_cache *cache );
+#endif /* POLARSSL_SHA256_C */
+
 #if defined(POLARSSL_X509_CHECK_KEY_USAGE)
 /**
  * \brief          Check usage of certificate against keyUsage extension.
@@ -286,6 +500,9 @@ int x509_crt_check_extended_key_usage( const x509_crt *crt,
 /**
  * \brief          Verify the certificate revocation status
  *
+ *                 The serial is looked up by binary search in the index of
+ *                 the CRL entries built by x509_crl_parse().
+ *
  * \param crt      a certificate to be verified
  * \param crl      the CRL to verify against
  *
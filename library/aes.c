@@ -962,6 +962,35 @@ int aes_crypt_ctr( aes_context *ctx,
     int c, i;
     size_t n = *nc_off;
 
+#if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
+    /*
+     * Bulk path: process 8 blocks at a time while on a block boundary
+     */
+    if( n == 0 && length >= 128 && aesni_supports( POLARSSL_AESNI_AES ) )
+    {
+        unsigned char counters[128];
+        int j;
+
+        while( length >= 128 )
+        {
+            for( j = 0; j < 128; j += 16 )
+            {
+                memcpy( counters + j, nonce_counter, 16 );
+
+                for( i = 16; i > 0; i-- )
+                    if( ++nonce_counter[i - 1] != 0 )
+                        break;
+            }
+
+            aesni_crypt_ctr8( ctx, counters, input, output );
+
+            input  += 128;
+            output += 128;
+            length -= 128;
+        }
+    }
+#endif
+
     while( length-- )
     {
         if( n == 0 ) {
@@ -33,6 +33,7 @@
 #if defined(POLARSSL_AESNI_C)
 
 #include "polarssl/aesni.h"
+#include <string.h>
 #include <stdio.h>
 
 #if defined(POLARSSL_HAVE_X86_64)
@@ -103,6 +104,94 @@ int aesni_crypt_ecb( aes_context *ctx,
     return( 0 );
 }
 
+/*
+ * AES-NI encryption of 8 independent counter blocks, XORed into the data.
+ * The 8 blocks go through each round together, so that the latency of
+ * AESENC is hidden behind the other blocks' rounds.
+ */
+void aesni_crypt_ctr8( aes_context *ctx,
+                       const unsigned char counters[128],
+                       const unsigned char input[128],
+                       unsigned char output[128] )
+{
+    int nr = ctx->nr;
+    const unsigned char *rk = (const unsigned char *) ctx->rk;
+
+    /* volatile: the result is only written to memory, not to an operand */
+    asm volatile( "movdqu    (%1), %%xmm8        \n" // load round key 0
+                  "movdqu      (%2), %%xmm0      \n" // load counter blocks
+                  "movdqu    16(%2), %%xmm1      \n"
+                  "movdqu    32(%2), %%xmm2      \n"
+                  "movdqu    48(%2), %%xmm3      \n"
+                  "movdqu    64(%2), %%xmm4      \n"
+                  "movdqu    80(%2), %%xmm5      \n"
+                  "movdqu    96(%2), %%xmm6      \n"
+                  "movdqu   112(%2), %%xmm7      \n"
+                  "pxor      %%xmm8, %%xmm0      \n" // round 0
+                  "pxor      %%xmm8, %%xmm1      \n"
+                  "pxor      %%xmm8, %%xmm2      \n"
+                  "pxor      %%xmm8, %%xmm3      \n"
+                  "pxor      %%xmm8, %%xmm4      \n"
+                  "pxor      %%xmm8, %%xmm5      \n"
+                  "pxor      %%xmm8, %%xmm6      \n"
+                  "pxor      %%xmm8, %%xmm7      \n"
+                  "addq      $16, %1             \n" // point to next round key
+                  "subl      $1, %0              \n" // normal rounds = nr - 1
+
+                  "1:                            \n" // encryption loop
+                  "movdqu    (%1), %%xmm8        \n" // load round key
+                  "aesenc    %%xmm8, %%xmm0      \n" // do round on each block
+                  "aesenc    %%xmm8, %%xmm1      \n"
+                  "aesenc    %%xmm8, %%xmm2      \n"
+                  "aesenc    %%xmm8, %%xmm3      \n"
+                  "aesenc    %%xmm8, %%xmm4      \n"
+                  "aesenc    %%xmm8, %%xmm5      \n"
+                  "aesenc    %%xmm8, %%xmm6      \n"
+                  "aesenc    %%xmm8, %%xmm7      \n"
+                  "addq      $16, %1             \n" // point to next round key
+                  "subl      $1, %0              \n" // loop
+                  "jnz       1b                  \n"
+
+                  "movdqu    (%1), %%xmm8        \n" // load round key
+                  "aesenclast %%xmm8, %%xmm0     \n" // last round
+                  "aesenclast %%xmm8, %%xmm1     \n"
+                  "aesenclast %%xmm8, %%xmm2     \n"
+                  "aesenclast %%xmm8, %%xmm3     \n"
+                  "aesenclast %%xmm8, %%xmm4     \n"
+                  "aesenclast %%xmm8, %%xmm5     \n"
+                  "aesenclast %%xmm8, %%xmm6     \n"
+                  "aesenclast %%xmm8, %%xmm7     \n"
+
+                  "movdqu      (%3), %%xmm8      \n" // XOR keystream with input
+                  "pxor      %%xmm8, %%xmm0      \n" // and export output
+                  "movdqu    %%xmm0,   (%4)      \n"
+                  "movdqu    16(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm1      \n"
+                  "movdqu    %%xmm1, 16(%4)      \n"
+                  "movdqu    32(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm2      \n"
+                  "movdqu    %%xmm2, 32(%4)      \n"
+                  "movdqu    48(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm3      \n"
+                  "movdqu    %%xmm3, 48(%4)      \n"
+                  "movdqu    64(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm4      \n"
+                  "movdqu    %%xmm4, 64(%4)      \n"
+                  "movdqu    80(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm5      \n"
+                  "movdqu    %%xmm5, 80(%4)      \n"
+                  "movdqu    96(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm6      \n"
+                  "movdqu    %%xmm6, 96(%4)      \n"
+                  "movdqu   112(%3), %%xmm8      \n"
+                  "pxor      %%xmm8, %%xmm7      \n"
+                  "movdqu    %%xmm7, 112(%4)     \n"
+                  : "+r" (nr), "+r" (rk)
+                  : "r" (counters), "r" (input), "r" (output)
+                  : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+                    "xmm5", "xmm6", "xmm7", "xmm8" );
+}
+
 /*
  * GCM multiplication: c = a times b in GF(2^128)
  * Based on [CLMUL-WP] algorithms 1 (with equation 27) and 5.
@@ -215,6 +304,137 @@ void aesni_gcm_mult( unsigned char c[16],
     return;
 }
 
+/*
+ * Powers of H for aggregated GHASH, byte-reversed as expected by
+ * aesni_gcm_mult8(): hpow holds H^8 first and H^1 last.
+ */
+void aesni_gcm_precompute( unsigned char hpow[128],
+                           const unsigned char h[16] )
+{
+    unsigned char p[16];
+    size_t i, j;
+
+    memcpy( p, h, 16 );
+
+    for( i = 8; i > 0; i-- )
+    {
+        if( i != 8 )
+            aesni_gcm_mult( p, p, h );
+
+        for( j = 0; j < 16; j++ )
+            hpow[16 * ( i - 1 ) + j] = p[15 - j];
+    }
+}
+
+/*
+ * Aggregated GHASH of 8 blocks, see [CLMUL-WP] section "Aggregated
+ * reduction" (p. 22): the 8 unreduced products are summed, then shifted
+ * and reduced once, as both steps are linear.
+ */
+void aesni_gcm_mult8( unsigned char y[16],
+                      const unsigned char x[128],
+                      const unsigned char hpow[128] )
+{
+    static const unsigned char bswap_mask[16] =
+        { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    const unsigned char *xp = x, *hp = hpow;
+    size_t n = 8;
+
+    /* volatile: the result is only written to memory, not to an operand */
+    asm volatile( "movdqu (%4), %%xmm10              \n" // byte-reversal mask
+                  "movdqu (%3), %%xmm9               \n" // y
+                  "pshufb %%xmm10, %%xmm9            \n"
+                  "pxor %%xmm6, %%xmm6               \n" // low accumulator
+                  "pxor %%xmm7, %%xmm7               \n" // high accumulator
+                  "pxor %%xmm8, %%xmm8               \n" // middle accumulator
+
+                  "1:                                \n"
+                  "movdqu (%0), %%xmm0               \n" // x_i
+                  "pshufb %%xmm10, %%xmm0            \n"
+                  "pxor %%xmm9, %%xmm0               \n" // y is added to x_1 only
+                  "pxor %%xmm9, %%xmm9               \n"
+                  "movdqu (%1), %%xmm1               \n" // H^(9-i)
+                  "movdqa %%xmm1, %%xmm2             \n"
+                  "movdqa %%xmm1, %%xmm3             \n"
+                  "movdqa %%xmm1, %%xmm4             \n"
+                  "pclmulqdq $0x00, %%xmm0, %%xmm1   \n" // a0*b0 = c1:c0
+                  "pclmulqdq $0x11, %%xmm0, %%xmm2   \n" // a1*b1 = d1:d0
+                  "pclmulqdq $0x10, %%xmm0, %%xmm3   \n" // a0*b1 = e1:e0
+                  "pclmulqdq $0x01, %%xmm0, %%xmm4   \n" // a1*b0 = f1:f0
+                  "pxor %%xmm1, %%xmm6               \n"
+                  "pxor %%xmm2, %%xmm7               \n"
+                  "pxor %%xmm3, %%xmm8               \n"
+                  "pxor %%xmm4, %%xmm8               \n"
+                  "add $16, %0                       \n"
+                  "add $16, %1                       \n"
+                  "sub $1, %2                        \n"
+                  "jnz 1b                            \n"
+
+                  /* Combine the accumulators into xmm2:xmm1, as aesni_gcm_mult() */
+                  "movdqa %%xmm6, %%xmm1             \n" // c1:c0
+                  "movdqa %%xmm7, %%xmm2             \n" // d1:d0
+                  "movdqa %%xmm8, %%xmm3             \n" // e1+f1:e0+f0
+                  "psrldq $8, %%xmm8                 \n" // 0:e1+f1
+                  "pslldq $8, %%xmm3                 \n" // e0+f0:0
+                  "pxor %%xmm8, %%xmm2               \n" // d1:d0+e1+f1
+                  "pxor %%xmm3, %%xmm1               \n" // c1+e0+f0:c0
+
+                  /* Shift left by one bit, see aesni_gcm_mult() */
+                  "movdqa %%xmm1, %%xmm3             \n"
+                  "movdqa %%xmm2, %%xmm4             \n"
+                  "psllq $1, %%xmm1                  \n"
+                  "psllq $1, %%xmm2                  \n"
+                  "psrlq $63, %%xmm3                 \n"
+                  "psrlq $63, %%xmm4                 \n"
+                  "movdqa %%xmm3, %%xmm5             \n"
+                  "pslldq $8, %%xmm3                 \n"
+                  "pslldq $8, %%xmm4                 \n"
+                  "psrldq $8, %%xmm5                 \n"
+                  "por %%xmm3, %%xmm1                \n"
+                  "por %%xmm4, %%xmm2                \n"
+                  "por %%xmm5, %%xmm2                \n"
+
+                  /* Reduce, see aesni_gcm_mult() */
+                  "movdqa %%xmm1, %%xmm3             \n"
+                  "movdqa %%xmm1, %%xmm4             \n"
+                  "movdqa %%xmm1, %%xmm5             \n"
+                  "psllq $63, %%xmm3                 \n"
+                  "psllq $62, %%xmm4                 \n"
+                  "psllq $57, %%xmm5                 \n"
+                  "pxor %%xmm4, %%xmm3               \n"
+                  "pxor %%xmm5, %%xmm3               \n"
+                  "pslldq $8, %%xmm3                 \n"
+                  "pxor %%xmm3, %%xmm1               \n"
+
+                  "movdqa %%xmm1,%%xmm0              \n"
+                  "movdqa %%xmm1,%%xmm4              \n"
+                  "movdqa %%xmm1,%%xmm5              \n"
+                  "psrlq $1, %%xmm0                  \n"
+                  "psrlq $2, %%xmm4                  \n"
+                  "psrlq $7, %%xmm5                  \n"
+                  "pxor %%xmm4, %%xmm0               \n"
+                  "pxor %%xmm5, %%xmm0               \n"
+                  "movdqa %%xmm1,%%xmm3              \n"
+                  "movdqa %%xmm1,%%xmm4              \n"
+                  "movdqa %%xmm1,%%xmm5              \n"
+                  "psllq $63, %%xmm3                 \n"
+                  "psllq $62, %%xmm4                 \n"
+                  "psllq $57, %%xmm5                 \n"
+                  "pxor %%xmm4, %%xmm3               \n"
+                  "pxor %%xmm5, %%xmm3               \n"
+                  "psrldq $8, %%xmm3                 \n"
+                  "pxor %%xmm3, %%xmm0               \n"
+                  "pxor %%xmm1, %%xmm0               \n"
+                  "pxor %%xmm2, %%xmm0               \n"
+
+                  "pshufb %%xmm10, %%xmm0            \n"
+                  "movdqu %%xmm0, (%3)               \n" // done
+                  : "+r" (xp), "+r" (hp), "+r" (n)
+                  : "r" (y), "r" (bswap_mask)
+                  : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+                    "xmm6", "xmm7", "xmm8", "xmm9", "xmm10" );
+}
+
 /*
  * Compute decryption round keys from encryption round keys
  */
@@ -920,7 +920,8 @@ int mpi_sub_abs( mpi *X, const mpi *A, const mpi *B )
 {
     mpi TB;
     int ret;
-    size_t n;
+    size_t n, i;
+    t_uint c, z, t;
 
     if( mpi_cmp_abs( A, B ) < 0 )
         return( POLARSSL_ERR_MPI_NEGATIVE_VALUE );
@@ -929,8 +930,26 @@ int mpi_sub_abs( mpi *X, const mpi *A, const mpi *B )
 
     if( X == B )
     {
-        MPI_CHK( mpi_copy( &TB, B ) );
-        B = &TB;
+        /*
+         * X = |A| - |X| in place, rather than copying B to a temporary:
+         * since |X| <= |A|, the limbs of X above those of A are zero.
+         */
+        for( n = A->n; n > 0; n-- )
+            if( A->p[n - 1] != 0 )
+                break;
+
+        MPI_CHK( mpi_grow( X, n ) );
+
+        for( i = c = 0; i < n; i++ )
+        {
+            t = A->p[i];
+            z = ( t < c );          t -= c;
+            c = ( t < X->p[i] ) + z; X->p[i] = t - X->p[i];
+        }
+
+        X->s = 1;
+
+        return( 0 );
     }
 
     if( X != A )
@@ -1050,6 +1069,44 @@ int mpi_sub_int( mpi *X, const mpi *A, t_sint b )
     return( mpi_sub_mpi( X, A, &_B ) );
 }
 
+#if defined(MULADDC_MULX_INIT)
+#define MPI_CPUID_BMI2      0x00000100u
+#define MPI_CPUID_ADX       0x00080000u
+
+/*
+ * BMI2 and ADX support detection routine, for the MULADDC_MULX variant
+ */
+static int mpi_mulx_supports( void )
+{
+    static int done = 0;
+    static unsigned int b = 0;
+    unsigned int max;
+
+    if( ! done )
+    {
+        asm( "xorl  %%eax, %%eax  \n"
+             "cpuid               \n"
+             : "=a" (max)
+             :
+             : "ebx", "ecx", "edx" );
+
+        if( max >= 7 )
+        {
+            asm( "movl  $7, %%eax     \n"
+                 "xorl  %%ecx, %%ecx  \n"
+                 "cpuid               \n"
+                 : "=b" (b)
+                 :
+                 : "eax", "ecx", "edx" );
+        }
+        done = 1;
+    }
+
+    return( ( b & ( MPI_CPUID_BMI2 | MPI_CPUID_ADX ) ) ==
+                  ( MPI_CPUID_BMI2 | MPI_CPUID_ADX ) );
+}
+#endif /* MULADDC_MULX_INIT */
+
 /*
  * Helper for mpi multiplication
  */
@@ -1065,6 +1122,26 @@ void mpi_mul_hlp( size_t i, t_uint *s, t_uint *d, t_uint b )
 {
     t_uint c = 0, t = 0;
 
+#if defined(MULADDC_MULX_INIT)
+    /* Consumes all limbs, the generic loops below are then skipped */
+    if( mpi_mulx_supports() )
+    {
+        for( ; i >= 8; i -= 8 )
+        {
+            MULADDC_MULX_INIT
+            MULADDC_MULX_HUIT
+            MULADDC_MULX_STOP
+        }
+
+        for( ; i > 0; i-- )
+        {
+            MULADDC_MULX_INIT
+            MULADDC_MULX_CORE
+            MULADDC_MULX_STOP
+        }
+    }
+#endif
+
 #if defined(MULADDC_HUIT)
     for( ; i >= 8; i -= 8 )
     {
@@ -1122,19 +1199,219 @@ void mpi_mul_hlp( size_t i, t_uint *s, t_uint *d, t_uint b )
     while( c != 0 );
 }
 
+/*
+ * Helper for raw additions: d[0..dn-1] += s[0..sn-1] & mask (sn <= dn)
+ * Returns the carry out of the top limb.
+ */
+static t_uint mpi_add_raw( t_uint *d, size_t dn,
+                           const t_uint *s, size_t sn, t_uint mask )
+{
+    size_t i;
+    t_uint c, z, t;
+
+    for( i = c = 0; i < dn; i++ )
+    {
+        t = ( i < sn ) ? s[i] & mask : 0;
+        z = d[i] + c; c  = ( z < c );
+        z += t;       c += ( z < t );
+        d[i] = z;
+    }
+
+    return( c );
+}
+
+/*
+ * Helper for raw subtractions: d[0..dn-1] -= s[0..sn-1] (sn <= dn)
+ * Returns the borrow out of the top limb.
+ */
+static t_uint mpi_sub_raw( t_uint *d, size_t dn, const t_uint *s, size_t sn )
+{
+    size_t i;
+    t_uint c, z, t;
+
+    for( i = c = 0; i < dn; i++ )
+    {
+        t = ( i < sn ) ? s[i] : 0;
+        z = ( d[i] < c ); d[i] -= c;
+        c = ( d[i] < t ) + z; d[i] -= t;
+    }
+
+    return( c );
+}
+
+/*
+ * Schoolbook product of limb arrays: d = a * b  (HAC 14.12)
+ * d holds an + bn limbs.
+ */
+static void mpi_mul_raw( t_uint *d, const t_uint *a, size_t an,
+                         const t_uint *b, size_t bn )
+{
+    memset( d, 0, ( an + bn ) * ciL );
+
+    for( ; bn > 0; bn-- )
+        mpi_mul_hlp( an, (t_uint *) a, d + bn - 1, b[bn - 1] );
+}
+
+/*
+ * Schoolbook squaring of a limb array: d = a^2  (HAC 14.16)
+ * d holds 2n limbs.
+ *
+ * Each cross product a[i] * a[j] (i < j) is computed only once, then the
+ * sum of them is doubled and the squares a[i]^2 are added.
+ */
+static void mpi_sqr_raw( t_uint *d, const t_uint *a, size_t n )
+{
+    size_t i;
+    t_uint c, z;
+#if defined(POLARSSL_HAVE_UDBL)
+    t_uint s, lo, hi;
+    t_udbl r;
+#endif
+
+    memset( d, 0, 2 * n * ciL );
+
+    for( i = 0; i + 1 < n; i++ )
+        mpi_mul_hlp( n - i - 1, (t_uint *) a + i + 1, d + 2 * i + 1, a[i] );
+
+#if defined(POLARSSL_HAVE_UDBL)
+    /*
+     * d = 2 d + sum( a[i]^2 B^2i ), in a single pass
+     */
+    for( i = c = s = 0; i < n; i++ )
+    {
+        r  = (t_udbl) a[i] * a[i];
+        lo = (t_uint) r;
+        hi = (t_uint)( r >> biL );
+
+        z = ( d[2 * i] << 1 ) | s;     s = d[2 * i] >> ( biL - 1 );
+        z += c;  c  = ( z < c );
+        z += lo; c += ( z < lo );
+        d[2 * i] = z;
+
+        z = ( d[2 * i + 1] << 1 ) | s; s = d[2 * i + 1] >> ( biL - 1 );
+        z += c;  c  = ( z < c );
+        z += hi; c += ( z < hi );
+        d[2 * i + 1] = z;
+    }
+#else
+    for( i = c = 0; i < 2 * n; i++ )
+    {
+        z = d[i] >> ( biL - 1 );
+        d[i] = ( d[i] << 1 ) | c;
+        c = z;
+    }
+
+    for( i = 0; i < n; i++ )
+        mpi_mul_hlp( 1, (t_uint *) a + i, d + 2 * i, a[i] );
+#endif
+}
+
+/*
+ * Number of temporary limbs needed by mpi_mul_kara() for n-limb operands
+ */
+static size_t mpi_kara_tmp_len( size_t n, int sqr )
+{
+    size_t l, len = 0;
+    size_t thres = sqr ? POLARSSL_MPI_KARATSUBA_SQR_THRESHOLD
+                       : POLARSSL_MPI_KARATSUBA_THRESHOLD;
+
+    while( n >= thres && n >= 4 )
+    {
+        l = ( n + 1 ) / 2;
+        len += 4 * l + 2;
+        n = l;
+    }
+
+    return( len );
+}
+
+/*
+ * Product of two n-limb arrays: d = a * b, d holding 2n limbs and tmp
+ * mpi_kara_tmp_len( n, a == b ) limbs. If a == b, squarings are used.
+ *
+ * Above the thresholds, with l = ceil(n/2), a = a1 B^l + a0, b = b1 B^l + b0:
+ * a * b = a1 b1 B^2l + ( (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 ) B^l + a0 b0
+ * The carries of the half sums are applied with masks rather than branches,
+ * so the sequence of operations only depends on n.
+ */
+static void mpi_mul_kara( t_uint *d, const t_uint *a, const t_uint *b,
+                          size_t n, t_uint *tmp )
+{
+    size_t l, h;
+    t_uint ca, cb, *sa, *sb, *t;
+    int sqr = ( a == b );
+
+    if( n < 4 || n < ( sqr ? POLARSSL_MPI_KARATSUBA_SQR_THRESHOLD
+                           : POLARSSL_MPI_KARATSUBA_THRESHOLD ) )
+    {
+        if( sqr )
+            mpi_sqr_raw( d, a, n );
+        else
+            mpi_mul_raw( d, a, n, b, n );
+        return;
+    }
+
+    l = ( n + 1 ) / 2;
+    h = n - l;
+    sa = tmp;
+    sb = sa + l;
+    t  = sb + l;
+
+    /*
+     * d = a1 b1 B^2l + a0 b0
+     */
+    mpi_mul_kara( d, a, b, l, tmp );
+    mpi_mul_kara( d + 2 * l, a + l, b + l, h, tmp );
+
+    /*
+     * t = (a0 + a1)(b0 + b1), with 2l + 2 limbs
+     */
+    memcpy( sa, a, l * ciL );
+    ca = mpi_add_raw( sa, l, a + l, h, ~(t_uint) 0 );
+
+    if( sqr )
+    {
+        mpi_mul_kara( t, sa, sa, l, t + 2 * l + 2 );
+        t[2 * l] = t[2 * l + 1] = 0;
+        mpi_add_raw( t + l, l + 2, sa, l, - ca );
+        mpi_add_raw( t + l, l + 2, sa, l, - ca );
+        t[2 * l] += ca;
+    }
+    else
+    {
+        memcpy( sb, b, l * ciL );
+        cb = mpi_add_raw( sb, l, b + l, h, ~(t_uint) 0 );
+
+        mpi_mul_kara( t, sa, sb, l, t + 2 * l + 2 );
+        t[2 * l] = t[2 * l + 1] = 0;
+        mpi_add_raw( t + l, l + 2, sb, l, - ca );
+        mpi_add_raw( t + l, l + 2, sa, l, - cb );
+        t[2 * l] += ca & cb;
+    }
+
+    /*
+     * d += ( t - a0 b0 - a1 b1 ) B^l
+     */
+    mpi_sub_raw( t, 2 * l + 2, d, 2 * l );
+    mpi_sub_raw( t, 2 * l + 2, d + 2 * l, 2 * h );
+    mpi_add_raw( d + l, l + 2 * h, t, l + h + 1, ~(t_uint) 0 );
+}
+
 /*
  * Baseline multiplication: X = A * B  (HAC 14.12)
  */
 int mpi_mul_mpi( mpi *X, const mpi *A, const mpi *B )
 {
     int ret;
-    size_t i, j;
-    mpi TA, TB;
+    size_t i, j, k;
+    mpi TA, TB, TT;
+    int sqr = ( A == B );
 
-    mpi_init( &TA ); mpi_init( &TB );
+    mpi_init( &TA ); mpi_init( &TB ); mpi_init( &TT );
 
     if( X == A ) { MPI_CHK( mpi_copy( &TA, A ) ); A = &TA; }
-    if( X == B ) { MPI_CHK( mpi_copy( &TB, B ) ); B = &TB; }
+    if( sqr ) B = A;
+    else if( X == B ) { MPI_CHK( mpi_copy( &TB, B ) ); B = &TB; }
 
     for( i = A->n; i > 0; i-- )
         if( A->p[i - 1] != 0 )
@@ -1147,14 +1424,25 @@ int mpi_mul_mpi( mpi *X, const mpi *A, const mpi *B )
     MPI_CHK( mpi_grow( X, i + j ) );
     MPI_CHK( mpi_lset( X, 0 ) );
 
-    for( i++; j > 0; j-- )
-        mpi_mul_hlp( i - 1, A->p, X->p + j - 1, B->p[j - 1] );
+    if( i == j && i >= ( sqr ? POLARSSL_MPI_SQR_THRESHOLD
+                             : POLARSSL_MPI_KARATSUBA_THRESHOLD ) )
+    {
+        if( ( k = mpi_kara_tmp_len( i, sqr ) ) > 0 )
+            MPI_CHK( mpi_grow( &TT, k ) );
+
+        mpi_mul_kara( X->p, A->p, B->p, i, TT.p );
+    }
+    else
+    {
+        for( i++; j > 0; j-- )
+            mpi_mul_hlp( i - 1, A->p, X->p + j - 1, B->p[j - 1] );
+    }
 
     X->s = A->s * B->s;
 
 cleanup:
 
-    mpi_free( &TB ); mpi_free( &TA );
+    mpi_free( &TT ); mpi_free( &TB ); mpi_free( &TA );
 
     return( ret );
 }
@@ -1462,32 +1750,63 @@ static void mpi_montg_init( t_uint *mm, const mpi *N )
     *mm = ~x + 1;
 }
 
+/*
+ * Number of limbs of the temporary used by mpi_montmul() for a n-limb modulus
+ */
+static size_t mpi_montmul_tmp_len( size_t n )
+{
+    return( 2 * n + 2 + mpi_kara_tmp_len( n, 1 ) );
+}
+
 /*
  * Montgomery multiplication: A = A * B * R^-1 mod N  (HAC 14.36)
+ *
+ * Large squarings (B == A) are computed in full first with the dedicated
+ * kernel, then reduced word by word (HAC 14.32).
+ * T must hold at least mpi_montmul_tmp_len( N->n ) limbs.
  */
 static void mpi_montmul( mpi *A, const mpi *B, const mpi *N, t_uint mm, const mpi *T )
 {
     size_t i, n, m;
     t_uint u0, u1, *d;
 
-    memset( T->p, 0, T->n * ciL );
-
     d = T->p;
     n = N->n;
     m = ( B->n < n ) ? B->n : n;
 
-    for( i = 0; i < n; i++ )
+    if( B == A && n >= POLARSSL_MPI_SQR_THRESHOLD )
     {
-        /*
-         * T = (T + u0*B + u1*N) / 2^biL
-         */
-        u0 = A->p[i];
-        u1 = ( d[0] + u0 * B->p[0] ) * mm;
+        mpi_mul_kara( d, A->p, A->p, n, d + 2 * n + 2 );
+        d[2 * n] = 0;
 
-        mpi_mul_hlp( m, B->p, d, u0 );
-        mpi_mul_hlp( n, N->p, d, u1 );
+        for( i = 0; i < n; i++ )
+        {
+            /*
+             * T = T + u1*N*2^(i*biL), clearing limb i
+             */
+            u1 = d[i] * mm;
+            mpi_mul_hlp( n, N->p, d + i, u1 );
+        }
 
-        *d++ = u0; d[n + 1] = 0;
+        d += n;
+    }
+    else
+    {
+        memset( T->p, 0, ( 2 * n + 2 ) * ciL );
+
+        for( i = 0; i < n; i++ )
+        {
+            /*
+             * T = (T + u0*B + u1*N) / 2^biL
+             */
+            u0 = A->p[i];
+            u1 = ( d[0] + u0 * B->p[0] ) * mm;
+
+            mpi_mul_hlp( m, B->p, d, u0 );
+            mpi_mul_hlp( n, N->p, d, u1 );
+
+            *d++ = u0; d[n + 1] = 0;
+        }
     }
 
     memcpy( A->p, d, (n + 1) * ciL );
@@ -1496,7 +1815,7 @@ static void mpi_montmul( mpi *A, const mpi *B, const mpi *N, t_uint mm, const mp
         mpi_sub_hlp( n, N->p, A->p );
     else
         /* prevent timing attacks */
-        mpi_sub_hlp( n, A->p, T->p );
+        mpi_sub_hlp( n, A->p, d );
 }
 
 /*
@@ -1551,7 +1870,7 @@ int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
     j = N->n + 1;
     MPI_CHK( mpi_grow( X, j ) );
     MPI_CHK( mpi_grow( &W[1],  j ) );
-    MPI_CHK( mpi_grow( &T, j * 2 ) );
+    MPI_CHK( mpi_grow( &T, mpi_montmul_tmp_len( N->n ) ) );
 
     /*
      * Compensate for negative A (and correct at the end)
@@ -1721,6 +2040,396 @@ cleanup:
     return( ret );
 }
 
+/*
+ * Sliding-window exponentiation of several bases with a common exponent
+ * and modulus: X[k] = A[k]^E mod N
+ *
+ * The window decomposition only depends on E, so every base goes through
+ * the same sequence of Montgomery multiplications; they are done base after
+ * base at each step, sharing the Montgomery setup, R^2 mod N and the
+ * temporary.
+ */
+int mpi_exp_mod_batch( mpi *X, const mpi *A, size_t count,
+                       const mpi *E, const mpi *N, mpi *_RR )
+{
+    int ret;
+    size_t wbits, wsize, one = 1;
+    size_t i, j, k, nblimbs, tsize;
+    size_t bufsize, nbits;
+    t_uint ei, mm, state;
+    mpi RR, T, *W, *Wk;
+
+    if( mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mpi_cmp_int( E, 0 ) < 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    if( count == 0 )
+        return( 0 );
+
+    /*
+     * Init temps and window size
+     */
+    i = mpi_msb( E );
+
+    wsize = ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
+            ( i >  79 ) ? 4 : ( i >  23 ) ? 3 : 1;
+
+    if( wsize > POLARSSL_MPI_WINDOW_SIZE )
+        wsize = POLARSSL_MPI_WINDOW_SIZE;
+
+    tsize = one << wsize;
+
+    W = (mpi *) polarssl_malloc( count * tsize * sizeof( mpi ) );
+    if( W == NULL )
+        return( POLARSSL_ERR_MPI_MALLOC_FAILED );
+
+    for( i = 0; i < count * tsize; i++ )
+        mpi_init( &W[i] );
+
+    mpi_montg_init( &mm, N );
+    mpi_init( &RR ); mpi_init( &T );
+
+    MPI_CHK( mpi_grow( &T, mpi_montmul_tmp_len( N->n ) ) );
+
+    /*
+     * If 1st call, pre-compute R^2 mod N
+     */
+    if( _RR == NULL || _RR->p == NULL )
+    {
+        MPI_CHK( mpi_lset( &RR, 1 ) );
+        MPI_CHK( mpi_shift_l( &RR, N->n * 2 * biL ) );
+        MPI_CHK( mpi_mod_mpi( &RR, &RR, N ) );
+
+        if( _RR != NULL )
+            memcpy( _RR, &RR, sizeof( mpi ) );
+    }
+    else
+        memcpy( &RR, _RR, sizeof( mpi ) );
+
+    /*
+     * Tables of every base, all built before any X[k] is written so that
+     * X and A may be the same array
+     */
+    for( k = 0; k < count; k++ )
+    {
+        Wk = W + k * tsize;
+
+        /*
+         * W[1] = A * R^2 * R^-1 mod N = A * R mod N
+         */
+        MPI_CHK( mpi_grow( &Wk[1], N->n + 1 ) );
+
+        if( mpi_cmp_int( &A[k], 0 ) < 0 || mpi_cmp_mpi( &A[k], N ) >= 0 )
+            MPI_CHK( mpi_mod_mpi( &Wk[1], &A[k], N ) );
+        else
+            MPI_CHK( mpi_copy( &Wk[1], &A[k] ) );
+
+        mpi_montmul( &Wk[1], &RR, N, mm, &T );
+
+        if( wsize > 1 )
+        {
+            /*
+             * W[1 << (wsize - 1)] = W[1] ^ (wsize - 1)
+             */
+            j = tsize >> 1;
+
+            MPI_CHK( mpi_grow( &Wk[j], N->n + 1 ) );
+            MPI_CHK( mpi_copy( &Wk[j], &Wk[1] ) );
+
+            for( i = 0; i < wsize - 1; i++ )
+                mpi_montmul( &Wk[j], &Wk[j], N, mm, &T );
+
+            /*
+             * W[i] = W[i - 1] * W[1]
+             */
+            for( i = j + 1; i < tsize; i++ )
+            {
+                MPI_CHK( mpi_grow( &Wk[i], N->n + 1 ) );
+                MPI_CHK( mpi_copy( &Wk[i], &Wk[i - 1] ) );
+
+                mpi_montmul( &Wk[i], &Wk[1], N, mm, &T );
+            }
+        }
+    }
+
+    /*
+     * X = R^2 * R^-1 mod N = R mod N
+     */
+    for( k = 0; k < count; k++ )
+    {
+        MPI_CHK( mpi_grow( &X[k], N->n + 1 ) );
+        MPI_CHK( mpi_copy( &X[k], &RR ) );
+        mpi_montred( &X[k], N, mm, &T );
+    }
+
+    nblimbs = E->n;
+    bufsize = 0;
+    nbits   = 0;
+    wbits   = 0;
+    state   = 0;
+
+    while( 1 )
+    {
+        if( bufsize == 0 )
+        {
+            if( nblimbs == 0 )
+                break;
+
+            nblimbs--;
+
+            bufsize = sizeof( t_uint ) << 3;
+        }
+
+        bufsize--;
+
+        ei = (E->p[nblimbs] >> bufsize) & 1;
+
+        /*
+         * skip leading 0s
+         */
+        if( ei == 0 && state == 0 )
+            continue;
+
+        if( ei == 0 && state == 1 )
+        {
+            /*
+             * out of window, square X
+             */
+            for( k = 0; k < count; k++ )
+                mpi_montmul( &X[k], &X[k], N, mm, &T );
+            continue;
+        }
+
+        /*
+         * add ei to current window
+         */
+        state = 2;
+
+        nbits++;
+        wbits |= (ei << (wsize - nbits));
+
+        if( nbits == wsize )
+        {
+            /*
+             * X = X^wsize R^-1 mod N
+             * X = X * W[wbits] R^-1 mod N
+             */
+            for( k = 0; k < count; k++ )
+            {
+                for( i = 0; i < wsize; i++ )
+                    mpi_montmul( &X[k], &X[k], N, mm, &T );
+
+                mpi_montmul( &X[k], &W[k * tsize + wbits], N, mm, &T );
+            }
+
+            state--;
+            nbits = 0;
+            wbits = 0;
+        }
+    }
+
+    /*
+     * process the remaining bits
+     */
+    for( i = 0; i < nbits; i++ )
+    {
+        wbits <<= 1;
+
+        for( k = 0; k < count; k++ )
+        {
+            mpi_montmul( &X[k], &X[k], N, mm, &T );
+
+            if( (wbits & (one << wsize)) != 0 )
+                mpi_montmul( &X[k], &W[k * tsize + 1], N, mm, &T );
+        }
+    }
+
+    /*
+     * X = A^E * R * R^-1 mod N = A^E mod N
+     */
+    for( k = 0; k < count; k++ )
+        mpi_montred( &X[k], N, mm, &T );
+
+cleanup:
+
+    for( i = 0; i < count * tsize; i++ )
+        mpi_free( &W[i] );
+
+    polarssl_free( W );
+    mpi_free( &T );
+
+    if( _RR == NULL || _RR->p == NULL )
+        mpi_free( &RR );
+
+    return( ret );
+}
+
+/*
+ * Fixed-base comb tables (HAC 14.117, Lim-Lee with a single table)
+ *
+ * With h teeth spaced d bits apart, the exponent is split in h blocks of
+ * d bits, and T[j] = G^( sum of 2^(i*d) for each bit i set in j ). Each of
+ * the d steps of mpi_exp_mod_fixed() is then one squaring and one
+ * multiplication by a table entry.
+ */
+void mpi_fixed_base_init( mpi_fixed_base *B )
+{
+    memset( B, 0, sizeof( mpi_fixed_base ) );
+}
+
+void mpi_fixed_base_free( mpi_fixed_base *B )
+{
+    size_t i;
+
+    if( B == NULL )
+        return;
+
+    if( B->T != NULL )
+    {
+        for( i = 0; i < ( (size_t) 1 << B->h ); i++ )
+            mpi_free( &B->T[i] );
+
+        polarssl_free( B->T );
+    }
+
+    mpi_free( &B->N );
+
+    memset( B, 0, sizeof( mpi_fixed_base ) );
+}
+
+int mpi_fixed_base_setup( mpi_fixed_base *B, const mpi *G, const mpi *N,
+                          size_t ebits )
+{
+    int ret;
+    size_t i, j, h, d, top, one = 1;
+    mpi RR, T;
+
+    if( mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mpi_cmp_int( G, 0 ) < 0 || ebits == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_fixed_base_free( B );
+
+    h = POLARSSL_MPI_FIXED_BASE_TEETH;
+    if( h > ebits )
+        h = ebits;
+    d = ( ebits + h - 1 ) / h;
+
+    B->T = (mpi *) polarssl_malloc( ( one << h ) * sizeof( mpi ) );
+    if( B->T == NULL )
+        return( POLARSSL_ERR_MPI_MALLOC_FAILED );
+
+    B->h = h;
+    B->d = d;
+
+    for( i = 0; i < ( one << h ); i++ )
+        mpi_init( &B->T[i] );
+
+    mpi_init( &RR ); mpi_init( &T );
+
+    MPI_CHK( mpi_copy( &B->N, N ) );
+    mpi_montg_init( &B->mm, N );
+
+    j = N->n + 1;
+    MPI_CHK( mpi_grow( &T, mpi_montmul_tmp_len( N->n ) ) );
+
+    MPI_CHK( mpi_lset( &RR, 1 ) );
+    MPI_CHK( mpi_shift_l( &RR, N->n * 2 * biL ) );
+    MPI_CHK( mpi_mod_mpi( &RR, &RR, N ) );
+
+    /*
+     * T[0] = R mod N, T[1] = G * R mod N
+     */
+    MPI_CHK( mpi_copy( &B->T[0], &RR ) );
+    MPI_CHK( mpi_grow( &B->T[0], j ) );
+    mpi_montred( &B->T[0], N, B->mm, &T );
+
+    MPI_CHK( mpi_mod_mpi( &B->T[1], G, N ) );
+    MPI_CHK( mpi_grow( &B->T[1], j ) );
+    mpi_montmul( &B->T[1], &RR, N, B->mm, &T );
+
+    /*
+     * T[2^i] = T[2^(i-1)] ^ (2^d)
+     */
+    for( i = 1; i < h; i++ )
+    {
+        MPI_CHK( mpi_copy( &B->T[one << i], &B->T[one << ( i - 1 )] ) );
+        MPI_CHK( mpi_grow( &B->T[one << i], j ) );
+
+        for( top = 0; top < d; top++ )
+            mpi_montmul( &B->T[one << i], &B->T[one << i], N, B->mm, &T );
+    }
+
+    /*
+     * T[i] = T[i - top] * T[top], top being the highest bit of i
+     */
+    for( top = 2; top < ( one << h ); top <<= 1 )
+    {
+        for( i = top + 1; i < ( top << 1 ); i++ )
+        {
+            MPI_CHK( mpi_copy( &B->T[i], &B->T[i - top] ) );
+            MPI_CHK( mpi_grow( &B->T[i], j ) );
+            mpi_montmul( &B->T[i], &B->T[top], N, B->mm, &T );
+        }
+    }
+
+cleanup:
+
+    mpi_free( &RR ); mpi_free( &T );
+
+    if( ret != 0 )
+        mpi_fixed_base_free( B );
+
+    return( ret );
+}
+
+/*
+ * Fixed-base comb exponentiation: X = G^E mod N
+ */
+int mpi_exp_mod_fixed( mpi *X, const mpi_fixed_base *B, const mpi *E )
+{
+    int ret;
+    size_t i, k, idx;
+    mpi T;
+
+    if( B->T == NULL || mpi_cmp_int( E, 0 ) < 0 ||
+        mpi_msb( E ) > B->h * B->d )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_grow( &T, mpi_montmul_tmp_len( B->N.n ) ) );
+    MPI_CHK( mpi_copy( X, &B->T[0] ) );
+    MPI_CHK( mpi_grow( X, B->N.n + 1 ) );
+
+    for( k = B->d; k-- > 0; )
+    {
+        idx = 0;
+        for( i = 0; i < B->h; i++ )
+            idx |= (size_t) mpi_get_bit( E, i * B->d + k ) << i;
+
+        if( k != B->d - 1 )
+            mpi_montmul( X, X, &B->N, B->mm, &T );
+
+        mpi_montmul( X, &B->T[idx], &B->N, B->mm, &T );
+    }
+
+    /*
+     * X = G^E * R * R^-1 mod N = G^E mod N
+     */
+    mpi_montred( X, &B->N, B->mm, &T );
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
 /*
  * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
  */
@@ -106,6 +106,61 @@ static int dhm_check_range( const mpi *param, const mpi *P )
     return( ret );
 }
 
+/*
+ * Maximum number of (P, G) pairs in the fixed-base cache
+ */
+#define DHM_BASE_CACHE_SIZE     4
+
+/*
+ * Process-wide cache of fixed-base tables, one per group (P, G).
+ *
+ * Entries are only added by dhm_base_cache_add() and removed by
+ * dhm_base_cache_free(), and a table is never modified once it has been
+ * published, so lookups need no locking.
+ */
+typedef struct
+{
+    mpi G;                  /* generator the table was computed for     */
+    mpi_fixed_base B;       /* powers of G, B.N is the prime modulus    */
+}
+dhm_base_cache_entry;
+
+static dhm_base_cache_entry dhm_base_cache[DHM_BASE_CACHE_SIZE];
+
+/*
+ * Return the cached table for ctx->G and ctx->P, or NULL
+ */
+static const mpi_fixed_base *dhm_base_cache_get( const dhm_context *ctx )
+{
+    size_t i;
+
+    for( i = 0; i < DHM_BASE_CACHE_SIZE; i++ )
+    {
+        if( dhm_base_cache[i].B.T != NULL &&
+            mpi_cmp_mpi( &dhm_base_cache[i].B.N, &ctx->P ) == 0 &&
+            mpi_cmp_mpi( &dhm_base_cache[i].G, &ctx->G ) == 0 )
+        {
+            return( &dhm_base_cache[i].B );
+        }
+    }
+
+    return( NULL );
+}
+
+/*
+ * Calculate GX = G^X mod P, using the cached table if there is one
+ */
+static int dhm_make_gx( dhm_context *ctx )
+{
+    const mpi_fixed_base *B = dhm_base_cache_get( ctx );
+
+    if( B != NULL )
+        return( mpi_exp_mod_fixed( &ctx->GX, B, &ctx->X ) );
+
+    return( mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
+                         &ctx->P , &ctx->RP ) );
+}
+
 /*
  * Parse the ServerKeyExchange parameters
  */
@@ -163,8 +218,7 @@ int dhm_make_params( dhm_context *ctx, int x_size,
     /*
      * Calculate GX = G^X mod P
      */
-    MPI_CHK( mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
-                          &ctx->P , &ctx->RP ) );
+    MPI_CHK( dhm_make_gx( ctx ) );
 
     if( ( ret = dhm_check_range( &ctx->GX, &ctx->P ) ) != 0 )
         return( ret );
@@ -246,8 +300,7 @@ int dhm_make_public( dhm_context *ctx, int x_size,
     }
     while( dhm_check_range( &ctx->X, &ctx->P ) != 0 );
 
-    MPI_CHK( mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
-                          &ctx->P , &ctx->RP ) );
+    MPI_CHK( dhm_make_gx( ctx ) );
 
     if( ( ret = dhm_check_range( &ctx->GX, &ctx->P ) ) != 0 )
         return( ret );
@@ -393,6 +446,67 @@ void dhm_free( dhm_context *ctx )
     memset( ctx, 0, sizeof( dhm_context ) );
 }
 
+/*
+ * Pre-compute and publish the fixed-base table for (P, G)
+ */
+int dhm_base_cache_add( const mpi *P, const mpi *G )
+{
+    int ret;
+    size_t i, slot;
+    mpi_fixed_base B;
+    mpi GG;
+
+    slot = DHM_BASE_CACHE_SIZE;
+    for( i = 0; i < DHM_BASE_CACHE_SIZE; i++ )
+    {
+        if( dhm_base_cache[i].B.T == NULL )
+        {
+            if( slot == DHM_BASE_CACHE_SIZE )
+                slot = i;
+        }
+        else if( mpi_cmp_mpi( &dhm_base_cache[i].B.N, P ) == 0 &&
+                 mpi_cmp_mpi( &dhm_base_cache[i].G, G ) == 0 )
+            return( 0 );
+    }
+
+    if( slot == DHM_BASE_CACHE_SIZE )
+        return( POLARSSL_ERR_DHM_BAD_INPUT_DATA );
+
+    mpi_fixed_base_init( &B );
+    mpi_init( &GG );
+
+    MPI_CHK( mpi_copy( &GG, G ) );
+
+    /* Private values are always smaller than P */
+    MPI_CHK( mpi_fixed_base_setup( &B, G, P, mpi_msb( P ) ) );
+
+    /* Only publish the table once it is complete */
+    memcpy( &dhm_base_cache[slot].G, &GG, sizeof( mpi ) );
+    memcpy( &dhm_base_cache[slot].B, &B, sizeof( mpi_fixed_base ) );
+    mpi_init( &GG );
+    mpi_fixed_base_init( &B );
+
+cleanup:
+    mpi_free( &GG );
+    mpi_fixed_base_free( &B );
+
+    return( ret );
+}
+
+/*
+ * Release all cached fixed-base tables
+ */
+void dhm_base_cache_free( void )
+{
+    size_t i;
+
+    for( i = 0; i < DHM_BASE_CACHE_SIZE; i++ )
+    {
+        mpi_free( &dhm_base_cache[i].G );
+        mpi_fixed_base_free( &dhm_base_cache[i].B );
+    }
+}
+
 #if defined(POLARSSL_ASN1_PARSE_C)
 /*
  * Parse DHM parameters
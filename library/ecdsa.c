@@ -234,9 +234,9 @@ int ecdsa_verify( ecp_group *grp,
 {
     int ret;
     mpi e, s_inv, u1, u2;
-    ecp_point R, P;
+    ecp_point R;
 
-    ecp_point_init( &R ); ecp_point_init( &P );
+    ecp_point_init( &R );
     mpi_init( &e ); mpi_init( &s_inv ); mpi_init( &u1 ); mpi_init( &u2 );
 
     /* Fail cleanly on curves such as Curve25519 that can't be used for ECDSA */
@@ -277,12 +277,10 @@ int ecdsa_verify( ecp_group *grp,
     /*
      * Step 5: R = u1 G + u2 Q
      *
-     * Since we're not using any secret data, no need to pass a RNG to
-     * ecp_mul() for countermesures.
+     * Since we're not using any secret data, there is no need for
+     * countermeasures: use the faster, variable-time ecp_muladd().
      */
-    MPI_CHK( ecp_mul( grp, &R, &u1, &grp->G, NULL, NULL ) );
-    MPI_CHK( ecp_mul( grp, &P, &u2, Q, NULL, NULL ) );
-    MPI_CHK( ecp_add( grp, &R, &R, &P ) );
+    MPI_CHK( ecp_muladd( grp, &R, &u1, &grp->G, &u2, Q ) );
 
     if( ecp_is_zero( &R ) )
     {
@@ -306,7 +304,7 @@ int ecdsa_verify( ecp_group *grp,
     }
 
 cleanup:
-    ecp_point_free( &R ); ecp_point_free( &P );
+    ecp_point_free( &R );
     mpi_free( &e ); mpi_free( &s_inv ); mpi_free( &u1 ); mpi_free( &u2 );
 
     return( ret );
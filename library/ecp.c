@@ -50,6 +50,14 @@
 
 #include "polarssl/ecp.h"
 
+#if defined(POLARSSL_ECP_P256_C)
+#include "polarssl/ecp_p256.h"
+#endif
+
+#if defined(POLARSSL_ECP_X25519_C)
+#include "polarssl/ecp_x25519.h"
+#endif
+
 #if defined(POLARSSL_PLATFORM_C)
 #include "polarssl/platform.h"
 #else
@@ -718,9 +726,9 @@ cleanup:
  * Reduce a mpi mod p in-place, to use after mpi_sub_mpi
  * N->s < 0 is a very fast test, which fails only if N is 0
  */
-#define MOD_SUB( N )                                \
-    while( N.s < 0 && mpi_cmp_int( &N, 0 ) != 0 )   \
-        MPI_CHK( mpi_add_mpi( &N, &N, &grp->P ) )
+#define MOD_SUB( N )                                    \
+    while( (N).s < 0 && mpi_cmp_int( &(N), 0 ) != 0 )   \
+        MPI_CHK( mpi_add_mpi( &(N), &(N), &grp->P ) )
 
 /*
  * Reduce a mpi mod p in-place, to use after mpi_add_mpi and mpi_mul_int.
@@ -731,6 +739,48 @@ cleanup:
     while( mpi_cmp_mpi( &N, &grp->P ) >= 0 )        \
         MPI_CHK( mpi_sub_abs( &N, &N, &grp->P ) )
 
+/*
+ * Temporaries for the point arithmetic functions below.
+ *
+ * Rather than having each of them init and free its own temporaries, hence
+ * allocate them again for every single point operation, the callers provide
+ * an array of ECP_TMP_NB mpi's, grown once to hold a product of two
+ * elements of GF(p). Also, the destination of mpi_mul_mpi() is never one of
+ * its operands, which would make it copy them to new temporaries.
+ *
+ * With this, and provided the points involved are already large enough,
+ * the main loops of the multiplication functions make no allocation.
+ */
+#define ECP_TMP_NB      8
+
+static void ecp_tmp_init( mpi tmp[] )
+{
+    size_t i;
+
+    for( i = 0; i < ECP_TMP_NB; i++ )
+        mpi_init( &tmp[i] );
+}
+
+static int ecp_tmp_grow( const ecp_group *grp, mpi tmp[] )
+{
+    int ret = 0;
+    size_t i;
+
+    for( i = 0; i < ECP_TMP_NB; i++ )
+        MPI_CHK( mpi_grow( &tmp[i], 2 * grp->P.n + 1 ) );
+
+cleanup:
+    return( ret );
+}
+
+static void ecp_tmp_free( mpi tmp[] )
+{
+    size_t i;
+
+    for( i = 0; i < ECP_TMP_NB; i++ )
+        mpi_free( &tmp[i] );
+}
+
 #if defined(POLARSSL_ECP_SHORT_WEIERSTRASS)
 /*
  * For curves in short Weierstrass form, we do all the internal operations in
@@ -744,28 +794,29 @@ cleanup:
  * Normalize jacobian coordinates so that Z == 0 || Z == 1  (GECC 3.2.1)
  * Cost: 1N := 1I + 3M + 1S
  */
-static int ecp_normalize_jac( const ecp_group *grp, ecp_point *pt )
+static int ecp_normalize_jac( const ecp_group *grp, ecp_point *pt,
+                              mpi tmp[] )
 {
     int ret;
-    mpi Zi, ZZi;
+    mpi *Zi = &tmp[0], *ZZi = &tmp[1], *T = &tmp[2];
 
     if( mpi_cmp_int( &pt->Z, 0 ) == 0 )
         return( 0 );
 
-    mpi_init( &Zi ); mpi_init( &ZZi );
-
     /*
      * X = X / Z^2  mod p
      */
-    MPI_CHK( mpi_inv_mod( &Zi,      &pt->Z,     &grp->P ) );
-    MPI_CHK( mpi_mul_mpi( &ZZi,     &Zi,        &Zi     ) ); MOD_MUL( ZZi );
-    MPI_CHK( mpi_mul_mpi( &pt->X,   &pt->X,     &ZZi    ) ); MOD_MUL( pt->X );
+    MPI_CHK( mpi_inv_mod( Zi,       &pt->Z,     &grp->P ) );
+    MPI_CHK( mpi_mul_mpi( ZZi,      Zi,         Zi      ) ); MOD_MUL( *ZZi );
+    MPI_CHK( mpi_mul_mpi( T,        &pt->X,     ZZi     ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &pt->X, T ) );
 
     /*
      * Y = Y / Z^3  mod p
      */
-    MPI_CHK( mpi_mul_mpi( &pt->Y,   &pt->Y,     &ZZi    ) ); MOD_MUL( pt->Y );
-    MPI_CHK( mpi_mul_mpi( &pt->Y,   &pt->Y,     &Zi     ) ); MOD_MUL( pt->Y );
+    MPI_CHK( mpi_mul_mpi( T,        &pt->Y,     ZZi     ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_mul_mpi( ZZi,      T,          Zi      ) ); MOD_MUL( *ZZi );
+    MPI_CHK( mpi_copy( &pt->Y, ZZi ) );
 
     /*
      * Z = 1
@@ -773,9 +824,6 @@ static int ecp_normalize_jac( const ecp_group *grp, ecp_point *pt )
     MPI_CHK( mpi_lset( &pt->Z, 1 ) );
 
 cleanup:
-
-    mpi_free( &Zi ); mpi_free( &ZZi );
-
     return( ret );
 }
 
@@ -791,19 +839,19 @@ cleanup:
  * Cost: 1N(t) := 1I + (6t - 3)M + 1S
  */
 static int ecp_normalize_jac_many( const ecp_group *grp,
-                                   ecp_point *T[], size_t t_len )
+                                   ecp_point *T[], size_t t_len,
+                                   mpi tmp[] )
 {
     int ret;
     size_t i;
-    mpi *c, u, Zi, ZZi;
+    mpi *c, *u = &tmp[0], *Zi = &tmp[1], *ZZi = &tmp[2], *M = &tmp[3];
 
     if( t_len < 2 )
-        return( ecp_normalize_jac( grp, *T ) );
+        return( ecp_normalize_jac( grp, *T, tmp ) );
 
     if( ( c = (mpi *) polarssl_malloc( t_len * sizeof( mpi ) ) ) == NULL )
         return( POLARSSL_ERR_ECP_MALLOC_FAILED );
 
-    mpi_init( &u ); mpi_init( &Zi ); mpi_init( &ZZi );
     for( i = 0; i < t_len; i++ )
         mpi_init( &c[i] );
 
@@ -820,7 +868,7 @@ static int ecp_normalize_jac_many( const ecp_group *grp,
     /*
      * u = 1 / (Z_0 * ... * Z_n) mod P
      */
-    MPI_CHK( mpi_inv_mod( &u, &c[t_len-1], &grp->P ) );
+    MPI_CHK( mpi_inv_mod( u, &c[t_len-1], &grp->P ) );
 
     for( i = t_len - 1; ; i-- )
     {
@@ -829,21 +877,24 @@ static int ecp_normalize_jac_many( const ecp_group *grp,
          * u = 1 / (Z_0 * ... * Z_i) mod P
          */
         if( i == 0 ) {
-            MPI_CHK( mpi_copy( &Zi, &u ) );
+            MPI_CHK( mpi_copy( Zi, u ) );
         }
         else
         {
-            MPI_CHK( mpi_mul_mpi( &Zi, &u, &c[i-1]  ) ); MOD_MUL( Zi );
-            MPI_CHK( mpi_mul_mpi( &u,  &u, &T[i]->Z ) ); MOD_MUL( u );
+            MPI_CHK( mpi_mul_mpi( Zi, u, &c[i-1]  ) ); MOD_MUL( *Zi );
+            MPI_CHK( mpi_mul_mpi( M,  u, &T[i]->Z ) ); MOD_MUL( *M );
+            mpi_swap( u, M );
         }
 
         /*
          * proceed as in normalize()
          */
-        MPI_CHK( mpi_mul_mpi( &ZZi,     &Zi,      &Zi  ) ); MOD_MUL( ZZi );
-        MPI_CHK( mpi_mul_mpi( &T[i]->X, &T[i]->X, &ZZi ) ); MOD_MUL( T[i]->X );
-        MPI_CHK( mpi_mul_mpi( &T[i]->Y, &T[i]->Y, &ZZi ) ); MOD_MUL( T[i]->Y );
-        MPI_CHK( mpi_mul_mpi( &T[i]->Y, &T[i]->Y, &Zi  ) ); MOD_MUL( T[i]->Y );
+        MPI_CHK( mpi_mul_mpi( ZZi,      Zi,       Zi   ) ); MOD_MUL( *ZZi );
+        MPI_CHK( mpi_mul_mpi( M,        &T[i]->X, ZZi  ) ); MOD_MUL( *M );
+        MPI_CHK( mpi_copy( &T[i]->X, M ) );
+        MPI_CHK( mpi_mul_mpi( M,        &T[i]->Y, ZZi  ) ); MOD_MUL( *M );
+        MPI_CHK( mpi_mul_mpi( ZZi,      M,        Zi   ) ); MOD_MUL( *ZZi );
+        MPI_CHK( mpi_copy( &T[i]->Y, ZZi ) );
 
         /*
          * Post-precessing: reclaim some memory by shrinking coordinates
@@ -861,7 +912,6 @@ static int ecp_normalize_jac_many( const ecp_group *grp,
 
 cleanup:
 
-    mpi_free( &u ); mpi_free( &Zi ); mpi_free( &ZZi );
     for( i = 0; i < t_len; i++ )
         mpi_free( &c[i] );
     polarssl_free( c );
@@ -875,22 +925,19 @@ cleanup:
  */
 static int ecp_safe_invert_jac( const ecp_group *grp,
                             ecp_point *Q,
-                            unsigned char inv )
+                            unsigned char inv,
+                            mpi tmp[] )
 {
     int ret;
     unsigned char nonzero;
-    mpi mQY;
-
-    mpi_init( &mQY );
+    mpi *mQY = &tmp[0];
 
     /* Use the fact that -Q.Y mod P = P - Q.Y unless Q.Y == 0 */
-    MPI_CHK( mpi_sub_mpi( &mQY, &grp->P, &Q->Y ) );
+    MPI_CHK( mpi_sub_mpi( mQY, &grp->P, &Q->Y ) );
     nonzero = mpi_cmp_int( &Q->Y, 0 ) != 0;
-    MPI_CHK( mpi_safe_cond_assign( &Q->Y, &mQY, inv & nonzero ) );
+    MPI_CHK( mpi_safe_cond_assign( &Q->Y, mQY, inv & nonzero ) );
 
 cleanup:
-    mpi_free( &mQY );
-
     return( ret );
 }
 
@@ -900,66 +947,66 @@ cleanup:
  * http://www.hyperelliptic.org/EFD/g1p/auto-code/shortw/jacobian/doubling/dbl-2007-bl.op3
  * with heavy variable renaming, some reordering and one minor modification
  * (a = 2 * b, c = d - 2a replaced with c = d, c = c - b, c = c - b)
- * in order to use a lot less intermediate variables (6 vs 25).
+ * in order to use a lot less intermediate variables (7 vs 25).
  *
  * Cost: 1D := 2M + 8S
  */
 static int ecp_double_jac( const ecp_group *grp, ecp_point *R,
-                           const ecp_point *P )
+                           const ecp_point *P, mpi tmp[] )
 {
     int ret;
-    mpi T1, T2, T3, X3, Y3, Z3;
+    mpi *T1 = &tmp[0], *T2 = &tmp[1], *T3 = &tmp[2], *T4 = &tmp[3];
+    mpi *X3 = &tmp[4], *Y3 = &tmp[5], *Z3 = &tmp[6];
 
 #if defined(POLARSSL_SELF_TEST)
     dbl_count++;
 #endif
 
-    mpi_init( &T1 ); mpi_init( &T2 ); mpi_init( &T3 );
-    mpi_init( &X3 ); mpi_init( &Y3 ); mpi_init( &Z3 );
-
-    MPI_CHK( mpi_mul_mpi( &T3,  &P->X,  &P->X   ) ); MOD_MUL( T3 );
-    MPI_CHK( mpi_mul_mpi( &T2,  &P->Y,  &P->Y   ) ); MOD_MUL( T2 );
-    MPI_CHK( mpi_mul_mpi( &Y3,  &T2,    &T2     ) ); MOD_MUL( Y3 );
-    MPI_CHK( mpi_add_mpi( &X3,  &P->X,  &T2     ) ); MOD_ADD( X3 );
-    MPI_CHK( mpi_mul_mpi( &X3,  &X3,    &X3     ) ); MOD_MUL( X3 );
-    MPI_CHK( mpi_sub_mpi( &X3,  &X3,    &Y3     ) ); MOD_SUB( X3 );
-    MPI_CHK( mpi_sub_mpi( &X3,  &X3,    &T3     ) ); MOD_SUB( X3 );
-    MPI_CHK( mpi_mul_int( &T1,  &X3,    2       ) ); MOD_ADD( T1 );
-    MPI_CHK( mpi_mul_mpi( &Z3,  &P->Z,  &P->Z   ) ); MOD_MUL( Z3 );
-    MPI_CHK( mpi_mul_mpi( &X3,  &Z3,    &Z3     ) ); MOD_MUL( X3 );
-    MPI_CHK( mpi_mul_int( &T3,  &T3,    3       ) ); MOD_ADD( T3 );
+    MPI_CHK( mpi_mul_mpi( T3,   &P->X,  &P->X   ) ); MOD_MUL( *T3 );
+    MPI_CHK( mpi_mul_mpi( T2,   &P->Y,  &P->Y   ) ); MOD_MUL( *T2 );
+    MPI_CHK( mpi_mul_mpi( Y3,   T2,     T2      ) ); MOD_MUL( *Y3 );
+    MPI_CHK( mpi_add_mpi( T4,   &P->X,  T2      ) ); MOD_ADD( *T4 );
+    MPI_CHK( mpi_mul_mpi( X3,   T4,     T4      ) ); MOD_MUL( *X3 );
+    MPI_CHK( mpi_sub_mpi( X3,   X3,     Y3      ) ); MOD_SUB( *X3 );
+    MPI_CHK( mpi_sub_mpi( X3,   X3,     T3      ) ); MOD_SUB( *X3 );
+    MPI_CHK( mpi_add_mpi( T1,   X3,     X3      ) ); MOD_ADD( *T1 );
+    MPI_CHK( mpi_mul_mpi( Z3,   &P->Z,  &P->Z   ) ); MOD_MUL( *Z3 );
+    MPI_CHK( mpi_mul_mpi( T4,   Z3,     Z3      ) ); MOD_MUL( *T4 );
+    MPI_CHK( mpi_add_mpi( X3,   T3,     T3      ) ); MOD_ADD( *X3 );
+    MPI_CHK( mpi_add_mpi( T3,   X3,     T3      ) ); MOD_ADD( *T3 );
 
     /* Special case for A = -3 */
     if( grp->A.p == NULL )
     {
-        MPI_CHK( mpi_mul_int( &X3, &X3, 3 ) );
-        X3.s = -1; /* mpi_mul_int doesn't handle negative numbers */
-        MOD_SUB( X3 );
+        MPI_CHK( mpi_add_mpi( X3,   T4,     T4      ) ); MOD_ADD( *X3 );
+        MPI_CHK( mpi_add_mpi( X3,   X3,     T4      ) ); MOD_ADD( *X3 );
+        MPI_CHK( mpi_sub_mpi( T3,   T3,     X3      ) ); MOD_SUB( *T3 );
     }
     else
-        MPI_CHK( mpi_mul_mpi( &X3,  &X3,    &grp->A ) ); MOD_MUL( X3 );
-
-    MPI_CHK( mpi_add_mpi( &T3,  &T3,    &X3     ) ); MOD_ADD( T3 );
-    MPI_CHK( mpi_mul_mpi( &X3,  &T3,    &T3     ) ); MOD_MUL( X3 );
-    MPI_CHK( mpi_sub_mpi( &X3,  &X3,    &T1     ) ); MOD_SUB( X3 );
-    MPI_CHK( mpi_sub_mpi( &X3,  &X3,    &T1     ) ); MOD_SUB( X3 );
-    MPI_CHK( mpi_sub_mpi( &T1,  &T1,    &X3     ) ); MOD_SUB( T1 );
-    MPI_CHK( mpi_mul_mpi( &T1,  &T3,    &T1     ) ); MOD_MUL( T1 );
-    MPI_CHK( mpi_mul_int( &T3,  &Y3,    8       ) ); MOD_ADD( T3 );
-    MPI_CHK( mpi_sub_mpi( &Y3,  &T1,    &T3     ) ); MOD_SUB( Y3 );
-    MPI_CHK( mpi_add_mpi( &T1,  &P->Y,  &P->Z   ) ); MOD_ADD( T1 );
-    MPI_CHK( mpi_mul_mpi( &T1,  &T1,    &T1     ) ); MOD_MUL( T1 );
-    MPI_CHK( mpi_sub_mpi( &T1,  &T1,    &T2     ) ); MOD_SUB( T1 );
-    MPI_CHK( mpi_sub_mpi( &Z3,  &T1,    &Z3     ) ); MOD_SUB( Z3 );
-
-    MPI_CHK( mpi_copy( &R->X, &X3 ) );
-    MPI_CHK( mpi_copy( &R->Y, &Y3 ) );
-    MPI_CHK( mpi_copy( &R->Z, &Z3 ) );
+    {
+        MPI_CHK( mpi_mul_mpi( X3,   T4,     &grp->A ) ); MOD_MUL( *X3 );
+        MPI_CHK( mpi_add_mpi( T3,   T3,     X3      ) ); MOD_ADD( *T3 );
+    }
 
-cleanup:
-    mpi_free( &T1 ); mpi_free( &T2 ); mpi_free( &T3 );
-    mpi_free( &X3 ); mpi_free( &Y3 ); mpi_free( &Z3 );
+    MPI_CHK( mpi_mul_mpi( X3,   T3,     T3      ) ); MOD_MUL( *X3 );
+    MPI_CHK( mpi_sub_mpi( X3,   X3,     T1      ) ); MOD_SUB( *X3 );
+    MPI_CHK( mpi_sub_mpi( X3,   X3,     T1      ) ); MOD_SUB( *X3 );
+    MPI_CHK( mpi_sub_mpi( T1,   T1,     X3      ) ); MOD_SUB( *T1 );
+    MPI_CHK( mpi_mul_mpi( T4,   T3,     T1      ) ); MOD_MUL( *T4 );
+    MPI_CHK( mpi_add_mpi( T1,   Y3,     Y3      ) ); MOD_ADD( *T1 );
+    MPI_CHK( mpi_add_mpi( T3,   T1,     T1      ) ); MOD_ADD( *T3 );
+    MPI_CHK( mpi_add_mpi( T1,   T3,     T3      ) ); MOD_ADD( *T1 );
+    MPI_CHK( mpi_sub_mpi( Y3,   T4,     T1      ) ); MOD_SUB( *Y3 );
+    MPI_CHK( mpi_add_mpi( T1,   &P->Y,  &P->Z   ) ); MOD_ADD( *T1 );
+    MPI_CHK( mpi_mul_mpi( T4,   T1,     T1      ) ); MOD_MUL( *T4 );
+    MPI_CHK( mpi_sub_mpi( T4,   T4,     T2      ) ); MOD_SUB( *T4 );
+    MPI_CHK( mpi_sub_mpi( T4,   T4,     Z3      ) ); MOD_SUB( *T4 );
+
+    MPI_CHK( mpi_copy( &R->X, X3 ) );
+    MPI_CHK( mpi_copy( &R->Y, Y3 ) );
+    MPI_CHK( mpi_copy( &R->Z, T4 ) );
 
+cleanup:
     return( ret );
 }
 
@@ -982,10 +1029,12 @@ cleanup:
  * Cost: 1A := 8M + 3S
  */
 static int ecp_add_mixed( const ecp_group *grp, ecp_point *R,
-                          const ecp_point *P, const ecp_point *Q )
+                          const ecp_point *P, const ecp_point *Q,
+                          mpi tmp[] )
 {
     int ret;
-    mpi T1, T2, T3, T4, X, Y, Z;
+    mpi *T1 = &tmp[0], *T2 = &tmp[1], *T3 = &tmp[2], *T4 = &tmp[3];
+    mpi *X = &tmp[4], *Y = &tmp[5], *Z = &tmp[6];
 
 #if defined(POLARSSL_SELF_TEST)
     add_count++;
@@ -1006,22 +1055,19 @@ static int ecp_add_mixed( const ecp_group *grp, ecp_point *R,
     if( Q->Z.p != NULL && mpi_cmp_int( &Q->Z, 1 ) != 0 )
         return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
 
-    mpi_init( &T1 ); mpi_init( &T2 ); mpi_init( &T3 ); mpi_init( &T4 );
-    mpi_init( &X ); mpi_init( &Y ); mpi_init( &Z );
-
-    MPI_CHK( mpi_mul_mpi( &T1,  &P->Z,  &P->Z ) );  MOD_MUL( T1 );
-    MPI_CHK( mpi_mul_mpi( &T2,  &T1,    &P->Z ) );  MOD_MUL( T2 );
-    MPI_CHK( mpi_mul_mpi( &T1,  &T1,    &Q->X ) );  MOD_MUL( T1 );
-    MPI_CHK( mpi_mul_mpi( &T2,  &T2,    &Q->Y ) );  MOD_MUL( T2 );
-    MPI_CHK( mpi_sub_mpi( &T1,  &T1,    &P->X ) );  MOD_SUB( T1 );
-    MPI_CHK( mpi_sub_mpi( &T2,  &T2,    &P->Y ) );  MOD_SUB( T2 );
+    MPI_CHK( mpi_mul_mpi( T1,   &P->Z,  &P->Z ) );  MOD_MUL( *T1 );
+    MPI_CHK( mpi_mul_mpi( T2,   T1,     &P->Z ) );  MOD_MUL( *T2 );
+    MPI_CHK( mpi_mul_mpi( T3,   T1,     &Q->X ) );  MOD_MUL( *T3 );
+    MPI_CHK( mpi_mul_mpi( T4,   T2,     &Q->Y ) );  MOD_MUL( *T4 );
+    MPI_CHK( mpi_sub_mpi( T1,   T3,     &P->X ) );  MOD_SUB( *T1 );
+    MPI_CHK( mpi_sub_mpi( T2,   T4,     &P->Y ) );  MOD_SUB( *T2 );
 
     /* Special cases (2) and (3) */
-    if( mpi_cmp_int( &T1, 0 ) == 0 )
+    if( mpi_cmp_int( T1, 0 ) == 0 )
     {
-        if( mpi_cmp_int( &T2, 0 ) == 0 )
+        if( mpi_cmp_int( T2, 0 ) == 0 )
         {
-            ret = ecp_double_jac( grp, R, P );
+            ret = ecp_double_jac( grp, R, P, tmp );
             goto cleanup;
         }
         else
@@ -1031,28 +1077,24 @@ static int ecp_add_mixed( const ecp_group *grp, ecp_point *R,
         }
     }
 
-    MPI_CHK( mpi_mul_mpi( &Z,   &P->Z,  &T1   ) );  MOD_MUL( Z  );
-    MPI_CHK( mpi_mul_mpi( &T3,  &T1,    &T1   ) );  MOD_MUL( T3 );
-    MPI_CHK( mpi_mul_mpi( &T4,  &T3,    &T1   ) );  MOD_MUL( T4 );
-    MPI_CHK( mpi_mul_mpi( &T3,  &T3,    &P->X ) );  MOD_MUL( T3 );
-    MPI_CHK( mpi_mul_int( &T1,  &T3,    2     ) );  MOD_ADD( T1 );
-    MPI_CHK( mpi_mul_mpi( &X,   &T2,    &T2   ) );  MOD_MUL( X  );
-    MPI_CHK( mpi_sub_mpi( &X,   &X,     &T1   ) );  MOD_SUB( X  );
-    MPI_CHK( mpi_sub_mpi( &X,   &X,     &T4   ) );  MOD_SUB( X  );
-    MPI_CHK( mpi_sub_mpi( &T3,  &T3,    &X    ) );  MOD_SUB( T3 );
-    MPI_CHK( mpi_mul_mpi( &T3,  &T3,    &T2   ) );  MOD_MUL( T3 );
-    MPI_CHK( mpi_mul_mpi( &T4,  &T4,    &P->Y ) );  MOD_MUL( T4 );
-    MPI_CHK( mpi_sub_mpi( &Y,   &T3,    &T4   ) );  MOD_SUB( Y  );
-
-    MPI_CHK( mpi_copy( &R->X, &X ) );
-    MPI_CHK( mpi_copy( &R->Y, &Y ) );
-    MPI_CHK( mpi_copy( &R->Z, &Z ) );
+    MPI_CHK( mpi_mul_mpi( Z,    &P->Z,  T1    ) );  MOD_MUL( *Z  );
+    MPI_CHK( mpi_mul_mpi( T3,   T1,     T1    ) );  MOD_MUL( *T3 );
+    MPI_CHK( mpi_mul_mpi( T4,   T3,     T1    ) );  MOD_MUL( *T4 );
+    MPI_CHK( mpi_mul_mpi( Y,    T3,     &P->X ) );  MOD_MUL( *Y  );
+    MPI_CHK( mpi_add_mpi( T1,   Y,      Y     ) );  MOD_ADD( *T1 );
+    MPI_CHK( mpi_mul_mpi( X,    T2,     T2    ) );  MOD_MUL( *X  );
+    MPI_CHK( mpi_sub_mpi( X,    X,      T1    ) );  MOD_SUB( *X  );
+    MPI_CHK( mpi_sub_mpi( X,    X,      T4    ) );  MOD_SUB( *X  );
+    MPI_CHK( mpi_sub_mpi( Y,    Y,      X     ) );  MOD_SUB( *Y  );
+    MPI_CHK( mpi_mul_mpi( T3,   Y,      T2    ) );  MOD_MUL( *T3 );
+    MPI_CHK( mpi_mul_mpi( T1,   T4,     &P->Y ) );  MOD_MUL( *T1 );
+    MPI_CHK( mpi_sub_mpi( Y,    T3,     T1    ) );  MOD_SUB( *Y  );
+
+    MPI_CHK( mpi_copy( &R->X, X ) );
+    MPI_CHK( mpi_copy( &R->Y, Y ) );
+    MPI_CHK( mpi_copy( &R->Z, Z ) );
 
 cleanup:
-
-    mpi_free( &T1 ); mpi_free( &T2 ); mpi_free( &T3 ); mpi_free( &T4 );
-    mpi_free( &X ); mpi_free( &Y ); mpi_free( &Z );
-
     return( ret );
 }
 
@@ -1063,14 +1105,20 @@ int ecp_add( const ecp_group *grp, ecp_point *R,
              const ecp_point *P, const ecp_point *Q )
 {
     int ret;
+    mpi tmp[ECP_TMP_NB];
 
     if( ecp_get_type( grp ) != POLARSSL_ECP_TYPE_SHORT_WEIERSTRASS )
         return( POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE );
 
-    MPI_CHK( ecp_add_mixed( grp, R, P, Q ) );
-    MPI_CHK( ecp_normalize_jac( grp, R ) );
+    ecp_tmp_init( tmp );
+    MPI_CHK( ecp_tmp_grow( grp, tmp ) );
+
+    MPI_CHK( ecp_add_mixed( grp, R, P, Q, tmp ) );
+    MPI_CHK( ecp_normalize_jac( grp, R, tmp ) );
 
 cleanup:
+    ecp_tmp_free( tmp );
+
     return( ret );
 }
 
@@ -1082,22 +1130,27 @@ int ecp_sub( const ecp_group *grp, ecp_point *R,
 {
     int ret;
     ecp_point mQ;
+    mpi tmp[ECP_TMP_NB];
 
     ecp_point_init( &mQ );
+    ecp_tmp_init( tmp );
 
     if( ecp_get_type( grp ) != POLARSSL_ECP_TYPE_SHORT_WEIERSTRASS )
         return( POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE );
 
+    MPI_CHK( ecp_tmp_grow( grp, tmp ) );
+
     /* mQ = - Q */
     MPI_CHK( ecp_copy( &mQ, Q ) );
     if( mpi_cmp_int( &mQ.Y, 0 ) != 0 )
         MPI_CHK( mpi_sub_mpi( &mQ.Y, &grp->P, &mQ.Y ) );
 
-    MPI_CHK( ecp_add_mixed( grp, R, P, &mQ ) );
-    MPI_CHK( ecp_normalize_jac( grp, R ) );
+    MPI_CHK( ecp_add_mixed( grp, R, P, &mQ, tmp ) );
+    MPI_CHK( ecp_normalize_jac( grp, R, tmp ) );
 
 cleanup:
     ecp_point_free( &mQ );
+    ecp_tmp_free( tmp );
 
     return( ret );
 }
@@ -1110,42 +1163,42 @@ cleanup:
  * This countermeasure was first suggested in [2].
  */
 static int ecp_randomize_jac( const ecp_group *grp, ecp_point *pt,
-                int (*f_rng)(void *, unsigned char *, size_t), void *p_rng )
+                int (*f_rng)(void *, unsigned char *, size_t), void *p_rng,
+                mpi tmp[] )
 {
     int ret;
-    mpi l, ll;
+    mpi *l = &tmp[0], *ll = &tmp[1], *T = &tmp[2];
     size_t p_size = (grp->pbits + 7) / 8;
     int count = 0;
 
-    mpi_init( &l ); mpi_init( &ll );
-
     /* Generate l such that 1 < l < p */
     do
     {
-        mpi_fill_random( &l, p_size, f_rng, p_rng );
+        mpi_fill_random( l, p_size, f_rng, p_rng );
 
-        while( mpi_cmp_mpi( &l, &grp->P ) >= 0 )
-            mpi_shift_r( &l, 1 );
+        while( mpi_cmp_mpi( l, &grp->P ) >= 0 )
+            mpi_shift_r( l, 1 );
 
         if( count++ > 10 )
             return( POLARSSL_ERR_ECP_RANDOM_FAILED );
     }
-    while( mpi_cmp_int( &l, 1 ) <= 0 );
+    while( mpi_cmp_int( l, 1 ) <= 0 );
 
     /* Z = l * Z */
-    MPI_CHK( mpi_mul_mpi( &pt->Z,   &pt->Z,     &l  ) ); MOD_MUL( pt->Z );
+    MPI_CHK( mpi_mul_mpi( T,        &pt->Z,     l   ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &pt->Z, T ) );
 
     /* X = l^2 * X */
-    MPI_CHK( mpi_mul_mpi( &ll,      &l,         &l  ) ); MOD_MUL( ll );
-    MPI_CHK( mpi_mul_mpi( &pt->X,   &pt->X,     &ll ) ); MOD_MUL( pt->X );
+    MPI_CHK( mpi_mul_mpi( ll,       l,          l   ) ); MOD_MUL( *ll );
+    MPI_CHK( mpi_mul_mpi( T,        &pt->X,     ll  ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &pt->X, T ) );
 
     /* Y = l^3 * Y */
-    MPI_CHK( mpi_mul_mpi( &ll,      &ll,        &l  ) ); MOD_MUL( ll );
-    MPI_CHK( mpi_mul_mpi( &pt->Y,   &pt->Y,     &ll ) ); MOD_MUL( pt->Y );
+    MPI_CHK( mpi_mul_mpi( T,        ll,         l   ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_mul_mpi( ll,       &pt->Y,     T   ) ); MOD_MUL( *ll );
+    MPI_CHK( mpi_copy( &pt->Y, ll ) );
 
 cleanup:
-    mpi_free( &l ); mpi_free( &ll );
-
     return( ret );
 }
 
@@ -1159,8 +1212,16 @@ cleanup:
 /* d = ceil( n / w ) */
 #define COMB_MAX_D      ( POLARSSL_ECP_MAX_BITS + 1 ) / 2
 
+#if POLARSSL_ECP_COMB_CACHE_WINDOW < 2 || POLARSSL_ECP_COMB_CACHE_WINDOW > 7
+#error "POLARSSL_ECP_COMB_CACHE_WINDOW out of bounds"
+#endif
+
 /* number of precomputed points */
+#if POLARSSL_ECP_COMB_CACHE_WINDOW > POLARSSL_ECP_WINDOW_SIZE
+#define COMB_MAX_PRE    ( 1 << ( POLARSSL_ECP_COMB_CACHE_WINDOW - 1 ) )
+#else
 #define COMB_MAX_PRE    ( 1 << ( POLARSSL_ECP_WINDOW_SIZE - 1 ) )
+#endif
 
 /*
  * Compute the representation of m that will be used with our comb method.
@@ -1224,7 +1285,7 @@ static void ecp_comb_fixed( unsigned char x[], size_t d,
  */
 static int ecp_precompute_comb( const ecp_group *grp,
                                 ecp_point T[], const ecp_point *P,
-                                unsigned char w, size_t d )
+                                unsigned char w, size_t d, mpi tmp[] )
 {
     int ret;
     unsigned char i, k;
@@ -1243,12 +1304,12 @@ static int ecp_precompute_comb( const ecp_group *grp,
         cur = T + i;
         MPI_CHK( ecp_copy( cur, T + ( i >> 1 ) ) );
         for( j = 0; j < d; j++ )
-            MPI_CHK( ecp_double_jac( grp, cur, cur ) );
+            MPI_CHK( ecp_double_jac( grp, cur, cur, tmp ) );
 
         TT[k++] = cur;
     }
 
-    MPI_CHK( ecp_normalize_jac_many( grp, TT, k ) );
+    MPI_CHK( ecp_normalize_jac_many( grp, TT, k, tmp ) );
 
     /*
      * Compute the remaining ones using the minimal number of additions
@@ -1260,12 +1321,12 @@ static int ecp_precompute_comb( const ecp_group *grp,
         j = i;
         while( j-- )
         {
-            MPI_CHK( ecp_add_mixed( grp, &T[i + j], &T[j], &T[i] ) );
+            MPI_CHK( ecp_add_mixed( grp, &T[i + j], &T[j], &T[i], tmp ) );
             TT[k++] = &T[i + j];
         }
     }
 
-    MPI_CHK( ecp_normalize_jac_many( grp, TT, k ) );
+    MPI_CHK( ecp_normalize_jac_many( grp, TT, k, tmp ) );
 
 cleanup:
     return( ret );
@@ -1276,7 +1337,7 @@ cleanup:
  */
 static int ecp_select_comb( const ecp_group *grp, ecp_point *R,
                             const ecp_point T[], unsigned char t_len,
-                            unsigned char i )
+                            unsigned char i, mpi tmp[] )
 {
     int ret;
     unsigned char ii, j;
@@ -1292,7 +1353,7 @@ static int ecp_select_comb( const ecp_group *grp, ecp_point *R,
     }
 
     /* Safely invert result if i is "negative" */
-    MPI_CHK( ecp_safe_invert_jac( grp, R, i >> 7 ) );
+    MPI_CHK( ecp_safe_invert_jac( grp, R, i >> 7, tmp ) );
 
 cleanup:
     return( ret );
@@ -1308,7 +1369,7 @@ static int ecp_mul_comb_core( const ecp_group *grp, ecp_point *R,
                               const ecp_point T[], unsigned char t_len,
                               const unsigned char x[], size_t d,
                               int (*f_rng)(void *, unsigned char *, size_t),
-                              void *p_rng )
+                              void *p_rng, mpi tmp[] )
 {
     int ret;
     ecp_point Txi;
@@ -1318,16 +1379,16 @@ static int ecp_mul_comb_core( const ecp_group *grp, ecp_point *R,
 
     /* Start with a non-zero point and randomize its coordinates */
     i = d;
-    MPI_CHK( ecp_select_comb( grp, R, T, t_len, x[i] ) );
+    MPI_CHK( ecp_select_comb( grp, R, T, t_len, x[i], tmp ) );
     MPI_CHK( mpi_lset( &R->Z, 1 ) );
     if( f_rng != 0 )
-        MPI_CHK( ecp_randomize_jac( grp, R, f_rng, p_rng ) );
+        MPI_CHK( ecp_randomize_jac( grp, R, f_rng, p_rng, tmp ) );
 
     while( i-- != 0 )
     {
-        MPI_CHK( ecp_double_jac( grp, R, R ) );
-        MPI_CHK( ecp_select_comb( grp, &Txi, T, t_len, x[i] ) );
-        MPI_CHK( ecp_add_mixed( grp, R, R, &Txi ) );
+        MPI_CHK( ecp_double_jac( grp, R, R, tmp ) );
+        MPI_CHK( ecp_select_comb( grp, &Txi, T, t_len, x[i], tmp ) );
+        MPI_CHK( ecp_add_mixed( grp, R, R, &Txi, tmp ) );
     }
 
 cleanup:
@@ -1336,6 +1397,46 @@ cleanup:
     return( ret );
 }
 
+/*
+ * Process-wide cache of comb tables for the generator of known curves.
+ *
+ * Entries are only added by ecp_comb_cache_add() and removed by
+ * ecp_comb_cache_free(), and a table is never modified once it has been
+ * published, so lookups need no locking.
+ */
+typedef struct
+{
+    ecp_group_id grp_id;    /* curve the table belongs to               */
+    unsigned char w;        /* window size the table was computed for   */
+    ecp_point *T;           /* 2^(w-1) precomputed multiples of G       */
+}
+ecp_comb_cache_entry;
+
+static ecp_comb_cache_entry ecp_comb_cache[POLARSSL_ECP_DP_MAX];
+
+/*
+ * Return the cached table for the generator of grp, or NULL
+ */
+static ecp_point *ecp_comb_cache_get( const ecp_group *grp, unsigned char *w )
+{
+    size_t i;
+
+    if( grp->id == POLARSSL_ECP_DP_NONE )
+        return( NULL );
+
+    for( i = 0; i < POLARSSL_ECP_DP_MAX; i++ )
+    {
+        if( ecp_comb_cache[i].T != NULL &&
+            ecp_comb_cache[i].grp_id == grp->id )
+        {
+            *w = ecp_comb_cache[i].w;
+            return( ecp_comb_cache[i].T );
+        }
+    }
+
+    return( NULL );
+}
+
 /*
  * Multiplication using the comb method,
  * for curves in short Weierstrass form
@@ -1349,56 +1450,72 @@ static int ecp_mul_comb( ecp_group *grp, ecp_point *R,
     unsigned char w, m_is_odd, p_eq_g, pre_len, i;
     size_t d;
     unsigned char k[COMB_MAX_D + 1];
-    ecp_point *T;
-    mpi M, mm;
+    ecp_point *T = NULL;
+    mpi M, mm, tmp[ECP_TMP_NB];
 
     mpi_init( &M );
     mpi_init( &mm );
+    ecp_tmp_init( tmp );
 
     /* we need N to be odd to trnaform m in an odd number, check now */
     if( mpi_get_bit( &grp->N, 0 ) != 1 )
         return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
 
-    /*
-     * Minimize the number of multiplications, that is minimize
-     * 10 * d * w + 18 * 2^(w-1) + 11 * d + 7 * w, with d = ceil( nbits / w )
-     * (see costs of the various parts, with 1S = 1M)
-     */
-    w = grp->nbits >= 384 ? 5 : 4;
+    p_eq_g = 0;
+    MPI_CHK( ecp_tmp_grow( grp, tmp ) );
+
+    p_eq_g = ( mpi_cmp_mpi( &P->Y, &grp->G.Y ) == 0 &&
+               mpi_cmp_mpi( &P->X, &grp->G.X ) == 0 );
 
     /*
-     * If P == G, pre-compute a bit more, since this may be re-used later.
-     * Just adding one avoids upping the cost of the first mul too much,
-     * and the memory cost too.
+     * If P == G and the comb cache has a table for this curve, use it with
+     * the window size it was built for: it is shared, so never free it.
      */
+    T = p_eq_g ? ecp_comb_cache_get( grp, &w ) : NULL;
+
+    if( T == NULL )
+    {
+        /*
+         * Minimize the number of multiplications, that is minimize
+         * 10 * d * w + 18 * 2^(w-1) + 11 * d + 7 * w, with d = ceil( nbits / w )
+         * (see costs of the various parts, with 1S = 1M)
+         */
+        w = grp->nbits >= 384 ? 5 : 4;
+
+        /*
+         * If P == G, pre-compute a bit more, since this may be re-used later.
+         * Just adding one avoids upping the cost of the first mul too much,
+         * and the memory cost too.
+         */
 #if POLARSSL_ECP_FIXED_POINT_OPTIM == 1
-    p_eq_g = ( mpi_cmp_mpi( &P->Y, &grp->G.Y ) == 0 &&
-               mpi_cmp_mpi( &P->X, &grp->G.X ) == 0 );
-    if( p_eq_g )
-        w++;
+        if( p_eq_g )
+            w++;
 #else
-    p_eq_g = 0;
+        p_eq_g = 0;
 #endif
 
-    /*
-     * Make sure w is within bounds.
-     * (The last test is useful only for very small curves in the test suite.)
-     */
-    if( w > POLARSSL_ECP_WINDOW_SIZE )
-        w = POLARSSL_ECP_WINDOW_SIZE;
-    if( w >= grp->nbits )
-        w = 2;
+        /*
+         * Make sure w is within bounds.
+         * (The last test is useful only for very small curves in the test suite.)
+         */
+        if( w > POLARSSL_ECP_WINDOW_SIZE )
+            w = POLARSSL_ECP_WINDOW_SIZE;
+        if( w >= grp->nbits )
+            w = 2;
+
+        /* If P == G we want to use grp->T if already initialized */
+        if( p_eq_g )
+            T = grp->T;
+    }
 
     /* Other sizes that depend on w */
     pre_len = 1U << ( w - 1 );
     d = ( grp->nbits + w - 1 ) / w;
 
     /*
-     * Prepare precomputed points: if P == G we want to
-     * use grp->T if already initialized, or initialize it.
+     * Prepare precomputed points: if P == G and there is no table yet,
+     * initialize grp->T.
      */
-    T = p_eq_g ? grp->T : NULL;
-
     if( T == NULL )
     {
         T = (ecp_point *) polarssl_malloc( pre_len * sizeof( ecp_point ) );
@@ -1411,7 +1528,7 @@ static int ecp_mul_comb( ecp_group *grp, ecp_point *R,
         for( i = 0; i < pre_len; i++ )
             ecp_point_init( &T[i] );
 
-        MPI_CHK( ecp_precompute_comb( grp, T, P, w, d ) );
+        MPI_CHK( ecp_precompute_comb( grp, T, P, w, d, tmp ) );
 
         if( p_eq_g )
         {
@@ -1433,13 +1550,14 @@ static int ecp_mul_comb( ecp_group *grp, ecp_point *R,
      * Go for comb multiplication, R = M * P
      */
     ecp_comb_fixed( k, d, w, &M );
-    MPI_CHK( ecp_mul_comb_core( grp, R, T, pre_len, k, d, f_rng, p_rng ) );
+    MPI_CHK( ecp_mul_comb_core( grp, R, T, pre_len, k, d, f_rng, p_rng,
+                                tmp ) );
 
     /*
      * Now get m * P from M * P and normalize it
      */
-    MPI_CHK( ecp_safe_invert_jac( grp, R, ! m_is_odd ) );
-    MPI_CHK( ecp_normalize_jac( grp, R ) );
+    MPI_CHK( ecp_safe_invert_jac( grp, R, ! m_is_odd, tmp ) );
+    MPI_CHK( ecp_normalize_jac( grp, R, tmp ) );
 
 cleanup:
 
@@ -1452,6 +1570,7 @@ cleanup:
 
     mpi_free( &M );
     mpi_free( &mm );
+    ecp_tmp_free( tmp );
 
     if( ret != 0 )
         ecp_point_free( R );
@@ -1459,6 +1578,281 @@ cleanup:
     return( ret );
 }
 
+/*
+ * Compute the width-w NAF of m >= 0 (GECC 3.35): each x[i] is either zero
+ * or odd with |x[i]| < 2^(w-1), and among any w consecutive digits at most
+ * one is non-zero. The number of digits, at most bitlength(m) + 1, is
+ * stored in len.
+ *
+ * Not constant-time: this must only be used with public scalars.
+ */
+static int ecp_wnaf( signed char x[], size_t *len,
+                     unsigned char w, const mpi *m )
+{
+    int ret, digit;
+    size_t i;
+    mpi k;
+
+    mpi_init( &k );
+
+    MPI_CHK( mpi_copy( &k, m ) );
+
+    for( i = 0; mpi_cmp_int( &k, 0 ) != 0; i++ )
+    {
+        digit = 0;
+
+        if( mpi_get_bit( &k, 0 ) == 1 )
+        {
+            digit = (int)( k.p[0] & ( ( 1U << w ) - 1 ) );
+            if( digit >= ( 1 << ( w - 1 ) ) )
+                digit -= 1 << w;
+
+            MPI_CHK( mpi_sub_int( &k, &k, digit ) );
+        }
+
+        x[i] = (signed char) digit;
+        MPI_CHK( mpi_shift_r( &k, 1 ) );
+    }
+
+    *len = i;
+
+cleanup:
+    mpi_free( &k );
+
+    return( ret );
+}
+
+/*
+ * Precompute the odd multiples T[i] = (2i + 1) P for i = 0 .. 2^(w-2) - 1,
+ * with normalized coordinates
+ *
+ * Cost: 1D + 1N + (2^(w-2) - 1) A + 1 N(2^(w-2) - 1)
+ */
+static int ecp_precompute_wnaf( const ecp_group *grp,
+                                ecp_point T[], const ecp_point *P,
+                                unsigned char w, mpi tmp[] )
+{
+    int ret;
+    size_t i, t_len;
+    ecp_point P2, *TT[COMB_MAX_PRE - 1];
+
+    ecp_point_init( &P2 );
+
+    t_len = 1U << ( w - 2 );
+
+    MPI_CHK( ecp_copy( &T[0], P ) );
+
+    if( t_len > 1 )
+    {
+        MPI_CHK( ecp_double_jac( grp, &P2, P, tmp ) );
+        MPI_CHK( ecp_normalize_jac( grp, &P2, tmp ) );
+
+        for( i = 1; i < t_len; i++ )
+        {
+            MPI_CHK( ecp_add_mixed( grp, &T[i], &T[i-1], &P2, tmp ) );
+            TT[i-1] = &T[i];
+        }
+
+        MPI_CHK( ecp_normalize_jac_many( grp, TT, t_len - 1, tmp ) );
+    }
+
+cleanup:
+    ecp_point_free( &P2 );
+
+    return( ret );
+}
+
+/*
+ * R = R + Q or R = R - Q (if neg), with Q normalized and possibly missing
+ * its Z coordinate as in precomputed tables; mQ is scratch space.
+ *
+ * Unlike ecp_add_mixed(), R may be zero. Not constant-time.
+ */
+static int ecp_add_vartime( const ecp_group *grp, ecp_point *R,
+                            const ecp_point *Q, unsigned char neg,
+                            ecp_point *mQ, mpi tmp[] )
+{
+    int ret;
+
+    if( neg )
+    {
+        MPI_CHK( mpi_copy( &mQ->X, &Q->X ) );
+        MPI_CHK( mpi_copy( &mQ->Y, &Q->Y ) );
+        if( mpi_cmp_int( &mQ->Y, 0 ) != 0 )
+            MPI_CHK( mpi_sub_mpi( &mQ->Y, &grp->P, &mQ->Y ) );
+        mpi_free( &mQ->Z );
+        Q = mQ;
+    }
+
+    if( mpi_cmp_int( &R->Z, 0 ) == 0 )
+    {
+        MPI_CHK( mpi_copy( &R->X, &Q->X ) );
+        MPI_CHK( mpi_copy( &R->Y, &Q->Y ) );
+        MPI_CHK( mpi_lset( &R->Z, 1 ) );
+    }
+    else
+        MPI_CHK( ecp_add_mixed( grp, R, R, Q, tmp ) );
+
+cleanup:
+    return( ret );
+}
+
+/*
+ * R = m * P + n * Q with interleaved (Straus-Shamir) multiplication: the
+ * doublings are shared, and each scalar contributes one addition per
+ * non-zero digit of its w-NAF.
+ *
+ * If P == G and a comb table for G is already available (in the comb cache
+ * or in grp->T), m is rather encoded with the comb method: its d + 1 digits
+ * line up with the lowest positions of the w-NAF of n, so that m * G only
+ * costs d additions.
+ *
+ * Not constant-time: this must only be used with public data.
+ */
+static int ecp_muladd_sw( const ecp_group *grp, ecp_point *R,
+                          const mpi *m, const ecp_point *P,
+                          const mpi *n, const ecp_point *Q )
+{
+    int ret;
+    unsigned char w, wg, m_neg, j;
+    size_t i, d, t_len, m_len, n_len;
+    signed char xm[POLARSSL_ECP_MAX_BITS + 1], xn[POLARSSL_ECP_MAX_BITS + 1];
+    unsigned char k[COMB_MAX_D + 1];
+    const ecp_point *TG = NULL;
+    ecp_point *TP = NULL, *TQ = NULL, mQ;
+    mpi M, tmp[ECP_TMP_NB];
+
+    mpi_init( &M );
+    ecp_point_init( &mQ );
+    ecp_tmp_init( tmp );
+
+    MPI_CHK( ecp_tmp_grow( grp, tmp ) );
+
+    /* Window size for the w-NAF, within the same bounds as the comb */
+    w = grp->nbits >= 384 ? 6 : 5;
+    if( w > POLARSSL_ECP_WINDOW_SIZE )
+        w = POLARSSL_ECP_WINDOW_SIZE;
+    if( w >= grp->nbits )
+        w = 2;
+
+    t_len = 1U << ( w - 2 );
+
+    /*
+     * Look for an existing comb table if P == G
+     */
+    m_neg = 0;
+    wg = 0;
+    if( mpi_cmp_mpi( &P->Y, &grp->G.Y ) == 0 &&
+        mpi_cmp_mpi( &P->X, &grp->G.X ) == 0 )
+    {
+        TG = ecp_comb_cache_get( grp, &wg );
+
+        if( TG == NULL && grp->T != NULL )
+        {
+            TG = grp->T;
+            for( wg = 1; ( 1U << ( wg - 1 ) ) < grp->T_size; wg++ );
+        }
+    }
+
+    if( TG != NULL )
+    {
+        /* Same as in ecp_mul_comb(): M = m or M = N - m is odd */
+        m_neg = ( mpi_get_bit( m, 0 ) == 0 );
+        if( m_neg )
+            MPI_CHK( mpi_sub_mpi( &M, &grp->N, m ) );
+        else
+            MPI_CHK( mpi_copy( &M, m ) );
+
+        d = ( grp->nbits + wg - 1 ) / wg;
+        ecp_comb_fixed( k, d, wg, &M );
+        m_len = d + 1;
+    }
+    else
+    {
+        TP = (ecp_point *) polarssl_malloc( t_len * sizeof( ecp_point ) );
+        if( TP == NULL )
+        {
+            ret = POLARSSL_ERR_ECP_MALLOC_FAILED;
+            goto cleanup;
+        }
+
+        for( i = 0; i < t_len; i++ )
+            ecp_point_init( &TP[i] );
+
+        MPI_CHK( ecp_precompute_wnaf( grp, TP, P, w, tmp ) );
+        MPI_CHK( ecp_wnaf( xm, &m_len, w, m ) );
+    }
+
+    TQ = (ecp_point *) polarssl_malloc( t_len * sizeof( ecp_point ) );
+    if( TQ == NULL )
+    {
+        ret = POLARSSL_ERR_ECP_MALLOC_FAILED;
+        goto cleanup;
+    }
+
+    for( i = 0; i < t_len; i++ )
+        ecp_point_init( &TQ[i] );
+
+    MPI_CHK( ecp_precompute_wnaf( grp, TQ, Q, w, tmp ) );
+    MPI_CHK( ecp_wnaf( xn, &n_len, w, n ) );
+
+    /*
+     * Joint double-and-add, from the most significant digit.
+     * (R may alias P or Q: only touch it now.)
+     */
+    MPI_CHK( ecp_set_zero( R ) );
+
+    for( i = m_len > n_len ? m_len : n_len; i-- != 0; )
+    {
+        if( mpi_cmp_int( &R->Z, 0 ) != 0 )
+            MPI_CHK( ecp_double_jac( grp, R, R, tmp ) );
+
+        if( TG != NULL && i < m_len )
+        {
+            j = k[i];
+            MPI_CHK( ecp_add_vartime( grp, R, &TG[( j & 0x7Fu ) >> 1],
+                                      ( j >> 7 ) ^ m_neg, &mQ, tmp ) );
+        }
+        else if( TG == NULL && i < m_len && xm[i] != 0 )
+        {
+            MPI_CHK( ecp_add_vartime( grp, R,
+                        &TP[( xm[i] < 0 ? -xm[i] : xm[i] ) >> 1],
+                        xm[i] < 0, &mQ, tmp ) );
+        }
+
+        if( i < n_len && xn[i] != 0 )
+        {
+            MPI_CHK( ecp_add_vartime( grp, R,
+                        &TQ[( xn[i] < 0 ? -xn[i] : xn[i] ) >> 1],
+                        xn[i] < 0, &mQ, tmp ) );
+        }
+    }
+
+    MPI_CHK( ecp_normalize_jac( grp, R, tmp ) );
+
+cleanup:
+
+    if( TP != NULL )
+    {
+        for( i = 0; i < t_len; i++ )
+            ecp_point_free( &TP[i] );
+        polarssl_free( TP );
+    }
+
+    if( TQ != NULL )
+    {
+        for( i = 0; i < t_len; i++ )
+            ecp_point_free( &TQ[i] );
+        polarssl_free( TQ );
+    }
+
+    mpi_free( &M );
+    ecp_point_free( &mQ );
+    ecp_tmp_free( tmp );
+
+    return( ret );
+}
+
 #endif /* POLARSSL_ECP_SHORT_WEIERSTRASS */
 
 #if defined(POLARSSL_ECP_MONTGOMERY)
@@ -1474,12 +1868,15 @@ cleanup:
  * Normalize Montgomery x/z coordinates: X = X/Z, Z = 1
  * Cost: 1M + 1I
  */
-static int ecp_normalize_mxz( const ecp_group *grp, ecp_point *P )
+static int ecp_normalize_mxz( const ecp_group *grp, ecp_point *P,
+                              mpi tmp[] )
 {
     int ret;
+    mpi *Zi = &tmp[0], *T = &tmp[1];
 
-    MPI_CHK( mpi_inv_mod( &P->Z, &P->Z, &grp->P ) );
-    MPI_CHK( mpi_mul_mpi( &P->X, &P->X, &P->Z ) ); MOD_MUL( P->X );
+    MPI_CHK( mpi_inv_mod( Zi, &P->Z, &grp->P ) );
+    MPI_CHK( mpi_mul_mpi( T, &P->X, Zi ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &P->X, T ) );
     MPI_CHK( mpi_lset( &P->Z, 1 ) );
 
 cleanup:
@@ -1495,34 +1892,33 @@ cleanup:
  * Cost: 2M
  */
 static int ecp_randomize_mxz( const ecp_group *grp, ecp_point *P,
-                int (*f_rng)(void *, unsigned char *, size_t), void *p_rng )
+                int (*f_rng)(void *, unsigned char *, size_t), void *p_rng,
+                mpi tmp[] )
 {
     int ret;
-    mpi l;
+    mpi *l = &tmp[0], *T = &tmp[1];
     size_t p_size = (grp->pbits + 7) / 8;
     int count = 0;
 
-    mpi_init( &l );
-
     /* Generate l such that 1 < l < p */
     do
     {
-        mpi_fill_random( &l, p_size, f_rng, p_rng );
+        mpi_fill_random( l, p_size, f_rng, p_rng );
 
-        while( mpi_cmp_mpi( &l, &grp->P ) >= 0 )
-            mpi_shift_r( &l, 1 );
+        while( mpi_cmp_mpi( l, &grp->P ) >= 0 )
+            mpi_shift_r( l, 1 );
 
         if( count++ > 10 )
             return( POLARSSL_ERR_ECP_RANDOM_FAILED );
     }
-    while( mpi_cmp_int( &l, 1 ) <= 0 );
+    while( mpi_cmp_int( l, 1 ) <= 0 );
 
-    MPI_CHK( mpi_mul_mpi( &P->X, &P->X, &l ) ); MOD_MUL( P->X );
-    MPI_CHK( mpi_mul_mpi( &P->Z, &P->Z, &l ) ); MOD_MUL( P->Z );
+    MPI_CHK( mpi_mul_mpi( T, &P->X, l ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &P->X, T ) );
+    MPI_CHK( mpi_mul_mpi( T, &P->Z, l ) ); MOD_MUL( *T );
+    MPI_CHK( mpi_copy( &P->Z, T ) );
 
 cleanup:
-    mpi_free( &l );
-
     return( ret );
 }
 
@@ -1544,39 +1940,36 @@ cleanup:
 static int ecp_double_add_mxz( const ecp_group *grp,
                                ecp_point *R, ecp_point *S,
                                const ecp_point *P, const ecp_point *Q,
-                               const mpi *d )
+                               const mpi *d, mpi tmp[] )
 {
     int ret;
-    mpi A, AA, B, BB, E, C, D, DA, CB;
-
-    mpi_init( &A ); mpi_init( &AA ); mpi_init( &B );
-    mpi_init( &BB ); mpi_init( &E ); mpi_init( &C );
-    mpi_init( &D ); mpi_init( &DA ); mpi_init( &CB );
-
-    MPI_CHK( mpi_add_mpi( &A,    &P->X,   &P->Z ) ); MOD_ADD( A    );
-    MPI_CHK( mpi_mul_mpi( &AA,   &A,      &A    ) ); MOD_MUL( AA   );
-    MPI_CHK( mpi_sub_mpi( &B,    &P->X,   &P->Z ) ); MOD_SUB( B    );
-    MPI_CHK( mpi_mul_mpi( &BB,   &B,      &B    ) ); MOD_MUL( BB   );
-    MPI_CHK( mpi_sub_mpi( &E,    &AA,     &BB   ) ); MOD_SUB( E    );
-    MPI_CHK( mpi_add_mpi( &C,    &Q->X,   &Q->Z ) ); MOD_ADD( C    );
-    MPI_CHK( mpi_sub_mpi( &D,    &Q->X,   &Q->Z ) ); MOD_SUB( D    );
-    MPI_CHK( mpi_mul_mpi( &DA,   &D,      &A    ) ); MOD_MUL( DA   );
-    MPI_CHK( mpi_mul_mpi( &CB,   &C,      &B    ) ); MOD_MUL( CB   );
-    MPI_CHK( mpi_add_mpi( &S->X, &DA,     &CB   ) ); MOD_MUL( S->X );
-    MPI_CHK( mpi_mul_mpi( &S->X, &S->X,   &S->X ) ); MOD_MUL( S->X );
-    MPI_CHK( mpi_sub_mpi( &S->Z, &DA,     &CB   ) ); MOD_SUB( S->Z );
-    MPI_CHK( mpi_mul_mpi( &S->Z, &S->Z,   &S->Z ) ); MOD_MUL( S->Z );
-    MPI_CHK( mpi_mul_mpi( &S->Z, d,       &S->Z ) ); MOD_MUL( S->Z );
-    MPI_CHK( mpi_mul_mpi( &R->X, &AA,     &BB   ) ); MOD_MUL( R->X );
-    MPI_CHK( mpi_mul_mpi( &R->Z, &grp->A, &E    ) ); MOD_MUL( R->Z );
-    MPI_CHK( mpi_add_mpi( &R->Z, &BB,     &R->Z ) ); MOD_ADD( R->Z );
-    MPI_CHK( mpi_mul_mpi( &R->Z, &E,      &R->Z ) ); MOD_MUL( R->Z );
+    mpi *A = &tmp[0], *AA = &tmp[1], *B = &tmp[2], *BB = &tmp[3];
+    mpi *E = &tmp[4], *C = &tmp[5], *D = &tmp[6], *T = &tmp[7];
 
-cleanup:
-    mpi_free( &A ); mpi_free( &AA ); mpi_free( &B );
-    mpi_free( &BB ); mpi_free( &E ); mpi_free( &C );
-    mpi_free( &D ); mpi_free( &DA ); mpi_free( &CB );
+    /*
+     * Temporaries are reused once they are no longer needed:
+     * DA goes to D, CB to C, and A, B and T hold intermediate values.
+     */
+    MPI_CHK( mpi_add_mpi( A,     &P->X,   &P->Z ) ); MOD_ADD( *A    );
+    MPI_CHK( mpi_mul_mpi( AA,    A,       A     ) ); MOD_MUL( *AA   );
+    MPI_CHK( mpi_sub_mpi( B,     &P->X,   &P->Z ) ); MOD_SUB( *B    );
+    MPI_CHK( mpi_mul_mpi( BB,    B,       B     ) ); MOD_MUL( *BB   );
+    MPI_CHK( mpi_sub_mpi( E,     AA,      BB    ) ); MOD_SUB( *E    );
+    MPI_CHK( mpi_add_mpi( C,     &Q->X,   &Q->Z ) ); MOD_ADD( *C    );
+    MPI_CHK( mpi_sub_mpi( D,     &Q->X,   &Q->Z ) ); MOD_SUB( *D    );
+    MPI_CHK( mpi_mul_mpi( T,     D,       A     ) ); MOD_MUL( *T    );
+    MPI_CHK( mpi_mul_mpi( D,     C,       B     ) ); MOD_MUL( *D    );
+    MPI_CHK( mpi_add_mpi( A,     T,       D     ) ); MOD_ADD( *A    );
+    MPI_CHK( mpi_mul_mpi( &S->X, A,       A     ) ); MOD_MUL( S->X );
+    MPI_CHK( mpi_sub_mpi( B,     T,       D     ) ); MOD_SUB( *B    );
+    MPI_CHK( mpi_mul_mpi( T,     B,       B     ) ); MOD_MUL( *T    );
+    MPI_CHK( mpi_mul_mpi( &S->Z, d,       T     ) ); MOD_MUL( S->Z );
+    MPI_CHK( mpi_mul_mpi( &R->X, AA,      BB    ) ); MOD_MUL( R->X );
+    MPI_CHK( mpi_mul_mpi( T,     &grp->A, E     ) ); MOD_MUL( *T    );
+    MPI_CHK( mpi_add_mpi( A,     BB,      T     ) ); MOD_ADD( *A    );
+    MPI_CHK( mpi_mul_mpi( &R->Z, E,       A     ) ); MOD_MUL( R->Z );
 
+cleanup:
     return( ret );
 }
 
@@ -1593,9 +1986,12 @@ static int ecp_mul_mxz( ecp_group *grp, ecp_point *R,
     size_t i;
     unsigned char b;
     ecp_point RP;
-    mpi PX;
+    mpi PX, tmp[ECP_TMP_NB];
 
     ecp_point_init( &RP ); mpi_init( &PX );
+    ecp_tmp_init( tmp );
+
+    MPI_CHK( ecp_tmp_grow( grp, tmp ) );
 
     /* Save PX and read from P before writing to R, in case P == R */
     mpi_copy( &PX, &P->X );
@@ -1606,12 +2002,13 @@ static int ecp_mul_mxz( ecp_group *grp, ecp_point *R,
     MPI_CHK( mpi_lset( &R->Z, 0 ) );
     mpi_free( &R->Y );
 
-    /* RP.X might be sligtly larger than P, so reduce it */
+    /* RP.X and PX might be sligtly larger than P, so reduce them */
     MOD_ADD( RP.X );
+    MOD_ADD( PX );
 
     /* Randomize coordinates of the starting point */
     if( f_rng != NULL )
-        MPI_CHK( ecp_randomize_mxz( grp, &RP, f_rng, p_rng ) );
+        MPI_CHK( ecp_randomize_mxz( grp, &RP, f_rng, p_rng, tmp ) );
 
     /* Loop invariant: R = result so far, RP = R + P */
     i = mpi_msb( m ); /* one past the (zero-based) most significant bit */
@@ -1627,15 +2024,16 @@ static int ecp_mul_mxz( ecp_group *grp, ecp_point *R,
          */
         MPI_CHK( mpi_safe_cond_swap( &R->X, &RP.X, b ) );
         MPI_CHK( mpi_safe_cond_swap( &R->Z, &RP.Z, b ) );
-        MPI_CHK( ecp_double_add_mxz( grp, R, &RP, R, &RP, &PX ) );
+        MPI_CHK( ecp_double_add_mxz( grp, R, &RP, R, &RP, &PX, tmp ) );
         MPI_CHK( mpi_safe_cond_swap( &R->X, &RP.X, b ) );
         MPI_CHK( mpi_safe_cond_swap( &R->Z, &RP.Z, b ) );
     }
 
-    MPI_CHK( ecp_normalize_mxz( grp, R ) );
+    MPI_CHK( ecp_normalize_mxz( grp, R, tmp ) );
 
 cleanup:
     ecp_point_free( &RP ); mpi_free( &PX );
+    ecp_tmp_free( tmp );
 
     return( ret );
 }
@@ -1659,6 +2057,14 @@ int ecp_mul( ecp_group *grp, ecp_point *R,
         ( ret = ecp_check_pubkey( grp, P ) ) != 0 )
         return( ret );
 
+#if defined(POLARSSL_ECP_P256_C)
+    if( grp->id == POLARSSL_ECP_DP_SECP256R1 )
+        return( ecp_p256_mul( grp, R, m, P, f_rng, p_rng ) );
+#endif
+#if defined(POLARSSL_ECP_X25519_C)
+    if( grp->id == POLARSSL_ECP_DP_M255 )
+        return( ecp_x25519_mul( grp, R, m, P, f_rng, p_rng ) );
+#endif
 #if defined(POLARSSL_ECP_MONTGOMERY)
     if( ecp_get_type( grp ) == POLARSSL_ECP_TYPE_MONTGOMERY )
         return( ecp_mul_mxz( grp, R, m, P, f_rng, p_rng ) );
@@ -1670,6 +2076,152 @@ int ecp_mul( ecp_group *grp, ecp_point *R,
     return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
 }
 
+/*
+ * Linear combination R = m * P + n * Q (variable time)
+ */
+int ecp_muladd( const ecp_group *grp, ecp_point *R,
+                const mpi *m, const ecp_point *P,
+                const mpi *n, const ecp_point *Q )
+{
+    int ret;
+
+    if( ecp_get_type( grp ) != POLARSSL_ECP_TYPE_SHORT_WEIERSTRASS )
+        return( POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE );
+
+    if( mpi_cmp_int( &P->Z, 1 ) != 0 || mpi_cmp_int( &Q->Z, 1 ) != 0 )
+        return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
+
+    if( mpi_cmp_int( m, 0 ) < 0 || mpi_cmp_mpi( m, &grp->N ) >= 0 ||
+        mpi_cmp_int( n, 0 ) < 0 || mpi_cmp_mpi( n, &grp->N ) >= 0 )
+        return( POLARSSL_ERR_ECP_INVALID_KEY );
+
+    if( ( ret = ecp_check_pubkey( grp, P ) ) != 0 ||
+        ( ret = ecp_check_pubkey( grp, Q ) ) != 0 )
+        return( ret );
+
+#if defined(POLARSSL_ECP_P256_C)
+    if( grp->id == POLARSSL_ECP_DP_SECP256R1 )
+        return( ecp_p256_muladd( grp, R, m, P, n, Q ) );
+#endif
+#if defined(POLARSSL_ECP_SHORT_WEIERSTRASS)
+    return( ecp_muladd_sw( grp, R, m, P, n, Q ) );
+#else
+    return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
+#endif
+}
+
+/*
+ * Pre-compute and publish the comb table for the generator of a curve
+ */
+int ecp_comb_cache_add( ecp_group_id id )
+{
+#if defined(POLARSSL_ECP_SHORT_WEIERSTRASS)
+    int ret;
+    size_t i, slot, d;
+    unsigned char w, pre_len;
+    ecp_group grp;
+    ecp_point *T = NULL;
+    mpi tmp[ECP_TMP_NB];
+
+#if defined(POLARSSL_ECP_P256_C)
+    /* ecp_p256.c has its own embedded table */
+    if( id == POLARSSL_ECP_DP_SECP256R1 )
+        return( 0 );
+#endif
+
+    slot = POLARSSL_ECP_DP_MAX;
+    for( i = 0; i < POLARSSL_ECP_DP_MAX; i++ )
+    {
+        if( ecp_comb_cache[i].T == NULL )
+        {
+            if( slot == POLARSSL_ECP_DP_MAX )
+                slot = i;
+        }
+        else if( ecp_comb_cache[i].grp_id == id )
+            return( 0 );
+    }
+
+    if( slot == POLARSSL_ECP_DP_MAX )
+        return( POLARSSL_ERR_ECP_BAD_INPUT_DATA );
+
+    ecp_group_init( &grp );
+    ecp_tmp_init( tmp );
+
+    MPI_CHK( ecp_use_known_dp( &grp, id ) );
+
+    if( ecp_get_type( &grp ) != POLARSSL_ECP_TYPE_SHORT_WEIERSTRASS )
+    {
+        ret = POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE;
+        goto cleanup;
+    }
+
+    MPI_CHK( ecp_tmp_grow( &grp, tmp ) );
+
+    w = POLARSSL_ECP_COMB_CACHE_WINDOW;
+    if( w >= grp.nbits )
+        w = 2;
+
+    pre_len = 1U << ( w - 1 );
+    d = ( grp.nbits + w - 1 ) / w;
+
+    T = (ecp_point *) polarssl_malloc( pre_len * sizeof( ecp_point ) );
+    if( T == NULL )
+    {
+        ret = POLARSSL_ERR_ECP_MALLOC_FAILED;
+        goto cleanup;
+    }
+
+    for( i = 0; i < pre_len; i++ )
+        ecp_point_init( &T[i] );
+
+    MPI_CHK( ecp_precompute_comb( &grp, T, &grp.G, w, d, tmp ) );
+
+    /* Only publish the table once it is complete */
+    ecp_comb_cache[slot].grp_id = id;
+    ecp_comb_cache[slot].w = w;
+    ecp_comb_cache[slot].T = T;
+    T = NULL;
+
+cleanup:
+    if( T != NULL )
+    {
+        for( i = 0; i < pre_len; i++ )
+            ecp_point_free( &T[i] );
+        polarssl_free( T );
+    }
+
+    ecp_group_free( &grp );
+    ecp_tmp_free( tmp );
+
+    return( ret );
+#else
+    ((void) id);
+    return( POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE );
+#endif /* POLARSSL_ECP_SHORT_WEIERSTRASS */
+}
+
+/*
+ * Release all cached comb tables
+ */
+void ecp_comb_cache_free( void )
+{
+#if defined(POLARSSL_ECP_SHORT_WEIERSTRASS)
+    size_t i, j;
+
+    for( i = 0; i < POLARSSL_ECP_DP_MAX; i++ )
+    {
+        if( ecp_comb_cache[i].T == NULL )
+            continue;
+
+        for( j = 0; j < ( 1U << ( ecp_comb_cache[i].w - 1 ) ); j++ )
+            ecp_point_free( &ecp_comb_cache[i].T[j] );
+        polarssl_free( ecp_comb_cache[i].T );
+
+        memset( &ecp_comb_cache[i], 0, sizeof( ecp_comb_cache_entry ) );
+    }
+#endif /* POLARSSL_ECP_SHORT_WEIERSTRASS */
+}
+
 #if defined(POLARSSL_ECP_SHORT_WEIERSTRASS)
 /*
  * Check that an affine point is valid as a public key,
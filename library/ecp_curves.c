@@ -28,6 +28,7 @@
 #if defined(POLARSSL_ECP_C)
 
 #include "polarssl/ecp.h"
+#include "bn_const.h"
 
 #if defined(_MSC_VER) && !defined(inline)
 #define inline _inline
@@ -37,72 +38,6 @@
 #endif /* __ARMCC_VERSION */
 #endif /*_MSC_VER */
 
-/*
- * Conversion macros for embedded constants:
- * build lists of t_uint's from lists of unsigned char's grouped by 8, 4 or 2
- */
-#if defined(POLARSSL_HAVE_INT8)
-
-#define BYTES_TO_T_UINT_8( a, b, c, d, e, f, g, h ) \
-    a, b, c, d, e, f, g, h
-
-#define BYTES_TO_T_UINT_4( a, b, c, d )             \
-    a, b, c, d
-
-#define BYTES_TO_T_UINT_2( a, b )                   \
-    a, b
-
-#elif defined(POLARSSL_HAVE_INT16)
-
-#define BYTES_TO_T_UINT_2( a, b )                   \
-    ( (t_uint) a << 0 ) |                           \
-    ( (t_uint) b << 8 )
-
-#define BYTES_TO_T_UINT_4( a, b, c, d )             \
-    BYTES_TO_T_UINT_2( a, b ),                      \
-    BYTES_TO_T_UINT_2( c, d )
-
-#define BYTES_TO_T_UINT_8( a, b, c, d, e, f, g, h ) \
-    BYTES_TO_T_UINT_2( a, b ),                      \
-    BYTES_TO_T_UINT_2( c, d ),                      \
-    BYTES_TO_T_UINT_2( e, f ),                      \
-    BYTES_TO_T_UINT_2( g, h )
-
-#elif defined(POLARSSL_HAVE_INT32)
-
-#define BYTES_TO_T_UINT_4( a, b, c, d )             \
-    ( (t_uint) a <<  0 ) |                          \
-    ( (t_uint) b <<  8 ) |                          \
-    ( (t_uint) c << 16 ) |                          \
-    ( (t_uint) d << 24 )
-
-#define BYTES_TO_T_UINT_2( a, b )                   \
-    BYTES_TO_T_UINT_4( a, b, 0, 0 )
-
-#define BYTES_TO_T_UINT_8( a, b, c, d, e, f, g, h ) \
-    BYTES_TO_T_UINT_4( a, b, c, d ),                \
-    BYTES_TO_T_UINT_4( e, f, g, h )
-
-#else /* 64-bits */
-
-#define BYTES_TO_T_UINT_8( a, b, c, d, e, f, g, h ) \
-    ( (t_uint) a <<  0 ) |                          \
-    ( (t_uint) b <<  8 ) |                          \
-    ( (t_uint) c << 16 ) |                          \
-    ( (t_uint) d << 24 ) |                          \
-    ( (t_uint) e << 32 ) |                          \
-    ( (t_uint) f << 40 ) |                          \
-    ( (t_uint) g << 48 ) |                          \
-    ( (t_uint) h << 56 )
-
-#define BYTES_TO_T_UINT_4( a, b, c, d )             \
-    BYTES_TO_T_UINT_8( a, b, c, d, 0, 0, 0, 0 )
-
-#define BYTES_TO_T_UINT_2( a, b )                   \
-    BYTES_TO_T_UINT_8( a, b, 0, 0, 0, 0, 0, 0 )
-
-#endif /* bits in t_uint */
-
 /*
  * Note: the constants are in little-endian order
  * to be directly usable in MPIs
@@ -1215,8 +1150,8 @@ static int ecp_mod_p255( mpi *N )
 {
     int ret;
     size_t i;
-    mpi M;
-    t_uint Mp[P255_WIDTH + 2];
+    mpi M, A1;
+    t_uint Mp[P255_WIDTH + 2], A1p[P255_WIDTH + 2];
 
     if( N->n < P255_WIDTH )
         return( 0 );
@@ -1237,8 +1172,13 @@ static int ecp_mod_p255( mpi *N )
     for( i = P255_WIDTH; i < N->n; i++ )
         N->p[i] = 0;
 
-    /* N = A0 + 19 * A1 */
-    MPI_CHK( mpi_mul_int( &M, &M, 19 ) );
+    /* N = A0 + 19 * A1 (copying A1 to the stack, as mpi_mul_int() would
+     * otherwise allocate a copy of its operand) */
+    A1.s = 1;
+    A1.n = M.n;
+    A1.p = A1p;
+    memcpy( A1p, Mp, sizeof Mp );
+    MPI_CHK( mpi_mul_int( &M, &A1, 19 ) );
     MPI_CHK( mpi_add_abs( N, N, &M ) );
 
 cleanup:
@@ -1263,8 +1203,9 @@ static inline int ecp_mod_koblitz( mpi *N, t_uint *Rp, size_t p_limbs,
 {
     int ret;
     size_t i;
-    mpi M, R;
+    mpi M, R, A1;
     t_uint Mp[P_KOBLITZ_MAX + P_KOBLITZ_R];
+    t_uint A1p[P_KOBLITZ_MAX + P_KOBLITZ_R];
 
     if( N->n < p_limbs )
         return( 0 );
@@ -1274,9 +1215,12 @@ static inline int ecp_mod_koblitz( mpi *N, t_uint *Rp, size_t p_limbs,
     R.p = Rp;
     R.n = P_KOBLITZ_R;
 
-    /* Common setup for M */
+    /* Common setup for M, and A1 which holds a copy of it as mpi_mul_mpi()
+     * would otherwise allocate one */
     M.s = 1;
     M.p = Mp;
+    A1.s = 1;
+    A1.p = A1p;
 
     /* M = A1 */
     M.n = N->n - ( p_limbs - adjust );
@@ -1295,7 +1239,9 @@ static inline int ecp_mod_koblitz( mpi *N, t_uint *Rp, size_t p_limbs,
         N->p[i] = 0;
 
     /* N = A0 + R * A1 */
-    MPI_CHK( mpi_mul_mpi( &M, &M, &R ) );
+    A1.n = M.n;
+    memcpy( A1p, Mp, sizeof Mp );
+    MPI_CHK( mpi_mul_mpi( &M, &A1, &R ) );
     MPI_CHK( mpi_add_abs( N, N, &M ) );
 
     /* Second pass */
@@ -1317,7 +1263,9 @@ static inline int ecp_mod_koblitz( mpi *N, t_uint *Rp, size_t p_limbs,
         N->p[i] = 0;
 
     /* N = A0 + R * A1 */
-    MPI_CHK( mpi_mul_mpi( &M, &M, &R ) );
+    A1.n = M.n;
+    memcpy( A1p, Mp, sizeof Mp );
+    MPI_CHK( mpi_mul_mpi( &M, &A1, &R ) );
     MPI_CHK( mpi_add_abs( N, N, &M ) );
 
 cleanup:
@@ -0,0 +1,1088 @@
+/*
+ *  Elliptic curve secp256r1 with fixed-size arithmetic
+ *
+ *  Copyright (C) 2006-2014, Brainspark B.V.
+ *
+ *  This file is part of PolarSSL (http://www.polarssl.org)
+ *  Lead Maintainer: Paul Bakker <polarssl_maintainer at polarssl.org>
+ *
+ *  All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * References:
+ *
+ * GECC = Guide to Elliptic Curve Cryptography - Hankerson, Menezes, Vanstone
+ * HAC  = Handbook of Applied Cryptography - Menezes, van Oorschot, Vanstone
+ * EFD  = http://www.hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html
+ *
+ * Unlike ecp.c, which works on MPIs of any size, this module represents
+ * field elements of secp256r1 as fixed arrays of limbs on the stack, in
+ * Montgomery representation, and makes no allocation. All functions
+ * working on secret data run in constant time, except for the handling of
+ * P == Q in additions, which cannot happen in practice (see ecp.c).
+ */
+
+#include "polarssl/config.h"
+
+#if defined(POLARSSL_ECP_P256_C)
+
+#include "polarssl/ecp_p256.h"
+#include "bn_const.h"
+#include "polarssl/bn_mul.h"
+
+#include <string.h>
+
+#define ciL    (sizeof(t_uint))         /* chars in limb  */
+#define biL    (ciL << 3)               /* bits  in limb  */
+#define biH    (ciL << 2)               /* half limb size */
+
+#define P256_LIMBS      ( 32 / ciL )    /* limbs in a field element */
+
+/*
+ * Field elements are integers 0 .. p-1 in Montgomery representation,
+ * that is a R mod p for the element a, with R = 2^256. Points use Jacobian
+ * coordinates, Z == 0 representing the point at infinity.
+ */
+typedef struct
+{
+    t_uint X[P256_LIMBS];
+    t_uint Y[P256_LIMBS];
+    t_uint Z[P256_LIMBS];
+}
+p256_point;
+
+/*
+ * Note: the constants are in little-endian order
+ */
+
+/* p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const t_uint p256_p[P256_LIMBS] = {
+    BYTES_TO_T_UINT_8( 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF ),
+    BYTES_TO_T_UINT_8( 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00 ),
+    BYTES_TO_T_UINT_8( 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 ),
+    BYTES_TO_T_UINT_8( 0x01, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF ),
+};
+
+/* 1, for conversion from Montgomery representation */
+static const t_uint p256_1[P256_LIMBS] = { 1 };
+
+/* R mod p (1 in Montgomery representation) and R^2 mod p */
+static const t_uint p256_one[P256_LIMBS] = {
+    BYTES_TO_T_UINT_8( 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 ),
+    BYTES_TO_T_UINT_8( 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF ),
+    BYTES_TO_T_UINT_8( 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF ),
+    BYTES_TO_T_UINT_8( 0xFE, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00 ),
+};
+
+static const t_uint p256_rr[P256_LIMBS] = {
+    BYTES_TO_T_UINT_8( 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 ),
+    BYTES_TO_T_UINT_8( 0xFF, 0xFF, 0xFF, 0xFF, 0xFB, 0xFF, 0xFF, 0xFF ),
+    BYTES_TO_T_UINT_8( 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF ),
+    BYTES_TO_T_UINT_8( 0xFD, 0xFF, 0xFF, 0xFF, 0x04, 0x00, 0x00, 0x00 ),
+};
+
+/*
+ * Comb table for the generator G (affine coordinates, Montgomery
+ * representation): if i = i_3 i_2 i_1 i_0 in binary, then
+ * p256_comb[t][i-1] = sum( i_j 2^(64 j + 32 t) G, j = 0 .. 3 )
+ */
+static const t_uint p256_comb[2][15][2 * P256_LIMBS] = {
+    {
+        { /* i = 1 */
+            BYTES_TO_T_UINT_8( 0x3C, 0x14, 0xA9, 0x18, 0xD4, 0x30, 0xE7, 0x79 ),
+            BYTES_TO_T_UINT_8( 0x01, 0xB6, 0xED, 0x5F, 0xFC, 0x95, 0xBA, 0x75 ),
+            BYTES_TO_T_UINT_8( 0x10, 0x25, 0x62, 0x77, 0x2B, 0x73, 0xFB, 0x79 ),
+            BYTES_TO_T_UINT_8( 0xC6, 0x55, 0x37, 0xA5, 0x76, 0x5F, 0x90, 0x18 ),
+            BYTES_TO_T_UINT_8( 0x0A, 0x56, 0x95, 0xCE, 0x57, 0x53, 0xF2, 0xDD ),
+            BYTES_TO_T_UINT_8( 0x5C, 0xE4, 0x19, 0xBA, 0xE4, 0xB8, 0x4A, 0x8B ),
+            BYTES_TO_T_UINT_8( 0x25, 0xF3, 0x21, 0xDD, 0x88, 0x86, 0xE8, 0xD2 ),
+            BYTES_TO_T_UINT_8( 0x85, 0x5D, 0x88, 0x25, 0x18, 0xFF, 0x71, 0x85 ),
+        },
+        { /* i = 2 */
+            BYTES_TO_T_UINT_8( 0xBB, 0xD2, 0xA0, 0x16, 0xC5, 0x2F, 0x92, 0x4F ),
+            BYTES_TO_T_UINT_8( 0x99, 0x34, 0x62, 0x1A, 0x6C, 0xC1, 0x5C, 0x0D ),
+            BYTES_TO_T_UINT_8( 0x8B, 0x2C, 0xC6, 0x57, 0x3A, 0xCF, 0x41, 0x92 ),
+            BYTES_TO_T_UINT_8( 0x7F, 0x66, 0x1B, 0xFD, 0x61, 0x69, 0x5E, 0x2F ),
+            BYTES_TO_T_UINT_8( 0x97, 0x17, 0xA0, 0xF5, 0x0B, 0xC7, 0x15, 0x5C ),
+            BYTES_TO_T_UINT_8( 0x92, 0x61, 0x95, 0x60, 0x4D, 0xB4, 0x20, 0x3D ),
+            BYTES_TO_T_UINT_8( 0x52, 0xDB, 0x1F, 0x07, 0x37, 0x1B, 0x91, 0x04 ),
+            BYTES_TO_T_UINT_8( 0x7B, 0x0F, 0x6F, 0x8D, 0x16, 0xF9, 0x48, 0xF6 ),
+        },
+        { /* i = 3 */
+            BYTES_TO_T_UINT_8( 0xBC, 0xBB, 0x37, 0xE1, 0x47, 0x68, 0x56, 0x9E ),
+            BYTES_TO_T_UINT_8( 0xEC, 0x0B, 0x6A, 0x8A, 0x9E, 0x46, 0x34, 0xE4 ),
+            BYTES_TO_T_UINT_8( 0x63, 0x34, 0xD7, 0x79, 0x61, 0x27, 0xC4, 0xB1 ),
+            BYTES_TO_T_UINT_8( 0x15, 0x00, 0x3D, 0x13, 0x85, 0x02, 0xBE, 0x5A ),
+            BYTES_TO_T_UINT_8( 0xAB, 0x7D, 0x4C, 0xC0, 0x7C, 0x83, 0xAA, 0x92 ),
+            BYTES_TO_T_UINT_8( 0x07, 0x0C, 0x26, 0x43, 0x4C, 0x9F, 0x3D, 0x57 ),
+            BYTES_TO_T_UINT_8( 0x37, 0xCC, 0xE6, 0x78, 0x62, 0x15, 0x93, 0x0C ),
+            BYTES_TO_T_UINT_8( 0x83, 0x73, 0x6F, 0x6B, 0x5B, 0x72, 0xBB, 0x94 ),
+        },
+        { /* i = 4 */
+            BYTES_TO_T_UINT_8( 0x25, 0x09, 0xE2, 0xBF, 0x44, 0xC2, 0xA8, 0x62 ),
+            BYTES_TO_T_UINT_8( 0x67, 0xE8, 0xDC, 0x8F, 0xC3, 0x9A, 0xC1, 0x91 ),
+            BYTES_TO_T_UINT_8( 0x63, 0x70, 0x38, 0xDD, 0xD5, 0xA5, 0x96, 0x5A ),
+            BYTES_TO_T_UINT_8( 0xF6, 0x24, 0xD3, 0x21, 0xD4, 0x87, 0xD5, 0x61 ),
+            BYTES_TO_T_UINT_8( 0xEA, 0x73, 0x71, 0xA3, 0xA2, 0x73, 0x76, 0xE8 ),
+            BYTES_TO_T_UINT_8( 0x65, 0x8B, 0x77, 0x53, 0x08, 0x80, 0x84, 0x23 ),
+            BYTES_TO_T_UINT_8( 0x3E, 0xB4, 0xBA, 0x05, 0x1E, 0x44, 0xF8, 0x10 ),
+            BYTES_TO_T_UINT_8( 0xBE, 0xEF, 0x21, 0x46, 0x12, 0xFE, 0x11, 0xFA ),
+        },
+        { /* i = 5 */
+            BYTES_TO_T_UINT_8( 0xFD, 0x9F, 0xB1, 0x2C, 0x2B, 0x1F, 0x89, 0x1C ),
+            BYTES_TO_T_UINT_8( 0x23, 0x3C, 0x92, 0xB1, 0x5B, 0x8D, 0xBA, 0x01 ),
+            BYTES_TO_T_UINT_8( 0x8E, 0xCA, 0xC5, 0x8A, 0x67, 0x3D, 0xD0, 0xB6 ),
+            BYTES_TO_T_UINT_8( 0xDC, 0xBE, 0x13, 0x1F, 0x4C, 0xB0, 0x6E, 0x58 ),
+            BYTES_TO_T_UINT_8( 0x09, 0xED, 0xE8, 0x27, 0xE5, 0xC6, 0x35, 0x0C ),
+            BYTES_TO_T_UINT_8( 0xE2, 0xED, 0x19, 0x18, 0x3C, 0xA3, 0x81, 0x1E ),
+            BYTES_TO_T_UINT_8( 0xFA, 0x52, 0xC6, 0x56, 0xC0, 0xD6, 0x8F, 0x27 ),
+            BYTES_TO_T_UINT_8( 0x11, 0x4F, 0x86, 0x70, 0x08, 0xAC, 0xD5, 0x19 ),
+        },
+        { /* i = 6 */
+            BYTES_TO_T_UINT_8( 0xD5, 0x33, 0xB5, 0xD2, 0x34, 0x77, 0x57, 0x62 ),
+            BYTES_TO_T_UINT_8( 0xC0, 0xDD, 0xBD, 0xA1, 0xF6, 0x8A, 0x3B, 0x67 ),
+            BYTES_TO_T_UINT_8( 0x93, 0xC2, 0x9E, 0xA7, 0x9A, 0x7C, 0x7E, 0x57 ),
+            BYTES_TO_T_UINT_8( 0xB1, 0x66, 0xB2, 0xC3, 0x51, 0xE6, 0x6D, 0xBB ),
+            BYTES_TO_T_UINT_8( 0xB3, 0x59, 0x52, 0xB6, 0x3A, 0x30, 0xE9, 0xE7 ),
+            BYTES_TO_T_UINT_8( 0x80, 0x74, 0x3A, 0xD0, 0xD3, 0xAF, 0xA0, 0xD6 ),
+            BYTES_TO_T_UINT_8( 0x27, 0xFC, 0x3C, 0x9B, 0xD1, 0x83, 0xAC, 0xC5 ),
+            BYTES_TO_T_UINT_8( 0x9B, 0xB9, 0x18, 0x5D, 0x9A, 0x61, 0xB4, 0x60 ),
+        },
+        { /* i = 7 */
+            BYTES_TO_T_UINT_8( 0x1C, 0xAA, 0xE5, 0x1A, 0xE1, 0x38, 0x6A, 0xBD ),
+            BYTES_TO_T_UINT_8( 0x58, 0x36, 0xE7, 0x49, 0x2B, 0x65, 0xB7, 0xB8 ),
+            BYTES_TO_T_UINT_8( 0xED, 0x87, 0x5F, 0xEE, 0x14, 0x00, 0x13, 0x0B ),
+            BYTES_TO_T_UINT_8( 0xCD, 0xFF, 0xEB, 0xAE, 0xB2, 0x27, 0x0F, 0x9D ),
+            BYTES_TO_T_UINT_8( 0x55, 0x0A, 0x73, 0x7A, 0x31, 0x46, 0x92, 0xCA ),
+            BYTES_TO_T_UINT_8( 0x3A, 0xC8, 0xBB, 0xDD, 0x2F, 0x5B, 0x95, 0x9C ),
+            BYTES_TO_T_UINT_8( 0x71, 0x9A, 0x01, 0xAC, 0xE0, 0xDF, 0xC1, 0x07 ),
+            BYTES_TO_T_UINT_8( 0x8D, 0xC4, 0x6E, 0x35, 0x6D, 0x56, 0x4A, 0x24 ),
+        },
+        { /* i = 8 */
+            BYTES_TO_T_UINT_8( 0x6A, 0xB1, 0xF8, 0xF4, 0x0E, 0x41, 0xF8, 0x56 ),
+            BYTES_TO_T_UINT_8( 0x6A, 0x26, 0x7B, 0xC4, 0xFE, 0x1A, 0x24, 0x97 ),
+            BYTES_TO_T_UINT_8( 0xC1, 0x87, 0x9C, 0x6D, 0x8E, 0x6B, 0x40, 0x0A ),
+            BYTES_TO_T_UINT_8( 0x1B, 0xAB, 0x42, 0xCD, 0x02, 0x3E, 0x3F, 0x80 ),
+            BYTES_TO_T_UINT_8( 0x69, 0xEC, 0xDB, 0x04, 0xA8, 0x09, 0x03, 0x7F ),
+            BYTES_TO_T_UINT_8( 0x5F, 0xD0, 0xBA, 0x3B, 0xF7, 0x85, 0x3B, 0xA8 ),
+            BYTES_TO_T_UINT_8( 0x7F, 0x19, 0x8E, 0xAD, 0x73, 0x72, 0x09, 0xC6 ),
+            BYTES_TO_T_UINT_8( 0xC1, 0xAD, 0x67, 0x50, 0x0E, 0x44, 0x97, 0xC0 ),
+        },
+        { /* i = 9 */
+            BYTES_TO_T_UINT_8( 0x34, 0xAB, 0x79, 0xC3, 0xF2, 0x56, 0x6A, 0x84 ),
+            BYTES_TO_T_UINT_8( 0xD1, 0xF8, 0x1D, 0x84, 0x8B, 0x06, 0xEE, 0xA8 ),
+            BYTES_TO_T_UINT_8( 0xEF, 0x68, 0x6C, 0x17, 0x59, 0x44, 0x31, 0x20 ),
+            BYTES_TO_T_UINT_8( 0x30, 0x1F, 0x5F, 0x91, 0xD5, 0x32, 0xAF, 0xF1 ),
+            BYTES_TO_T_UINT_8( 0x50, 0xBD, 0x75, 0x5D, 0x31, 0x75, 0xC3, 0x99 ),
+            BYTES_TO_T_UINT_8( 0xBC, 0x67, 0x2F, 0xF7, 0xBA, 0xFF, 0x7C, 0x83 ),
+            BYTES_TO_T_UINT_8( 0x3F, 0x72, 0xD7, 0x48, 0x18, 0xA4, 0x13, 0x06 ),
+            BYTES_TO_T_UINT_8( 0x8B, 0x1C, 0xD4, 0xE2, 0x30, 0xF1, 0xD0, 0x23 ),
+        },
+        { /* i = 10 */
+            BYTES_TO_T_UINT_8( 0x2B, 0x5A, 0xBE, 0xD5, 0x25, 0xE2, 0x93, 0xED ),
+            BYTES_TO_T_UINT_8( 0xC6, 0xF3, 0x34, 0x59, 0x83, 0x99, 0xE7, 0x6F ),
+            BYTES_TO_T_UINT_8( 0xFC, 0x6F, 0x62, 0x22, 0x26, 0x09, 0x14, 0x43 ),
+            BYTES_TO_T_UINT_8( 0x6A, 0x21, 0x90, 0x79, 0xD9, 0xB4, 0xBB, 0x50 ),
+            BYTES_TO_T_UINT_8( 0x3E, 0xC6, 0x7E, 0xE5, 0xC6, 0x91, 0x81, 0x37 ),
+            BYTES_TO_T_UINT_8( 0xB2, 0xCD, 0x1D, 0x18, 0x40, 0x2C, 0x42, 0x65 ),
+            BYTES_TO_T_UINT_8( 0xF6, 0xE0, 0x36, 0x02, 0x9B, 0x09, 0xA8, 0x41 ),
+            BYTES_TO_T_UINT_8( 0xC3, 0x49, 0xFE, 0x01, 0x18, 0x01, 0x10, 0x2B ),
+        },
+        { /* i = 11 */
+            BYTES_TO_T_UINT_8( 0x93, 0x15, 0x39, 0x9B, 0xC5, 0xB5, 0x68, 0xFC ),
+            BYTES_TO_T_UINT_8( 0xFC, 0x70, 0x82, 0x59, 0xA2, 0xF5, 0x85, 0xC3 ),
+            BYTES_TO_T_UINT_8( 0xBB, 0xDC, 0x9A, 0xD1, 0xAA, 0xF3, 0x44, 0x71 ),
+            BYTES_TO_T_UINT_8( 0x0C, 0xAE, 0xFB, 0x83, 0x99, 0x89, 0x55, 0xDD ),
+            BYTES_TO_T_UINT_8( 0xF4, 0x2F, 0xB8, 0x74, 0x8E, 0x8B, 0xB8, 0x93 ),
+            BYTES_TO_T_UINT_8( 0xC9, 0x34, 0xE7, 0x71, 0x40, 0x3C, 0xE0, 0xD2 ),
+            BYTES_TO_T_UINT_8( 0x2A, 0x32, 0xC0, 0x43, 0xAF, 0x9E, 0x7A, 0x9A ),
+            BYTES_TO_T_UINT_8( 0x41, 0x60, 0x9D, 0x14, 0x51, 0xC5, 0xE4, 0xE6 ),
+        },
+        { /* i = 12 */
+            BYTES_TO_T_UINT_8( 0xFE, 0x21, 0xEC, 0x80, 0xFE, 0x4B, 0xE1, 0x5F ),
+            BYTES_TO_T_UINT_8( 0x82, 0xBE, 0x55, 0xC2, 0x6A, 0x11, 0xCE, 0xF6 ),
+            BYTES_TO_T_UINT_8( 0x67, 0x5D, 0x4A, 0x2F, 0x07, 0x5A, 0xBC, 0x98 ),
+            BYTES_TO_T_UINT_8( 0xAF, 0x63, 0x7E, 0xDB, 0x48, 0x71, 0xD2, 0xFA ),
+            BYTES_TO_T_UINT_8( 0xB3, 0x05, 0xAB, 0x29, 0xAC, 0xB6, 0xC0, 0x90 ),
+            BYTES_TO_T_UINT_8( 0xE6, 0x1A, 0x25, 0x4E, 0x3C, 0xA8, 0xA9, 0x37 ),
+            BYTES_TO_T_UINT_8( 0x7D, 0xDE, 0xAA, 0xC2, 0x75, 0xC8, 0x7D, 0x0A ),
+            BYTES_TO_T_UINT_8( 0x84, 0x1A, 0x0E, 0x9F, 0xE3, 0x7D, 0x38, 0x77 ),
+        },
+        { /* i = 13 */
+            BYTES_TO_T_UINT_8( 0xD7, 0x0D, 0x6C, 0xA5, 0x49, 0xCC, 0x9E, 0x1E ),
+            BYTES_TO_T_UINT_8( 0x74, 0x6C, 0x08, 0x46, 0xD8, 0xFC, 0xCF, 0xA5 ),
+            BYTES_TO_T_UINT_8( 0xCE, 0xAE, 0x05, 0xF5, 0x08, 0x14, 0x7A, 0x8F ),
+            BYTES_TO_T_UINT_8( 0x7E, 0xC4, 0xF0, 0xBE, 0xC0, 0x85, 0x7B, 0xB3 ),
+            BYTES_TO_T_UINT_8( 0x8F, 0x6A, 0x0E, 0xCC, 0xE4, 0xB6, 0x96, 0x35 ),
+            BYTES_TO_T_UINT_8( 0x23, 0x8F, 0x38, 0x6B, 0xBF, 0x4B, 0x6D, 0xFD ),
+            BYTES_TO_T_UINT_8( 0x4E, 0xEF, 0x9C, 0xC3, 0xFA, 0x53, 0xA4, 0xAB ),
+            BYTES_TO_T_UINT_8( 0xD5, 0x28, 0xF6, 0xF9, 0xC8, 0x5A, 0x13, 0x9C ),
+        },
+        { /* i = 14 */
+            BYTES_TO_T_UINT_8( 0xBE, 0xF8, 0xC8, 0x95, 0x94, 0x72, 0x1C, 0x0A ),
+            BYTES_TO_T_UINT_8( 0xBF, 0x62, 0xF3, 0x3B, 0x80, 0xC4, 0x61, 0x29 ),
+            BYTES_TO_T_UINT_8( 0xAC, 0xD4, 0x63, 0xDF, 0x03, 0x84, 0x41, 0x9E ),
+            BYTES_TO_T_UINT_8( 0x00, 0xE9, 0xEC, 0x91, 0xCB, 0xF9, 0x09, 0xC1 ),
+            BYTES_TO_T_UINT_8( 0x05, 0x57, 0x94, 0x58, 0xD0, 0x95, 0xD0, 0xC2 ),
+            BYTES_TO_T_UINT_8( 0xC0, 0x85, 0xEB, 0xDD, 0x96, 0x3D, 0x08, 0xB9 ),
+            BYTES_TO_T_UINT_8( 0x9B, 0x44, 0x40, 0x7A, 0x8D, 0x2B, 0x69, 0x84 ),
+            BYTES_TO_T_UINT_8( 0xE1, 0x1E, 0xEE, 0x2E, 0x4F, 0x34, 0xC3, 0x9B ),
+        },
+        { /* i = 15 */
+            BYTES_TO_T_UINT_8( 0x74, 0x30, 0x91, 0x42, 0x56, 0xE3, 0x5A, 0x0D ),
+            BYTES_TO_T_UINT_8( 0xB1, 0x42, 0xA5, 0x48, 0x27, 0x1B, 0x49, 0x55 ),
+            BYTES_TO_T_UINT_8( 0x2A, 0x73, 0x10, 0xB3, 0x65, 0xA6, 0x9C, 0x46 ),
+            BYTES_TO_T_UINT_8( 0xC1, 0x4C, 0x1A, 0x5F, 0x52, 0x1D, 0x59, 0x29 ),
+            BYTES_TO_T_UINT_8( 0x3F, 0x98, 0x4F, 0xB8, 0x6B, 0x5B, 0x6F, 0xE7 ),
+            BYTES_TO_T_UINT_8( 0xE1, 0x84, 0x5F, 0x9F, 0x41, 0xEF, 0x7E, 0xBE ),
+            BYTES_TO_T_UINT_8( 0x89, 0xA1, 0xBA, 0x80, 0x96, 0xD4, 0x00, 0x12 ),
+            BYTES_TO_T_UINT_8( 0x2C, 0x33, 0xEF, 0x18, 0x1F, 0x55, 0x76, 0x63 ),
+        },
+    },
+    {
+        { /* i = 1 */
+            BYTES_TO_T_UINT_8( 0x9A, 0x51, 0x47, 0x41, 0x02, 0x86, 0x28, 0x20 ),
+            BYTES_TO_T_UINT_8( 0xF0, 0x72, 0xB3, 0x26, 0xAC, 0x1E, 0x98, 0xD0 ),
+            BYTES_TO_T_UINT_8( 0xC8, 0xEB, 0x85, 0xA7, 0xCA, 0xA7, 0xD4, 0xA9 ),
+            BYTES_TO_T_UINT_8( 0xE9, 0x58, 0xDF, 0xDB, 0x0D, 0xC5, 0x53, 0xD9 ),
+            BYTES_TO_T_UINT_8( 0x8F, 0x0F, 0x59, 0xFD, 0xCC, 0x61, 0x63, 0x9D ),
+            BYTES_TO_T_UINT_8( 0x17, 0xC9, 0xE6, 0x44, 0x6B, 0x62, 0xE9, 0x72 ),
+            BYTES_TO_T_UINT_8( 0xCF, 0x64, 0xEB, 0x22, 0x10, 0x61, 0xD9, 0x7F ),
+            BYTES_TO_T_UINT_8( 0xF3, 0x88, 0xB2, 0x9E, 0x7E, 0xBB, 0x3E, 0x86 ),
+        },
+        { /* i = 2 */
+            BYTES_TO_T_UINT_8( 0x34, 0x3D, 0xE6, 0xB0, 0x31, 0xEE, 0xE7, 0x4F ),
+            BYTES_TO_T_UINT_8( 0xAB, 0x4F, 0xE5, 0xA9, 0x72, 0x05, 0x60, 0xF4 ),
+            BYTES_TO_T_UINT_8( 0xA4, 0xB5, 0xE7, 0xD5, 0x34, 0x33, 0x49, 0xC0 ),
+            BYTES_TO_T_UINT_8( 0x31, 0x48, 0xD5, 0x06, 0x92, 0xFB, 0x89, 0x85 ),
+            BYTES_TO_T_UINT_8( 0x3A, 0x55, 0x83, 0x65, 0xCC, 0xF5, 0x70, 0xAA ),
+            BYTES_TO_T_UINT_8( 0xE5, 0x49, 0x56, 0xE2, 0x4A, 0x09, 0x79, 0x08 ),
+            BYTES_TO_T_UINT_8( 0x52, 0x46, 0x04, 0x10, 0x07, 0x45, 0x90, 0xCC ),
+            BYTES_TO_T_UINT_8( 0x4F, 0x1C, 0x54, 0x02, 0x6D, 0x69, 0xB0, 0xEB ),
+        },
+        { /* i = 3 */
+            BYTES_TO_T_UINT_8( 0x99, 0xDA, 0x89, 0x3B, 0xC0, 0xA0, 0xBA, 0xAB ),
+            BYTES_TO_T_UINT_8( 0x22, 0x40, 0x28, 0xB8, 0x9E, 0xD7, 0xF2, 0xA6 ),
+            BYTES_TO_T_UINT_8( 0xE8, 0x05, 0x1C, 0xB8, 0x62, 0x78, 0x84, 0x27 ),
+            BYTES_TO_T_UINT_8( 0x63, 0x4D, 0xE5, 0x05, 0x59, 0x4B, 0x7A, 0x33 ),
+            BYTES_TO_T_UINT_8( 0x4A, 0x79, 0xF7, 0x21, 0x0D, 0x50, 0x67, 0x3C ),
+            BYTES_TO_T_UINT_8( 0x61, 0x7F, 0x6D, 0x7D, 0xB7, 0x05, 0x70, 0x20 ),
+            BYTES_TO_T_UINT_8( 0xE8, 0xD6, 0xCF, 0x04, 0x81, 0x37, 0x5A, 0x0A ),
+            BYTES_TO_T_UINT_8( 0xD6, 0xFB, 0xC2, 0xF4, 0xD5, 0xE0, 0x65, 0x0D ),
+        },
+        { /* i = 4 */
+            BYTES_TO_T_UINT_8( 0xCF, 0x49, 0x35, 0x6D, 0x0F, 0xE5, 0x33, 0xD4 ),
+            BYTES_TO_T_UINT_8( 0x5E, 0x66, 0xCD, 0xFA, 0x6F, 0x69, 0x33, 0x6F ),
+            BYTES_TO_T_UINT_8( 0xB4, 0xFC, 0x11, 0xCE, 0xAC, 0xFD, 0x5B, 0x69 ),
+            BYTES_TO_T_UINT_8( 0x60, 0x98, 0x7C, 0xAF, 0x52, 0xE2, 0x0E, 0x81 ),
+            BYTES_TO_T_UINT_8( 0x2C, 0xBB, 0x59, 0x71, 0xE1, 0x0F, 0x45, 0x65 ),
+            BYTES_TO_T_UINT_8( 0x7B, 0x35, 0x8B, 0x75, 0xBE, 0xBE, 0xDF, 0xF7 ),
+            BYTES_TO_T_UINT_8( 0x72, 0xEA, 0x9F, 0xD6, 0x74, 0x7E, 0x05, 0x2B ),
+            BYTES_TO_T_UINT_8( 0x45, 0x17, 0x73, 0x92, 0x7A, 0x71, 0x85, 0xD4 ),
+        },
+        { /* i = 5 */
+            BYTES_TO_T_UINT_8( 0x69, 0x76, 0x3F, 0xE8, 0xBB, 0x69, 0x1F, 0xCE ),
+            BYTES_TO_T_UINT_8( 0x6B, 0x7D, 0x87, 0x72, 0x82, 0xAE, 0xF8, 0x09 ),
+            BYTES_TO_T_UINT_8( 0x8D, 0x27, 0x44, 0x32, 0x54, 0xAE, 0x48, 0x95 ),
+            BYTES_TO_T_UINT_8( 0x9C, 0xC1, 0xC2, 0xE3, 0xDE, 0x55, 0x77, 0x20 ),
+            BYTES_TO_T_UINT_8( 0x45, 0x19, 0xEF, 0x6F, 0xD9, 0x61, 0xBD, 0x87 ),
+            BYTES_TO_T_UINT_8( 0xC3, 0x28, 0x2D, 0xB1, 0xEF, 0x3C, 0x81, 0x18 ),
+            BYTES_TO_T_UINT_8( 0xAA, 0x64, 0xDF, 0x72, 0xD6, 0xD1, 0xBC, 0x9F ),
+            BYTES_TO_T_UINT_8( 0x0D, 0xB0, 0x54, 0x71, 0xE5, 0x5E, 0xDC, 0x48 ),
+        },
+        { /* i = 6 */
+            BYTES_TO_T_UINT_8( 0x54, 0x31, 0x9A, 0xF4, 0x9E, 0x46, 0x0F, 0xEF ),
+            BYTES_TO_T_UINT_8( 0x9A, 0x2E, 0x2B, 0x6E, 0x95, 0xA5, 0x85, 0x3E ),
+            BYTES_TO_T_UINT_8( 0x9C, 0x4A, 0x92, 0xAA, 0x1E, 0xEC, 0xAA, 0x45 ),
+            BYTES_TO_T_UINT_8( 0x19, 0x47, 0x9E, 0xA0, 0xC8, 0xDF, 0x12, 0xAA ),
+            BYTES_TO_T_UINT_8( 0x1D, 0x9F, 0xF6, 0x4D, 0x27, 0x72, 0xF2, 0x26 ),
+            BYTES_TO_T_UINT_8( 0x73, 0x5E, 0xFF, 0xA2, 0x2C, 0xC8, 0xE4, 0xE0 ),
+            BYTES_TO_T_UINT_8( 0x44, 0xDD, 0xA9, 0xB7, 0x73, 0xCE, 0xD8, 0xB9 ),
+            BYTES_TO_T_UINT_8( 0x01, 0xA9, 0x8C, 0xE4, 0x73, 0x6E, 0x03, 0x6C ),
+        },
+        { /* i = 7 */
+            BYTES_TO_T_UINT_8( 0xF0, 0x53, 0x71, 0xA4, 0xE1, 0x21, 0xE4, 0xE1 ),
+            BYTES_TO_T_UINT_8( 0xC9, 0x18, 0x04, 0x92, 0x79, 0x3B, 0x6C, 0xB8 ),
+            BYTES_TO_T_UINT_8( 0x72, 0x76, 0x5D, 0x70, 0x87, 0xCE, 0xBD, 0x93 ),
+            BYTES_TO_T_UINT_8( 0x77, 0x9A, 0xB7, 0xCA, 0x93, 0xE7, 0x5A, 0xF2 ),
+            BYTES_TO_T_UINT_8( 0x0C, 0x9D, 0x86, 0x6D, 0xA3, 0x94, 0x31, 0x1F ),
+            BYTES_TO_T_UINT_8( 0x64, 0xC2, 0x86, 0x49, 0x82, 0xC8, 0x55, 0x9D ),
+            BYTES_TO_T_UINT_8( 0x5E, 0x94, 0x6E, 0x09, 0xA3, 0x5E, 0xFB, 0x49 ),
+            BYTES_TO_T_UINT_8( 0x3E, 0x0A, 0xDB, 0x13, 0x53, 0xE6, 0xB8, 0x39 ),
+        },
+        { /* i = 8 */
+            BYTES_TO_T_UINT_8( 0x4A, 0xB3, 0xD0, 0x35, 0xC0, 0x7B, 0x41, 0xE3 ),
+            BYTES_TO_T_UINT_8( 0xA7, 0xC0, 0x27, 0x83, 0x6B, 0x38, 0x0B, 0x44 ),
+            BYTES_TO_T_UINT_8( 0xD1, 0x62, 0x03, 0xAC, 0x2D, 0x26, 0xB7, 0x8F ),
+            BYTES_TO_T_UINT_8( 0x43, 0xF9, 0xCD, 0xE0, 0x4C, 0x11, 0x41, 0x2C ),
+            BYTES_TO_T_UINT_8( 0xB1, 0xA0, 0x95, 0xAD, 0xF1, 0xCE, 0xA5, 0x2B ),
+            BYTES_TO_T_UINT_8( 0x62, 0x43, 0xD5, 0x67, 0xA8, 0x37, 0x9B, 0xC0 ),
+            BYTES_TO_T_UINT_8( 0xC9, 0x86, 0xE4, 0x01, 0xD2, 0xCD, 0xD6, 0x26 ),
+            BYTES_TO_T_UINT_8( 0x97, 0x92, 0xFF, 0x42, 0xBF, 0x7A, 0x47, 0x20 ),
+        },
+        { /* i = 9 */
+            BYTES_TO_T_UINT_8( 0xD2, 0x67, 0x0A, 0xBC, 0x41, 0x1B, 0x12, 0x0F ),
+            BYTES_TO_T_UINT_8( 0x8A, 0x24, 0x4D, 0x44, 0x0A, 0x76, 0xD4, 0x62 ),
+            BYTES_TO_T_UINT_8( 0x37, 0x47, 0x9B, 0x65, 0x1D, 0x4F, 0x04, 0x0E ),
+            BYTES_TO_T_UINT_8( 0xA8, 0xB4, 0x0B, 0x25, 0x65, 0xE3, 0xFD, 0x08 ),
+            BYTES_TO_T_UINT_8( 0x87, 0xF2, 0x8B, 0x84, 0xDA, 0xC3, 0xEE, 0xAC ),
+            BYTES_TO_T_UINT_8( 0x6E, 0x9D, 0x36, 0xD3, 0x82, 0x21, 0xA6, 0xC2 ),
+            BYTES_TO_T_UINT_8( 0x82, 0x94, 0x44, 0x92, 0xDC, 0xDF, 0x82, 0x35 ),
+            BYTES_TO_T_UINT_8( 0xD7, 0x6C, 0x5D, 0x56, 0xD2, 0x2F, 0x7E, 0x2F ),
+        },
+        { /* i = 10 */
+            BYTES_TO_T_UINT_8( 0x6B, 0x87, 0x8A, 0x17, 0xB5, 0x22, 0x01, 0x0A ),
+            BYTES_TO_T_UINT_8( 0xB4, 0x04, 0x51, 0x08, 0xFF, 0x96, 0xFF, 0x51 ),
+            BYTES_TO_T_UINT_8( 0x76, 0x9F, 0xF2, 0x14, 0xAB, 0x31, 0x0B, 0x05 ),
+            BYTES_TO_T_UINT_8( 0xE6, 0xD4, 0x87, 0x5F, 0x8B, 0xB2, 0xAB, 0x84 ),
+            BYTES_TO_T_UINT_8( 0x0A, 0x79, 0x70, 0x82, 0x9F, 0x43, 0xED, 0xD5 ),
+            BYTES_TO_T_UINT_8( 0x6B, 0xF4, 0xE3, 0x85, 0x9D, 0xB5, 0x6C, 0x2D ),
+            BYTES_TO_T_UINT_8( 0x12, 0x22, 0x1E, 0x6C, 0x1B, 0x5C, 0xF5, 0x75 ),
+            BYTES_TO_T_UINT_8( 0x40, 0x56, 0x65, 0x17, 0x67, 0x6F, 0x43, 0xE5 ),
+        },
+        { /* i = 11 */
+            BYTES_TO_T_UINT_8( 0x6D, 0x59, 0xEB, 0x9A, 0xCC, 0x5E, 0x96, 0xC2 ),
+            BYTES_TO_T_UINT_8( 0xB4, 0x92, 0x3C, 0x02, 0xE7, 0x03, 0xEA, 0x01 ),
+            BYTES_TO_T_UINT_8( 0x61, 0x39, 0x01, 0x2E, 0xB6, 0xB4, 0x04, 0x47 ),
+            BYTES_TO_T_UINT_8( 0x67, 0xA3, 0x5E, 0x90, 0x3F, 0xFD, 0xA8, 0x0C ),
+            BYTES_TO_T_UINT_8( 0x61, 0x2B, 0x1B, 0x55, 0x42, 0x3A, 0x52, 0x92 ),
+            BYTES_TO_T_UINT_8( 0x06, 0xCD, 0x0F, 0x39, 0x9C, 0xA8, 0xB7, 0x1E ),
+            BYTES_TO_T_UINT_8( 0x3E, 0xA6, 0x92, 0x03, 0xBE, 0xD2, 0xF1, 0xE7 ),
+            BYTES_TO_T_UINT_8( 0x33, 0x0C, 0xDB, 0x4D, 0x64, 0xA2, 0xDC, 0x96 ),
+        },
+        { /* i = 12 */
+            BYTES_TO_T_UINT_8( 0x48, 0x98, 0x33, 0x15, 0x0E, 0x21, 0x1C, 0x23 ),
+            BYTES_TO_T_UINT_8( 0x8D, 0x8C, 0x77, 0x70, 0xE8, 0x28, 0x7A, 0xE8 ),
+            BYTES_TO_T_UINT_8( 0x70, 0xE1, 0x56, 0x69, 0x61, 0xE6, 0x1D, 0x9D ),
+            BYTES_TO_T_UINT_8( 0x0B, 0x9C, 0xB0, 0x2B, 0x38, 0xC9, 0xC3, 0x4A ),
+            BYTES_TO_T_UINT_8( 0x7D, 0x98, 0x98, 0x69, 0x51, 0x05, 0xBE, 0x19 ),
+            BYTES_TO_T_UINT_8( 0xD6, 0xF4, 0x09, 0xAE, 0xC4, 0x76, 0x23, 0x8B ),
+            BYTES_TO_T_UINT_8( 0x3D, 0x93, 0x3F, 0x1A, 0x65, 0xB7, 0xE0, 0x1D ),
+            BYTES_TO_T_UINT_8( 0xF4, 0x05, 0x97, 0xE3, 0xC7, 0x94, 0x0D, 0x38 ),
+        },
+        { /* i = 13 */
+            BYTES_TO_T_UINT_8( 0x1D, 0xC3, 0x31, 0x8C, 0x4B, 0x95, 0x85, 0x36 ),
+            BYTES_TO_T_UINT_8( 0x0C, 0x1A, 0xF2, 0x5B, 0x00, 0x3D, 0x53, 0x68 ),
+            BYTES_TO_T_UINT_8( 0xC9, 0x9E, 0xC7, 0x75, 0x6E, 0x62, 0xD7, 0x0B ),
+            BYTES_TO_T_UINT_8( 0x54, 0x9D, 0xC6, 0x42, 0x47, 0x75, 0x17, 0xCA ),
+            BYTES_TO_T_UINT_8( 0xB2, 0xDB, 0xD2, 0xF6, 0xFF, 0xDA, 0x6E, 0xCC ),
+            BYTES_TO_T_UINT_8( 0x18, 0x9D, 0x4A, 0x17, 0xBD, 0x8C, 0x0D, 0xFD ),
+            BYTES_TO_T_UINT_8( 0xE8, 0x78, 0x45, 0xAA, 0x93, 0x87, 0x5E, 0x87 ),
+            BYTES_TO_T_UINT_8( 0xE6, 0x2C, 0xAB, 0x9C, 0x13, 0xA7, 0x76, 0xA9 ),
+        },
+        { /* i = 14 */
+            BYTES_TO_T_UINT_8( 0xDB, 0xA1, 0x3E, 0xB4, 0x11, 0xAB, 0x37, 0xCE ),
+            BYTES_TO_T_UINT_8( 0x92, 0xD2, 0x59, 0x52, 0xA9, 0xF1, 0x7F, 0x0A ),
+            BYTES_TO_T_UINT_8( 0x86, 0xF1, 0x84, 0x8F, 0x21, 0x02, 0x1B, 0x85 ),
+            BYTES_TO_T_UINT_8( 0x13, 0xAD, 0xFA, 0xDE, 0xEA, 0x2B, 0x22, 0xA7 ),
+            BYTES_TO_T_UINT_8( 0x44, 0x91, 0x0A, 0x2B, 0xEC, 0x78, 0xAC, 0xA2 ),
+            BYTES_TO_T_UINT_8( 0xC5, 0x59, 0xFA, 0xF2, 0x51, 0x40, 0x02, 0x5A ),
+            BYTES_TO_T_UINT_8( 0x38, 0xCE, 0x47, 0x61, 0xA5, 0xEC, 0xD1, 0x91 ),
+            BYTES_TO_T_UINT_8( 0x90, 0xC6, 0x2A, 0xBC, 0x23, 0xD5, 0x94, 0xBE ),
+        },
+        { /* i = 15 */
+            BYTES_TO_T_UINT_8( 0x0F, 0x1A, 0xEC, 0x79, 0xFD, 0xAE, 0x8D, 0x2D ),
+            BYTES_TO_T_UINT_8( 0x97, 0x9C, 0xB3, 0xCE, 0xFD, 0xD6, 0xBC, 0x3B ),
+            BYTES_TO_T_UINT_8( 0x95, 0x1A, 0xF6, 0x58, 0xFC, 0x5F, 0x57, 0xF5 ),
+            BYTES_TO_T_UINT_8( 0x20, 0xB4, 0xF7, 0xAD, 0xC4, 0x86, 0xD9, 0xDB ),
+            BYTES_TO_T_UINT_8( 0xB7, 0x9E, 0xF3, 0x15, 0x14, 0x88, 0xAA, 0x81 ),
+            BYTES_TO_T_UINT_8( 0x6C, 0x97, 0x8D, 0xB9, 0xF5, 0xFC, 0xE2, 0x6E ),
+            BYTES_TO_T_UINT_8( 0x7D, 0x71, 0x2F, 0xCF, 0x5D, 0x47, 0x65, 0x54 ),
+            BYTES_TO_T_UINT_8( 0xD0, 0xBB, 0x60, 0x68, 0xC4, 0xD3, 0x24, 0x8E ),
+        },
+    },
+};
+
+/*
+ * d[0..P256_LIMBS-1] += s * b, returns the carry
+ */
+static t_uint p256_mul_add( const t_uint *s, t_uint *d, t_uint b )
+{
+    t_uint c = 0, t = 0;
+    size_t i;
+
+    for( i = P256_LIMBS; i >= 4; i -= 4 )
+    {
+        MULADDC_INIT
+        MULADDC_CORE   MULADDC_CORE
+        MULADDC_CORE   MULADDC_CORE
+        MULADDC_STOP
+    }
+
+    t++;
+
+    return( c );
+}
+
+/*
+ * X = A - p if A + top * 2^256 >= p, X = A otherwise,
+ * assuming A + top * 2^256 < 2p
+ */
+static void p256_reduce( t_uint X[], const t_uint A[], t_uint top )
+{
+    t_uint S[P256_LIMBS], t, borrow, mask;
+    size_t i;
+
+    borrow = 0;
+    for( i = 0; i < P256_LIMBS; i++ )
+    {
+        t = A[i] - borrow;
+        borrow = ( t > A[i] );
+        S[i] = t - p256_p[i];
+        borrow |= ( S[i] > t );
+    }
+
+    /* Keep the difference unless it is negative */
+    mask = (t_uint) 0 - ( ( top | ( borrow ^ 1 ) ) & 1 );
+
+    for( i = 0; i < P256_LIMBS; i++ )
+        X[i] = ( S[i] & mask ) | ( A[i] & ~mask );
+}
+
+/*
+ * X = A + B mod p
+ */
+static void p256_add( t_uint X[], const t_uint A[], const t_uint B[] )
+{
+    t_uint S[P256_LIMBS], t, c;
+    size_t i;
+
+    c = 0;
+    for( i = 0; i < P256_LIMBS; i++ )
+    {
+        t = A[i] + c;
+        c = ( t < c );
+        S[i] = t + B[i];
+        c += ( S[i] < t );
+    }
+
+    p256_reduce( X, S, c );
+}
+
+/*
+ * X = A - B mod p
+ */
+static void p256_sub( t_uint X[], const t_uint A[], const t_uint B[] )
+{
+    t_uint S[P256_LIMBS], t, c, mask;
+    size_t i;
+
+    c = 0;
+    for( i = 0; i < P256_LIMBS; i++ )
+    {
+        t = A[i] - c;
+        c = ( t > A[i] );
+        S[i] = t - B[i];
+        c |= ( S[i] > t );
+    }
+
+    /* Add p back if the difference is negative */
+    mask = (t_uint) 0 - c;
+
+    c = 0;
+    for( i = 0; i < P256_LIMBS; i++ )
+    {
+        t = S[i] + c;
+        c = ( t < c );
+        X[i] = t + ( p256_p[i] & mask );
+        c += ( X[i] < t );
+    }
+}
+
+/*
+ * Montgomery multiplication: X = A * B * R^-1 mod p  (HAC 14.36)
+ *
+ * Since p = -1 mod 2^biL, the factor making the low limb vanish at each
+ * step is simply that limb.
+ */
+static void p256_mul( t_uint X[], const t_uint A[], const t_uint B[] )
+{
+    t_uint T[2 * P256_LIMBS + 1], *d, u0, u1, c;
+    size_t i;
+
+    memset( T, 0, sizeof( T ) );
+
+    for( i = 0; i < P256_LIMBS; i++ )
+    {
+        /*
+         * T = T + u0*B + u1*p, which is now divisible by 2^(biL * (i+1))
+         */
+        d = T + i;
+        u0 = A[i];
+        u1 = d[0] + u0 * B[0];
+
+        c = p256_mul_add( B, d, u0 );
+        d[P256_LIMBS] += c;
+        d[P256_LIMBS + 1] += ( d[P256_LIMBS] < c );
+
+        c = p256_mul_add( p256_p, d, u1 );
+        d[P256_LIMBS] += c;
+        d[P256_LIMBS + 1] += ( d[P256_LIMBS] < c );
+    }
+
+    p256_reduce( X, T + P256_LIMBS, T[2 * P256_LIMBS] );
+}
+
+/*
+ * X = A^(2^n) mod p
+ */
+static void p256_sqr_n( t_uint X[], const t_uint A[], size_t n )
+{
+    memcpy( X, A, P256_LIMBS * ciL );
+
+    while( n-- != 0 )
+        p256_mul( X, X, X );
+}
+
+/*
+ * X = A^-1 mod p = A^(p-2) mod p (Fermat), A != 0
+ *
+ * p - 2 = ffffffff 00000001 00000000 00000000
+ *         00000000 ffffffff ffffffff fffffffd
+ *
+ * Cost: 255 S + 12 M
+ */
+static void p256_inv( t_uint X[], const t_uint A[] )
+{
+    t_uint x2[P256_LIMBS], x3[P256_LIMBS], x6[P256_LIMBS];
+    t_uint x12[P256_LIMBS], x15[P256_LIMBS], x30[P256_LIMBS];
+    t_uint x32[P256_LIMBS], t[P256_LIMBS];
+
+    /* xk = A^(2^k - 1) */
+    p256_mul( t, A, A );        p256_mul( x2, t, A );
+    p256_mul( t, x2, x2 );      p256_mul( x3, t, A );
+    p256_sqr_n( t, x3, 3 );     p256_mul( x6, t, x3 );
+    p256_sqr_n( t, x6, 6 );     p256_mul( x12, t, x6 );
+    p256_sqr_n( t, x12, 3 );    p256_mul( x15, t, x3 );
+    p256_sqr_n( t, x15, 15 );   p256_mul( x30, t, x15 );
+    p256_sqr_n( t, x30, 2 );    p256_mul( x32, t, x2 );
+
+    p256_sqr_n( t, x32, 32 );   p256_mul( t, t, A );
+    p256_sqr_n( t, t, 128 );    p256_mul( t, t, x32 );
+    p256_sqr_n( t, t, 32 );     p256_mul( t, t, x32 );
+    p256_sqr_n( t, t, 30 );     p256_mul( t, t, x30 );
+    p256_sqr_n( t, t, 2 );      p256_mul( X, t, A );
+}
+
+/*
+ * Return 1 if A == 0, 0 otherwise
+ */
+static t_uint p256_is_zero( const t_uint A[] )
+{
+    t_uint acc = 0;
+    size_t i;
+
+    for( i = 0; i < P256_LIMBS; i++ )
+        acc |= A[i];
+
+    return( acc == 0 );
+}
+
+/*
+ * X = A if mask is all ones, unchanged if mask is 0, without branches
+ */
+static void p256_cond_copy( t_uint X[], const t_uint A[], t_uint mask )
+{
+    size_t i;
+
+    for( i = 0; i < P256_LIMBS; i++ )
+        X[i] = ( A[i] & mask ) | ( X[i] & ~mask );
+}
+
+/*
+ * Import an integer 0 <= A < p, in Montgomery representation if mont != 0
+ */
+static void p256_read_mpi( t_uint X[], const mpi *A, int mont )
+{
+    size_t i;
+
+    memset( X, 0, P256_LIMBS * ciL );
+
+    for( i = 0; i < A->n && i < P256_LIMBS; i++ )
+        X[i] = A->p[i];
+
+    if( mont )
+        p256_mul( X, X, p256_rr );
+}
+
+/*
+ * Export a field element in Montgomery representation
+ */
+static int p256_write_mpi( mpi *X, const t_uint A[] )
+{
+    int ret;
+    t_uint t[P256_LIMBS];
+
+    p256_mul( t, A, p256_1 );
+
+    MPI_CHK( mpi_grow( X, P256_LIMBS ) );
+    memset( X->p, 0, X->n * ciL );
+    memcpy( X->p, t, P256_LIMBS * ciL );
+    X->s = 1;
+
+cleanup:
+    return( ret );
+}
+
+/*
+ * Point doubling R = 2 P, dbl-2001-b from EFD (a = -3)
+ *
+ * Cost: 3M + 5S
+ */
+static void p256_double( p256_point *R, const p256_point *P )
+{
+    t_uint delta[P256_LIMBS], gamma[P256_LIMBS], beta[P256_LIMBS];
+    t_uint alpha[P256_LIMBS], t[P256_LIMBS];
+
+    p256_mul( delta, P->Z, P->Z );
+    p256_mul( gamma, P->Y, P->Y );
+    p256_mul( beta,  P->X, gamma );
+
+    /* alpha = 3 (X1 - delta) (X1 + delta) */
+    p256_sub( t, P->X, delta );
+    p256_add( alpha, P->X, delta );
+    p256_mul( alpha, alpha, t );
+    p256_add( t, alpha, alpha );
+    p256_add( alpha, t, alpha );
+
+    /* Z3 = (Y1 + Z1)^2 - gamma - delta */
+    p256_add( R->Z, P->Y, P->Z );
+    p256_mul( R->Z, R->Z, R->Z );
+    p256_sub( R->Z, R->Z, gamma );
+    p256_sub( R->Z, R->Z, delta );
+
+    /* X3 = alpha^2 - 8 beta */
+    p256_add( beta, beta, beta );
+    p256_add( beta, beta, beta );
+    p256_mul( R->X, alpha, alpha );
+    p256_sub( R->X, R->X, beta );
+    p256_sub( R->X, R->X, beta );
+
+    /* Y3 = alpha (4 beta - X3) - 8 gamma^2 */
+    p256_sub( t, beta, R->X );
+    p256_mul( R->Y, alpha, t );
+    p256_mul( gamma, gamma, gamma );
+    p256_add( gamma, gamma, gamma );
+    p256_add( gamma, gamma, gamma );
+    p256_add( gamma, gamma, gamma );
+    p256_sub( R->Y, R->Y, gamma );
+}
+
+/*
+ * Point addition R = P + Q, add-2007-bl from EFD
+ *
+ * Cost: 11M + 5S
+ */
+static void p256_add_jac( p256_point *R, const p256_point *P,
+                          const p256_point *Q )
+{
+    t_uint Z1Z1[P256_LIMBS], Z2Z2[P256_LIMBS], U1[P256_LIMBS];
+    t_uint U2[P256_LIMBS], S1[P256_LIMBS], S2[P256_LIMBS];
+    t_uint H[P256_LIMBS], I[P256_LIMBS], r[P256_LIMBS], t[P256_LIMBS];
+    t_uint p_zero, q_zero;
+    p256_point S;
+
+    p_zero = p256_is_zero( P->Z );
+    q_zero = p256_is_zero( Q->Z );
+
+    p256_mul( Z1Z1, P->Z, P->Z );
+    p256_mul( Z2Z2, Q->Z, Q->Z );
+    p256_mul( U1, P->X, Z2Z2 );
+    p256_mul( U2, Q->X, Z1Z1 );
+    p256_mul( S1, P->Y, Q->Z );
+    p256_mul( S1, S1, Z2Z2 );
+    p256_mul( S2, Q->Y, P->Z );
+    p256_mul( S2, S2, Z1Z1 );
+    p256_sub( H, U2, U1 );
+    p256_sub( r, S2, S1 );
+
+    /* P == Q: the formulas don't apply */
+    if( p256_is_zero( H ) & p256_is_zero( r ) & ( p_zero ^ 1 ) & ( q_zero ^ 1 ) )
+    {
+        p256_double( R, P );
+        return;
+    }
+
+    /* I = (2 H)^2, J = H I (in U2), V = U1 I (in U1) */
+    p256_add( I, H, H );
+    p256_mul( I, I, I );
+    p256_mul( U2, H, I );
+    p256_mul( U1, U1, I );
+    p256_add( r, r, r );
+
+    /* X3 = r^2 - J - 2 V */
+    p256_mul( S.X, r, r );
+    p256_sub( S.X, S.X, U2 );
+    p256_sub( S.X, S.X, U1 );
+    p256_sub( S.X, S.X, U1 );
+
+    /* Y3 = r (V - X3) - 2 S1 J */
+    p256_sub( t, U1, S.X );
+    p256_mul( S.Y, r, t );
+    p256_mul( t, S1, U2 );
+    p256_add( t, t, t );
+    p256_sub( S.Y, S.Y, t );
+
+    /* Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) H */
+    p256_add( S.Z, P->Z, Q->Z );
+    p256_mul( S.Z, S.Z, S.Z );
+    p256_sub( S.Z, S.Z, Z1Z1 );
+    p256_sub( S.Z, S.Z, Z2Z2 );
+    p256_mul( S.Z, S.Z, H );
+
+    /* R = Q if P == 0, R = P if Q == 0 */
+    p256_cond_copy( S.X, Q->X, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.Y, Q->Y, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.Z, Q->Z, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.X, P->X, (t_uint) 0 - q_zero );
+    p256_cond_copy( S.Y, P->Y, (t_uint) 0 - q_zero );
+    p256_cond_copy( S.Z, P->Z, (t_uint) 0 - q_zero );
+
+    memcpy( R, &S, sizeof( p256_point ) );
+}
+
+/*
+ * Mixed addition R = P + (X2, Y2), madd-2007-bl from EFD,
+ * where (X2, Y2) is affine, or zero if q_nonzero is 0
+ *
+ * Cost: 7M + 4S
+ */
+static void p256_add_mixed( p256_point *R, const p256_point *P,
+                            const t_uint X2[], const t_uint Y2[],
+                            t_uint q_nonzero )
+{
+    t_uint Z1Z1[P256_LIMBS], U2[P256_LIMBS], S2[P256_LIMBS];
+    t_uint H[P256_LIMBS], HH[P256_LIMBS], I[P256_LIMBS];
+    t_uint r[P256_LIMBS], t[P256_LIMBS];
+    t_uint p_zero;
+    p256_point S;
+
+    p_zero = p256_is_zero( P->Z );
+
+    p256_mul( Z1Z1, P->Z, P->Z );
+    p256_mul( U2, X2, Z1Z1 );
+    p256_mul( S2, Y2, P->Z );
+    p256_mul( S2, S2, Z1Z1 );
+    p256_sub( H, U2, P->X );
+    p256_sub( r, S2, P->Y );
+
+    /* P == Q: the formulas don't apply */
+    if( p256_is_zero( H ) & p256_is_zero( r ) & ( p_zero ^ 1 ) & q_nonzero )
+    {
+        p256_double( R, P );
+        return;
+    }
+
+    /* HH = H^2, I = 4 HH, J = H I (in U2), V = X1 I (in I) */
+    p256_mul( HH, H, H );
+    p256_add( I, HH, HH );
+    p256_add( I, I, I );
+    p256_mul( U2, H, I );
+    p256_mul( I, P->X, I );
+    p256_add( r, r, r );
+
+    /* X3 = r^2 - J - 2 V */
+    p256_mul( S.X, r, r );
+    p256_sub( S.X, S.X, U2 );
+    p256_sub( S.X, S.X, I );
+    p256_sub( S.X, S.X, I );
+
+    /* Y3 = r (V - X3) - 2 Y1 J */
+    p256_sub( t, I, S.X );
+    p256_mul( S.Y, r, t );
+    p256_mul( t, P->Y, U2 );
+    p256_add( t, t, t );
+    p256_sub( S.Y, S.Y, t );
+
+    /* Z3 = (Z1 + H)^2 - Z1Z1 - HH */
+    p256_add( S.Z, P->Z, H );
+    p256_mul( S.Z, S.Z, S.Z );
+    p256_sub( S.Z, S.Z, Z1Z1 );
+    p256_sub( S.Z, S.Z, HH );
+
+    /* R = Q if P == 0, R = P if Q == 0 */
+    p256_cond_copy( S.X, X2, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.Y, Y2, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.Z, p256_one, (t_uint) 0 - p_zero );
+    p256_cond_copy( S.X, P->X, q_nonzero - 1 );
+    p256_cond_copy( S.Y, P->Y, q_nonzero - 1 );
+    p256_cond_copy( S.Z, P->Z, q_nonzero - 1 );
+
+    memcpy( R, &S, sizeof( p256_point ) );
+}
+
+/*
+ * Randomize Jacobian coordinates: (X, Y, Z) -> (l^2 X, l^3 Y, l Z)
+ */
+static int p256_randomize( p256_point *P,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng )
+{
+    t_uint l[P256_LIMBS], ll[P256_LIMBS];
+    int count = 0;
+
+    do
+    {
+        if( f_rng( p_rng, (unsigned char *) l, sizeof( l ) ) != 0 )
+            return( POLARSSL_ERR_ECP_RANDOM_FAILED );
+
+        /* Any l < 2^256 is fine here, and the result is reduced */
+        p256_mul( l, l, p256_rr );
+
+        if( count++ > 10 )
+            return( POLARSSL_ERR_ECP_RANDOM_FAILED );
+    }
+    while( p256_is_zero( l ) );
+
+    p256_mul( ll, l, l );
+    p256_mul( P->X, P->X, ll );
+    p256_mul( ll, ll, l );
+    p256_mul( P->Y, P->Y, ll );
+    p256_mul( P->Z, P->Z, l );
+
+    return( 0 );
+}
+
+/*
+ * Constant-time selection: R = T[i-1], or zero if i == 0
+ */
+static void p256_select( p256_point *R, const p256_point T[], unsigned char i )
+{
+    unsigned char j;
+    t_uint mask;
+
+    memset( R, 0, sizeof( p256_point ) );
+
+    for( j = 1; j < 16; j++ )
+    {
+        mask = (t_uint) 0 - ( j == i );
+        p256_cond_copy( R->X, T[j-1].X, mask );
+        p256_cond_copy( R->Y, T[j-1].Y, mask );
+        p256_cond_copy( R->Z, T[j-1].Z, mask );
+    }
+}
+
+/*
+ * R = k P, with a fixed window of 4 bits
+ *
+ * Cost: 7D + 8A for T, then 252D + 63A
+ */
+static void p256_mul_var( p256_point *R, const t_uint k[],
+                          const p256_point *P )
+{
+    p256_point T[15], Q;
+    unsigned char j, digit;
+    size_t i;
+
+    /* T[j] = (j + 1) P */
+    memcpy( &T[0], P, sizeof( p256_point ) );
+    for( j = 1; j < 15; j++ )
+    {
+        if( j & 1 )
+            p256_double( &T[j], &T[j / 2] );
+        else
+            p256_add_jac( &T[j], &T[j - 1], P );
+    }
+
+    for( i = 256 / 4; i-- != 0; )
+    {
+        digit = (unsigned char)( ( k[( 4 * i ) / biL] >> ( ( 4 * i ) % biL ) )
+                                 & 0x0F );
+
+        if( i != 256 / 4 - 1 )
+        {
+            for( j = 0; j < 4; j++ )
+                p256_double( R, R );
+
+            p256_select( &Q, T, digit );
+            p256_add_jac( R, R, &Q );
+        }
+        else
+            p256_select( R, T, digit );
+    }
+
+    memset( T, 0, sizeof( T ) );
+    memset( &Q, 0, sizeof( Q ) );
+}
+
+#define P256_BIT( k, i )    ( ( (k)[(i) / biL] >> ( (i) % biL ) ) & 1 )
+
+/*
+ * R = k G, using the embedded comb table with two sets of 4 teeth
+ *
+ * Cost: 31D + 64A
+ */
+static int p256_mul_gen( p256_point *R, const t_uint k[],
+                         int (*f_rng)(void *, unsigned char *, size_t),
+                         void *p_rng )
+{
+    int ret;
+    t_uint X[P256_LIMBS], Y[P256_LIMBS], mask;
+    unsigned char j, t, idx;
+    size_t i;
+
+    memset( R, 0, sizeof( p256_point ) );
+
+    for( i = 32; i-- != 0; )
+    {
+        if( i != 31 )
+            p256_double( R, R );
+
+        for( t = 2; t-- != 0; )
+        {
+            idx = (unsigned char)(
+                  ( P256_BIT( k, i + 32 * t       )      ) |
+                  ( P256_BIT( k, i + 32 * t +  64 ) << 1 ) |
+                  ( P256_BIT( k, i + 32 * t + 128 ) << 2 ) |
+                  ( P256_BIT( k, i + 32 * t + 192 ) << 3 ) );
+
+            /* Read the whole table to thwart cache-based timing attacks */
+            memset( X, 0, sizeof( X ) );
+            memset( Y, 0, sizeof( Y ) );
+            for( j = 1; j < 16; j++ )
+            {
+                mask = (t_uint) 0 - ( j == idx );
+                p256_cond_copy( X, p256_comb[t][j-1], mask );
+                p256_cond_copy( Y, p256_comb[t][j-1] + P256_LIMBS, mask );
+            }
+
+            p256_add_mixed( R, R, X, Y, idx != 0 );
+        }
+
+        if( i == 31 && f_rng != NULL )
+        {
+            if( ( ret = p256_randomize( R, f_rng, p_rng ) ) != 0 )
+                return( ret );
+        }
+    }
+
+    memset( X, 0, sizeof( X ) );
+    memset( Y, 0, sizeof( Y ) );
+
+    return( 0 );
+}
+
+/*
+ * R = m P, using the comb table if P is the generator
+ */
+static int p256_mul_point( const ecp_group *grp, p256_point *R,
+                           const mpi *m, const ecp_point *P,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng )
+{
+    int ret = 0;
+    t_uint k[P256_LIMBS];
+    p256_point T;
+
+    p256_read_mpi( k, m, 0 );
+
+    if( mpi_cmp_mpi( &P->Y, &grp->G.Y ) == 0 &&
+        mpi_cmp_mpi( &P->X, &grp->G.X ) == 0 )
+    {
+        ret = p256_mul_gen( R, k, f_rng, p_rng );
+    }
+    else
+    {
+        p256_read_mpi( T.X, &P->X, 1 );
+        p256_read_mpi( T.Y, &P->Y, 1 );
+        memcpy( T.Z, p256_one, sizeof( T.Z ) );
+
+        if( f_rng != NULL )
+            ret = p256_randomize( &T, f_rng, p_rng );
+
+        if( ret == 0 )
+            p256_mul_var( R, k, &T );
+    }
+
+    memset( k, 0, sizeof( k ) );
+
+    return( ret );
+}
+
+/*
+ * Normalize and export a point
+ */
+static int p256_write_point( ecp_point *R, const p256_point *P )
+{
+    int ret;
+    t_uint Zi[P256_LIMBS], ZZi[P256_LIMBS], t[P256_LIMBS];
+
+    if( p256_is_zero( P->Z ) )
+        return( ecp_set_zero( R ) );
+
+    p256_inv( Zi, P->Z );
+    p256_mul( ZZi, Zi, Zi );
+
+    p256_mul( t, P->X, ZZi );
+    MPI_CHK( p256_write_mpi( &R->X, t ) );
+
+    p256_mul( t, P->Y, ZZi );
+    p256_mul( t, t, Zi );
+    MPI_CHK( p256_write_mpi( &R->Y, t ) );
+
+    MPI_CHK( mpi_lset( &R->Z, 1 ) );
+
+cleanup:
+    return( ret );
+}
+
+/*
+ * Multiplication R = m * P
+ */
+int ecp_p256_mul( const ecp_group *grp, ecp_point *R,
+                  const mpi *m, const ecp_point *P,
+                  int (*f_rng)(void *, unsigned char *, size_t),
+                  void *p_rng )
+{
+    int ret;
+    p256_point T;
+
+    MPI_CHK( p256_mul_point( grp, &T, m, P, f_rng, p_rng ) );
+    MPI_CHK( p256_write_point( R, &T ) );
+
+cleanup:
+    memset( &T, 0, sizeof( T ) );
+
+    if( ret != 0 )
+        ecp_point_free( R );
+
+    return( ret );
+}
+
+/*
+ * Linear combination R = m * P + n * Q
+ */
+int ecp_p256_muladd( const ecp_group *grp, ecp_point *R,
+                     const mpi *m, const ecp_point *P,
+                     const mpi *n, const ecp_point *Q )
+{
+    int ret;
+    p256_point S, T;
+
+    MPI_CHK( p256_mul_point( grp, &S, m, P, NULL, NULL ) );
+    MPI_CHK( p256_mul_point( grp, &T, n, Q, NULL, NULL ) );
+
+    p256_add_jac( &S, &S, &T );
+
+    MPI_CHK( p256_write_point( R, &S ) );
+
+cleanup:
+    return( ret );
+}
+
+#endif /* POLARSSL_ECP_P256_C */
@@ -0,0 +1,572 @@
+/*
+ *  Curve25519 (X25519) with fixed-size field arithmetic
+ *
+ *  Copyright (C) 2006-2014, Brainspark B.V.
+ *
+ *  This file is part of PolarSSL (http://www.polarssl.org)
+ *  Lead Maintainer: Paul Bakker <polarssl_maintainer at polarssl.org>
+ *
+ *  All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * References:
+ *
+ * [M255]   http://cr.yp.to/ecdh/curve25519-20060209.pdf
+ * [NEON]   http://cr.yp.to/highspeed/neoncrypto-20120320.pdf (section 4)
+ * RFC 7748 Elliptic Curves for Security (section 5)
+ *
+ * Unlike ecp.c, which works on MPIs of any size, this module represents
+ * elements of GF(2^255 - 19) as fixed arrays of unsigned limbs on the stack
+ * and makes no allocation. Limbs are not kept fully reduced between
+ * operations: additions are done without carries, and the bounds noted
+ * for each function ensure that no intermediate result overflows.
+ *
+ * With a 64-bit t_uint and a double-width t_udbl, elements use radix 2^51
+ * (5 limbs); otherwise they use radix 2^25.5 (10 limbs alternately of 26
+ * and 25 bits) with 64-bit products.
+ */
+
+#include "polarssl/config.h"
+
+#if defined(POLARSSL_ECP_X25519_C)
+
+#include "polarssl/ecp_x25519.h"
+
+#include <string.h>
+
+#if defined(POLARSSL_HAVE_INT64) && defined(POLARSSL_HAVE_UDBL)
+
+#define X25519_RADIX_51
+
+typedef t_uint   fe_limb;
+typedef t_udbl   fe_wide;
+
+#define FE_LIMBS            5
+#define FE_BITS( i )        51
+
+#else
+
+typedef uint32_t fe_limb;
+typedef uint64_t fe_wide;
+
+#define FE_LIMBS            10
+#define FE_BITS( i )        ( 26 - ( (i) & 1 ) )
+
+#endif /* POLARSSL_HAVE_INT64 && POLARSSL_HAVE_UDBL */
+
+#define FE_MASK( i )        ( ( (fe_limb) 1 << FE_BITS( i ) ) - 1 )
+
+/*
+ * Field element: sum of h[i] 2^(ceil(i * 255 / FE_LIMBS)) mod p
+ *
+ * "Carried" elements, as output by fe_mul() and friends, have limbs
+ * h[i] < 2^FE_BITS(i), except h[1] which may exceed that by 2^18.
+ * Sums and differences of two carried elements are valid inputs for
+ * multiplication, but not for further additions.
+ */
+typedef fe_limb fe[FE_LIMBS];
+
+/* 2 p, used to keep differences positive */
+#if defined(X25519_RADIX_51)
+static const fe fe_2p = {
+    0xFFFFFFFFFFFDA, 0xFFFFFFFFFFFFE, 0xFFFFFFFFFFFFE,
+    0xFFFFFFFFFFFFE, 0xFFFFFFFFFFFFE
+};
+#else
+static const fe fe_2p = {
+    0x7FFFFDA, 0x3FFFFFE, 0x7FFFFFE, 0x3FFFFFE, 0x7FFFFFE,
+    0x3FFFFFE, 0x7FFFFFE, 0x3FFFFFE, 0x7FFFFFE, 0x3FFFFFE
+};
+#endif
+
+/* (A + 2) / 4 for Curve25519 */
+#define X25519_A24          121666
+
+/*
+ * h = 0 or 1
+ */
+static void fe_set( fe h, fe_limb v )
+{
+    memset( h, 0, sizeof( fe ) );
+    h[0] = v;
+}
+
+/*
+ * h = f + g, without carries
+ */
+static void fe_add( fe h, const fe f, const fe g )
+{
+    size_t i;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+        h[i] = f[i] + g[i];
+}
+
+/*
+ * h = f - g, without carries, for g carried
+ */
+static void fe_sub( fe h, const fe f, const fe g )
+{
+    size_t i;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+        h[i] = ( f[i] + fe_2p[i] ) - g[i];
+}
+
+/*
+ * Carry propagation on a double-width result: h = t mod p, carried
+ */
+static void fe_carry_wide( fe h, fe_wide t[FE_LIMBS] )
+{
+    size_t i;
+
+    for( i = 0; i < FE_LIMBS - 1; i++ )
+    {
+        t[i + 1] += t[i] >> FE_BITS( i );
+        h[i] = (fe_limb) t[i] & FE_MASK( i );
+    }
+
+    h[FE_LIMBS - 1] = (fe_limb) t[FE_LIMBS - 1] & FE_MASK( FE_LIMBS - 1 );
+
+    /* 2^255 = 19 mod p */
+    t[0] = h[0] + ( t[FE_LIMBS - 1] >> FE_BITS( FE_LIMBS - 1 ) ) * 19;
+    h[0] = (fe_limb) t[0] & FE_MASK( 0 );
+    h[1] += (fe_limb)( t[0] >> FE_BITS( 0 ) );
+}
+
+#if defined(X25519_RADIX_51)
+/*
+ * h = f * g mod p
+ *
+ * Inputs limbs are below 2^54, so that 19 g[i] fits in a limb and each
+ * column sum of products in a t_udbl.
+ */
+static void fe_mul( fe h, const fe f, const fe g )
+{
+    fe_wide t[5];
+    fe_limb g1_19 = 19 * g[1], g2_19 = 19 * g[2];
+    fe_limb g3_19 = 19 * g[3], g4_19 = 19 * g[4];
+
+    t[0] = (fe_wide) f[0] * g[0]  + (fe_wide) f[1] * g4_19 +
+           (fe_wide) f[2] * g3_19 + (fe_wide) f[3] * g2_19 +
+           (fe_wide) f[4] * g1_19;
+    t[1] = (fe_wide) f[0] * g[1]  + (fe_wide) f[1] * g[0]  +
+           (fe_wide) f[2] * g4_19 + (fe_wide) f[3] * g3_19 +
+           (fe_wide) f[4] * g2_19;
+    t[2] = (fe_wide) f[0] * g[2]  + (fe_wide) f[1] * g[1]  +
+           (fe_wide) f[2] * g[0]  + (fe_wide) f[3] * g4_19 +
+           (fe_wide) f[4] * g3_19;
+    t[3] = (fe_wide) f[0] * g[3]  + (fe_wide) f[1] * g[2]  +
+           (fe_wide) f[2] * g[1]  + (fe_wide) f[3] * g[0]  +
+           (fe_wide) f[4] * g4_19;
+    t[4] = (fe_wide) f[0] * g[4]  + (fe_wide) f[1] * g[3]  +
+           (fe_wide) f[2] * g[2]  + (fe_wide) f[3] * g[1]  +
+           (fe_wide) f[4] * g[0];
+
+    fe_carry_wide( h, t );
+}
+
+/*
+ * h = f^2 mod p, with the same bounds as fe_mul()
+ */
+static void fe_sqr( fe h, const fe f )
+{
+    fe_wide t[5];
+    fe_limb f0_2 = 2 * f[0], f1_2 = 2 * f[1];
+    fe_limb f3_19 = 19 * f[3], f4_19 = 19 * f[4];
+
+    t[0] = (fe_wide) f[0] * f[0]  + (fe_wide) f1_2 * f4_19 +
+           (fe_wide) ( 2 * f[2] ) * f3_19;
+    t[1] = (fe_wide) f0_2 * f[1]  + (fe_wide) ( 2 * f[2] ) * f4_19 +
+           (fe_wide) f[3] * f3_19;
+    t[2] = (fe_wide) f0_2 * f[2]  + (fe_wide) f[1] * f[1] +
+           (fe_wide) ( 2 * f[3] ) * f4_19;
+    t[3] = (fe_wide) f0_2 * f[3]  + (fe_wide) f1_2 * f[2] +
+           (fe_wide) f[4] * f4_19;
+    t[4] = (fe_wide) f0_2 * f[4]  + (fe_wide) f1_2 * f[3] +
+           (fe_wide) f[2] * f[2];
+
+    fe_carry_wide( h, t );
+}
+#else
+/*
+ * h = f * g mod p
+ *
+ * Input limbs are below 2^27.6. A product of two odd-indexed limbs has
+ * an extra factor 2 since their weights are 2^(25.5 i + 0.5).
+ */
+static void fe_mul( fe h, const fe f, const fe g )
+{
+    fe_wide t[FE_LIMBS], p;
+    fe_limb g19[FE_LIMBS];
+    size_t i, j;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+    {
+        t[i] = 0;
+        g19[i] = 19 * g[i];
+    }
+
+    for( i = 0; i < FE_LIMBS; i++ )
+    {
+        for( j = 0; j < FE_LIMBS; j++ )
+        {
+            p = (fe_wide) f[i] * ( i + j < FE_LIMBS ? g[j] : g19[j] );
+            t[( i + j ) % FE_LIMBS] += p << ( i & j & 1 );
+        }
+    }
+
+    fe_carry_wide( h, t );
+}
+
+static void fe_sqr( fe h, const fe f )
+{
+    fe_mul( h, f, f );
+}
+#endif /* X25519_RADIX_51 */
+
+/*
+ * h = f * c mod p, for a small constant c < 2^17
+ */
+static void fe_mul_small( fe h, const fe f, fe_limb c )
+{
+    fe_wide t[FE_LIMBS];
+    size_t i;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+        t[i] = (fe_wide) f[i] * c;
+
+    fe_carry_wide( h, t );
+}
+
+/*
+ * h = f^(2^n) mod p, n >= 1
+ */
+static void fe_sqr_n( fe h, const fe f, size_t n )
+{
+    fe_sqr( h, f );
+
+    while( --n > 0 )
+        fe_sqr( h, h );
+}
+
+/*
+ * h = f^-1 mod p = f^(p-2) mod p (Fermat), or 0 if f == 0
+ *
+ * Addition chain from [M255]
+ * Cost: 254 S + 11 M
+ */
+static void fe_inv( fe h, const fe f )
+{
+    fe z2, z9, z11, z_5_0, z_10_0, z_20_0, z_50_0, z_100_0, t;
+
+    fe_sqr( z2, f );                                /* 2 */
+    fe_sqr_n( t, z2, 2 );                           /* 8 */
+    fe_mul( z9, t, f );                             /* 9 */
+    fe_mul( z11, z9, z2 );                          /* 11 */
+    fe_sqr( t, z11 );                               /* 22 */
+    fe_mul( z_5_0, t, z9 );                         /* 2^5 - 1 */
+    fe_sqr_n( t, z_5_0, 5 );
+    fe_mul( z_10_0, t, z_5_0 );                     /* 2^10 - 1 */
+    fe_sqr_n( t, z_10_0, 10 );
+    fe_mul( z_20_0, t, z_10_0 );                    /* 2^20 - 1 */
+    fe_sqr_n( t, z_20_0, 20 );
+    fe_mul( t, t, z_20_0 );                         /* 2^40 - 1 */
+    fe_sqr_n( t, t, 10 );
+    fe_mul( z_50_0, t, z_10_0 );                    /* 2^50 - 1 */
+    fe_sqr_n( t, z_50_0, 50 );
+    fe_mul( z_100_0, t, z_50_0 );                   /* 2^100 - 1 */
+    fe_sqr_n( t, z_100_0, 100 );
+    fe_mul( t, t, z_100_0 );                        /* 2^200 - 1 */
+    fe_sqr_n( t, t, 50 );
+    fe_mul( t, t, z_50_0 );                         /* 2^250 - 1 */
+    fe_sqr_n( t, t, 5 );                            /* 2^255 - 2^5 */
+    fe_mul( h, t, z11 );                            /* 2^255 - 21 */
+}
+
+/*
+ * Swap f and g if swap == 1, leave them unchanged if swap == 0,
+ * without branches
+ */
+static void fe_cswap( fe f, fe g, fe_limb swap )
+{
+    fe_limb mask = (fe_limb) 0 - swap, x;
+    size_t i;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+    {
+        x = mask & ( f[i] ^ g[i] );
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+/*
+ * Import a 256-bit little-endian integer, reducing it mod p
+ */
+static void fe_read( fe h, const unsigned char s[32] )
+{
+    fe_wide acc = 0;
+    size_t i, j = 0, bits = 0;
+
+    for( i = 0; i < FE_LIMBS; i++ )
+    {
+        while( bits < FE_BITS( i ) )
+        {
+            acc |= (fe_wide) s[j++] << bits;
+            bits += 8;
+        }
+
+        h[i] = (fe_limb) acc & FE_MASK( i );
+        acc >>= FE_BITS( i );
+        bits -= FE_BITS( i );
+    }
+
+    /* bit 255 is left in acc, and 2^255 = 19 mod p */
+    h[0] += 19 * (fe_limb) acc;
+}
+
+/*
+ * Export a carried element as a 32-byte little-endian integer 0 .. p-1
+ */
+static void fe_write( unsigned char s[32], const fe f )
+{
+    fe h;
+    fe_wide acc = 0;
+    fe_limb q;
+    size_t i, j = 0, bits = 0;
+
+    memcpy( h, f, sizeof( fe ) );
+
+    /* q = 1 if h >= p, 0 otherwise (h < 2p for carried inputs) */
+    q = ( h[0] + 19 ) >> FE_BITS( 0 );
+    for( i = 1; i < FE_LIMBS; i++ )
+        q = ( h[i] + q ) >> FE_BITS( i );
+
+    /* h = h - q p = h + 19 q - q 2^255 */
+    h[0] += 19 * q;
+    for( i = 0; i < FE_LIMBS - 1; i++ )
+    {
+        h[i + 1] += h[i] >> FE_BITS( i );
+        h[i] &= FE_MASK( i );
+    }
+    h[FE_LIMBS - 1] &= FE_MASK( FE_LIMBS - 1 );
+
+    for( i = 0; i < FE_LIMBS; i++ )
+    {
+        acc |= (fe_wide) h[i] << bits;
+        bits += FE_BITS( i );
+
+        while( bits >= 8 )
+        {
+            s[j++] = (unsigned char) acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+
+    s[j] = (unsigned char) acc;
+
+    memset( h, 0, sizeof( fe ) );
+}
+
+/*
+ * Import an MPI 0 <= A < 2^256 as a little-endian string (no allocation)
+ */
+static int x25519_read_mpi( unsigned char s[32], const mpi *A )
+{
+    int ret;
+    unsigned char t;
+    size_t i;
+
+    MPI_CHK( mpi_write_binary( A, s, 32 ) );
+
+    for( i = 0; i < 16; i++ )
+    {
+        t = s[i];
+        s[i] = s[31 - i];
+        s[31 - i] = t;
+    }
+
+cleanup:
+    return( ret );
+}
+
+/*
+ * Montgomery ladder on x/z coordinates, from bit 254 of k down to bit 0:
+ * X2 / Z2 = x(k P), for x(P) = X1 and starting with X3 / Z3 = x(P).
+ *
+ * The ladder step is [M255] appendix B, the same formulas as
+ * ecp_double_add_mxz() in ecp.c.
+ * Cost: 255 (5M + 4S + 1 small)
+ */
+static void x25519_ladder( fe X2, fe Z2, fe X3, fe Z3,
+                           const fe X1, const unsigned char k[32] )
+{
+    fe A, AA, B, BB, E, C, D, DA, CB;
+    fe_limb swap = 0, b;
+    int i;
+
+    fe_set( X2, 1 );
+    fe_set( Z2, 0 );
+
+    for( i = 254; i >= 0; i-- )
+    {
+        b = ( k[i >> 3] >> ( i & 7 ) ) & 1;
+        swap ^= b;
+        fe_cswap( X2, X3, swap );
+        fe_cswap( Z2, Z3, swap );
+        swap = b;
+
+        fe_add( A, X2, Z2 );
+        fe_sqr( AA, A );
+        fe_sub( B, X2, Z2 );
+        fe_sqr( BB, B );
+        fe_sub( E, AA, BB );
+        fe_add( C, X3, Z3 );
+        fe_sub( D, X3, Z3 );
+        fe_mul( DA, D, A );
+        fe_mul( CB, C, B );
+
+        fe_add( X3, DA, CB );
+        fe_sqr( X3, X3 );
+        fe_sub( Z3, DA, CB );
+        fe_sqr( Z3, Z3 );
+        fe_mul( Z3, Z3, X1 );
+
+        fe_mul( X2, AA, BB );
+        fe_mul_small( Z2, E, X25519_A24 );
+        fe_add( Z2, Z2, BB );
+        fe_mul( Z2, Z2, E );
+    }
+
+    fe_cswap( X2, X3, swap );
+    fe_cswap( Z2, Z3, swap );
+
+    memset( A, 0, sizeof( fe ) ); memset( AA, 0, sizeof( fe ) );
+    memset( B, 0, sizeof( fe ) ); memset( BB, 0, sizeof( fe ) );
+    memset( E, 0, sizeof( fe ) ); memset( C, 0, sizeof( fe ) );
+    memset( D, 0, sizeof( fe ) ); memset( DA, 0, sizeof( fe ) );
+    memset( CB, 0, sizeof( fe ) );
+}
+
+/*
+ * Pick a random non-zero l and set (X3, Z3) = (l X1, l)
+ * (as ecp_randomize_mxz() in ecp.c)
+ */
+static int x25519_randomize( fe X3, fe Z3, const fe X1,
+                             int (*f_rng)(void *, unsigned char *, size_t),
+                             void *p_rng )
+{
+    unsigned char buf[32], zero[32];
+    int count = 0;
+
+    memset( zero, 0, sizeof( zero ) );
+
+    do
+    {
+        if( f_rng( p_rng, buf, sizeof( buf ) ) != 0 ||
+            count++ > 10 )
+        {
+            memset( buf, 0, sizeof( buf ) );
+            return( POLARSSL_ERR_ECP_RANDOM_FAILED );
+        }
+
+        fe_read( Z3, buf );
+        fe_mul_small( Z3, Z3, 1 );
+        fe_write( buf, Z3 );
+    }
+    while( memcmp( buf, zero, sizeof( buf ) ) == 0 );
+
+    fe_mul( X3, X1, Z3 );
+
+    memset( buf, 0, sizeof( buf ) );
+
+    return( 0 );
+}
+
+/*
+ * Multiplication R = m * P
+ */
+int ecp_x25519_mul( const ecp_group *grp, ecp_point *R,
+                    const mpi *m, const ecp_point *P,
+                    int (*f_rng)(void *, unsigned char *, size_t),
+                    void *p_rng )
+{
+    int ret;
+    unsigned char k[32], u[32];
+    fe X1, X2, Z2, X3, Z3;
+    size_t i;
+    unsigned char nonzero = 0;
+
+    ((void) grp);
+
+    MPI_CHK( x25519_read_mpi( k, m ) );
+    MPI_CHK( x25519_read_mpi( u, &P->X ) );
+
+    /* Multiplying by 1 carries the limbs of X1 */
+    fe_read( X1, u );
+    fe_mul_small( X1, X1, 1 );
+
+    if( f_rng != NULL )
+        MPI_CHK( x25519_randomize( X3, Z3, X1, f_rng, p_rng ) );
+    else
+    {
+        memcpy( X3, X1, sizeof( fe ) );
+        fe_set( Z3, 1 );
+    }
+
+    x25519_ladder( X2, Z2, X3, Z3, X1, k );
+
+    /* Only the final result is checked for zero, which is public */
+    fe_write( u, Z2 );
+    for( i = 0; i < 32; i++ )
+        nonzero |= u[i];
+
+    if( nonzero == 0 )
+    {
+        MPI_CHK( ecp_set_zero( R ) );
+        goto cleanup;
+    }
+
+    fe_inv( Z2, Z2 );
+    fe_mul( X2, X2, Z2 );
+    fe_write( u, X2 );
+
+    for( i = 0; i < 16; i++ )
+    {
+        k[i] = u[31 - i];
+        k[31 - i] = u[i];
+    }
+
+    MPI_CHK( mpi_read_binary( &R->X, k, 32 ) );
+    MPI_CHK( mpi_lset( &R->Z, 1 ) );
+    mpi_free( &R->Y );
+
+cleanup:
+    memset( k, 0, sizeof( k ) ); memset( u, 0, sizeof( u ) );
+    memset( X2, 0, sizeof( fe ) ); memset( Z2, 0, sizeof( fe ) );
+    memset( X3, 0, sizeof( fe ) ); memset( Z3, 0, sizeof( fe ) );
+
+    if( ret != 0 )
+        ecp_point_free( R );
+
+    return( ret );
+}
+
+#endif /* POLARSSL_ECP_X25519_C */
@@ -31,6 +31,8 @@
  *
  * We use the algorithm described as Shoup's method with 4-bit tables in
  * [MGV] 4.1, pp. 12-13, to enhance speed without using too much memory.
+ * With POLARSSL_GCM_8BIT_TABLES, the 8-bit variant of the same method is
+ * used instead, trading 4 KB of tables per context for speed.
  */
 
 #include "polarssl/config.h"
@@ -101,21 +103,24 @@ static int gcm_gen_table( gcm_context *ctx )
     GET_UINT32_BE( lo, h,  12 );
     vl = (uint64_t) hi << 32 | lo;
 
-    /* 8 = 1000 corresponds to 1 in GF(2^128) */
-    ctx->HL[8] = vl;
-    ctx->HH[8] = vh;
+    /* GCM_HTABLE_SIZE / 2 = 10...0 corresponds to 1 in GF(2^128) */
+    ctx->HL[GCM_HTABLE_SIZE / 2] = vl;
+    ctx->HH[GCM_HTABLE_SIZE / 2] = vh;
 
 #if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
-    /* With CLMUL support, we need only h, not the rest of the table */
+    /* With CLMUL support, we need only h and its powers, not the table */
     if( aesni_supports( POLARSSL_AESNI_CLMUL ) )
+    {
+        aesni_gcm_precompute( ctx->HP, h );
         return( 0 );
+    }
 #endif
 
     /* 0 corresponds to 0 in GF(2^128) */
     ctx->HH[0] = 0;
     ctx->HL[0] = 0;
 
-    for( i = 4; i > 0; i >>= 1 )
+    for( i = GCM_HTABLE_SIZE / 4; i > 0; i >>= 1 )
     {
         uint32_t T = ( vl & 1 ) * 0xe1000000U;
         vl  = ( vh << 63 ) | ( vl >> 1 );
@@ -125,7 +130,7 @@ static int gcm_gen_table( gcm_context *ctx )
         ctx->HH[i] = vh;
     }
 
-    for (i = 2; i < 16; i <<= 1 )
+    for (i = 2; i < GCM_HTABLE_SIZE; i <<= 1 )
     {
         uint64_t *HiL = ctx->HL + i, *HiH = ctx->HH + i;
         vh = *HiH;
@@ -170,6 +175,48 @@ int gcm_init( gcm_context *ctx, cipher_id_t cipher, const unsigned char *key,
     return( 0 );
 }
 
+#if defined(POLARSSL_GCM_8BIT_TABLES)
+/*
+ * Shoup's method for multiplication use this table with
+ *      last8[x] = x times P^128
+ * where x and last8[x] are seen as elements of GF(2^128) as in [MGV]
+ */
+static const uint16_t last8[256] =
+{
+    0x0000, 0x01c2, 0x0384, 0x0246, 0x0708, 0x06ca, 0x048c, 0x054e,
+    0x0e10, 0x0fd2, 0x0d94, 0x0c56, 0x0918, 0x08da, 0x0a9c, 0x0b5e,
+    0x1c20, 0x1de2, 0x1fa4, 0x1e66, 0x1b28, 0x1aea, 0x18ac, 0x196e,
+    0x1230, 0x13f2, 0x11b4, 0x1076, 0x1538, 0x14fa, 0x16bc, 0x177e,
+    0x3840, 0x3982, 0x3bc4, 0x3a06, 0x3f48, 0x3e8a, 0x3ccc, 0x3d0e,
+    0x3650, 0x3792, 0x35d4, 0x3416, 0x3158, 0x309a, 0x32dc, 0x331e,
+    0x2460, 0x25a2, 0x27e4, 0x2626, 0x2368, 0x22aa, 0x20ec, 0x212e,
+    0x2a70, 0x2bb2, 0x29f4, 0x2836, 0x2d78, 0x2cba, 0x2efc, 0x2f3e,
+    0x7080, 0x7142, 0x7304, 0x72c6, 0x7788, 0x764a, 0x740c, 0x75ce,
+    0x7e90, 0x7f52, 0x7d14, 0x7cd6, 0x7998, 0x785a, 0x7a1c, 0x7bde,
+    0x6ca0, 0x6d62, 0x6f24, 0x6ee6, 0x6ba8, 0x6a6a, 0x682c, 0x69ee,
+    0x62b0, 0x6372, 0x6134, 0x60f6, 0x65b8, 0x647a, 0x663c, 0x67fe,
+    0x48c0, 0x4902, 0x4b44, 0x4a86, 0x4fc8, 0x4e0a, 0x4c4c, 0x4d8e,
+    0x46d0, 0x4712, 0x4554, 0x4496, 0x41d8, 0x401a, 0x425c, 0x439e,
+    0x54e0, 0x5522, 0x5764, 0x56a6, 0x53e8, 0x522a, 0x506c, 0x51ae,
+    0x5af0, 0x5b32, 0x5974, 0x58b6, 0x5df8, 0x5c3a, 0x5e7c, 0x5fbe,
+    0xe100, 0xe0c2, 0xe284, 0xe346, 0xe608, 0xe7ca, 0xe58c, 0xe44e,
+    0xef10, 0xeed2, 0xec94, 0xed56, 0xe818, 0xe9da, 0xeb9c, 0xea5e,
+    0xfd20, 0xfce2, 0xfea4, 0xff66, 0xfa28, 0xfbea, 0xf9ac, 0xf86e,
+    0xf330, 0xf2f2, 0xf0b4, 0xf176, 0xf438, 0xf5fa, 0xf7bc, 0xf67e,
+    0xd940, 0xd882, 0xdac4, 0xdb06, 0xde48, 0xdf8a, 0xddcc, 0xdc0e,
+    0xd750, 0xd692, 0xd4d4, 0xd516, 0xd058, 0xd19a, 0xd3dc, 0xd21e,
+    0xc560, 0xc4a2, 0xc6e4, 0xc726, 0xc268, 0xc3aa, 0xc1ec, 0xc02e,
+    0xcb70, 0xcab2, 0xc8f4, 0xc936, 0xcc78, 0xcdba, 0xcffc, 0xce3e,
+    0x9180, 0x9042, 0x9204, 0x93c6, 0x9688, 0x974a, 0x950c, 0x94ce,
+    0x9f90, 0x9e52, 0x9c14, 0x9dd6, 0x9898, 0x995a, 0x9b1c, 0x9ade,
+    0x8da0, 0x8c62, 0x8e24, 0x8fe6, 0x8aa8, 0x8b6a, 0x892c, 0x88ee,
+    0x83b0, 0x8272, 0x8034, 0x81f6, 0x84b8, 0x857a, 0x873c, 0x86fe,
+    0xa9c0, 0xa802, 0xaa44, 0xab86, 0xaec8, 0xaf0a, 0xad4c, 0xac8e,
+    0xa7d0, 0xa612, 0xa454, 0xa596, 0xa0d8, 0xa11a, 0xa35c, 0xa29e,
+    0xb5e0, 0xb422, 0xb664, 0xb7a6, 0xb2e8, 0xb32a, 0xb16c, 0xb0ae,
+    0xbbf0, 0xba32, 0xb874, 0xb9b6, 0xbcf8, 0xbd3a, 0xbf7c, 0xbebe
+};
+#else
 /*
  * Shoup's method for multiplication use this table with
  *      last4[x] = x times P^128
@@ -182,6 +229,7 @@ static const uint64_t last4[16] =
     0xe100, 0xfd20, 0xd940, 0xc560,
     0x9180, 0x8da0, 0xa9c0, 0xb5e0
 };
+#endif /* POLARSSL_GCM_8BIT_TABLES */
 
 /*
  * Sets output to x times H using the precomputed tables.
@@ -191,26 +239,40 @@ static void gcm_mult( gcm_context *ctx, const unsigned char x[16],
                       unsigned char output[16] )
 {
     int i = 0;
-    unsigned char z[16];
-    unsigned char lo, hi, rem;
+    unsigned char rem;
     uint64_t zh, zl;
+#if !defined(POLARSSL_GCM_8BIT_TABLES)
+    unsigned char lo, hi;
+#endif
 
 #if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
     if( aesni_supports( POLARSSL_AESNI_CLMUL ) ) {
         unsigned char h[16];
 
-        PUT_UINT32_BE( ctx->HH[8] >> 32, h,  0 );
-        PUT_UINT32_BE( ctx->HH[8],       h,  4 );
-        PUT_UINT32_BE( ctx->HL[8] >> 32, h,  8 );
-        PUT_UINT32_BE( ctx->HL[8],       h, 12 );
+        PUT_UINT32_BE( ctx->HH[GCM_HTABLE_SIZE / 2] >> 32, h,  0 );
+        PUT_UINT32_BE( ctx->HH[GCM_HTABLE_SIZE / 2],       h,  4 );
+        PUT_UINT32_BE( ctx->HL[GCM_HTABLE_SIZE / 2] >> 32, h,  8 );
+        PUT_UINT32_BE( ctx->HL[GCM_HTABLE_SIZE / 2],       h, 12 );
 
         aesni_gcm_mult( output, x, h );
         return;
     }
 #endif
 
-    memset( z, 0x00, 16 );
+#if defined(POLARSSL_GCM_8BIT_TABLES)
+    zh = ctx->HH[x[15]];
+    zl = ctx->HL[x[15]];
 
+    for( i = 14; i >= 0; i-- )
+    {
+        rem = (unsigned char) zl;
+        zl = ( zh << 56 ) | ( zl >> 8 );
+        zh = ( zh >> 8 );
+        zh ^= (uint64_t) last8[rem] << 48;
+        zh ^= ctx->HH[x[i]];
+        zl ^= ctx->HL[x[i]];
+    }
+#else
     lo = x[15] & 0xf;
     hi = x[15] >> 4;
 
@@ -240,6 +302,7 @@ static void gcm_mult( gcm_context *ctx, const unsigned char x[16],
         zh ^= ctx->HH[hi];
         zl ^= ctx->HL[hi];
     }
+#endif /* POLARSSL_GCM_8BIT_TABLES */
 
     PUT_UINT32_BE( zh >> 32, output, 0 );
     PUT_UINT32_BE( zh, output, 4 );
@@ -247,6 +310,32 @@ static void gcm_mult( gcm_context *ctx, const unsigned char x[16],
     PUT_UINT32_BE( zl, output, 12 );
 }
 
+/*
+ * Absorb whole blocks into the running hash ctx->buf.
+ * With CLMUL, 8 blocks at a time are hashed with a single reduction.
+ */
+static void gcm_ghash( gcm_context *ctx, const unsigned char *x,
+                       size_t blocks )
+{
+    size_t i;
+
+#if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
+    if( aesni_supports( POLARSSL_AESNI_CLMUL ) )
+    {
+        for( ; blocks >= 8; blocks -= 8, x += 128 )
+            aesni_gcm_mult8( ctx->buf, x, ctx->HP );
+    }
+#endif
+
+    for( ; blocks > 0; blocks--, x += 16 )
+    {
+        for( i = 0; i < 16; i++ )
+            ctx->buf[i] ^= x[i];
+
+        gcm_mult( ctx, ctx->buf, ctx->buf );
+    }
+}
+
 int gcm_starts( gcm_context *ctx,
                 int mode,
                 const unsigned char *iv,
@@ -304,23 +393,68 @@ int gcm_starts( gcm_context *ctx,
     }
 
     ctx->add_len = add_len;
-    p = add;
-    while( add_len > 0 )
+    gcm_ghash( ctx, add, add_len / 16 );
+
+    if( add_len % 16 != 0 )
     {
-        use_len = ( add_len < 16 ) ? add_len : 16;
+        p = add + add_len - add_len % 16;
 
-        for( i = 0; i < use_len; i++ )
+        for( i = 0; i < add_len % 16; i++ )
             ctx->buf[i] ^= p[i];
 
         gcm_mult( ctx, ctx->buf, ctx->buf );
-
-        add_len -= use_len;
-        p += use_len;
     }
 
     return( 0 );
 }
 
+#if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
+/*
+ * Bulk path for AES with AES-NI and CLMUL: 8 counter blocks are encrypted
+ * together, and each 128-byte chunk is hashed while it is still in cache,
+ * with a single reduction per chunk.
+ * Only processes whole chunks, returns the number of bytes processed.
+ */
+static size_t gcm_update_aesni( gcm_context *ctx,
+                                size_t length,
+                                const unsigned char *input,
+                                unsigned char *output )
+{
+    aes_context *aes = (aes_context *) ctx->cipher_ctx.cipher_ctx;
+    unsigned char counters[128];
+    const unsigned char *hashed;
+    size_t done, i, j;
+
+    for( done = 0; length - done >= 128; done += 128 )
+    {
+        for( j = 0; j < 128; j += 16 )
+        {
+            for( i = 16; i > 12; i-- )
+                if( ++ctx->y[i - 1] != 0 )
+                    break;
+
+            memcpy( counters + j, ctx->y, 16 );
+        }
+
+        /*
+         * Hash the ciphertext: on decryption, before the output
+         * (which may overlap the input) is written
+         */
+        hashed = ( ctx->mode == GCM_DECRYPT ) ? input + done : output + done;
+
+        if( ctx->mode == GCM_ENCRYPT )
+            aesni_crypt_ctr8( aes, counters, input + done, output + done );
+
+        gcm_ghash( ctx, hashed, 8 );
+
+        if( ctx->mode == GCM_DECRYPT )
+            aesni_crypt_ctr8( aes, counters, input + done, output + done );
+    }
+
+    return( done );
+}
+#endif /* POLARSSL_AESNI_C && POLARSSL_HAVE_X86_64 */
+
 int gcm_update( gcm_context *ctx,
                 size_t length,
                 const unsigned char *input,
@@ -339,6 +473,21 @@ int gcm_update( gcm_context *ctx,
     ctx->len += length;
 
     p = input;
+
+#if defined(POLARSSL_AESNI_C) && defined(POLARSSL_HAVE_X86_64)
+    if( length >= 128 &&
+        ctx->cipher_ctx.cipher_info->base->cipher == POLARSSL_CIPHER_ID_AES &&
+        aesni_supports( POLARSSL_AESNI_AES ) &&
+        aesni_supports( POLARSSL_AESNI_CLMUL ) )
+    {
+        use_len = gcm_update_aesni( ctx, length, p, out_p );
+
+        length -= use_len;
+        p += use_len;
+        out_p += use_len;
+    }
+#endif
+
     while( length > 0 )
     {
         use_len = ( length < 16 ) ? length : 16;
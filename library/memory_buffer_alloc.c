@@ -52,6 +52,34 @@
 #define MAGIC2       0xEE119966
 #define MAX_BT 20
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+#if defined(_MSC_VER)
+#define MEMORY_THREAD_LOCAL __declspec(thread)
+#else
+#define MEMORY_THREAD_LOCAL __thread
+#endif
+#endif /* POLARSSL_MEMORY_THREAD_CACHE */
+
+/*
+ * Size classes for small and medium blocks. Freed blocks up to the largest
+ * class are kept in a free list per class instead of being merged back into
+ * the heap, so that they can be handed out again without searching.
+ */
+#define MEMORY_BINS  16
+
+static const size_t bin_size[MEMORY_BINS] =
+{
+      16,   32,   48,   64,   96,  128,  192,  256,
+     384,  512,  768, 1024, 1536, 2048, 3072, 4096
+};
+
+/*
+ * Value of alloc for a block kept in a size class: it is not allocated, but
+ * it is not in the free list either, so its neighbours must not merge with
+ * it (they only merge with alloc == 0)
+ */
+#define MEMORY_BINNED   2
+
 typedef struct _memory_header memory_header;
 struct _memory_header
 {
@@ -75,6 +103,7 @@ typedef struct
     size_t          len;
     memory_header   *first;
     memory_header   *first_free;
+    memory_header   *bins[MEMORY_BINS];
     size_t          current_alloc_size;
     int             verify;
 #if defined(POLARSSL_MEMORY_DEBUG)
@@ -93,6 +122,30 @@ buffer_alloc_ctx;
 
 static buffer_alloc_ctx heap;
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+/*
+ * Blocks freed by a thread, kept for its next allocations without locking.
+ * Other threads read the headers of a block's neighbours under the lock, so
+ * cached blocks keep alloc == 1 and are linked through their first bytes of
+ * data instead of next_free: the cache never writes to a shared header.
+ */
+typedef struct
+{
+    memory_header   *bins[MEMORY_BINS];
+    size_t          count[MEMORY_BINS];
+    unsigned int    generation;
+}
+thread_cache_ctx;
+
+static MEMORY_THREAD_LOCAL thread_cache_ctx thread_cache;
+
+#define THREAD_CACHE_NEXT( hdr )                                        \
+    ( *(memory_header **)( (unsigned char *) (hdr) + sizeof(memory_header) ) )
+
+/* Incremented by each memory_buffer_alloc_init(), invalidates caches */
+static unsigned int heap_generation;
+#endif /* POLARSSL_MEMORY_THREAD_CACHE */
+
 #if defined(POLARSSL_MEMORY_DEBUG)
 static void debug_header( memory_header *hdr )
 {
@@ -155,7 +208,7 @@ static int verify_header( memory_header *hdr )
         return( 1 );
     }
 
-    if( hdr->alloc > 1 )
+    if( hdr->alloc > MEMORY_BINNED )
     {
 #if defined(POLARSSL_MEMORY_DEBUG)
         polarssl_fprintf( stderr, "FATAL: alloc has illegal value\n" );
@@ -231,23 +284,136 @@ static int verify_chain()
     return( 0 );
 }
 
-static void *buffer_alloc_malloc( size_t len )
+static size_t align_len( size_t len )
+{
+    if( len % POLARSSL_MEMORY_ALIGN_MULTIPLE )
+    {
+        len -= len % POLARSSL_MEMORY_ALIGN_MULTIPLE;
+        len += POLARSSL_MEMORY_ALIGN_MULTIPLE;
+    }
+
+    return( len );
+}
+
+/*
+ * Smallest size class for an allocation of len bytes,
+ * MEMORY_BINS if too large
+ */
+static size_t bin_for_alloc( size_t len )
+{
+    size_t i;
+
+    if( len > bin_size[MEMORY_BINS - 1] )
+        return( MEMORY_BINS );
+
+    for( i = 0; bin_size[i] < len; i++ );
+
+    return( i );
+}
+
+/*
+ * Largest size class a free block of the given size can serve,
+ * MEMORY_BINS if it should go back to the heap
+ */
+static size_t bin_for_free( size_t size )
+{
+    size_t i;
+
+    if( size < bin_size[0] || size > bin_size[MEMORY_BINS - 1] )
+        return( MEMORY_BINS );
+
+    for( i = MEMORY_BINS - 1; bin_size[i] > size; i-- );
+
+    return( i );
+}
+
+/*
+ * Check a pointer given to polarssl_free() and return its header.
+ * Only the fields the block's neighbours never touch are checked, so this
+ * is safe without the lock.
+ */
+static memory_header *block_header( void *ptr )
+{
+    memory_header *hdr;
+    unsigned char *p = (unsigned char *) ptr;
+
+    if( p < heap.buf || p > heap.buf + heap.len )
+    {
+#if defined(POLARSSL_MEMORY_DEBUG)
+        polarssl_fprintf( stderr, "FATAL: polarssl_free() outside of managed "
+                                  "space\n" );
+#endif
+        exit( 1 );
+    }
+
+    p -= sizeof(memory_header);
+    hdr = (memory_header *) p;
+
+    if( hdr->magic1 != MAGIC1 || hdr->magic2 != MAGIC2 )
+    {
+#if defined(POLARSSL_MEMORY_DEBUG)
+        polarssl_fprintf( stderr, "FATAL: MAGIC mismatch\n" );
+#endif
+        exit( 1 );
+    }
+
+    if( hdr->alloc != 1 )
+    {
+#if defined(POLARSSL_MEMORY_DEBUG)
+        polarssl_fprintf( stderr, "FATAL: polarssl_free() on unallocated "
+                                  "data\n" );
+#endif
+        exit( 1 );
+    }
+
+    return( hdr );
+}
+
+/*
+ * Bookkeeping for a block handed out to / given back by the application
+ */
+static void block_allocated( memory_header *hdr )
 {
-    memory_header *new, *cur = heap.first_free;
-    unsigned char *p;
 #if defined(POLARSSL_MEMORY_BACKTRACE)
     void *trace_buffer[MAX_BT];
     size_t trace_cnt;
 #endif
 
-    if( heap.buf == NULL || heap.first == NULL )
-        return( NULL );
+#if defined(POLARSSL_MEMORY_DEBUG)
+    heap.malloc_count++;
+    heap.total_used += hdr->size;
+    if( heap.total_used > heap.maximum_used)
+        heap.maximum_used = heap.total_used;
+#endif
+#if defined(POLARSSL_MEMORY_BACKTRACE)
+    trace_cnt = backtrace( trace_buffer, MAX_BT );
+    hdr->trace = backtrace_symbols( trace_buffer, trace_cnt );
+    hdr->trace_count = trace_cnt;
+#endif
+    ((void) hdr);
+}
 
-    if( len % POLARSSL_MEMORY_ALIGN_MULTIPLE )
-    {
-        len -= len % POLARSSL_MEMORY_ALIGN_MULTIPLE;
-        len += POLARSSL_MEMORY_ALIGN_MULTIPLE;
-    }
+static void block_freed( memory_header *hdr )
+{
+#if defined(POLARSSL_MEMORY_DEBUG)
+    heap.free_count++;
+    heap.total_used -= hdr->size;
+#endif
+#if defined(POLARSSL_MEMORY_BACKTRACE)
+    free( hdr->trace );
+    hdr->trace = NULL;
+    hdr->trace_count = 0;
+#endif
+    ((void) hdr);
+}
+
+/*
+ * Take a block of at least len (aligned) bytes from the heap (first fit)
+ */
+static memory_header *heap_alloc( size_t len )
+{
+    memory_header *new, *cur = heap.first_free;
+    unsigned char *p;
 
     // Find block that fits
     //
@@ -271,10 +437,6 @@ static void *buffer_alloc_malloc( size_t len )
         exit( 1 );
     }
 
-#if defined(POLARSSL_MEMORY_DEBUG)
-    heap.malloc_count++;
-#endif
-
     // Found location, split block if > memory_header + 4 room left
     //
     if( cur->size - len < sizeof(memory_header) + POLARSSL_MEMORY_ALIGN_MULTIPLE )
@@ -294,21 +456,7 @@ static void *buffer_alloc_malloc( size_t len )
         cur->prev_free = NULL;
         cur->next_free = NULL;
 
-#if defined(POLARSSL_MEMORY_DEBUG)
-        heap.total_used += cur->size;
-        if( heap.total_used > heap.maximum_used)
-            heap.maximum_used = heap.total_used;
-#endif
-#if defined(POLARSSL_MEMORY_BACKTRACE)
-        trace_cnt = backtrace( trace_buffer, MAX_BT );
-        cur->trace = backtrace_symbols( trace_buffer, trace_cnt );
-        cur->trace_count = trace_cnt;
-#endif
-
-        if( ( heap.verify & MEMORY_VERIFY_ALLOC ) && verify_chain() != 0 )
-            exit( 1 );
-
-        return ( (unsigned char *) cur ) + sizeof(memory_header);
+        return( cur );
     }
 
     p = ( (unsigned char *) cur ) + sizeof(memory_header) + len;
@@ -350,61 +498,20 @@ static void *buffer_alloc_malloc( size_t len )
     heap.header_count++;
     if( heap.header_count > heap.maximum_header_count )
         heap.maximum_header_count = heap.header_count;
-    heap.total_used += cur->size;
-    if( heap.total_used > heap.maximum_used)
-        heap.maximum_used = heap.total_used;
-#endif
-#if defined(POLARSSL_MEMORY_BACKTRACE)
-    trace_cnt = backtrace( trace_buffer, MAX_BT );
-    cur->trace = backtrace_symbols( trace_buffer, trace_cnt );
-    cur->trace_count = trace_cnt;
 #endif
 
-    if( ( heap.verify & MEMORY_VERIFY_ALLOC ) && verify_chain() != 0 )
-        exit( 1 );
-
-    return ( (unsigned char *) cur ) + sizeof(memory_header);
+    return( cur );
 }
 
-static void buffer_alloc_free( void *ptr )
+/*
+ * Give a block back to the heap, merging it with free neighbours
+ */
+static void heap_free( memory_header *hdr )
 {
-    memory_header *hdr, *old = NULL;
-    unsigned char *p = (unsigned char *) ptr;
-
-    if( ptr == NULL || heap.buf == NULL || heap.first == NULL )
-        return;
-
-    if( p < heap.buf || p > heap.buf + heap.len )
-    {
-#if defined(POLARSSL_MEMORY_DEBUG)
-        polarssl_fprintf( stderr, "FATAL: polarssl_free() outside of managed "
-                                  "space\n" );
-#endif
-        exit( 1 );
-    }
-
-    p -= sizeof(memory_header);
-    hdr = (memory_header *) p;
-
-    if( verify_header( hdr ) != 0 )
-        exit( 1 );
-
-    if( hdr->alloc != 1 )
-    {
-#if defined(POLARSSL_MEMORY_DEBUG)
-        polarssl_fprintf( stderr, "FATAL: polarssl_free() on unallocated "
-                                  "data\n" );
-#endif
-        exit( 1 );
-    }
+    memory_header *old = NULL;
 
     hdr->alloc = 0;
 
-#if defined(POLARSSL_MEMORY_DEBUG)
-    heap.free_count++;
-    heap.total_used -= hdr->size;
-#endif
-
     // Regroup with block before
     //
     if( hdr->prev != NULL && hdr->prev->alloc == 0 )
@@ -474,7 +581,8 @@ static void buffer_alloc_free( void *ptr )
     if( old == NULL )
     {
         hdr->next_free = heap.first_free;
-        heap.first_free->prev_free = hdr;
+        if( heap.first_free != NULL )
+            heap.first_free->prev_free = hdr;
         heap.first_free = hdr;
     }
 
@@ -482,6 +590,92 @@ static void buffer_alloc_free( void *ptr )
     hdr->trace = NULL;
     hdr->trace_count = 0;
 #endif
+}
+
+/*
+ * Merge all blocks kept in the size class free lists back into the heap
+ */
+static void bins_flush( void )
+{
+    size_t i;
+    memory_header *hdr;
+
+    for( i = 0; i < MEMORY_BINS; i++ )
+    {
+        while( ( hdr = heap.bins[i] ) != NULL )
+        {
+            heap.bins[i] = hdr->next_free;
+            hdr->next_free = NULL;
+            heap_free( hdr );
+        }
+    }
+}
+
+static void *buffer_alloc_malloc( size_t len )
+{
+    memory_header *cur = NULL;
+    size_t bin;
+
+    if( heap.buf == NULL || heap.first == NULL )
+        return( NULL );
+
+    len = align_len( len );
+
+    // Small and medium blocks come from their size class if possible
+    //
+    if( ( bin = bin_for_alloc( len ) ) < MEMORY_BINS )
+    {
+        if( ( cur = heap.bins[bin] ) != NULL )
+        {
+            heap.bins[bin] = cur->next_free;
+            cur->next_free = NULL;
+            cur->alloc = 1;
+        }
+        else
+            len = align_len( bin_size[bin] );
+    }
+
+    if( cur == NULL && ( cur = heap_alloc( len ) ) == NULL )
+    {
+        // Blocks kept in the size classes may prevent merging
+        //
+        bins_flush();
+
+        if( ( cur = heap_alloc( len ) ) == NULL )
+            return( NULL );
+    }
+
+    block_allocated( cur );
+
+    if( ( heap.verify & MEMORY_VERIFY_ALLOC ) && verify_chain() != 0 )
+        exit( 1 );
+
+    return ( (unsigned char *) cur ) + sizeof(memory_header);
+}
+
+static void buffer_alloc_free( void *ptr )
+{
+    memory_header *hdr;
+    size_t bin;
+
+    if( ptr == NULL || heap.buf == NULL || heap.first == NULL )
+        return;
+
+    hdr = block_header( ptr );
+
+    if( verify_header( hdr ) != 0 )
+        exit( 1 );
+
+    block_freed( hdr );
+
+    if( ( bin = bin_for_free( hdr->size ) ) < MEMORY_BINS )
+    {
+        hdr->alloc = MEMORY_BINNED;
+        hdr->next_free = heap.bins[bin];
+        heap.bins[bin] = hdr;
+    }
+    else
+        heap_free( hdr );
 
     if( ( heap.verify & MEMORY_VERIFY_FREE ) && verify_chain() != 0 )
         exit( 1 );
@@ -500,6 +694,19 @@ int memory_buffer_alloc_verify()
 #if defined(POLARSSL_MEMORY_DEBUG)
 void memory_buffer_alloc_status()
 {
+    // Blocks kept for reuse are free: merge them back first
+    //
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    memory_buffer_alloc_thread_flush();
+#endif
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_lock( &heap.mutex );
+#endif
+    bins_flush();
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_unlock( &heap.mutex );
+#endif
+
     polarssl_fprintf( stderr,
                       "Current use: %u blocks / %u bytes, max: %u blocks / "
                       "%u bytes (total %u bytes), malloc / free: %u / %u\n",
@@ -519,18 +726,172 @@ void memory_buffer_alloc_status()
 }
 #endif /* POLARSSL_MEMORY_DEBUG */
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+/*
+ * Drop the cache if it belongs to a previous heap
+ */
+static void thread_cache_check( void )
+{
+    if( thread_cache.generation != heap_generation )
+    {
+        memset( &thread_cache, 0, sizeof(thread_cache_ctx) );
+        thread_cache.generation = heap_generation;
+    }
+}
+
+/*
+ * Allocate from the calling thread's cache, without taking the lock
+ * (except for the debug statistics)
+ */
+static void *thread_cache_malloc( size_t len )
+{
+    memory_header *hdr;
+    size_t bin;
+
+    if( heap.buf == NULL || heap.first == NULL ||
+        heap.verify != MEMORY_VERIFY_NONE )
+    {
+        return( NULL );
+    }
+
+    thread_cache_check();
+
+    if( ( bin = bin_for_alloc( align_len( len ) ) ) == MEMORY_BINS ||
+        ( hdr = thread_cache.bins[bin] ) == NULL )
+    {
+        return( NULL );
+    }
+
+    thread_cache.bins[bin] = THREAD_CACHE_NEXT( hdr );
+    thread_cache.count[bin]--;
+
+#if defined(POLARSSL_MEMORY_DEBUG)
+    polarssl_mutex_lock( &heap.mutex );
+#endif
+    block_allocated( hdr );
+#if defined(POLARSSL_MEMORY_DEBUG)
+    polarssl_mutex_unlock( &heap.mutex );
+#endif
+
+    return ( (unsigned char *) hdr ) + sizeof(memory_header);
+}
+
+/*
+ * Keep a freed block in the calling thread's cache.
+ * Returns -1 if the block does not fit in the cache.
+ */
+static int thread_cache_free( void *ptr )
+{
+    memory_header *hdr, *cur;
+    size_t bin;
+
+    if( ptr == NULL || heap.buf == NULL || heap.first == NULL ||
+        heap.verify != MEMORY_VERIFY_NONE )
+    {
+        return( -1 );
+    }
+
+    thread_cache_check();
+
+    hdr = block_header( ptr );
+
+    if( ( bin = bin_for_free( hdr->size ) ) == MEMORY_BINS ||
+        thread_cache.count[bin] >= POLARSSL_MEMORY_THREAD_CACHE_SIZE )
+    {
+        return( -1 );
+    }
+
+    // Cached blocks still look allocated: catch freeing one twice here
+    //
+    for( cur = thread_cache.bins[bin]; cur != NULL;
+         cur = THREAD_CACHE_NEXT( cur ) )
+    {
+        if( cur == hdr )
+        {
+#if defined(POLARSSL_MEMORY_DEBUG)
+            polarssl_fprintf( stderr, "FATAL: polarssl_free() on unallocated "
+                                      "data\n" );
+#endif
+            exit( 1 );
+        }
+    }
+
+#if defined(POLARSSL_MEMORY_DEBUG)
+    polarssl_mutex_lock( &heap.mutex );
+#endif
+    block_freed( hdr );
+#if defined(POLARSSL_MEMORY_DEBUG)
+    polarssl_mutex_unlock( &heap.mutex );
+#endif
+
+    THREAD_CACHE_NEXT( hdr ) = thread_cache.bins[bin];
+    thread_cache.bins[bin] = hdr;
+    thread_cache.count[bin]++;
+
+    return( 0 );
+}
+
+void memory_buffer_alloc_thread_flush( void )
+{
+    size_t i;
+    memory_header *hdr;
+
+    thread_cache_check();
+
+    polarssl_mutex_lock( &heap.mutex );
+
+    for( i = 0; i < MEMORY_BINS; i++ )
+    {
+        while( ( hdr = thread_cache.bins[i] ) != NULL )
+        {
+            thread_cache.bins[i] = THREAD_CACHE_NEXT( hdr );
+            heap_free( hdr );
+        }
+
+        thread_cache.count[i] = 0;
+    }
+
+    polarssl_mutex_unlock( &heap.mutex );
+}
+#endif /* POLARSSL_MEMORY_THREAD_CACHE */
+
 #if defined(POLARSSL_THREADING_C)
 static void *buffer_alloc_malloc_mutexed( size_t len )
 {
     void *buf;
+
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    if( ( buf = thread_cache_malloc( len ) ) != NULL )
+        return( buf );
+#endif
+
     polarssl_mutex_lock( &heap.mutex );
     buf = buffer_alloc_malloc( len );
     polarssl_mutex_unlock( &heap.mutex );
+
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    if( buf == NULL )
+    {
+        // Our cached blocks may prevent merging as well
+        //
+        memory_buffer_alloc_thread_flush();
+
+        polarssl_mutex_lock( &heap.mutex );
+        buf = buffer_alloc_malloc( len );
+        polarssl_mutex_unlock( &heap.mutex );
+    }
+#endif
+
     return( buf );
 }
 
 static void buffer_alloc_free_mutexed( void *ptr )
 {
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    if( thread_cache_free( ptr ) == 0 )
+        return;
+#endif
+
     polarssl_mutex_lock( &heap.mutex );
     buffer_alloc_free( ptr );
     polarssl_mutex_unlock( &heap.mutex );
@@ -542,6 +903,10 @@ int memory_buffer_alloc_init( unsigned char *buf, size_t len )
     memset( &heap, 0, sizeof(buffer_alloc_ctx) );
     memset( buf, 0, len );
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    heap_generation++;
+#endif
+
 #if defined(POLARSSL_THREADING_C)
     polarssl_mutex_init( &heap.mutex );
     platform_set_malloc_free( buffer_alloc_malloc_mutexed,
@@ -72,6 +72,7 @@ static int wsa_init_done = 0;
 #include <fcntl.h>
 #include <netdb.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #if defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) ||  \
     defined(__DragonFly__)
@@ -554,6 +555,69 @@ int net_send( void *ctx, const unsigned char *buf, size_t len )
     return( ret );
 }
 
+/*
+ * Write data from several buffers in one call
+ */
+int net_sendv( void *ctx, const net_iovec *iov, size_t iovcnt )
+{
+    int fd = *((int *) ctx);
+    int ret;
+    size_t i;
+#if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
+    !defined(EFI32)
+    WSABUF bufs[POLARSSL_NET_MAX_IOV];
+    DWORD sent = 0;
+#else
+    struct iovec bufs[POLARSSL_NET_MAX_IOV];
+#endif
+
+    if( iovcnt > POLARSSL_NET_MAX_IOV )
+        iovcnt = POLARSSL_NET_MAX_IOV;
+
+    for( i = 0; i < iovcnt; i++ )
+    {
+#if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
+    !defined(EFI32)
+        bufs[i].buf = (char *) iov[i].buf;
+        bufs[i].len = (u_long) iov[i].len;
+#else
+        bufs[i].iov_base = (void *) iov[i].buf;
+        bufs[i].iov_len  = iov[i].len;
+#endif
+    }
+
+#if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
+    !defined(EFI32)
+    ret = WSASend( fd, bufs, (DWORD) iovcnt, &sent, 0, NULL, NULL );
+    if( ret == 0 )
+        ret = (int) sent;
+#else
+    ret = (int) writev( fd, bufs, (int) iovcnt );
+#endif
+
+    if( ret < 0 )
+    {
+        if( net_would_block( fd ) != 0 )
+            return( POLARSSL_ERR_NET_WANT_WRITE );
+
+#if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
+    !defined(EFI32)
+        if( WSAGetLastError() == WSAECONNRESET )
+            return( POLARSSL_ERR_NET_CONN_RESET );
+#else
+        if( errno == EPIPE || errno == ECONNRESET )
+            return( POLARSSL_ERR_NET_CONN_RESET );
+
+        if( errno == EINTR )
+            return( POLARSSL_ERR_NET_WANT_WRITE );
+#endif
+
+        return( POLARSSL_ERR_NET_SEND_FAILED );
+    }
+
+    return( ret );
+}
+
 /*
  * Gracefully close the connection
  */
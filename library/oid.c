@@ -235,6 +235,14 @@ static const oid_x509_ext_t oid_x509_ext[] =
         { ADD_LEN( OID_NS_CERT_TYPE ),         "id-netscape-certtype",     "Netscape Certificate Type" },
         EXT_NS_CERT_TYPE,
     },
+    {
+        { ADD_LEN( OID_SUBJECT_KEY_IDENTIFIER ),   "id-ce-subjectKeyIdentifier",   "Subject Key Identifier" },
+        EXT_SUBJECT_KEY_IDENTIFIER,
+    },
+    {
+        { ADD_LEN( OID_AUTHORITY_KEY_IDENTIFIER ), "id-ce-authorityKeyIdentifier", "Authority Key Identifier" },
+        EXT_AUTHORITY_KEY_IDENTIFIER,
+    },
     {
         { NULL, 0, NULL, NULL },
         0,
@@ -630,8 +630,9 @@ static int pk_parse_key_pkcs1_der( rsa_context *rsa,
                                    size_t keylen )
 {
     int ret;
-    size_t len;
-    unsigned char *p, *end;
+    size_t len, seq_len;
+    unsigned char *p, *end, *seq_end, *info_end;
+    rsa_prime_info *info;
 
     p = (unsigned char *) key;
     end = p + keylen;
@@ -665,7 +666,7 @@ static int pk_parse_key_pkcs1_der( rsa_context *rsa,
         return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT + ret );
     }
 
-    if( rsa->ver != 0 )
+    if( rsa->ver != 0 && rsa->ver != 1 )
     {
         return( POLARSSL_ERR_PK_KEY_INVALID_VERSION );
     }
@@ -685,6 +686,71 @@ static int pk_parse_key_pkcs1_der( rsa_context *rsa,
 
     rsa->len = mpi_size( &rsa->N );
 
+    /*
+     * Version 1 (multi-prime) keys end with:
+     *
+     *  OtherPrimeInfos ::= SEQUENCE SIZE(1..MAX) OF OtherPrimeInfo
+     *
+     *  OtherPrimeInfo ::= SEQUENCE {
+     *      prime             INTEGER,  -- ri
+     *      exponent          INTEGER,  -- di
+     *      coefficient       INTEGER   -- ti
+     *  }
+     */
+    if( rsa->ver == 1 )
+    {
+        if( ( ret = asn1_get_tag( &p, end, &seq_len,
+                ASN1_CONSTRUCTED | ASN1_SEQUENCE ) ) != 0 )
+        {
+            rsa_free( rsa );
+            return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT + ret );
+        }
+
+        seq_end = p + seq_len;
+
+        while( p < seq_end )
+        {
+            if( rsa->others == POLARSSL_RSA_MAX_PRIMES - 2 )
+            {
+                rsa_free( rsa );
+                return( POLARSSL_ERR_PK_FEATURE_UNAVAILABLE );
+            }
+
+            info = &rsa->other[rsa->others++];
+
+            if( ( ret = asn1_get_tag( &p, seq_end, &len,
+                    ASN1_CONSTRUCTED | ASN1_SEQUENCE ) ) != 0 )
+            {
+                rsa_free( rsa );
+                return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT + ret );
+            }
+
+            info_end = p + len;
+
+            if( ( ret = asn1_get_mpi( &p, info_end, &info->R ) ) != 0 ||
+                ( ret = asn1_get_mpi( &p, info_end, &info->D ) ) != 0 ||
+                ( ret = asn1_get_mpi( &p, info_end, &info->T ) ) != 0 )
+            {
+                rsa_free( rsa );
+                return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT + ret );
+            }
+
+            if( p != info_end )
+            {
+                rsa_free( rsa );
+                return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT +
+                        POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
+            }
+        }
+
+        if( rsa->others == 0 || p != seq_end )
+        {
+            rsa_free( rsa );
+            return( POLARSSL_ERR_PK_KEY_INVALID_FORMAT +
+                    POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
+        }
+    }
+
     if( p != end )
     {
         rsa_free( rsa );
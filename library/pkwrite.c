@@ -202,6 +202,30 @@ int pk_write_key_der( pk_context *key, unsigned char *buf, size_t size )
     if( pk_get_type( key ) == POLARSSL_PK_RSA )
     {
         rsa_context *rsa = pk_rsa( *key );
+        size_t i, info_len, seq_len = 0;
+
+        /* otherPrimeInfos, see pk_parse_key_pkcs1_der() */
+        for( i = rsa->others; i > 0; i-- )
+        {
+            info_len = 0;
+
+            ASN1_CHK_ADD( info_len, asn1_write_mpi( &c, buf, &rsa->other[i - 1].T ) );
+            ASN1_CHK_ADD( info_len, asn1_write_mpi( &c, buf, &rsa->other[i - 1].D ) );
+            ASN1_CHK_ADD( info_len, asn1_write_mpi( &c, buf, &rsa->other[i - 1].R ) );
+
+            ASN1_CHK_ADD( info_len, asn1_write_len( &c, buf, info_len ) );
+            ASN1_CHK_ADD( info_len, asn1_write_tag( &c, buf, ASN1_CONSTRUCTED | ASN1_SEQUENCE ) );
+
+            seq_len += info_len;
+        }
+
+        if( rsa->others > 0 )
+        {
+            ASN1_CHK_ADD( seq_len, asn1_write_len( &c, buf, seq_len ) );
+            ASN1_CHK_ADD( seq_len, asn1_write_tag( &c, buf, ASN1_CONSTRUCTED | ASN1_SEQUENCE ) );
+        }
+
+        len += seq_len;
 
         ASN1_CHK_ADD( len, asn1_write_mpi( &c, buf, &rsa->QP ) );
         ASN1_CHK_ADD( len, asn1_write_mpi( &c, buf, &rsa->DQ ) );
@@ -211,7 +235,7 @@ int pk_write_key_der( pk_context *key, unsigned char *buf, size_t size )
         ASN1_CHK_ADD( len, asn1_write_mpi( &c, buf, &rsa->D ) );
         ASN1_CHK_ADD( len, asn1_write_mpi( &c, buf, &rsa->E ) );
         ASN1_CHK_ADD( len, asn1_write_mpi( &c, buf, &rsa->N ) );
-        ASN1_CHK_ADD( len, asn1_write_int( &c, buf, 0 ) );
+        ASN1_CHK_ADD( len, asn1_write_int( &c, buf, rsa->others > 0 ? 1 : 0 ) );
 
         ASN1_CHK_ADD( len, asn1_write_len( &c, buf, len ) );
         ASN1_CHK_ADD( len, asn1_write_tag( &c, buf, ASN1_CONSTRUCTED | ASN1_SEQUENCE ) );
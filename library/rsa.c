@@ -47,6 +47,8 @@
 #include "polarssl/platform.h"
 #else
 #define polarssl_printf printf
+#define polarssl_malloc     malloc
+#define polarssl_free       free
 #endif
 
 /*
@@ -56,12 +58,20 @@ void rsa_init( rsa_context *ctx,
                int padding,
                int hash_id )
 {
+#if !defined(POLARSSL_RSA_NO_CRT) && defined(POLARSSL_THREADING_C)
+    size_t i;
+#endif
+
     memset( ctx, 0, sizeof( rsa_context ) );
 
     rsa_set_padding( ctx, padding, hash_id );
 
 #if defined(POLARSSL_THREADING_C)
     polarssl_mutex_init( &ctx->mutex );
+#if !defined(POLARSSL_RSA_NO_CRT)
+    for( i = 0; i < POLARSSL_RSA_BLINDING_SLOTS; i++ )
+        polarssl_mutex_init( &ctx->blinding[i].mutex );
+#endif
 #endif
 }
 
@@ -83,28 +93,44 @@ int rsa_gen_key( rsa_context *ctx,
                  int (*f_rng)(void *, unsigned char *, size_t),
                  void *p_rng,
                  unsigned int nbits, int exponent )
+{
+    return( rsa_gen_key_multi( ctx, f_rng, p_rng, nbits, exponent, 2 ) );
+}
+
+/*
+ * Generate a multi-prime RSA keypair
+ */
+int rsa_gen_key_multi( rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       unsigned int nbits, int exponent, int nprimes )
 {
     int ret;
+    size_t i, pbits;
     mpi P1, Q1, H, G;
 
-    if( f_rng == NULL || nbits < 128 || exponent < 3 )
+    if( f_rng == NULL || exponent < 3 ||
+        nprimes < 2 || nprimes > POLARSSL_RSA_MAX_PRIMES ||
+        nbits < 64 * (unsigned int) nprimes )
         return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
 
     mpi_init( &P1 ); mpi_init( &Q1 ); mpi_init( &H ); mpi_init( &G );
 
+    ctx->ver = ( nprimes > 2 ) ? 1 : 0;
+    ctx->others = nprimes - 2;
+    pbits = ( nbits + nprimes - 1 ) / nprimes;
+
     /*
-     * find primes P and Q with Q < P so that:
-     * GCD( E, (P-1)*(Q-1) ) == 1
+     * find primes P, Q (and r_3, ...) with Q < P so that:
+     * GCD( E, (P-1)*(Q-1)*(r_3-1)*... ) == 1
      */
     MPI_CHK( mpi_lset( &ctx->E, exponent ) );
 
     do
     {
-        MPI_CHK( mpi_gen_prime( &ctx->P, ( nbits + 1 ) >> 1, 0, 
-                                f_rng, p_rng ) );
+        MPI_CHK( mpi_gen_prime( &ctx->P, pbits, 0, f_rng, p_rng ) );
 
-        MPI_CHK( mpi_gen_prime( &ctx->Q, ( nbits + 1 ) >> 1, 0,
-                                f_rng, p_rng ) );
+        MPI_CHK( mpi_gen_prime( &ctx->Q, pbits, 0, f_rng, p_rng ) );
 
         if( mpi_cmp_mpi( &ctx->P, &ctx->Q ) < 0 )
             mpi_swap( &ctx->P, &ctx->Q );
@@ -113,27 +139,61 @@ int rsa_gen_key( rsa_context *ctx,
             continue;
 
         MPI_CHK( mpi_mul_mpi( &ctx->N, &ctx->P, &ctx->Q ) );
+
+        for( i = 0; i < ctx->others; i++ )
+        {
+            /* The last prime brings N to nbits bits, or one more */
+            MPI_CHK( mpi_gen_prime( &ctx->other[i].R,
+                                    i + 1 < ctx->others ? pbits :
+                                    nbits + 1 - mpi_msb( &ctx->N ),
+                                    0, f_rng, p_rng ) );
+            MPI_CHK( mpi_mul_mpi( &ctx->N, &ctx->N, &ctx->other[i].R ) );
+        }
+
         if( mpi_msb( &ctx->N ) != nbits )
             continue;
 
         MPI_CHK( mpi_sub_int( &P1, &ctx->P, 1 ) );
         MPI_CHK( mpi_sub_int( &Q1, &ctx->Q, 1 ) );
         MPI_CHK( mpi_mul_mpi( &H, &P1, &Q1 ) );
+
+        for( i = 0; i < ctx->others; i++ )
+        {
+            MPI_CHK( mpi_sub_int( &P1, &ctx->other[i].R, 1 ) );
+            MPI_CHK( mpi_mul_mpi( &H, &H, &P1 ) );
+        }
+
         MPI_CHK( mpi_gcd( &G, &ctx->E, &H  ) );
     }
     while( mpi_cmp_int( &G, 1 ) != 0 );
 
     /*
-     * D  = E^-1 mod ((P-1)*(Q-1))
+     * D  = E^-1 mod ((P-1)*(Q-1)*...)
      * DP = D mod (P - 1)
      * DQ = D mod (Q - 1)
      * QP = Q^-1 mod P
      */
     MPI_CHK( mpi_inv_mod( &ctx->D , &ctx->E, &H  ) );
+    MPI_CHK( mpi_sub_int( &P1, &ctx->P, 1 ) );
     MPI_CHK( mpi_mod_mpi( &ctx->DP, &ctx->D, &P1 ) );
     MPI_CHK( mpi_mod_mpi( &ctx->DQ, &ctx->D, &Q1 ) );
     MPI_CHK( mpi_inv_mod( &ctx->QP, &ctx->Q, &ctx->P ) );
 
+    /*
+     * For each additional prime r_i (RFC 3447 3.2):
+     * d_i = D mod (r_i - 1)
+     * t_i = (P * Q * ... * r_(i-1))^-1 mod r_i
+     */
+    MPI_CHK( mpi_mul_mpi( &G, &ctx->P, &ctx->Q ) );
+
+    for( i = 0; i < ctx->others; i++ )
+    {
+        MPI_CHK( mpi_sub_int( &P1, &ctx->other[i].R, 1 ) );
+        MPI_CHK( mpi_mod_mpi( &ctx->other[i].D, &ctx->D, &P1 ) );
+        MPI_CHK( mpi_inv_mod( &ctx->other[i].T, &G, &ctx->other[i].R ) );
+        MPI_CHK( mpi_mul_mpi( &G, &G, &ctx->other[i].R ) );
+    }
+
     ctx->len = ( mpi_msb( &ctx->N ) + 7 ) >> 3;
 
 cleanup:
@@ -180,6 +240,7 @@ int rsa_check_pubkey( const rsa_context *ctx )
 int rsa_check_privkey( const rsa_context *ctx )
 {
     int ret;
+    size_t i;
     mpi PQ, DE, P1, Q1, H, I, G, G2, L1, L2, DP, DQ, QP;
 
     if( ( ret = rsa_check_pubkey( ctx ) ) != 0 )
@@ -188,6 +249,13 @@ int rsa_check_privkey( const rsa_context *ctx )
     if( !ctx->P.p || !ctx->Q.p || !ctx->D.p )
         return( POLARSSL_ERR_RSA_KEY_CHECK_FAILED );
 
+    if( ctx->others > POLARSSL_RSA_MAX_PRIMES - 2 )
+        return( POLARSSL_ERR_RSA_KEY_CHECK_FAILED );
+
+    for( i = 0; i < ctx->others; i++ )
+        if( !ctx->other[i].R.p )
+            return( POLARSSL_ERR_RSA_KEY_CHECK_FAILED );
+
     mpi_init( &PQ ); mpi_init( &DE ); mpi_init( &P1 ); mpi_init( &Q1 );
     mpi_init( &H  ); mpi_init( &I  ); mpi_init( &G  ); mpi_init( &G2 );
     mpi_init( &L1 ); mpi_init( &L2 ); mpi_init( &DP ); mpi_init( &DQ );
@@ -198,15 +266,42 @@ int rsa_check_privkey( const rsa_context *ctx )
     MPI_CHK( mpi_sub_int( &P1, &ctx->P, 1 ) );
     MPI_CHK( mpi_sub_int( &Q1, &ctx->Q, 1 ) );
     MPI_CHK( mpi_mul_mpi( &H, &P1, &Q1 ) );
-    MPI_CHK( mpi_gcd( &G, &ctx->E, &H  ) );
 
     MPI_CHK( mpi_gcd( &G2, &P1, &Q1 ) );
     MPI_CHK( mpi_div_mpi( &L1, &L2, &H, &G2 ) );
-    MPI_CHK( mpi_mod_mpi( &I, &DE, &L1  ) );
 
     MPI_CHK( mpi_mod_mpi( &DP, &ctx->D, &P1 ) );
     MPI_CHK( mpi_mod_mpi( &DQ, &ctx->D, &Q1 ) );
     MPI_CHK( mpi_inv_mod( &QP, &ctx->Q, &ctx->P ) );
+
+    /*
+     * Additional primes: check d_i and t_i, and extend PQ to the product
+     * of all primes, H to the product of all (r_i - 1) and L1 to their LCM
+     */
+    for( i = 0; i < ctx->others; i++ )
+    {
+        MPI_CHK( mpi_sub_int( &P1, &ctx->other[i].R, 1 ) );
+        MPI_CHK( mpi_mod_mpi( &Q1, &ctx->D, &P1 ) );
+        MPI_CHK( mpi_inv_mod( &I, &PQ, &ctx->other[i].R ) );
+
+        if( mpi_cmp_mpi( &Q1, &ctx->other[i].D ) != 0 ||
+            mpi_cmp_mpi( &I, &ctx->other[i].T ) != 0 )
+        {
+            ret = POLARSSL_ERR_RSA_KEY_CHECK_FAILED;
+            goto cleanup;
+        }
+
+        MPI_CHK( mpi_mul_mpi( &PQ, &PQ, &ctx->other[i].R ) );
+        MPI_CHK( mpi_mul_mpi( &H, &H, &P1 ) );
+
+        MPI_CHK( mpi_gcd( &G2, &L1, &P1 ) );
+        MPI_CHK( mpi_mul_mpi( &I, &L1, &P1 ) );
+        MPI_CHK( mpi_div_mpi( &L1, &L2, &I, &G2 ) );
+    }
+
+    MPI_CHK( mpi_gcd( &G, &ctx->E, &H  ) );
+    MPI_CHK( mpi_mod_mpi( &I, &DE, &L1  ) );
+
     /*
      * Check for a valid PKCS1v2 private key
      */
@@ -282,18 +377,31 @@ static int rsa_prepare_blinding( rsa_context *ctx, mpi *Vi, mpi *Vf,
                  int (*f_rng)(void *, unsigned char *, size_t), void *p_rng )
 {
     int ret, count = 0;
+    rsa_blinding *b;
 
 #if defined(POLARSSL_THREADING_C)
+    /*
+     * Only the choice of a pair is made under the context mutex, the pair
+     * itself is updated under its own mutex
+     */
     polarssl_mutex_lock( &ctx->mutex );
+    b = &ctx->blinding[ctx->next_blinding];
+    ctx->next_blinding = ( ctx->next_blinding + 1 ) %
+                         POLARSSL_RSA_BLINDING_SLOTS;
+    polarssl_mutex_unlock( &ctx->mutex );
+
+    polarssl_mutex_lock( &b->mutex );
+#else
+    b = &ctx->blinding[0];
 #endif
 
-    if( ctx->Vf.p != NULL )
+    if( b->Vf.p != NULL )
     {
         /* We already have blinding values, just update them by squaring */
-        MPI_CHK( mpi_mul_mpi( &ctx->Vi, &ctx->Vi, &ctx->Vi ) );
-        MPI_CHK( mpi_mod_mpi( &ctx->Vi, &ctx->Vi, &ctx->N ) );
-        MPI_CHK( mpi_mul_mpi( &ctx->Vf, &ctx->Vf, &ctx->Vf ) );
-        MPI_CHK( mpi_mod_mpi( &ctx->Vf, &ctx->Vf, &ctx->N ) );
+        MPI_CHK( mpi_mul_mpi( &b->Vi, &b->Vi, &b->Vi ) );
+        MPI_CHK( mpi_mod_mpi( &b->Vi, &b->Vi, &ctx->N ) );
+        MPI_CHK( mpi_mul_mpi( &b->Vf, &b->Vf, &b->Vf ) );
+        MPI_CHK( mpi_mod_mpi( &b->Vf, &b->Vf, &ctx->N ) );
 
         goto done;
     }
@@ -301,26 +409,29 @@ static int rsa_prepare_blinding( rsa_context *ctx, mpi *Vi, mpi *Vf,
     /* Unblinding value: Vf = random number, invertible mod N */
     do {
         if( count++ > 10 )
-            return( POLARSSL_ERR_RSA_RNG_FAILED );
+        {
+            ret = POLARSSL_ERR_RSA_RNG_FAILED;
+            goto cleanup;
+        }
 
-        MPI_CHK( mpi_fill_random( &ctx->Vf, ctx->len - 1, f_rng, p_rng ) );
-        MPI_CHK( mpi_gcd( &ctx->Vi, &ctx->Vf, &ctx->N ) );
-    } while( mpi_cmp_int( &ctx->Vi, 1 ) != 0 );
+        MPI_CHK( mpi_fill_random( &b->Vf, ctx->len - 1, f_rng, p_rng ) );
+        MPI_CHK( mpi_gcd( &b->Vi, &b->Vf, &ctx->N ) );
+    } while( mpi_cmp_int( &b->Vi, 1 ) != 0 );
 
     /* Blinding value: Vi =  Vf^(-e) mod N */
-    MPI_CHK( mpi_inv_mod( &ctx->Vi, &ctx->Vf, &ctx->N ) );
-    MPI_CHK( mpi_exp_mod( &ctx->Vi, &ctx->Vi, &ctx->E, &ctx->N, &ctx->RN ) );
+    MPI_CHK( mpi_inv_mod( &b->Vi, &b->Vf, &ctx->N ) );
+    MPI_CHK( mpi_exp_mod( &b->Vi, &b->Vi, &ctx->E, &ctx->N, &ctx->RN ) );
 
 done:
-    if( Vi != &ctx->Vi )
+    if( Vi != &b->Vi )
     {
-        MPI_CHK( mpi_copy( Vi, &ctx->Vi ) );
-        MPI_CHK( mpi_copy( Vf, &ctx->Vf ) );
+        MPI_CHK( mpi_copy( Vi, &b->Vi ) );
+        MPI_CHK( mpi_copy( Vf, &b->Vf ) );
     }
 
 cleanup:
 #if defined(POLARSSL_THREADING_C)
-    polarssl_mutex_unlock( &ctx->mutex );
+    polarssl_mutex_unlock( &b->mutex );
 #endif
 
     return( ret );
@@ -340,6 +451,8 @@ int rsa_private( rsa_context *ctx,
     size_t olen;
     mpi T, T1, T2;
 #if !defined(POLARSSL_RSA_NO_CRT)
+    size_t i;
+    mpi C, R;
     mpi *Vi, *Vf;
 
     /*
@@ -354,12 +467,15 @@ int rsa_private( rsa_context *ctx,
     Vi = &Vi_copy;
     Vf = &Vf_copy;
 #else
-    Vi = &ctx->Vi;
-    Vf = &ctx->Vf;
+    Vi = &ctx->blinding[0].Vi;
+    Vf = &ctx->blinding[0].Vf;
 #endif
 #endif
 
     mpi_init( &T ); mpi_init( &T1 ); mpi_init( &T2 );
+#if !defined(POLARSSL_RSA_NO_CRT)
+    mpi_init( &C ); mpi_init( &R );
+#endif
 
     MPI_CHK( mpi_read_binary( &T, input, ctx->len ) );
     if( mpi_cmp_mpi( &T, &ctx->N ) >= 0 )
@@ -384,6 +500,10 @@ int rsa_private( rsa_context *ctx,
         MPI_CHK( mpi_mod_mpi( &T, &T, &ctx->N ) );
     }
 
+    /* Additional primes need the input after T is overwritten */
+    if( ctx->others > 0 )
+        MPI_CHK( mpi_copy( &C, &T ) );
+
     /*
      * faster decryption using the CRT
      *
@@ -406,6 +526,30 @@ int rsa_private( rsa_context *ctx,
     MPI_CHK( mpi_mul_mpi( &T1, &T, &ctx->Q ) );
     MPI_CHK( mpi_add_mpi( &T, &T2, &T1 ) );
 
+    /*
+     * Additional primes (RFC 3447 5.1.2, step 2.b.v), with R = P * Q:
+     *
+     * T1 = input ^ d_i mod r_i
+     * T  = T + R * ( ( T1 - T ) * t_i mod r_i )
+     * R  = R * r_i
+     */
+    if( ctx->others > 0 )
+        MPI_CHK( mpi_mul_mpi( &R, &ctx->P, &ctx->Q ) );
+
+    for( i = 0; i < ctx->others; i++ )
+    {
+        MPI_CHK( mpi_exp_mod( &T1, &C, &ctx->other[i].D, &ctx->other[i].R,
+                              &ctx->other[i].RR ) );
+        MPI_CHK( mpi_sub_mpi( &T2, &T1, &T ) );
+        MPI_CHK( mpi_mul_mpi( &T1, &T2, &ctx->other[i].T ) );
+        MPI_CHK( mpi_mod_mpi( &T2, &T1, &ctx->other[i].R ) );
+        MPI_CHK( mpi_mul_mpi( &T1, &T2, &R ) );
+        MPI_CHK( mpi_add_mpi( &T, &T, &T1 ) );
+
+        if( i + 1 < ctx->others )
+            MPI_CHK( mpi_mul_mpi( &R, &R, &ctx->other[i].R ) );
+    }
+
     if( f_rng != NULL )
     {
         /*
@@ -422,6 +566,9 @@ int rsa_private( rsa_context *ctx,
 
 cleanup:
     mpi_free( &T ); mpi_free( &T1 ); mpi_free( &T2 );
+#if !defined(POLARSSL_RSA_NO_CRT)
+    mpi_free( &C ); mpi_free( &R );
+#endif
 #if !defined(POLARSSL_RSA_NO_CRT) && defined(POLARSSL_THREADING_C)
     mpi_free( &Vi_copy ); mpi_free( &Vf_copy );
 #endif
@@ -432,6 +579,161 @@ cleanup:
     return( 0 );
 }
 
+/*
+ * Do several RSA private key operations, with the exponentiations of all
+ * operations done together
+ */
+int rsa_private_batch( rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       size_t count,
+                       const unsigned char * const input[],
+                       unsigned char * const output[],
+                       int result[] )
+{
+    int ret;
+    size_t k, n;
+    mpi *M, *T, *T1, *T2;
+#if !defined(POLARSSL_RSA_NO_CRT)
+    size_t i;
+    mpi R, *C, *Vi, *Vf;
+#endif
+
+    if( count == 0 )
+        return( 0 );
+
+#if defined(POLARSSL_RSA_NO_CRT)
+    n = 3 * count;
+#else
+    n = 6 * count;
+#endif
+
+    if( ( M = (mpi *) polarssl_malloc( n * sizeof( mpi ) ) ) == NULL )
+        return( POLARSSL_ERR_RSA_PRIVATE_FAILED + POLARSSL_ERR_MPI_MALLOC_FAILED );
+
+    for( k = 0; k < n; k++ )
+        mpi_init( &M[k] );
+
+    T  = M;
+    T1 = M + count;
+    T2 = M + 2 * count;
+#if !defined(POLARSSL_RSA_NO_CRT)
+    C  = M + 3 * count;
+    Vi = M + 4 * count;
+    Vf = M + 5 * count;
+    mpi_init( &R );
+#endif
+
+    /*
+     * Inputs that are not smaller than N are replaced by 0, which keeps
+     * the rest of the batch going
+     */
+    for( k = 0; k < count; k++ )
+    {
+        result[k] = 0;
+
+        MPI_CHK( mpi_read_binary( &T[k], input[k], ctx->len ) );
+        if( mpi_cmp_mpi( &T[k], &ctx->N ) >= 0 )
+        {
+            result[k] = POLARSSL_ERR_RSA_BAD_INPUT_DATA;
+            MPI_CHK( mpi_lset( &T[k], 0 ) );
+        }
+    }
+
+#if defined(POLARSSL_RSA_NO_CRT)
+    ((void) f_rng);
+    ((void) p_rng);
+    MPI_CHK( mpi_exp_mod_batch( T, T, count, &ctx->D, &ctx->N, &ctx->RN ) );
+#else
+    if( f_rng != NULL )
+    {
+        /*
+         * Blinding, each operation taking the next of the context's pairs
+         * (see rsa_prepare_blinding()): in a batch larger than
+         * POLARSSL_RSA_BLINDING_SLOTS, a pair is used again after squaring
+         * T = T * Vi mod N
+         */
+        for( k = 0; k < count; k++ )
+        {
+            MPI_CHK( rsa_prepare_blinding( ctx, &Vi[k], &Vf[k],
+                                           f_rng, p_rng ) );
+            MPI_CHK( mpi_mul_mpi( &T[k], &T[k], &Vi[k] ) );
+            MPI_CHK( mpi_mod_mpi( &T[k], &T[k], &ctx->N ) );
+        }
+    }
+
+    if( ctx->others > 0 )
+        for( k = 0; k < count; k++ )
+            MPI_CHK( mpi_copy( &C[k], &T[k] ) );
+
+    /*
+     * CRT as in rsa_private(), each exponentiation for the whole batch
+     */
+    MPI_CHK( mpi_exp_mod_batch( T1, T, count, &ctx->DP, &ctx->P, &ctx->RP ) );
+    MPI_CHK( mpi_exp_mod_batch( T2, T, count, &ctx->DQ, &ctx->Q, &ctx->RQ ) );
+
+    for( k = 0; k < count; k++ )
+    {
+        MPI_CHK( mpi_sub_mpi( &T[k], &T1[k], &T2[k] ) );
+        MPI_CHK( mpi_mul_mpi( &T1[k], &T[k], &ctx->QP ) );
+        MPI_CHK( mpi_mod_mpi( &T[k], &T1[k], &ctx->P ) );
+        MPI_CHK( mpi_mul_mpi( &T1[k], &T[k], &ctx->Q ) );
+        MPI_CHK( mpi_add_mpi( &T[k], &T2[k], &T1[k] ) );
+    }
+
+    if( ctx->others > 0 )
+        MPI_CHK( mpi_mul_mpi( &R, &ctx->P, &ctx->Q ) );
+
+    for( i = 0; i < ctx->others; i++ )
+    {
+        MPI_CHK( mpi_exp_mod_batch( T1, C, count, &ctx->other[i].D,
+                                    &ctx->other[i].R, &ctx->other[i].RR ) );
+
+        for( k = 0; k < count; k++ )
+        {
+            MPI_CHK( mpi_sub_mpi( &T2[k], &T1[k], &T[k] ) );
+            MPI_CHK( mpi_mul_mpi( &T1[k], &T2[k], &ctx->other[i].T ) );
+            MPI_CHK( mpi_mod_mpi( &T2[k], &T1[k], &ctx->other[i].R ) );
+            MPI_CHK( mpi_mul_mpi( &T1[k], &T2[k], &R ) );
+            MPI_CHK( mpi_add_mpi( &T[k], &T[k], &T1[k] ) );
+        }
+
+        if( i + 1 < ctx->others )
+            MPI_CHK( mpi_mul_mpi( &R, &R, &ctx->other[i].R ) );
+    }
+
+    if( f_rng != NULL )
+    {
+        /*
+         * Unblind
+         * T = T * Vf mod N
+         */
+        for( k = 0; k < count; k++ )
+        {
+            MPI_CHK( mpi_mul_mpi( &T[k], &T[k], &Vf[k] ) );
+            MPI_CHK( mpi_mod_mpi( &T[k], &T[k], &ctx->N ) );
+        }
+    }
+#endif
+
+    for( k = 0; k < count; k++ )
+        if( result[k] == 0 )
+            MPI_CHK( mpi_write_binary( &T[k], output[k], ctx->len ) );
+
+cleanup:
+    for( k = 0; k < n; k++ )
+        mpi_free( &M[k] );
+    polarssl_free( M );
+#if !defined(POLARSSL_RSA_NO_CRT)
+    mpi_free( &R );
+#endif
+
+    if( ret != 0 )
+        return( POLARSSL_ERR_RSA_PRIVATE_FAILED + ret );
+
+    return( 0 );
+}
+
 #if defined(POLARSSL_PKCS1_V21)
 /**
  * Generate and apply the MGF1 operation (from PKCS#1 v2.1) to a buffer.
@@ -761,35 +1063,15 @@ int rsa_rsaes_oaep_decrypt( rsa_context *ctx,
 
 #if defined(POLARSSL_PKCS1_V15)
 /*
- * Implementation of the PKCS#1 v2.1 RSAES-PKCS1-V1_5-DECRYPT function
+ * Check and remove the EME-PKCS1-v1_5 padding of the ilen bytes in buf
  */
-int rsa_rsaes_pkcs1_v15_decrypt( rsa_context *ctx,
-                                 int (*f_rng)(void *, unsigned char *, size_t),
-                                 void *p_rng,
-                                 int mode, size_t *olen,
-                                 const unsigned char *input,
-                                 unsigned char *output,
-                                 size_t output_max_len)
+static int rsa_rsaes_pkcs1_v15_unpad( int mode, size_t ilen,
+                                      unsigned char *buf, size_t *olen,
+                                      unsigned char *output,
+                                      size_t output_max_len )
 {
-    int ret;
-    size_t ilen, pad_count = 0, i;
+    size_t pad_count = 0, i;
     unsigned char *p, bad, pad_done = 0;
-    unsigned char buf[POLARSSL_MPI_MAX_SIZE];
-
-    if( ctx->padding != RSA_PKCS_V15 )
-        return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
-
-    ilen = ctx->len;
-
-    if( ilen < 16 || ilen > sizeof( buf ) )
-        return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
-
-    ret = ( mode == RSA_PUBLIC )
-          ? rsa_public(  ctx, input, buf )
-          : rsa_private( ctx, f_rng, p_rng, input, buf );
-
-    if( ret != 0 )
-        return( ret );
 
     p = buf;
     bad = 0;
@@ -842,6 +1124,40 @@ int rsa_rsaes_pkcs1_v15_decrypt( rsa_context *ctx,
 
     return( 0 );
 }
+
+/*
+ * Implementation of the PKCS#1 v2.1 RSAES-PKCS1-V1_5-DECRYPT function
+ */
+int rsa_rsaes_pkcs1_v15_decrypt( rsa_context *ctx,
+                                 int (*f_rng)(void *, unsigned char *, size_t),
+                                 void *p_rng,
+                                 int mode, size_t *olen,
+                                 const unsigned char *input,
+                                 unsigned char *output,
+                                 size_t output_max_len)
+{
+    int ret;
+    size_t ilen;
+    unsigned char buf[POLARSSL_MPI_MAX_SIZE];
+
+    if( ctx->padding != RSA_PKCS_V15 )
+        return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
+
+    ilen = ctx->len;
+
+    if( ilen < 16 || ilen > sizeof( buf ) )
+        return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
+
+    ret = ( mode == RSA_PUBLIC )
+          ? rsa_public(  ctx, input, buf )
+          : rsa_private( ctx, f_rng, p_rng, input, buf );
+
+    if( ret != 0 )
+        return( ret );
+
+    return( rsa_rsaes_pkcs1_v15_unpad( mode, ilen, buf, olen,
+                                       output, output_max_len ) );
+}
 #endif /* POLARSSL_PKCS1_V15 */
 
 /*
@@ -976,16 +1292,13 @@ int rsa_rsassa_pss_sign( rsa_context *ctx,
  * Implementation of the PKCS#1 v2.1 RSASSA-PKCS1-V1_5-SIGN function
  */
 /*
- * Do an RSA operation to sign the message digest
+ * Encode the message digest with EMSA-PKCS1-v1_5 in sig
  */
-int rsa_rsassa_pkcs1_v15_sign( rsa_context *ctx,
-                               int (*f_rng)(void *, unsigned char *, size_t),
-                               void *p_rng,
-                               int mode,
-                               md_type_t md_alg,
-                               unsigned int hashlen,
-                               const unsigned char *hash,
-                               unsigned char *sig )
+static int rsa_rsassa_pkcs1_v15_encode( rsa_context *ctx,
+                                        md_type_t md_alg,
+                                        unsigned int hashlen,
+                                        const unsigned char *hash,
+                                        unsigned char *sig )
 {
     size_t nb_pad, olen, oid_size = 0;
     unsigned char *p = sig;
@@ -1052,6 +1365,27 @@ int rsa_rsassa_pkcs1_v15_sign( rsa_context *ctx,
         memcpy( p, hash, hashlen );
     }
 
+    return( 0 );
+}
+
+/*
+ * Do an RSA operation to sign the message digest
+ */
+int rsa_rsassa_pkcs1_v15_sign( rsa_context *ctx,
+                               int (*f_rng)(void *, unsigned char *, size_t),
+                               void *p_rng,
+                               int mode,
+                               md_type_t md_alg,
+                               unsigned int hashlen,
+                               const unsigned char *hash,
+                               unsigned char *sig )
+{
+    int ret;
+
+    if( ( ret = rsa_rsassa_pkcs1_v15_encode( ctx, md_alg, hashlen,
+                                             hash, sig ) ) != 0 )
+        return( ret );
+
     return( ( mode == RSA_PUBLIC )
             ? rsa_public(  ctx, sig, sig )
             : rsa_private( ctx, f_rng, p_rng, sig, sig ) );
@@ -1351,12 +1685,128 @@ int rsa_pkcs1_verify( rsa_context *ctx,
     }
 }
 
+/*
+ * Do several PKCS#1 private key operations with the same key
+ */
+int rsa_pkcs1_batch( rsa_context *ctx,
+                     int (*f_rng)(void *, unsigned char *, size_t),
+                     void *p_rng,
+                     rsa_batch_op *ops,
+                     size_t count )
+{
+    size_t k;
+#if defined(POLARSSL_PKCS1_V15)
+    int ret;
+    size_t ilen;
+    unsigned char *buf = NULL, **io = NULL;
+    int *result = NULL;
+#endif
+
+    if( count == 0 )
+        return( 0 );
+
+#if defined(POLARSSL_PKCS1_V15)
+    if( ctx->padding == RSA_PKCS_V15 )
+    {
+        ilen = ctx->len;
+
+        if( ilen < 16 || ilen > POLARSSL_MPI_MAX_SIZE )
+            return( POLARSSL_ERR_RSA_BAD_INPUT_DATA );
+
+        buf = (unsigned char *) polarssl_malloc( count * ilen );
+        io = (unsigned char **) polarssl_malloc( 2 * count * sizeof( *io ) );
+        result = (int *) polarssl_malloc( count * sizeof( int ) );
+
+        if( buf == NULL || io == NULL || result == NULL )
+        {
+            ret = POLARSSL_ERR_RSA_PRIVATE_FAILED + POLARSSL_ERR_MPI_MALLOC_FAILED;
+            goto cleanup;
+        }
+
+        /*
+         * Signatures are encoded and computed in place, decryptions go
+         * through buf. Operations that failed early compute 0 in buf.
+         */
+        memset( buf, 0, count * ilen );
+
+        for( k = 0; k < count; k++ )
+        {
+            io[k] = io[count + k] = buf + k * ilen;
+
+            if( ops[k].type == RSA_SIGN )
+            {
+                ops[k].ret = rsa_rsassa_pkcs1_v15_encode( ctx, ops[k].md_alg,
+                                ops[k].hashlen, ops[k].input, ops[k].output );
+                if( ops[k].ret == 0 )
+                    io[k] = io[count + k] = ops[k].output;
+            }
+            else if( ops[k].type == RSA_CRYPT )
+            {
+                ops[k].ret = 0;
+                io[k] = (unsigned char *) ops[k].input;
+            }
+            else
+                ops[k].ret = POLARSSL_ERR_RSA_BAD_INPUT_DATA;
+        }
+
+        if( ( ret = rsa_private_batch( ctx, f_rng, p_rng, count,
+                                       (const unsigned char * const *) io,
+                                       io + count, result ) ) != 0 )
+            goto cleanup;
+
+        for( k = 0; k < count; k++ )
+        {
+            if( ops[k].ret != 0 )
+                continue;
+
+            if( result[k] != 0 )
+                ops[k].ret = result[k];
+            else if( ops[k].type == RSA_CRYPT )
+                ops[k].ret = rsa_rsaes_pkcs1_v15_unpad( RSA_PRIVATE, ilen,
+                                 buf + k * ilen, &ops[k].olen,
+                                 ops[k].output, ops[k].output_max_len );
+        }
+
+cleanup:
+        if( buf != NULL )
+            memset( buf, 0, count * ilen );
+
+        polarssl_free( buf );
+        polarssl_free( io );
+        polarssl_free( result );
+
+        return( ret );
+    }
+#endif /* POLARSSL_PKCS1_V15 */
+
+    /*
+     * Other paddings: one operation after the other
+     */
+    for( k = 0; k < count; k++ )
+    {
+        if( ops[k].type == RSA_SIGN )
+            ops[k].ret = rsa_pkcs1_sign( ctx, f_rng, p_rng, RSA_PRIVATE,
+                                         ops[k].md_alg, ops[k].hashlen,
+                                         ops[k].input, ops[k].output );
+        else if( ops[k].type == RSA_CRYPT )
+            ops[k].ret = rsa_pkcs1_decrypt( ctx, f_rng, p_rng, RSA_PRIVATE,
+                                            &ops[k].olen, ops[k].input,
+                                            ops[k].output,
+                                            ops[k].output_max_len );
+        else
+            ops[k].ret = POLARSSL_ERR_RSA_BAD_INPUT_DATA;
+    }
+
+    return( 0 );
+}
+
 /*
  * Copy the components of an RSA key
  */
 int rsa_copy( rsa_context *dst, const rsa_context *src )
 {
     int ret;
+    size_t i;
 
     dst->ver = src->ver;
     dst->len = src->len;
@@ -1375,9 +1825,22 @@ int rsa_copy( rsa_context *dst, const rsa_context *src )
     MPI_CHK( mpi_copy( &dst->RP, &src->RP ) );
     MPI_CHK( mpi_copy( &dst->RQ, &src->RQ ) );
 
+    dst->others = src->others;
+
+    for( i = 0; i < src->others; i++ )
+    {
+        MPI_CHK( mpi_copy( &dst->other[i].R, &src->other[i].R ) );
+        MPI_CHK( mpi_copy( &dst->other[i].D, &src->other[i].D ) );
+        MPI_CHK( mpi_copy( &dst->other[i].T, &src->other[i].T ) );
+        MPI_CHK( mpi_copy( &dst->other[i].RR, &src->other[i].RR ) );
+    }
+
 #if !defined(POLARSSL_RSA_NO_CRT)
-    MPI_CHK( mpi_copy( &dst->Vi, &src->Vi ) );
-    MPI_CHK( mpi_copy( &dst->Vf, &src->Vf ) );
+    for( i = 0; i < POLARSSL_RSA_BLINDING_SLOTS; i++ )
+    {
+        MPI_CHK( mpi_copy( &dst->blinding[i].Vi, &src->blinding[i].Vi ) );
+        MPI_CHK( mpi_copy( &dst->blinding[i].Vf, &src->blinding[i].Vf ) );
+    }
 #endif
 
     dst->padding = src->padding;
@@ -1395,9 +1858,24 @@ cleanup:
  */
 void rsa_free( rsa_context *ctx )
 {
+    size_t i;
+
 #if !defined(POLARSSL_RSA_NO_CRT)
-    mpi_free( &ctx->Vi ); mpi_free( &ctx->Vf );
+    for( i = 0; i < POLARSSL_RSA_BLINDING_SLOTS; i++ )
+    {
+        mpi_free( &ctx->blinding[i].Vi ); mpi_free( &ctx->blinding[i].Vf );
+#if defined(POLARSSL_THREADING_C)
+        polarssl_mutex_free( &ctx->blinding[i].mutex );
+#endif
+    }
 #endif
+
+    for( i = 0; i < POLARSSL_RSA_MAX_PRIMES - 2; i++ )
+    {
+        mpi_free( &ctx->other[i].RR ); mpi_free( &ctx->other[i].T );
+        mpi_free( &ctx->other[i].D  ); mpi_free( &ctx->other[i].R );
+    }
+
     mpi_free( &ctx->RQ ); mpi_free( &ctx->RP ); mpi_free( &ctx->RN );
     mpi_free( &ctx->QP ); mpi_free( &ctx->DQ ); mpi_free( &ctx->DP );
     mpi_free( &ctx->Q  ); mpi_free( &ctx->P  ); mpi_free( &ctx->D );
@@ -25,6 +25,9 @@
 /*
  * These session callbacks use a simple chained list
  * to store and retrieve the session information.
+ *
+ * The sharded variant hashes session IDs to several independently
+ * locked shards, each holding a hash table and an LRU list.
  */
 
 #include "polarssl/config.h"
@@ -42,6 +45,91 @@
 
 #include <stdlib.h>
 
+/*
+ * Restore the cached data of entry into session
+ */
+static int ssl_cache_entry_restore( const ssl_cache_entry *entry,
+                                    ssl_session *session )
+{
+    memcpy( session->master, entry->session.master, 48 );
+
+    session->verify_result = entry->session.verify_result;
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+    /*
+     * Restore peer certificate (without rest of the original chain)
+     */
+    if( entry->peer_cert.p != NULL )
+    {
+        session->peer_cert = (x509_crt *) polarssl_malloc( sizeof(x509_crt) );
+        if( session->peer_cert == NULL )
+            return( 1 );
+
+        x509_crt_init( session->peer_cert );
+        if( x509_crt_parse( session->peer_cert, entry->peer_cert.p,
+                            entry->peer_cert.len ) != 0 )
+        {
+            polarssl_free( session->peer_cert );
+            session->peer_cert = NULL;
+            return( 1 );
+        }
+    }
+#endif /* POLARSSL_X509_CRT_PARSE_C */
+
+    return( 0 );
+}
+
+/*
+ * Copy session into entry, replacing any previously stored data
+ */
+static int ssl_cache_entry_store( ssl_cache_entry *entry,
+                                  const ssl_session *session )
+{
+    memcpy( &entry->session, session, sizeof( ssl_session ) );
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+    /*
+     * If we're reusing an entry, free its certificate first
+     */
+    if( entry->peer_cert.p != NULL )
+    {
+        polarssl_free( entry->peer_cert.p );
+        memset( &entry->peer_cert, 0, sizeof(x509_buf) );
+    }
+
+    /*
+     * Store peer certificate
+     */
+    if( session->peer_cert != NULL )
+    {
+        entry->peer_cert.p = (unsigned char *) polarssl_malloc( session->peer_cert->raw.len );
+        if( entry->peer_cert.p == NULL )
+            return( 1 );
+
+        memcpy( entry->peer_cert.p, session->peer_cert->raw.p,
+                session->peer_cert->raw.len );
+        entry->peer_cert.len = session->peer_cert->raw.len;
+
+        entry->session.peer_cert = NULL;
+    }
+#endif /* POLARSSL_X509_CRT_PARSE_C */
+
+    return( 0 );
+}
+
+/*
+ * Free the data referenced by entry (but not entry itself)
+ */
+static void ssl_cache_entry_free( ssl_cache_entry *entry )
+{
+    ssl_session_free( &entry->session );
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+    if( entry->peer_cert.p != NULL )
+        polarssl_free( entry->peer_cert.p );
+#endif /* POLARSSL_X509_CRT_PARSE_C */
+}
+
 void ssl_cache_init( ssl_cache_context *cache )
 {
     memset( cache, 0, sizeof( ssl_cache_context ) );
@@ -91,34 +179,11 @@ int ssl_cache_get( void *data, ssl_session *session )
                     entry->session.length ) != 0 )
             continue;
 
-        memcpy( session->master, entry->session.master, 48 );
-
-        session->verify_result = entry->session.verify_result;
-
-#if defined(POLARSSL_X509_CRT_PARSE_C)
-        /*
-         * Restore peer certificate (without rest of the original chain)
-         */
-        if( entry->peer_cert.p != NULL )
+        if( ssl_cache_entry_restore( entry, session ) != 0 )
         {
-            session->peer_cert = (x509_crt *) polarssl_malloc( sizeof(x509_crt) );
-            if( session->peer_cert == NULL )
-            {
-                ret = 1;
-                goto exit;
-            }
-
-            x509_crt_init( session->peer_cert );
-            if( x509_crt_parse( session->peer_cert, entry->peer_cert.p,
-                                entry->peer_cert.len ) != 0 )
-            {
-                polarssl_free( session->peer_cert );
-                session->peer_cert = NULL;
-                ret = 1;
-                goto exit;
-            }
+            ret = 1;
+            goto exit;
         }
-#endif /* POLARSSL_X509_CRT_PARSE_C */
 
         ret = 0;
         goto exit;
@@ -240,37 +305,11 @@ int ssl_cache_set( void *data, const ssl_session *session )
 #endif
     }
 
-    memcpy( &cur->session, session, sizeof( ssl_session ) );
-
-#if defined(POLARSSL_X509_CRT_PARSE_C)
-    /*
-     * If we're reusing an entry, free its certificate first
-     */
-    if( cur->peer_cert.p != NULL )
-    {
-        polarssl_free( cur->peer_cert.p );
-        memset( &cur->peer_cert, 0, sizeof(x509_buf) );
-    }
-
-    /*
-     * Store peer certificate
-     */
-    if( session->peer_cert != NULL )
+    if( ssl_cache_entry_store( cur, session ) != 0 )
     {
-        cur->peer_cert.p = (unsigned char *) polarssl_malloc( session->peer_cert->raw.len );
-        if( cur->peer_cert.p == NULL )
-        {
-            ret = 1;
-            goto exit;
-        }
-
-        memcpy( cur->peer_cert.p, session->peer_cert->raw.p,
-                session->peer_cert->raw.len );
-        cur->peer_cert.len = session->peer_cert->raw.len;
-
-        cur->session.peer_cert = NULL;
+        ret = 1;
+        goto exit;
     }
-#endif /* POLARSSL_X509_CRT_PARSE_C */
 
     ret = 0;
 
@@ -310,13 +349,7 @@ void ssl_cache_free( ssl_cache_context *cache )
         prv = cur;
         cur = cur->next;
 
-        ssl_session_free( &prv->session );
-
-#if defined(POLARSSL_X509_CRT_PARSE_C)
-        if( prv->peer_cert.p != NULL )
-            polarssl_free( prv->peer_cert.p );
-#endif /* POLARSSL_X509_CRT_PARSE_C */
-
+        ssl_cache_entry_free( prv );
         polarssl_free( prv );
     }
 
@@ -325,4 +358,420 @@ void ssl_cache_free( ssl_cache_context *cache )
 #endif
 }
 
+/*
+ * Sharded cache implementation
+ */
+
+/*
+ * FNV-1a hash of a session ID, with a final avalanche step so that the
+ * low bits used for shard and bucket selection depend on every byte
+ */
+static uint32_t ssl_cache_hash( const unsigned char *id, size_t len )
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        h ^= id[i];
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return( h );
+}
+
+static unsigned int ssl_cache_round_pow2( unsigned int n )
+{
+    unsigned int p = 1;
+
+    while( p < n && p < 0x80000000u )
+        p <<= 1;
+
+    return( p );
+}
+
+static void ssl_cache_shard_locate( const ssl_cache_sharded_context *cache,
+                                    const unsigned char *id, size_t len,
+                                    ssl_cache_shard **shard,
+                                    ssl_cache_sharded_entry ***bucket )
+{
+    uint32_t h = ssl_cache_hash( id, len );
+
+    *shard = &cache->shards[h & ( cache->shard_count - 1 )];
+    *bucket = &(*shard)->buckets[( h / cache->shard_count ) &
+                                 ( cache->bucket_count - 1 )];
+}
+
+/*
+ * Find the entry with the given session id in a bucket
+ */
+static ssl_cache_sharded_entry *ssl_cache_bucket_find(
+                                            ssl_cache_sharded_entry *cur,
+                                            const unsigned char *id,
+                                            size_t len )
+{
+    while( cur != NULL )
+    {
+        if( cur->entry.session.length == len &&
+            memcmp( cur->entry.session.id, id, len ) == 0 )
+            return( cur );
+
+        cur = cur->hnext;
+    }
+
+    return( NULL );
+}
+
+static void ssl_cache_lru_unlink( ssl_cache_shard *shard,
+                                  ssl_cache_sharded_entry *cur )
+{
+    if( cur->lru_prev != NULL )
+        cur->lru_prev->lru_next = cur->lru_next;
+    else
+        shard->lru_head = cur->lru_next;
+
+    if( cur->lru_next != NULL )
+        cur->lru_next->lru_prev = cur->lru_prev;
+    else
+        shard->lru_tail = cur->lru_prev;
+
+    cur->lru_prev = NULL;
+    cur->lru_next = NULL;
+}
+
+static void ssl_cache_lru_push( ssl_cache_shard *shard,
+                                ssl_cache_sharded_entry *cur )
+{
+    cur->lru_prev = NULL;
+    cur->lru_next = shard->lru_head;
+
+    if( shard->lru_head != NULL )
+        shard->lru_head->lru_prev = cur;
+    else
+        shard->lru_tail = cur;
+
+    shard->lru_head = cur;
+}
+
+/*
+ * Unlink an entry from its hash bucket and from the LRU list
+ */
+static void ssl_cache_shard_unlink( const ssl_cache_sharded_context *cache,
+                                    ssl_cache_shard *shard,
+                                    ssl_cache_sharded_entry *cur )
+{
+    ssl_cache_shard *owner;
+    ssl_cache_sharded_entry **bucket;
+
+    ssl_cache_shard_locate( cache, cur->entry.session.id,
+                            cur->entry.session.length, &owner, &bucket );
+
+    while( *bucket != NULL && *bucket != cur )
+        bucket = &(*bucket)->hnext;
+
+    if( *bucket != NULL )
+        *bucket = cur->hnext;
+
+    cur->hnext = NULL;
+
+    ssl_cache_lru_unlink( shard, cur );
+    shard->entries--;
+}
+
+static void ssl_cache_shard_remove( const ssl_cache_sharded_context *cache,
+                                    ssl_cache_shard *shard,
+                                    ssl_cache_sharded_entry *cur )
+{
+    ssl_cache_shard_unlink( cache, shard, cur );
+    ssl_cache_entry_free( &cur->entry );
+    polarssl_free( cur );
+}
+
+/*
+ * Share of max_entries held by a shard: the remainder of the division goes
+ * to the first shards, so that the limits add up to max_entries
+ */
+static int ssl_cache_shard_max_entries( const ssl_cache_sharded_context *cache,
+                                        const ssl_cache_shard *shard )
+{
+    int n = (int) cache->shard_count;
+    int i = (int) ( shard - cache->shards );
+
+    return( cache->max_entries / n + ( i < cache->max_entries % n ) );
+}
+
+#if defined(POLARSSL_HAVE_TIME)
+static int ssl_cache_sharded_expired( const ssl_cache_sharded_context *cache,
+                                      const ssl_cache_sharded_entry *cur,
+                                      time_t t )
+{
+    return( cache->timeout != 0 &&
+            (int) ( t - cur->entry.timestamp ) > cache->timeout );
+}
+#endif /* POLARSSL_HAVE_TIME */
+
+int ssl_cache_sharded_init( ssl_cache_sharded_context *cache,
+                            unsigned int shards, unsigned int buckets )
+{
+    unsigned int i;
+
+    memset( cache, 0, sizeof( ssl_cache_sharded_context ) );
+
+    cache->timeout = SSL_CACHE_DEFAULT_TIMEOUT;
+    cache->max_entries = SSL_CACHE_DEFAULT_MAX_ENTRIES;
+    cache->shard_count = ssl_cache_round_pow2(
+                            shards != 0 ? shards : SSL_CACHE_DEFAULT_SHARDS );
+    cache->bucket_count = ssl_cache_round_pow2(
+                            buckets != 0 ? buckets : SSL_CACHE_DEFAULT_BUCKETS );
+
+    cache->shards = (ssl_cache_shard *) polarssl_malloc(
+                            cache->shard_count * sizeof( ssl_cache_shard ) );
+    if( cache->shards == NULL )
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+
+    memset( cache->shards, 0, cache->shard_count * sizeof( ssl_cache_shard ) );
+
+    for( i = 0; i < cache->shard_count; i++ )
+    {
+        cache->shards[i].buckets = (ssl_cache_sharded_entry **)
+            polarssl_malloc( cache->bucket_count *
+                             sizeof( ssl_cache_sharded_entry * ) );
+
+        if( cache->shards[i].buckets == NULL )
+        {
+            cache->shard_count = i;
+            ssl_cache_sharded_free( cache );
+            return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+        }
+
+        memset( cache->shards[i].buckets, 0,
+                cache->bucket_count * sizeof( ssl_cache_sharded_entry * ) );
+
+#if defined(POLARSSL_THREADING_C)
+        polarssl_mutex_init( &cache->shards[i].mutex );
+#endif
+    }
+
+    return( 0 );
+}
+
+int ssl_cache_sharded_get( void *data, ssl_session *session )
+{
+    int ret = 1;
+#if defined(POLARSSL_HAVE_TIME)
+    time_t t = time( NULL );
+#endif
+    ssl_cache_sharded_context *cache = (ssl_cache_sharded_context *) data;
+    ssl_cache_shard *shard;
+    ssl_cache_sharded_entry **bucket, *cur;
+
+    if( cache->shards == NULL || session->length > sizeof( session->id ) )
+        return( 1 );
+
+    ssl_cache_shard_locate( cache, session->id, session->length,
+                            &shard, &bucket );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &shard->mutex ) != 0 )
+        return( 1 );
+#endif
+
+    cur = ssl_cache_bucket_find( *bucket, session->id, session->length );
+    if( cur == NULL )
+        goto exit;
+
+#if defined(POLARSSL_HAVE_TIME)
+    if( ssl_cache_sharded_expired( cache, cur, t ) )
+    {
+        ssl_cache_shard_remove( cache, shard, cur );
+        goto exit;
+    }
+#endif
+
+    if( session->ciphersuite != cur->entry.session.ciphersuite ||
+        session->compression != cur->entry.session.compression )
+        goto exit;
+
+    if( ssl_cache_entry_restore( &cur->entry, session ) != 0 )
+        goto exit;
+
+    ssl_cache_lru_unlink( shard, cur );
+    ssl_cache_lru_push( shard, cur );
+
+    ret = 0;
+
+exit:
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &shard->mutex ) != 0 )
+        ret = 1;
+#endif
+
+    return( ret );
+}
+
+int ssl_cache_sharded_set( void *data, const ssl_session *session )
+{
+    int ret = 1;
+#if defined(POLARSSL_HAVE_TIME)
+    time_t t = time( NULL );
+#endif
+    ssl_cache_sharded_context *cache = (ssl_cache_sharded_context *) data;
+    ssl_cache_shard *shard;
+    ssl_cache_sharded_entry **bucket, *cur;
+    int max_entries;
+
+    if( cache->shards == NULL || session->length > sizeof( session->id ) )
+        return( 1 );
+
+    ssl_cache_shard_locate( cache, session->id, session->length,
+                            &shard, &bucket );
+
+    max_entries = ssl_cache_shard_max_entries( cache, shard );
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &shard->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    cur = ssl_cache_bucket_find( *bucket, session->id, session->length );
+
+    if( cur != NULL )
+    {
+        /* client reconnected, keep timestamp for session id */
+        ssl_cache_lru_unlink( shard, cur );
+        ssl_cache_lru_push( shard, cur );
+    }
+    else
+    {
+#if defined(POLARSSL_HAVE_TIME)
+        /*
+         * Drop expired entries from the cold end of the LRU list
+         */
+        while( shard->lru_tail != NULL &&
+               ssl_cache_sharded_expired( cache, shard->lru_tail, t ) )
+        {
+            ssl_cache_shard_remove( cache, shard, shard->lru_tail );
+        }
+#endif
+
+        if( shard->entries >= max_entries )
+        {
+            /*
+             * Reuse least recently used entry if max_entries reached
+             */
+            if( shard->lru_tail == NULL )
+            {
+                ret = 1;
+                goto exit;
+            }
+
+            cur = shard->lru_tail;
+            ssl_cache_shard_unlink( cache, shard, cur );
+        }
+        else
+        {
+            /*
+             * max_entries not reached, create new entry
+             */
+            cur = (ssl_cache_sharded_entry *) polarssl_malloc(
+                                        sizeof( ssl_cache_sharded_entry ) );
+            if( cur == NULL )
+            {
+                ret = 1;
+                goto exit;
+            }
+
+            memset( cur, 0, sizeof( ssl_cache_sharded_entry ) );
+        }
+
+        /*
+         * Session id is needed for the bucket link, store it first
+         */
+        cur->entry.session.length = session->length;
+        memcpy( cur->entry.session.id, session->id, session->length );
+
+#if defined(POLARSSL_HAVE_TIME)
+        cur->entry.timestamp = t;
+#endif
+
+        cur->hnext = *bucket;
+        *bucket = cur;
+        ssl_cache_lru_push( shard, cur );
+        shard->entries++;
+    }
+
+    if( ssl_cache_entry_store( &cur->entry, session ) != 0 )
+    {
+        ret = 1;
+        goto exit;
+    }
+
+    ret = 0;
+
+exit:
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &shard->mutex ) != 0 )
+        ret = 1;
+#endif
+
+    return( ret );
+}
+
+#if defined(POLARSSL_HAVE_TIME)
+void ssl_cache_sharded_set_timeout( ssl_cache_sharded_context *cache,
+                                    int timeout )
+{
+    if( timeout < 0 ) timeout = 0;
+
+    cache->timeout = timeout;
+}
+#endif /* POLARSSL_HAVE_TIME */
+
+void ssl_cache_sharded_set_max_entries( ssl_cache_sharded_context *cache,
+                                        int max )
+{
+    if( max < 0 ) max = 0;
+
+    cache->max_entries = max;
+}
+
+void ssl_cache_sharded_free( ssl_cache_sharded_context *cache )
+{
+    unsigned int i;
+    ssl_cache_sharded_entry *cur, *prv;
+
+    if( cache->shards == NULL )
+        return;
+
+    for( i = 0; i < cache->shard_count; i++ )
+    {
+        cur = cache->shards[i].lru_head;
+
+        while( cur != NULL )
+        {
+            prv = cur;
+            cur = cur->lru_next;
+
+            ssl_cache_entry_free( &prv->entry );
+            polarssl_free( prv );
+        }
+
+        polarssl_free( cache->shards[i].buckets );
+
+#if defined(POLARSSL_THREADING_C)
+        polarssl_mutex_free( &cache->shards[i].mutex );
+#endif
+    }
+
+    polarssl_free( cache->shards );
+
+    memset( cache, 0, sizeof( ssl_cache_sharded_context ) );
+}
+
 #endif /* POLARSSL_SSL_CACHE_C */
@@ -730,6 +730,8 @@ static int ssl_parse_max_fragment_length_ext( ssl_context *ssl,
         return( POLARSSL_ERR_SSL_BAD_HS_SERVER_HELLO );
     }
 
+    ssl->session_negotiate->mfl_code = buf[0];
+
     return( 0 );
 }
 #endif /* POLARSSL_SSL_MAX_FRAGMENT_LENGTH */
@@ -1376,7 +1378,7 @@ static int ssl_write_encrypted_pms( ssl_context *ssl,
     if( ( ret = pk_encrypt( &ssl->session_negotiate->peer_cert->pk,
                             p, ssl->handshake->pmslen,
                             ssl->out_msg + offset + len_bytes, olen,
-                            SSL_MAX_CONTENT_LEN - offset - len_bytes,
+                            ssl->out_content_len - offset - len_bytes,
                             ssl->f_rng, ssl->p_rng ) ) != 0 )
     {
         SSL_DEBUG_RET( 1, "rsa_pkcs1_encrypt", ret );
@@ -2157,7 +2159,7 @@ static int ssl_write_client_key_exchange( ssl_context *ssl )
              * ClientECDiffieHellmanPublic public;
              */
             ret = ecdh_make_public( &ssl->handshake->ecdh_ctx, &n,
-                    &ssl->out_msg[i], SSL_MAX_CONTENT_LEN - i,
+                    &ssl->out_msg[i], ssl->out_content_len - i,
                     ssl->f_rng, ssl->p_rng );
             if( ret != 0 )
             {
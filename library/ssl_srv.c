@@ -178,21 +178,19 @@ static int ssl_write_ticket( ssl_context *ssl, size_t *tlen )
     unsigned char *state;
     unsigned char iv[16];
     size_t clear_len, enc_len, pad_len, i;
+    ssl_ticket_key_store *store = ssl->ticket_store;
+    ssl_ticket_keys tkeys;
+    aes_context aes;
 
     *tlen = 0;
 
-    if( ssl->ticket_keys == NULL )
+    if( store == NULL )
         return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
 
-    /* Write key name */
-    memcpy( p, ssl->ticket_keys->key_name, 16 );
-    p += 16;
-
     /* Generate and write IV (with a copy for aes_crypt) */
-    if( ( ret = ssl->f_rng( ssl->p_rng, p, 16 ) ) != 0 )
+    if( ( ret = ssl->f_rng( ssl->p_rng, start + 16, 16 ) ) != 0 )
         return( ret );
-    memcpy( iv, p, 16 );
-    p += 16;
+    memcpy( iv, start + 16, 16 );
 
     /*
      * Dump session state
@@ -200,9 +198,9 @@ static int ssl_write_ticket( ssl_context *ssl, size_t *tlen )
      * After the session state itself, we still need room for 16 bytes of
      * padding and 32 bytes of MAC, so there's only so much room left
      */
-    state = p + 2;
+    state = start + 34;
     if( ssl_save_session( ssl->session_negotiate, state,
-                          SSL_MAX_CONTENT_LEN - (state - ssl->out_ctr) - 48,
+                          ssl->out_content_len - (state - ssl->out_ctr) - 48,
                           &clear_len ) != 0 )
     {
         return( POLARSSL_ERR_SSL_CERTIFICATE_TOO_LARGE );
@@ -215,11 +213,40 @@ static int ssl_write_ticket( ssl_context *ssl, size_t *tlen )
     for( i = clear_len; i < enc_len; i++ )
         state[i] = (unsigned char) pad_len;
 
+    /*
+     * Only take a copy of the active keys under the store mutex, so that
+     * contexts sharing the store do not wait for each other's crypto
+     */
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &store->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    /* Rotate keys if they are due */
+    if( ( ret = ssl_ticket_store_refresh( store ) ) == 0 )
+        memcpy( &tkeys, &store->keys[store->active], sizeof( ssl_ticket_keys ) );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &store->mutex ) != 0 && ret == 0 )
+        ret = POLARSSL_ERR_THREADING_MUTEX_ERROR;
+#endif
+
+    if( ret != 0 )
+    {
+        memset( &tkeys, 0, sizeof( ssl_ticket_keys ) );
+        return( ret );
+    }
+
+    /* Write key name */
+    memcpy( p, tkeys.key_name, 16 );
+    p += 16 + 16;
+
     /* Encrypt */
-    if( ( ret = aes_crypt_cbc( &ssl->ticket_keys->enc, AES_ENCRYPT,
+    if( ( ret = aes_setkey_enc( &aes, tkeys.aes_key, 128 ) ) != 0 ||
+        ( ret = aes_crypt_cbc( &aes, AES_ENCRYPT,
                                enc_len, iv, state, state ) ) != 0 )
     {
-        return( ret );
+        goto exit;
     }
 
     /* Write length */
@@ -228,11 +255,18 @@ static int ssl_write_ticket( ssl_context *ssl, size_t *tlen )
     p = state + enc_len;
 
     /* Compute and write MAC( key_name + iv + enc_state_len + enc_state ) */
-    sha256_hmac( ssl->ticket_keys->mac_key, 16, start, p - start, p, 0 );
+    sha256_hmac( tkeys.mac_key, 16, start, p - start, p, 0 );
     p += 32;
 
     *tlen = p - start;
 
+exit:
+    memset( &tkeys, 0, sizeof( ssl_ticket_keys ) );
+    memset( &aes, 0, sizeof( aes_context ) );
+
+    if( ret != 0 )
+        return( ret );
+
     SSL_DEBUG_BUF( 3, "session ticket structure", start, *tlen );
 
     return( 0 );
@@ -255,10 +289,14 @@ static int ssl_parse_ticket( ssl_context *ssl,
     unsigned char computed_mac[32];
     size_t enc_len, clear_len, i;
     unsigned char pad_len, diff;
+    ssl_ticket_key_store *store = ssl->ticket_store;
+    ssl_ticket_keys tkeys;
+    aes_context aes;
+    int j;
 
     SSL_DEBUG_BUF( 3, "session ticket structure", buf, len );
 
-    if( len < 34 || ssl->ticket_keys == NULL )
+    if( len < 34 || store == NULL )
         return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
 
     enc_len = ( enc_len_p[0] << 8 ) | enc_len_p[1];
@@ -267,14 +305,43 @@ static int ssl_parse_ticket( ssl_context *ssl,
     if( len != enc_len + 66 )
         return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
 
-    /* Check name, in constant time though it's not a big secret */
-    diff = 0;
-    for( i = 0; i < 16; i++ )
-        diff |= key_name[i] ^ ssl->ticket_keys->key_name[i];
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &store->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    /*
+     * Select keys by name, newest first, comparing in constant time
+     * though it's not a big secret. If no name matches, use the active
+     * keys anyway and check the MAC before failing.
+     * Only take a copy of the keys under the store mutex.
+     */
+    diff = 1;
+    for( j = 0; j < store->count; j++ )
+    {
+        ssl_ticket_keys *cur = &store->keys[( store->active - j +
+                                 SSL_TICKET_MAX_KEYS ) % SSL_TICKET_MAX_KEYS];
+
+        if( diff != 0 && safer_memcmp( key_name, cur->key_name, 16 ) == 0 )
+        {
+            memcpy( &tkeys, cur, sizeof( ssl_ticket_keys ) );
+            diff = 0;
+        }
+    }
+    if( diff != 0 )
+        memcpy( &tkeys, &store->keys[store->active], sizeof( ssl_ticket_keys ) );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &store->mutex ) != 0 )
+    {
+        memset( &tkeys, 0, sizeof( ssl_ticket_keys ) );
+        return( POLARSSL_ERR_THREADING_MUTEX_ERROR );
+    }
+#endif
     /* don't return yet, check the MAC anyway */
 
     /* Check mac, with constant-time buffer comparison */
-    sha256_hmac( ssl->ticket_keys->mac_key, 16, buf, len - 32,
+    sha256_hmac( tkeys.mac_key, 16, buf, len - 32,
                  computed_mac, 0 );
 
     for( i = 0; i < 32; i++ )
@@ -283,15 +350,22 @@ static int ssl_parse_ticket( ssl_context *ssl,
     /* Now return if ticket is not authentic, since we want to avoid
      * decrypting arbitrary attacker-chosen data */
     if( diff != 0 )
-        return( POLARSSL_ERR_SSL_INVALID_MAC );
-
-    /* Decrypt */
-    if( ( ret = aes_crypt_cbc( &ssl->ticket_keys->dec, AES_DECRYPT,
-                               enc_len, iv, ticket, ticket ) ) != 0 )
+        ret = POLARSSL_ERR_SSL_INVALID_MAC;
+    else
     {
-        return( ret );
+        /* Decrypt */
+        if( ( ret = aes_setkey_dec( &aes, tkeys.aes_key, 128 ) ) == 0 )
+            ret = aes_crypt_cbc( &aes, AES_DECRYPT,
+                                 enc_len, iv, ticket, ticket );
+
+        memset( &aes, 0, sizeof( aes_context ) );
     }
 
+    memset( &tkeys, 0, sizeof( ssl_ticket_keys ) );
+
+    if( ret != 0 )
+        return( ret );
+
     /* Check PKCS padding */
     pad_len = ticket[enc_len - 1];
 
@@ -2075,7 +2149,9 @@ static int ssl_write_certificate_request( ssl_context *ssl )
     total_dn_size = 0;
     while( crt != NULL )
     {
-        if( p - buf > 4096 )
+        if( p - buf > 4096 ||
+            (size_t)( p - buf ) + 2 + crt->subject_raw.len >
+            ssl->out_content_len )
             break;
 
         dn_size = crt->subject_raw.len;
@@ -2132,6 +2208,71 @@ static int ssl_get_ecdh_params_from_cert( ssl_context *ssl )
 #endif /* POLARSSL_KEY_EXCHANGE_ECDH_RSA_ENABLED) ||
           POLARSSL_KEY_EXCHANGE_ECDH_ECDSA_ENABLED */
 
+/*
+ * Send the ServerKeyExchange message of n bytes after the header
+ */
+static int ssl_write_server_key_exchange_msg( ssl_context *ssl, size_t n )
+{
+    int ret;
+
+    ssl->out_msglen  = 4 + n;
+    ssl->out_msgtype = SSL_MSG_HANDSHAKE;
+    ssl->out_msg[0]  = SSL_HS_SERVER_KEY_EXCHANGE;
+
+    ssl->state++;
+
+    if( ( ret = ssl_write_record( ssl ) ) != 0 )
+    {
+        SSL_DEBUG_RET( 1, "ssl_write_record", ret );
+        return( ret );
+    }
+
+    SSL_DEBUG_MSG( 2, ( "<= write server key exchange" ) );
+
+    return( 0 );
+}
+
+#if defined(POLARSSL_KEY_EXCHANGE_DHE_RSA_ENABLED) ||                       \
+    defined(POLARSSL_KEY_EXCHANGE_ECDHE_RSA_ENABLED) ||                     \
+    defined(POLARSSL_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED)
+/*
+ * Finish a ServerKeyExchange whose signature was done out of line:
+ * the parameters are still in out_msg, the signature follows them
+ */
+static int ssl_resume_server_key_exchange( ssl_context *ssl )
+{
+    int ret = ssl->handshake->priv_op_ret;
+    size_t n = ssl->handshake->priv_op_offset;
+    size_t signature_len = ssl->handshake->priv_op_len;
+    unsigned char *p = ssl->out_msg + 4 + n;
+
+    ssl->handshake->priv_op_state = SSL_PRIV_OP_NONE;
+
+    if( ret != 0 )
+    {
+        SSL_DEBUG_RET( 1, "pending signature", ret );
+        return( ret );
+    }
+
+    SSL_DEBUG_MSG( 3, ( "pending signature done" ) );
+
+    if( signature_len > ssl->handshake->priv_op_out_max )
+    {
+        SSL_DEBUG_MSG( 1, ( "signature too long" ) );
+        return( POLARSSL_ERR_SSL_INTERNAL_ERROR );
+    }
+
+    *(p++) = (unsigned char)( signature_len >> 8 );
+    *(p++) = (unsigned char)( signature_len      );
+
+    SSL_DEBUG_BUF( 3, "my signature", p, signature_len );
+
+    return( ssl_write_server_key_exchange_msg( ssl, n + 2 + signature_len ) );
+}
+#endif /* POLARSSL_KEY_EXCHANGE_DHE_RSA_ENABLED ||
+          POLARSSL_KEY_EXCHANGE_ECDHE_RSA_ENABLED ||
+          POLARSSL_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED */
+
 static int ssl_write_server_key_exchange( ssl_context *ssl )
 {
     int ret;
@@ -2153,6 +2294,20 @@ static int ssl_write_server_key_exchange( ssl_context *ssl )
 
     SSL_DEBUG_MSG( 2, ( "=> write server key exchange" ) );
 
+#if defined(POLARSSL_KEY_EXCHANGE_DHE_RSA_ENABLED) ||                       \
+    defined(POLARSSL_KEY_EXCHANGE_ECDHE_RSA_ENABLED) ||                     \
+    defined(POLARSSL_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED)
+    ret = ssl_priv_op_state( ssl );
+    if( ret == SSL_PRIV_OP_QUEUED || ret == SSL_PRIV_OP_ASYNC )
+    {
+        SSL_DEBUG_MSG( 2, ( "<= write server key exchange (pending)" ) );
+        return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+    }
+
+    if( ret == SSL_PRIV_OP_DONE )
+        return( ssl_resume_server_key_exchange( ssl ) );
+#endif
+
 #if defined(POLARSSL_KEY_EXCHANGE_RSA_ENABLED) ||                           \
     defined(POLARSSL_KEY_EXCHANGE_PSK_ENABLED) ||                           \
     defined(POLARSSL_KEY_EXCHANGE_RSA_PSK_ENABLED)
@@ -2281,7 +2436,7 @@ curve_matching_done:
         }
 
         if( ( ret = ecdh_make_params( &ssl->handshake->ecdh_ctx, &len,
-                                      p, SSL_MAX_CONTENT_LEN - n,
+                                      p, ssl->out_content_len - n,
                                       ssl->f_rng, ssl->p_rng ) ) != 0 )
         {
             SSL_DEBUG_RET( 1, "ecdh_make_params", ret );
@@ -2441,6 +2596,57 @@ curve_matching_done:
         }
 #endif /* POLARSSL_SSL_PROTO_TLS1_2 */
 
+        ssl->handshake->priv_op_offset = n;
+        ssl->handshake->priv_op_out = p + 2;
+        ssl->handshake->priv_op_out_max = ssl->out_content_len - 4 - n - 2;
+        memcpy( ssl->handshake->priv_op_hash, hash, sizeof( hash ) );
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+        if( ssl->f_async_sign != NULL )
+        {
+            ret = ssl->f_async_sign( ssl->p_async, ssl, ssl_own_key( ssl ),
+                                     md_alg, ssl->handshake->priv_op_hash,
+                                     hashlen != 0 ? hashlen :
+                        (unsigned int) ( md_info_from_type( md_alg ) )->size );
+            if( ret == 0 )
+            {
+                ssl->handshake->priv_op_state = SSL_PRIV_OP_ASYNC;
+                SSL_DEBUG_MSG( 2, ( "<= write server key exchange (pending)" ) );
+                return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+            }
+
+            if( ret != POLARSSL_ERR_SSL_HW_ACCEL_FALLTHROUGH )
+            {
+                SSL_DEBUG_RET( 1, "f_async_sign", ret );
+                return( ret );
+            }
+        }
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
+#if defined(POLARSSL_RSA_C)
+        if( ssl->rsa_batch != NULL &&
+            pk_get_type( ssl_own_key( ssl ) ) == POLARSSL_PK_RSA )
+        {
+            rsa_batch_op *op = &ssl->handshake->rsa_op;
+
+            memset( op, 0, sizeof( rsa_batch_op ) );
+            op->type = RSA_SIGN;
+            op->md_alg = md_alg;
+            op->hashlen = hashlen;
+            op->input = ssl->handshake->priv_op_hash;
+            op->output = ssl->handshake->priv_op_out;
+
+            if( ( ret = ssl_rsa_batch_queue( ssl ) ) != 0 )
+            {
+                if( ret == POLARSSL_ERR_SSL_PRIVATE_PENDING )
+                    SSL_DEBUG_MSG( 2, ( "<= write server key exchange (pending)" ) );
+                return( ret );
+            }
+
+            return( ssl_resume_server_key_exchange( ssl ) );
+        }
+#endif /* POLARSSL_RSA_C */
+
         if( ( ret = pk_sign( ssl_own_key( ssl ), md_alg, hash, hashlen,
                         p + 2 , &signature_len,
                         ssl->f_rng, ssl->p_rng ) ) != 0 )
@@ -2462,21 +2668,7 @@ curve_matching_done:
           POLARSSL_KEY_EXCHANGE_ECDHE_RSA_ENABLED ||
           POLARSSL_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED */
 
-    ssl->out_msglen  = 4 + n;
-    ssl->out_msgtype = SSL_MSG_HANDSHAKE;
-    ssl->out_msg[0]  = SSL_HS_SERVER_KEY_EXCHANGE;
-
-    ssl->state++;
-
-    if( ( ret = ssl_write_record( ssl ) ) != 0 )
-    {
-        SSL_DEBUG_RET( 1, "ssl_write_record", ret );
-        return( ret );
-    }
-
-    SSL_DEBUG_MSG( 2, ( "<= write server key exchange" ) );
-
-    return( 0 );
+    return( ssl_write_server_key_exchange_msg( ssl, n ) );
 }
 
 static int ssl_write_server_hello_done( ssl_context *ssl )
@@ -2582,10 +2774,65 @@ static int ssl_parse_encrypted_pms( ssl_context *ssl,
         return( POLARSSL_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE );
     }
 
-    ret = pk_decrypt( ssl_own_key( ssl ), p, len,
-                      pms, &ssl->handshake->pmslen,
-                      sizeof( ssl->handshake->premaster ) - pms_offset,
-                      ssl->f_rng, ssl->p_rng );
+    if( ssl->handshake->priv_op_state == SSL_PRIV_OP_NONE )
+    {
+        ssl->handshake->priv_op_out = pms;
+        ssl->handshake->priv_op_out_max =
+            sizeof( ssl->handshake->premaster ) - pms_offset;
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+        if( ssl->f_async_decrypt != NULL )
+        {
+            ret = ssl->f_async_decrypt( ssl->p_async, ssl, ssl_own_key( ssl ),
+                                        p, len );
+            if( ret == 0 )
+            {
+                ssl->handshake->priv_op_state = SSL_PRIV_OP_ASYNC;
+                SSL_DEBUG_MSG( 2, ( "<= parse client key exchange (pending)" ) );
+                return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+            }
+
+            if( ret != POLARSSL_ERR_SSL_HW_ACCEL_FALLTHROUGH )
+            {
+                SSL_DEBUG_RET( 1, "f_async_decrypt", ret );
+                return( ret );
+            }
+        }
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
+#if defined(POLARSSL_RSA_C)
+        if( ssl->rsa_batch != NULL &&
+            pk_get_type( ssl_own_key( ssl ) ) == POLARSSL_PK_RSA )
+        {
+            rsa_batch_op *op = &ssl->handshake->rsa_op;
+
+            memset( op, 0, sizeof( rsa_batch_op ) );
+            op->type = RSA_CRYPT;
+            op->input = p;
+            op->output = ssl->handshake->priv_op_out;
+            op->output_max_len = ssl->handshake->priv_op_out_max;
+
+            if( ( ret = ssl_rsa_batch_queue( ssl ) ) != 0 )
+            {
+                if( ret == POLARSSL_ERR_SSL_PRIVATE_PENDING )
+                    SSL_DEBUG_MSG( 2, ( "<= parse client key exchange (pending)" ) );
+                return( ret );
+            }
+        }
+#endif /* POLARSSL_RSA_C */
+    }
+
+    if( ssl->handshake->priv_op_state == SSL_PRIV_OP_DONE )
+    {
+        ret = ssl->handshake->priv_op_ret;
+        ssl->handshake->pmslen = ssl->handshake->priv_op_len;
+        ssl->handshake->priv_op_state = SSL_PRIV_OP_NONE;
+    }
+    else
+        ret = pk_decrypt( ssl_own_key( ssl ), p, len,
+                          pms, &ssl->handshake->pmslen,
+                          sizeof( ssl->handshake->premaster ) - pms_offset,
+                          ssl->f_rng, ssl->p_rng );
 
     if( ret != 0 || ssl->handshake->pmslen != 48 ||
         pms[0] != ssl->handshake->max_major_ver ||
@@ -2690,6 +2937,25 @@ static int ssl_parse_client_key_exchange( ssl_context *ssl )
 
     SSL_DEBUG_MSG( 2, ( "=> parse client key exchange" ) );
 
+#if defined(POLARSSL_KEY_EXCHANGE_RSA_ENABLED) ||                           \
+    defined(POLARSSL_KEY_EXCHANGE_RSA_PSK_ENABLED)
+    /*
+     * With a pending decryption the message is still in in_msg, and is
+     * parsed again once the decryption is done
+     */
+    ret = ssl_priv_op_state( ssl );
+    if( ret == SSL_PRIV_OP_QUEUED || ret == SSL_PRIV_OP_ASYNC )
+    {
+        SSL_DEBUG_MSG( 2, ( "<= parse client key exchange (pending)" ) );
+        return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+    }
+
+    if( ret == SSL_PRIV_OP_DONE )
+    {
+        SSL_DEBUG_MSG( 3, ( "pending decryption done" ) );
+    }
+    else
+#endif
     if( ( ret = ssl_read_record( ssl ) ) != 0 )
     {
         SSL_DEBUG_RET( 1, "ssl_read_record", ret );
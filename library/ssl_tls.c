@@ -57,6 +57,12 @@
 #define strcasecmp _stricmp
 #endif
 
+/*
+ * Allocated length of the input buffer and of each output slot
+ */
+#define SSL_IN_BUFFER_LEN( ssl )    ( (ssl)->in_content_len  + SSL_BUFFER_OVERHEAD )
+#define SSL_OUT_BUFFER_LEN( ssl )   ( (ssl)->out_content_len + SSL_BUFFER_OVERHEAD )
+
 #if defined(POLARSSL_SSL_MAX_FRAGMENT_LENGTH)
 /*
  * Convert max_fragment_length codes to length.
@@ -1633,13 +1639,16 @@ static int ssl_decrypt_buf( ssl_context *ssl )
              * Padding is guaranteed to be incorrect if:
              *   1. padlen >= ssl->in_msglen
              *
-             *   2. padding_idx > SSL_MAX_CONTENT_LEN
+             *   2. padding_idx >= ssl->in_content_len + SSL_COMPRESSION_ADD +
+             *      maclen, i.e. the record holds more than the buffer was
+             *      sized for (a full record has its MAC right before it)
              *
              * In both cases we reset padding_idx to a safe value (0) to
              * prevent out-of-buffer reads.
              */
             correct &= ( ssl->in_msglen >= padlen + 1 );
-            correct &= ( padding_idx <= SSL_MAX_CONTENT_LEN );
+            correct &= ( padding_idx < ssl->in_content_len + SSL_COMPRESSION_ADD +
+                                       ssl->transform_in->maclen );
 
             padding_idx *= correct;
 
@@ -1828,7 +1837,7 @@ static int ssl_compress_buf( ssl_context *ssl )
     ssl->transform_out->ctx_deflate.next_in = msg_pre;
     ssl->transform_out->ctx_deflate.avail_in = len_pre;
     ssl->transform_out->ctx_deflate.next_out = msg_post;
-    ssl->transform_out->ctx_deflate.avail_out = SSL_BUFFER_LEN;
+    ssl->transform_out->ctx_deflate.avail_out = SSL_OUT_BUFFER_LEN( ssl );
 
     ret = deflate( &ssl->transform_out->ctx_deflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -1837,7 +1846,7 @@ static int ssl_compress_buf( ssl_context *ssl )
         return( POLARSSL_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->out_msglen = SSL_BUFFER_LEN - ssl->transform_out->ctx_deflate.avail_out;
+    ssl->out_msglen = SSL_OUT_BUFFER_LEN( ssl ) - ssl->transform_out->ctx_deflate.avail_out;
 
     SSL_DEBUG_MSG( 3, ( "after compression: msglen = %d, ",
                    ssl->out_msglen ) );
@@ -1873,7 +1882,7 @@ static int ssl_decompress_buf( ssl_context *ssl )
     ssl->transform_in->ctx_inflate.next_in = msg_pre;
     ssl->transform_in->ctx_inflate.avail_in = len_pre;
     ssl->transform_in->ctx_inflate.next_out = msg_post;
-    ssl->transform_in->ctx_inflate.avail_out = SSL_MAX_CONTENT_LEN;
+    ssl->transform_in->ctx_inflate.avail_out = ssl->in_content_len;
 
     ret = inflate( &ssl->transform_in->ctx_inflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -1882,7 +1891,7 @@ static int ssl_decompress_buf( ssl_context *ssl )
         return( POLARSSL_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->in_msglen = SSL_MAX_CONTENT_LEN - ssl->transform_in->ctx_inflate.avail_out;
+    ssl->in_msglen = ssl->in_content_len - ssl->transform_in->ctx_inflate.avail_out;
 
     SSL_DEBUG_MSG( 3, ( "after decompression: msglen = %d, ",
                    ssl->in_msglen ) );
@@ -1929,6 +1938,334 @@ int ssl_fetch_input( ssl_context *ssl, size_t nb_want )
     return( 0 );
 }
 
+/*
+ * Record buffer management
+ */
+typedef struct _ssl_pool_buf ssl_pool_buf;
+
+/*
+ * Header written at the start of a buffer while it sits in a pool
+ */
+struct _ssl_pool_buf
+{
+    ssl_pool_buf *next;
+    size_t len;
+};
+
+void ssl_buffer_pool_init( ssl_buffer_pool *pool, size_t max_count )
+{
+    memset( pool, 0, sizeof( ssl_buffer_pool ) );
+
+    pool->max_count = max_count;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_init( &pool->mutex );
+#endif
+}
+
+void ssl_buffer_pool_free( ssl_buffer_pool *pool )
+{
+    ssl_pool_buf *cur, *next;
+
+    cur = (ssl_pool_buf *) pool->head;
+
+    while( cur != NULL )
+    {
+        next = cur->next;
+        polarssl_free( cur );
+        cur = next;
+    }
+
+    pool->head = NULL;
+    pool->count = 0;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_free( &pool->mutex );
+#endif
+}
+
+/*
+ * Take a free buffer of exactly len bytes from the pool, if any
+ */
+static unsigned char *ssl_buffer_pool_get( ssl_buffer_pool *pool, size_t len )
+{
+    ssl_pool_buf *cur, *prv = NULL;
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &pool->mutex ) != 0 )
+        return( NULL );
+#endif
+
+    for( cur = (ssl_pool_buf *) pool->head; cur != NULL; cur = cur->next )
+    {
+        if( cur->len == len )
+        {
+            if( prv == NULL )
+                pool->head = cur->next;
+            else
+                prv->next = cur->next;
+
+            pool->count--;
+            break;
+        }
+
+        prv = cur;
+    }
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &pool->mutex ) != 0 )
+        return( NULL );
+#endif
+
+    if( cur != NULL )
+        memset( cur, 0, sizeof( ssl_pool_buf ) );
+
+    return( (unsigned char *) cur );
+}
+
+/*
+ * Keep a (wiped) buffer in the pool. Returns -1 if the pool is full.
+ */
+static int ssl_buffer_pool_put( ssl_buffer_pool *pool, unsigned char *buf,
+                                size_t len )
+{
+    int ret = -1;
+    ssl_pool_buf *cur = (ssl_pool_buf *) buf;
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &pool->mutex ) != 0 )
+        return( -1 );
+#endif
+
+    if( pool->count < pool->max_count )
+    {
+        cur->next = (ssl_pool_buf *) pool->head;
+        cur->len = len;
+
+        pool->head = cur;
+        pool->count++;
+        ret = 0;
+    }
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &pool->mutex ) != 0 )
+        return( -1 );
+#endif
+
+    return( ret );
+}
+
+/*
+ * Allocate a record buffer, from the context's pool if possible
+ */
+static unsigned char *ssl_buffer_get( ssl_context *ssl, size_t len )
+{
+    unsigned char *buf;
+
+    if( ssl->buf_pool != NULL &&
+        ( buf = ssl_buffer_pool_get( ssl->buf_pool, len ) ) != NULL )
+    {
+        SSL_DEBUG_MSG( 3, ( "record buffer of %d bytes taken from pool", len ) );
+        return( buf );
+    }
+
+    if( ( buf = (unsigned char *) polarssl_malloc( len ) ) == NULL )
+    {
+        SSL_DEBUG_MSG( 1, ( "malloc(%d bytes) failed", len ) );
+        return( NULL );
+    }
+
+    memset( buf, 0, len );
+
+    return( buf );
+}
+
+/*
+ * Wipe a record buffer and give it to the context's pool, or free it
+ */
+static void ssl_buffer_put( ssl_context *ssl, unsigned char *buf, size_t len )
+{
+    memset( buf, 0, len );
+
+    if( ssl->buf_pool == NULL ||
+        ssl_buffer_pool_put( ssl->buf_pool, buf, len ) != 0 )
+    {
+        polarssl_free( buf );
+    }
+}
+
+/*
+ * Reallocate the record buffers for the given content sizes and number of
+ * output slots, keeping what they hold as far as it fits. The output side
+ * is only changed while no output is pending. Released buffers are only
+ * resized when they are acquired again.
+ */
+static int ssl_resize_buffers( ssl_context *ssl, size_t in_len,
+                               size_t out_len, size_t records )
+{
+    unsigned char *buf;
+    size_t old_len, new_len;
+
+    if( ssl->in_ctr != NULL && in_len != ssl->in_content_len )
+    {
+        old_len = SSL_IN_BUFFER_LEN( ssl );
+        new_len = in_len + SSL_BUFFER_OVERHEAD;
+
+        if( ( buf = ssl_buffer_get( ssl, new_len ) ) == NULL )
+            return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+
+        memcpy( buf, ssl->in_ctr, old_len < new_len ? old_len : new_len );
+
+        ssl->in_hdr = buf + ( ssl->in_hdr - ssl->in_ctr );
+        ssl->in_iv  = buf + ( ssl->in_iv  - ssl->in_ctr );
+        ssl->in_msg = buf + ( ssl->in_msg - ssl->in_ctr );
+        if( ssl->in_offt != NULL )
+            ssl->in_offt = buf + ( ssl->in_offt - ssl->in_ctr );
+
+        ssl_buffer_put( ssl, ssl->in_ctr, old_len );
+        ssl->in_ctr = buf;
+    }
+
+    ssl->in_content_len = in_len;
+
+    if( ssl->out_left != 0 )
+        return( 0 );
+
+    if( ssl->out_buf != NULL &&
+        ( out_len != ssl->out_content_len || records != ssl->out_records ) )
+    {
+        old_len = SSL_OUT_BUFFER_LEN( ssl );
+        new_len = out_len + SSL_BUFFER_OVERHEAD;
+
+        if( ( buf = ssl_buffer_get( ssl, records * new_len ) ) == NULL )
+            return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+
+        /* Nothing is pending, so only the current slot is in use */
+        memcpy( buf, ssl->out_ctr, old_len < new_len ? old_len : new_len );
+
+        ssl->out_hdr = buf + ( ssl->out_hdr - ssl->out_ctr );
+        ssl->out_iv  = buf + ( ssl->out_iv  - ssl->out_ctr );
+        ssl->out_msg = buf + ( ssl->out_msg - ssl->out_ctr );
+        ssl->out_ctr = buf;
+
+        ssl_buffer_put( ssl, ssl->out_buf, ssl->out_records * old_len );
+        ssl->out_buf = buf;
+    }
+
+    ssl->out_content_len = out_len;
+    ssl->out_records = records;
+
+    return( 0 );
+}
+
+/*
+ * The connection is idle if the handshake is over and no record is being
+ * received, held for the application or being sent
+ */
+static int ssl_buffers_idle( const ssl_context *ssl )
+{
+    return( ssl->state == SSL_HANDSHAKE_OVER &&
+            ssl->in_left == 0 && ssl->in_offt == NULL &&
+            ( ssl->in_hslen == 0 || ssl->in_hslen >= ssl->in_msglen ) &&
+            ssl->record_read == 0 && ssl->out_left == 0 );
+}
+
+/*
+ * Give the record buffers back while the connection is idle, keeping only
+ * the record counters and message offsets
+ */
+static void ssl_buffers_release( ssl_context *ssl )
+{
+    if( ssl->buf_pool == NULL || ssl->in_ctr == NULL ||
+        ! ssl_buffers_idle( ssl ) )
+    {
+        return;
+    }
+
+    SSL_DEBUG_MSG( 3, ( "releasing idle record buffers" ) );
+
+    memcpy( ssl->in_ctr_idle,  ssl->in_ctr,  8 );
+    memcpy( ssl->out_ctr_idle, ssl->out_ctr, 8 );
+    ssl->in_msg_idle  = ssl->in_msg  - ssl->in_ctr;
+    ssl->out_msg_idle = ssl->out_msg - ssl->out_ctr;
+
+    ssl_buffer_put( ssl, ssl->in_ctr, SSL_IN_BUFFER_LEN( ssl ) );
+    ssl_buffer_put( ssl, ssl->out_buf,
+                    ssl->out_records * SSL_OUT_BUFFER_LEN( ssl ) );
+
+    ssl->in_ctr = ssl->in_hdr = ssl->in_iv = ssl->in_msg = NULL;
+    ssl->out_buf = NULL;
+    ssl->out_ctr = ssl->out_hdr = ssl->out_iv = ssl->out_msg = NULL;
+}
+
+/*
+ * Get the record buffers (back) if they are not there
+ */
+static int ssl_buffers_acquire( ssl_context *ssl )
+{
+    unsigned char *in_buf, *out_buf;
+
+    if( ssl->in_ctr != NULL )
+        return( 0 );
+
+    if( ( in_buf = ssl_buffer_get( ssl, SSL_IN_BUFFER_LEN( ssl ) ) ) == NULL )
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+
+    if( ( out_buf = ssl_buffer_get( ssl,
+                ssl->out_records * SSL_OUT_BUFFER_LEN( ssl ) ) ) == NULL )
+    {
+        ssl_buffer_put( ssl, in_buf, SSL_IN_BUFFER_LEN( ssl ) );
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+    }
+
+    ssl->in_ctr = in_buf;
+    ssl->in_hdr = ssl->in_ctr +  8;
+    ssl->in_iv  = ssl->in_ctr + 13;
+    ssl->in_msg = ssl->in_ctr + ssl->in_msg_idle;
+
+    ssl->out_buf = out_buf;
+    ssl->out_ctr = ssl->out_buf;
+    ssl->out_hdr = ssl->out_ctr +  8;
+    ssl->out_iv  = ssl->out_ctr + 13;
+    ssl->out_msg = ssl->out_ctr + ssl->out_msg_idle;
+
+    memcpy( ssl->in_ctr,  ssl->in_ctr_idle,  8 );
+    memcpy( ssl->out_ctr, ssl->out_ctr_idle, 8 );
+    memset( ssl->in_ctr_idle,  0, 8 );
+    memset( ssl->out_ctr_idle, 0, 8 );
+
+    return( 0 );
+}
+
+/*
+ * Move the outgoing record pointers to the given output slot, carrying the
+ * record counter over
+ */
+static void ssl_out_slot_select( ssl_context *ssl, size_t slot )
+{
+    unsigned char *ctr = ssl->out_buf + slot * SSL_OUT_BUFFER_LEN( ssl );
+
+    if( ctr == ssl->out_ctr )
+        return;
+
+    memcpy( ctr, ssl->out_ctr, 8 );
+
+    ssl->out_hdr = ctr + ( ssl->out_hdr - ssl->out_ctr );
+    ssl->out_iv  = ctr + ( ssl->out_iv  - ssl->out_ctr );
+    ssl->out_msg = ctr + ( ssl->out_msg - ssl->out_ctr );
+    ssl->out_ctr = ctr;
+}
+
+/*
+ * Length of the sealed record (with header) in the given output slot
+ */
+static size_t ssl_out_slot_len( const ssl_context *ssl, size_t slot )
+{
+    const unsigned char *hdr = ssl->out_buf + slot * SSL_OUT_BUFFER_LEN( ssl ) + 8;
+
+    return( 5 + ( ( hdr[3] << 8 ) | hdr[4] ) );
+}
+
 /*
  * Flush any data not yet written
  */
@@ -1936,18 +2273,57 @@ int ssl_flush_output( ssl_context *ssl )
 {
     int ret;
     unsigned char *buf;
+    size_t i, n, len, total, written;
+    ssl_iovec iov[SSL_MAX_OUT_RECORDS];
+
+    /* Buffers released while idle: nothing pending */
+    if( ssl->out_buf == NULL )
+        return( 0 );
 
     SSL_DEBUG_MSG( 2, ( "=> flush output" ) );
 
     while( ssl->out_left > 0 )
     {
-        SSL_DEBUG_MSG( 2, ( "message length: %d, out_left: %d",
-                       5 + ssl->out_msglen, ssl->out_left ) );
+        SSL_DEBUG_MSG( 2, ( "queued records: %d, out_left: %d",
+                       ssl->out_queued, ssl->out_left ) );
+
+        /*
+         * Find the first byte not written yet among the queued records
+         */
+        for( total = 0, i = 0; i < ssl->out_queued; i++ )
+            total += ssl_out_slot_len( ssl, i );
+
+        written = total - ssl->out_left;
+
+        for( i = 0; written >= ( len = ssl_out_slot_len( ssl, i ) ); i++ )
+            written -= len;
+
+        buf = ssl->out_buf + i * SSL_OUT_BUFFER_LEN( ssl ) + 8 + written;
+
+        if( ssl->f_send_vec != NULL && i + 1 < ssl->out_queued )
+        {
+            /*
+             * Send the rest of this record and all following ones at once
+             */
+            for( n = 0; i < ssl->out_queued; i++, n++ )
+            {
+                iov[n].buf = ssl->out_buf + i * SSL_OUT_BUFFER_LEN( ssl ) + 8;
+                iov[n].len = ssl_out_slot_len( ssl, i );
+            }
+
+            iov[0].buf = buf;
+            iov[0].len -= written;
 
-        buf = ssl->out_hdr + 5 + ssl->out_msglen - ssl->out_left;
-        ret = ssl->f_send( ssl->p_send, buf, ssl->out_left );
+            ret = ssl->f_send_vec( ssl->p_send, iov, n );
+
+            SSL_DEBUG_RET( 2, "ssl->f_send_vec", ret );
+        }
+        else
+        {
+            ret = ssl->f_send( ssl->p_send, buf, len - written );
 
-        SSL_DEBUG_RET( 2, "ssl->f_send", ret );
+            SSL_DEBUG_RET( 2, "ssl->f_send", ret );
+        }
 
         if( ret <= 0 )
             return( ret );
@@ -1955,6 +2331,9 @@ int ssl_flush_output( ssl_context *ssl )
         ssl->out_left -= ret;
     }
 
+    ssl->out_queued = 0;
+    ssl_out_slot_select( ssl, 0 );
+
     SSL_DEBUG_MSG( 2, ( "<= flush output" ) );
 
     return( 0 );
@@ -1963,7 +2342,12 @@ int ssl_flush_output( ssl_context *ssl )
 /*
  * Record layer functions
  */
-int ssl_write_record( ssl_context *ssl )
+/*
+ * Seal the current record. If queue is set and an output slot is free, the
+ * record is kept in the output buffer, otherwise all pending records are
+ * flushed.
+ */
+static int ssl_write_record_int( ssl_context *ssl, int queue )
 {
     int ret, done = 0;
     size_t len = ssl->out_msglen;
@@ -2031,7 +2415,7 @@ int ssl_write_record( ssl_context *ssl )
             ssl->out_hdr[4] = (unsigned char)( len      );
         }
 
-        ssl->out_left = 5 + ssl->out_msglen;
+        ssl->out_left += 5 + ssl->out_msglen;
 
         SSL_DEBUG_MSG( 3, ( "output record: msgtype = %d, "
                             "version = [%d:%d], msglen = %d",
@@ -2042,6 +2426,17 @@ int ssl_write_record( ssl_context *ssl )
                        ssl->out_hdr, 5 + ssl->out_msglen );
     }
 
+    ssl->out_queued++;
+
+    if( queue && !done && ssl->out_queued < ssl->out_records )
+    {
+        ssl_out_slot_select( ssl, ssl->out_queued );
+
+        SSL_DEBUG_MSG( 2, ( "<= write record (queued)" ) );
+
+        return( 0 );
+    }
+
     if( ( ret = ssl_flush_output( ssl ) ) != 0 )
     {
         SSL_DEBUG_RET( 1, "ssl_flush_output", ret );
@@ -2053,6 +2448,11 @@ int ssl_write_record( ssl_context *ssl )
     return( 0 );
 }
 
+int ssl_write_record( ssl_context *ssl )
+{
+    return( ssl_write_record_int( ssl, 0 ) );
+}
+
 int ssl_read_record( ssl_context *ssl )
 {
     int ret, done = 0;
@@ -2135,7 +2535,7 @@ int ssl_read_record( ssl_context *ssl )
     if( ssl->transform_in == NULL )
     {
         if( ssl->in_msglen < 1 ||
-            ssl->in_msglen > SSL_MAX_CONTENT_LEN )
+            ssl->in_msglen > ssl->in_content_len )
         {
             SSL_DEBUG_MSG( 1, ( "bad message length" ) );
             return( POLARSSL_ERR_SSL_INVALID_RECORD );
@@ -2151,7 +2551,7 @@ int ssl_read_record( ssl_context *ssl )
 
 #if defined(POLARSSL_SSL_PROTO_SSL3)
         if( ssl->minor_ver == SSL_MINOR_VERSION_0 &&
-            ssl->in_msglen > ssl->transform_in->minlen + SSL_MAX_CONTENT_LEN )
+            ssl->in_msglen > ssl->transform_in->minlen + ssl->in_content_len )
         {
             SSL_DEBUG_MSG( 1, ( "bad message length" ) );
             return( POLARSSL_ERR_SSL_INVALID_RECORD );
@@ -2164,7 +2564,7 @@ int ssl_read_record( ssl_context *ssl )
          * TLS encrypted messages can have up to 256 bytes of padding
          */
         if( ssl->minor_ver >= SSL_MINOR_VERSION_1 &&
-            ssl->in_msglen > ssl->transform_in->minlen + SSL_MAX_CONTENT_LEN + 256 )
+            ssl->in_msglen > ssl->transform_in->minlen + ssl->in_content_len + 256 )
         {
             SSL_DEBUG_MSG( 1, ( "bad message length" ) );
             return( POLARSSL_ERR_SSL_INVALID_RECORD );
@@ -2219,7 +2619,7 @@ int ssl_read_record( ssl_context *ssl )
         SSL_DEBUG_BUF( 4, "input payload after decrypt",
                        ssl->in_msg, ssl->in_msglen );
 
-        if( ssl->in_msglen > SSL_MAX_CONTENT_LEN )
+        if( ssl->in_msglen > ssl->in_content_len )
         {
             SSL_DEBUG_MSG( 1, ( "bad message length" ) );
             return( POLARSSL_ERR_SSL_INVALID_RECORD );
@@ -2342,6 +2742,9 @@ int ssl_send_alert_message( ssl_context *ssl,
 
     SSL_DEBUG_MSG( 2, ( "=> send alert message" ) );
 
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
     ssl->out_msgtype = SSL_MSG_ALERT;
     ssl->out_msglen = 2;
     ssl->out_msg[0] = level;
@@ -2479,10 +2882,10 @@ int ssl_write_certificate( ssl_context *ssl )
     while( crt != NULL )
     {
         n = crt->raw.len;
-        if( n > SSL_MAX_CONTENT_LEN - 3 - i )
+        if( n > ssl->out_content_len - 3 - i )
         {
             SSL_DEBUG_MSG( 1, ( "certificate too large, %d > %d",
-                           i + 3 + n, SSL_MAX_CONTENT_LEN ) );
+                           i + 3 + n, ssl->out_content_len ) );
             return( POLARSSL_ERR_SSL_CERTIFICATE_TOO_LARGE );
         }
 
@@ -2522,7 +2925,8 @@ write_msg:
 int ssl_parse_certificate( ssl_context *ssl )
 {
     int ret = POLARSSL_ERR_SSL_FEATURE_UNAVAILABLE;
-    size_t i, n;
+    size_t i, n, total;
+    unsigned char *chain_buf, *p;
     const ssl_ciphersuite_t *ciphersuite_info = ssl->transform_negotiate->ciphersuite_info;
 
     SSL_DEBUG_MSG( 2, ( "=> parse certificate" ) );
@@ -2640,6 +3044,7 @@ int ssl_parse_certificate( ssl_context *ssl )
     x509_crt_init( ssl->session_negotiate->peer_cert );
 
     i = 7;
+    total = 0;
 
     while( i < ssl->in_hslen )
     {
@@ -2659,14 +3064,46 @@ int ssl_parse_certificate( ssl_context *ssl )
             return( POLARSSL_ERR_SSL_BAD_HS_CERTIFICATE );
         }
 
-        ret = x509_crt_parse_der( ssl->session_negotiate->peer_cert,
-                                  ssl->in_msg + i, n );
+        total += n;
+        i += n;
+    }
+
+    /*
+     * Copy the certificates back to back into a single buffer, referenced
+     * by all of them and owned by the first one
+     */
+    if( ( chain_buf = (unsigned char *) polarssl_malloc( total ) ) == NULL )
+    {
+        SSL_DEBUG_MSG( 1, ( "malloc(%d bytes) failed", total ) );
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+    }
+
+    i = 7;
+    p = chain_buf;
+
+    while( i < ssl->in_hslen )
+    {
+        n = ( (unsigned int) ssl->in_msg[i + 1] << 8 )
+            | (unsigned int) ssl->in_msg[i + 2];
+        i += 3;
+
+        memcpy( p, ssl->in_msg + i, n );
+
+        ret = x509_crt_parse_der_nocopy( ssl->session_negotiate->peer_cert,
+                                         p, n );
         if( ret != 0 )
         {
-            SSL_DEBUG_RET( 1, " x509_crt_parse_der", ret );
+            if( p == chain_buf )
+                polarssl_free( chain_buf );
+
+            SSL_DEBUG_RET( 1, " x509_crt_parse_der_nocopy", ret );
             return( ret );
         }
 
+        if( p == chain_buf )
+            ssl->session_negotiate->peer_cert->own_buffer = 1;
+
+        p += n;
         i += n;
     }
 
@@ -2707,10 +3144,18 @@ int ssl_parse_certificate( ssl_context *ssl )
         /*
          * Main check: verify certificate
          */
+#if defined(POLARSSL_SHA256_C)
+        ret = x509_crt_verify_cached( ssl->session_negotiate->peer_cert,
+                                      ssl->ca_chain, ssl->ca_crl, ssl->peer_cn,
+                                     &ssl->session_negotiate->verify_result,
+                                      ssl->f_vrfy, ssl->p_vrfy,
+                                      ssl->verify_cache );
+#else
         ret = x509_crt_verify( ssl->session_negotiate->peer_cert,
                                ssl->ca_chain, ssl->ca_crl, ssl->peer_cn,
                               &ssl->session_negotiate->verify_result,
                                ssl->f_vrfy, ssl->p_vrfy );
+#endif
 
         if( ret != 0 )
         {
@@ -3333,21 +3778,81 @@ int ssl_parse_finished( ssl_context *ssl )
     return( 0 );
 }
 
-static int ssl_handshake_init( ssl_context *ssl )
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+/*
+ * Abandon a started operation before its handshake goes away
+ */
+static void ssl_async_cancel( ssl_context *ssl )
 {
-    if( ssl->transform_negotiate )
-        ssl_transform_free( ssl->transform_negotiate );
-    else
-    {
-        ssl->transform_negotiate =
-            (ssl_transform *) polarssl_malloc( sizeof(ssl_transform) );
+    if( ssl->handshake == NULL ||
+        ssl->handshake->priv_op_state != SSL_PRIV_OP_ASYNC )
+        return;
 
-        if( ssl->transform_negotiate != NULL )
-            memset( ssl->transform_negotiate, 0, sizeof(ssl_transform) );
-    }
+    if( ssl->f_async_cancel != NULL )
+        ssl->f_async_cancel( ssl->p_async, ssl );
 
-    if( ssl->session_negotiate )
-        ssl_session_free( ssl->session_negotiate );
+    ssl->handshake->priv_op_state = SSL_PRIV_OP_NONE;
+    ssl->async_data = NULL;
+}
+#endif
+
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+/*
+ * Take an operation that will never be resumed out of its batch. If a run
+ * is doing it, the run drops the result instead.
+ */
+static void ssl_rsa_batch_cancel( ssl_context *ssl )
+{
+    size_t i;
+    ssl_rsa_batch *batch = ssl->rsa_batch;
+    ssl_handshake_params *handshake = ssl->handshake;
+
+    if( batch == NULL || handshake == NULL )
+        return;
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &batch->mutex ) != 0 )
+        return;
+#endif
+
+    if( handshake->rsa_op_slot != NULL )
+        *handshake->rsa_op_slot = NULL;
+    else if( handshake->rsa_op_batch != NULL )
+    {
+        for( i = 0; i < batch->count; i++ )
+        {
+            if( batch->queue[i] == handshake )
+            {
+                batch->queue[i] = batch->queue[--batch->count];
+                break;
+            }
+        }
+    }
+
+    handshake->rsa_op_slot = NULL;
+    handshake->rsa_op_batch = NULL;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_unlock( &batch->mutex );
+#endif
+}
+#endif
+
+static int ssl_handshake_init( ssl_context *ssl )
+{
+    if( ssl->transform_negotiate )
+        ssl_transform_free( ssl->transform_negotiate );
+    else
+    {
+        ssl->transform_negotiate =
+            (ssl_transform *) polarssl_malloc( sizeof(ssl_transform) );
+
+        if( ssl->transform_negotiate != NULL )
+            memset( ssl->transform_negotiate, 0, sizeof(ssl_transform) );
+    }
+
+    if( ssl->session_negotiate )
+        ssl_session_free( ssl->session_negotiate );
     else
     {
         ssl->session_negotiate =
@@ -3358,7 +3863,15 @@ static int ssl_handshake_init( ssl_context *ssl )
     }
 
     if( ssl->handshake )
+    {
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+        ssl_async_cancel( ssl );
+#endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+        ssl_rsa_batch_cancel( ssl );
+#endif
         ssl_handshake_free( ssl->handshake );
+    }
     else
     {
         ssl->handshake = (ssl_handshake_params *)
@@ -3410,7 +3923,6 @@ static int ssl_handshake_init( ssl_context *ssl )
 int ssl_init( ssl_context *ssl )
 {
     int ret;
-    int len = SSL_BUFFER_LEN;
 
     memset( ssl, 0, sizeof( ssl_context ) );
 
@@ -3438,32 +3950,15 @@ int ssl_init( ssl_context *ssl )
     /*
      * Prepare base structures
      */
-    ssl->in_ctr = (unsigned char *) polarssl_malloc( len );
-    ssl->in_hdr = ssl->in_ctr +  8;
-    ssl->in_iv  = ssl->in_ctr + 13;
-    ssl->in_msg = ssl->in_ctr + 13;
-
-    if( ssl->in_ctr == NULL )
-    {
-        SSL_DEBUG_MSG( 1, ( "malloc(%d bytes) failed", len ) );
-        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
-    }
-
-    ssl->out_ctr = (unsigned char *) polarssl_malloc( len );
-    ssl->out_hdr = ssl->out_ctr +  8;
-    ssl->out_iv  = ssl->out_ctr + 13;
-    ssl->out_msg = ssl->out_ctr + 13;
-
-    if( ssl->out_ctr == NULL )
-    {
-        SSL_DEBUG_MSG( 1, ( "malloc(%d bytes) failed", len ) );
-        polarssl_free( ssl->in_ctr );
-        ssl->in_ctr = NULL;
-        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
-    }
-
-    memset( ssl-> in_ctr, 0, SSL_BUFFER_LEN );
-    memset( ssl->out_ctr, 0, SSL_BUFFER_LEN );
+    ssl->max_content_len = SSL_MAX_CONTENT_LEN;
+    ssl->in_content_len  = SSL_MAX_CONTENT_LEN;
+    ssl->out_content_len = SSL_MAX_CONTENT_LEN;
+    ssl->out_records = 1;
+    ssl->in_msg_idle  = 13;
+    ssl->out_msg_idle = 13;
+
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
 
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
     ssl->ticket_lifetime = SSL_DEFAULT_TICKET_LIFETIME;
@@ -3487,6 +3982,9 @@ int ssl_session_reset( ssl_context *ssl )
 {
     int ret;
 
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
     ssl->state = SSL_HELLO_REQUEST;
     ssl->renegotiation = SSL_INITIAL_HANDSHAKE;
     ssl->secure_renegotiation = SSL_LEGACY_RENEGOTIATION;
@@ -3506,16 +4004,30 @@ int ssl_session_reset( ssl_context *ssl )
     ssl->nb_zero = 0;
     ssl->record_read = 0;
 
+    ssl->out_ctr = ssl->out_buf;
+    ssl->out_hdr = ssl->out_ctr +  8;
+    ssl->out_iv  = ssl->out_ctr + 13;
     ssl->out_msg = ssl->out_ctr + 13;
     ssl->out_msgtype = 0;
     ssl->out_msglen = 0;
     ssl->out_left = 0;
+    ssl->out_queued = 0;
 
     ssl->transform_in = NULL;
     ssl->transform_out = NULL;
 
-    memset( ssl->out_ctr, 0, SSL_BUFFER_LEN );
-    memset( ssl->in_ctr, 0, SSL_BUFFER_LEN );
+    memset( ssl->out_buf, 0, ssl->out_records * SSL_OUT_BUFFER_LEN( ssl ) );
+    memset( ssl->in_ctr, 0, SSL_IN_BUFFER_LEN( ssl ) );
+
+    /*
+     * Undo any shrinking to a maximum fragment length negotiated before
+     */
+    if( ( ret = ssl_resize_buffers( ssl, ssl->max_content_len,
+                                    ssl->max_content_len,
+                                    ssl->out_records ) ) != 0 )
+    {
+        return( ret );
+    }
 
 #if defined(POLARSSL_SSL_HW_RECORD_ACCEL)
     if( ssl_hw_record_reset != NULL)
@@ -3555,42 +4067,156 @@ int ssl_session_reset( ssl_context *ssl )
 
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
 /*
- * Allocate and initialize ticket keys
+ * Generate a fresh set of ticket keys
  */
-static int ssl_ticket_keys_init( ssl_context *ssl )
+static int ssl_ticket_keys_generate( ssl_ticket_keys *tkeys,
+                                     int (*f_rng)(void *, unsigned char *, size_t),
+                                     void *p_rng )
 {
     int ret;
-    ssl_ticket_keys *tkeys;
-    unsigned char buf[16];
 
-    if( ssl->ticket_keys != NULL )
-        return( 0 );
+    if( ( ret = f_rng( p_rng, tkeys->key_name, 16 ) ) != 0 ||
+        ( ret = f_rng( p_rng, tkeys->aes_key, 16 ) ) != 0 )
+    {
+        return( ret );
+    }
 
-    tkeys = (ssl_ticket_keys *) polarssl_malloc( sizeof(ssl_ticket_keys) );
-    if( tkeys == NULL )
-        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+    if( ( ret = f_rng( p_rng, tkeys->mac_key, 16 ) ) != 0 )
+        return( ret );
+
+#if defined(POLARSSL_HAVE_TIME)
+    tkeys->generation_time = time( NULL );
+#endif
+
+    return( 0 );
+}
+
+/*
+ * Generate new active keys in the slot following the active one.
+ * If all slots are in use, that slot holds the oldest keys: they are
+ * dropped first, so that a failure leaves the store consistent.
+ * Caller must hold the store mutex.
+ */
+static int ssl_ticket_store_rotate_int( ssl_ticket_key_store *store )
+{
+    int ret;
+    int next = ( store->active + 1 ) % SSL_TICKET_MAX_KEYS;
 
-    if( ( ret = ssl->f_rng( ssl->p_rng, tkeys->key_name, 16 ) ) != 0 )
+    if( store->count == 0 )
+        next = store->active;
+    else if( store->count == SSL_TICKET_MAX_KEYS )
+        store->count--;
+
+    if( ( ret = ssl_ticket_keys_generate( &store->keys[next],
+                                          store->f_rng, store->p_rng ) ) != 0 )
     {
-        polarssl_free( tkeys );
+        memset( &store->keys[next], 0, sizeof( ssl_ticket_keys ) );
         return( ret );
     }
 
-    if( ( ret = ssl->f_rng( ssl->p_rng, buf, 16 ) ) != 0 ||
-        ( ret = aes_setkey_enc( &tkeys->enc, buf, 128 ) ) != 0 ||
-        ( ret = aes_setkey_dec( &tkeys->dec, buf, 128 ) ) != 0 )
+    store->active = next;
+    store->count++;
+
+    return( 0 );
+}
+
+/*
+ * Rotate keys if the active ones are older than the rotation interval.
+ * Caller must hold the store mutex.
+ */
+int ssl_ticket_store_refresh( ssl_ticket_key_store *store )
+{
+#if defined(POLARSSL_HAVE_TIME)
+    if( store->count == 0 ||
+        ( store->rotation_interval != 0 &&
+          (int) ( time( NULL ) - store->keys[store->active].generation_time )
+                >= store->rotation_interval ) )
     {
-        polarssl_free( tkeys );
-        return( ret );
+        return( ssl_ticket_store_rotate_int( store ) );
     }
+#else
+    if( store->count == 0 )
+        return( ssl_ticket_store_rotate_int( store ) );
+#endif
+
+    return( 0 );
+}
+
+int ssl_ticket_store_init( ssl_ticket_key_store *store,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng,
+                           int rotation_interval )
+{
+    memset( store, 0, sizeof( ssl_ticket_key_store ) );
+
+    if( f_rng == NULL )
+        return( POLARSSL_ERR_SSL_NO_RNG );
+
+    store->f_rng = f_rng;
+    store->p_rng = p_rng;
+    store->rotation_interval = rotation_interval < 0 ? 0 : rotation_interval;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_init( &store->mutex );
+#endif
+
+    return( ssl_ticket_store_rotate_int( store ) );
+}
+
+int ssl_ticket_store_rotate( ssl_ticket_key_store *store )
+{
+    int ret;
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &store->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    ret = ssl_ticket_store_rotate_int( store );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &store->mutex ) != 0 )
+        return( POLARSSL_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+}
+
+void ssl_ticket_store_free( ssl_ticket_key_store *store )
+{
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_free( &store->mutex );
+#endif
+
+    memset( store, 0, sizeof( ssl_ticket_key_store ) );
+}
+
+/*
+ * Allocate and initialize a private ticket key store
+ */
+static int ssl_ticket_keys_init( ssl_context *ssl )
+{
+    int ret;
+    ssl_ticket_key_store *store;
+
+    if( ssl->ticket_store != NULL )
+        return( 0 );
+
+    store = (ssl_ticket_key_store *)
+            polarssl_malloc( sizeof( ssl_ticket_key_store ) );
+    if( store == NULL )
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
 
-    if( ( ret = ssl->f_rng( ssl->p_rng, tkeys->mac_key, 16 ) ) != 0 )
+    if( ( ret = ssl_ticket_store_init( store, ssl->f_rng, ssl->p_rng,
+                                       0 ) ) != 0 )
     {
-        polarssl_free( tkeys );
+        ssl_ticket_store_free( store );
+        polarssl_free( store );
         return( ret );
     }
 
-    ssl->ticket_keys = tkeys;
+    ssl->ticket_store = store;
+    ssl->ticket_store_own_alloc = 1;
 
     return( 0 );
 }
@@ -3650,6 +4276,12 @@ void ssl_set_bio( ssl_context *ssl,
     ssl->p_send     = p_send;
 }
 
+void ssl_set_bio_vec( ssl_context *ssl,
+            int (*f_send_vec)(void *, const ssl_iovec *, size_t) )
+{
+    ssl->f_send_vec = f_send_vec;
+}
+
 void ssl_set_session_cache( ssl_context *ssl,
         int (*f_get_cache)(void *, ssl_session *), void *p_get_cache,
         int (*f_set_cache)(void *, const ssl_session *), void *p_set_cache )
@@ -3738,6 +4370,13 @@ void ssl_set_ca_chain( ssl_context *ssl, x509_crt *ca_chain,
     ssl->peer_cn    = peer_cn;
 }
 
+#if defined(POLARSSL_SHA256_C)
+void ssl_set_verify_cache( ssl_context *ssl, x509_verify_cache *cache )
+{
+    ssl->verify_cache = cache;
+}
+#endif
+
 int ssl_set_own_cert( ssl_context *ssl, x509_crt *own_cert,
                        pk_context *pk_key )
 {
@@ -4029,129 +4668,563 @@ void ssl_legacy_renegotiation( ssl_context *ssl, int allow_legacy )
     ssl->allow_legacy_renegotiation = allow_legacy;
 }
 
-#if defined(POLARSSL_SSL_SESSION_TICKETS)
-int ssl_set_session_tickets( ssl_context *ssl, int use_tickets )
+int ssl_set_output_queue( ssl_context *ssl, size_t records )
 {
-    ssl->session_tickets = use_tickets;
+    if( records < 1 || records > SSL_MAX_OUT_RECORDS || ssl->out_left != 0 )
+        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
 
-    if( ssl->endpoint == SSL_IS_CLIENT )
-        return( 0 );
+    return( ssl_resize_buffers( ssl, ssl->in_content_len,
+                                ssl->out_content_len, records ) );
+}
 
-    if( ssl->f_rng == NULL )
+int ssl_set_max_content_len( ssl_context *ssl, size_t len )
+{
+    if( len < SSL_MIN_CONTENT_LEN || len > SSL_MAX_CONTENT_LEN ||
+        ssl->in_left != 0 || ssl->in_offt != NULL || ssl->out_left != 0 )
+    {
         return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+    }
 
-    return( ssl_ticket_keys_init( ssl ) );
+    ssl->max_content_len = len;
+
+    return( ssl_resize_buffers( ssl, len, len, ssl->out_records ) );
 }
 
-void ssl_set_session_ticket_lifetime( ssl_context *ssl, int lifetime )
+void ssl_set_buffer_pool( ssl_context *ssl, ssl_buffer_pool *pool )
 {
-    ssl->ticket_lifetime = lifetime;
+    ssl->buf_pool = pool;
 }
-#endif /* POLARSSL_SSL_SESSION_TICKETS */
 
-/*
- * SSL get accessors
- */
-size_t ssl_get_bytes_avail( const ssl_context *ssl )
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+void ssl_set_rsa_batch( ssl_context *ssl, ssl_rsa_batch *batch )
 {
-    return( ssl->in_offt == NULL ? 0 : ssl->in_msglen );
+    ssl->rsa_batch = batch;
 }
 
-int ssl_get_verify_result( const ssl_context *ssl )
+void ssl_rsa_batch_init( ssl_rsa_batch *batch,
+                         int (*f_rng)(void *, unsigned char *, size_t),
+                         void *p_rng )
 {
-    return( ssl->session->verify_result );
+    memset( batch, 0, sizeof( ssl_rsa_batch ) );
+
+    batch->f_rng = f_rng;
+    batch->p_rng = p_rng;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_init( &batch->mutex );
+#endif
 }
 
-const char *ssl_get_ciphersuite( const ssl_context *ssl )
+void ssl_rsa_batch_free( ssl_rsa_batch *batch )
 {
-    if( ssl == NULL || ssl->session == NULL )
-        return NULL;
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_free( &batch->mutex );
+#endif
 
-    return ssl_get_ciphersuite_name( ssl->session->ciphersuite );
+    memset( batch, 0, sizeof( ssl_rsa_batch ) );
 }
 
-const char *ssl_get_version( const ssl_context *ssl )
+/*
+ * Operations taken out of a batch by one run. They are done on copies of
+ * their input and output, without the mutex, so that the handshakes may be
+ * freed meanwhile: ssl_rsa_batch_cancel() then clears their entry in hs[].
+ */
+typedef struct
 {
-    switch( ssl->minor_ver )
-    {
-        case SSL_MINOR_VERSION_0:
-            return( "SSLv3.0" );
+    ssl_handshake_params *hs[SSL_MAX_RSA_BATCH];
+    rsa_context *key[SSL_MAX_RSA_BATCH];
+    rsa_batch_op ops[SSL_MAX_RSA_BATCH];
+    size_t count;
+    unsigned char *buf;
+    size_t buflen;
+}
+ssl_rsa_batch_run_ctx;
 
-        case SSL_MINOR_VERSION_1:
-            return( "TLSv1.0" );
+/*
+ * Move the queued operations to run, copying their data (mutex held)
+ */
+static int ssl_rsa_batch_take( ssl_rsa_batch *batch,
+                               ssl_rsa_batch_run_ctx *run )
+{
+    size_t i, in_len;
+    unsigned char *p;
+    rsa_batch_op *op;
 
-        case SSL_MINOR_VERSION_2:
-            return( "TLSv1.1" );
+    memset( run, 0, sizeof( ssl_rsa_batch_run_ctx ) );
 
-        case SSL_MINOR_VERSION_3:
-            return( "TLSv1.2" );
+    for( i = 0; i < batch->count; i++ )
+    {
+        op = &batch->queue[i]->rsa_op;
+        run->buflen += ( op->type == RSA_SIGN ) ?
+            sizeof( batch->queue[i]->priv_op_hash ) +
+                batch->queue[i]->rsa_op_key->len :
+            batch->queue[i]->rsa_op_key->len + op->output_max_len;
+    }
 
-        default:
-            break;
+    if( batch->count != 0 &&
+        ( run->buf = (unsigned char *) polarssl_malloc( run->buflen ) ) == NULL )
+    {
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
     }
-    return( "unknown" );
-}
 
-#if defined(POLARSSL_X509_CRT_PARSE_C)
-const x509_crt *ssl_get_peer_cert( const ssl_context *ssl )
-{
-    if( ssl == NULL || ssl->session == NULL )
-        return NULL;
+    for( p = run->buf, i = 0; i < batch->count; i++ )
+    {
+        run->hs[i] = batch->queue[i];
+        run->key[i] = run->hs[i]->rsa_op_key;
+        run->ops[i] = run->hs[i]->rsa_op;
+        run->hs[i]->rsa_op_slot = &run->hs[i];
 
-    return ssl->session->peer_cert;
-}
-#endif /* POLARSSL_X509_CRT_PARSE_C */
+        op = &run->ops[i];
+        in_len = ( op->type == RSA_SIGN ) ? sizeof( run->hs[i]->priv_op_hash )
+                                          : run->key[i]->len;
 
-int ssl_get_session( const ssl_context *ssl, ssl_session *dst )
-{
-    if( ssl == NULL ||
-        dst == NULL ||
-        ssl->session == NULL ||
-        ssl->endpoint != SSL_IS_CLIENT )
-    {
-        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+        memcpy( p, op->input, in_len );
+        op->input = p;
+        p += in_len;
+
+        op->output = p;
+        p += ( op->type == RSA_SIGN ) ? run->key[i]->len : op->output_max_len;
     }
 
-    return( ssl_session_copy( dst, ssl->session ) );
+    run->count = batch->count;
+    batch->count = 0;
+
+    return( 0 );
 }
 
 /*
- * Perform a single step of the SSL handshake
+ * Do the operations of a run, grouped by key (mutex not held)
  */
-int ssl_handshake_step( ssl_context *ssl )
+static int ssl_rsa_batch_compute( ssl_rsa_batch *batch,
+                                  ssl_rsa_batch_run_ctx *run )
 {
-    int ret = POLARSSL_ERR_SSL_FEATURE_UNAVAILABLE;
+    int ret = 0, r;
+    size_t i, j, n;
+    unsigned char done[SSL_MAX_RSA_BATCH];
+    rsa_batch_op ops[SSL_MAX_RSA_BATCH];
+    size_t idx[SSL_MAX_RSA_BATCH];
 
-#if defined(POLARSSL_SSL_CLI_C)
-    if( ssl->endpoint == SSL_IS_CLIENT )
-        ret = ssl_handshake_client_step( ssl );
-#endif
+    memset( done, 0, sizeof( done ) );
 
-#if defined(POLARSSL_SSL_SRV_C)
-    if( ssl->endpoint == SSL_IS_SERVER )
-        ret = ssl_handshake_server_step( ssl );
-#endif
+    for( i = 0; i < run->count; i++ )
+    {
+        if( done[i] )
+            continue;
+
+        for( n = 0, j = i; j < run->count; j++ )
+        {
+            if( done[j] || run->key[j] != run->key[i] )
+                continue;
+
+            idx[n] = j;
+            ops[n] = run->ops[j];
+            done[j] = 1;
+            n++;
+        }
+
+        r = rsa_pkcs1_batch( run->key[i], batch->f_rng, batch->p_rng, ops, n );
+        if( r != 0 && ret == 0 )
+            ret = r;
+
+        for( j = 0; j < n; j++ )
+        {
+            run->ops[idx[j]] = ops[j];
+            if( r != 0 )
+                run->ops[idx[j]].ret = r;
+        }
+    }
 
     return( ret );
 }
 
 /*
- * Perform the SSL handshake
+ * Hand the results to the handshakes still waiting for them (mutex held)
  */
-int ssl_handshake( ssl_context *ssl )
+static void ssl_rsa_batch_publish( ssl_rsa_batch_run_ctx *run )
 {
-    int ret = 0;
-
-    SSL_DEBUG_MSG( 2, ( "=> handshake" ) );
+    size_t i, len;
+    ssl_handshake_params *hs;
 
-    while( ssl->state != SSL_HANDSHAKE_OVER )
+    for( i = 0; i < run->count; i++ )
     {
-        ret = ssl_handshake_step( ssl );
+        if( ( hs = run->hs[i] ) == NULL )
+            continue;
 
-        if( ret != 0 )
+        len = ( run->ops[i].type == RSA_SIGN ) ? run->key[i]->len
+                                               : run->ops[i].olen;
+
+        if( run->ops[i].ret == 0 )
+            memcpy( hs->rsa_op.output, run->ops[i].output, len );
+
+        hs->rsa_op.olen = run->ops[i].olen;
+        hs->rsa_op.ret = run->ops[i].ret;
+        hs->priv_op_ret = run->ops[i].ret;
+        hs->priv_op_len = len;
+        hs->priv_op_state = SSL_PRIV_OP_DONE;
+        hs->rsa_op_slot = NULL;
+        hs->rsa_op_batch = NULL;
+    }
+}
+
+static void ssl_rsa_batch_run_free( ssl_rsa_batch_run_ctx *run )
+{
+    if( run->buf != NULL )
+    {
+        /* Holds premaster secrets */
+        memset( run->buf, 0, run->buflen );
+        polarssl_free( run->buf );
+    }
+
+    memset( run, 0, sizeof( ssl_rsa_batch_run_ctx ) );
+}
+
+/*
+ * Take the queued operations, do them with the mutex released, and publish
+ * the results. If allocation fails, the operations fail with ret.
+ */
+int ssl_rsa_batch_run( ssl_rsa_batch *batch )
+{
+    int ret, r;
+    size_t i;
+    ssl_rsa_batch_run_ctx run;
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &batch->mutex ) != 0 )
+        return( POLARSSL_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    if( ( ret = ssl_rsa_batch_take( batch, &run ) ) != 0 )
+    {
+        for( i = 0; i < batch->count; i++ )
+        {
+            batch->queue[i]->priv_op_ret = ret;
+            batch->queue[i]->priv_op_state = SSL_PRIV_OP_DONE;
+            batch->queue[i]->rsa_op_batch = NULL;
+        }
+        batch->count = 0;
+    }
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &batch->mutex ) != 0 && ret == 0 )
+        ret = POLARSSL_ERR_THREADING_MUTEX_ERROR;
+#endif
+
+    if( run.count == 0 )
+        return( ret );
+
+    if( ( r = ssl_rsa_batch_compute( batch, &run ) ) != 0 && ret == 0 )
+        ret = r;
+
+#if defined(POLARSSL_THREADING_C)
+    /* The handshakes must not keep pointers into run, publish anyway */
+    if( polarssl_mutex_lock( &batch->mutex ) != 0 )
+        ret = POLARSSL_ERR_THREADING_MUTEX_ERROR;
+#endif
+
+    ssl_rsa_batch_publish( &run );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &batch->mutex ) != 0 )
+        ret = POLARSSL_ERR_THREADING_MUTEX_ERROR;
+#endif
+
+    ssl_rsa_batch_run_free( &run );
+
+    return( ret );
+}
+
+/*
+ * Queue the operation set up in ssl->handshake->rsa_op. Returns
+ * POLARSSL_ERR_SSL_PRIVATE_PENDING, or 0 if the batch got full and the
+ * operation is already done.
+ */
+int ssl_rsa_batch_queue( ssl_context *ssl )
+{
+    int full;
+    ssl_rsa_batch *batch = ssl->rsa_batch;
+    ssl_handshake_params *handshake = ssl->handshake;
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &batch->mutex ) != 0 )
+        return( POLARSSL_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    handshake->rsa_op_key = pk_rsa( *ssl_own_key( ssl ) );
+    handshake->rsa_op_batch = batch;
+    handshake->rsa_op_slot = NULL;
+    handshake->priv_op_state = SSL_PRIV_OP_QUEUED;
+
+    batch->queue[batch->count++] = handshake;
+    full = ( batch->count == SSL_MAX_RSA_BATCH );
+
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_unlock( &batch->mutex ) != 0 )
+        return( POLARSSL_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    if( !full )
+        return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+
+    SSL_DEBUG_MSG( 3, ( "RSA batch full, running it" ) );
+
+    /*
+     * A failure is reported in priv_op_ret of every handshake. Another
+     * thread may have run the batch meanwhile: ours is done either way,
+     * unless it is still in that thread's hands.
+     */
+    (void) ssl_rsa_batch_run( batch );
+
+    return( ssl_priv_op_state( ssl ) == SSL_PRIV_OP_DONE ?
+            0 : POLARSSL_ERR_SSL_PRIVATE_PENDING );
+}
+#endif /* POLARSSL_RSA_C && POLARSSL_X509_CRT_PARSE_C */
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+int ssl_set_async_private( ssl_context *ssl,
+        int (*f_async_sign)(void *, ssl_context *, pk_context *, md_type_t,
+                            const unsigned char *, size_t),
+        int (*f_async_decrypt)(void *, ssl_context *, pk_context *,
+                               const unsigned char *, size_t),
+        int (*f_async_resume)(void *, ssl_context *, unsigned char *,
+                              size_t *, size_t),
+        void (*f_async_cancel)(void *, ssl_context *),
+        void *p_async )
+{
+    /* A started operation could never complete */
+    if( f_async_resume == NULL &&
+        ( f_async_sign != NULL || f_async_decrypt != NULL ) )
+    {
+        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    ssl->f_async_sign       = f_async_sign;
+    ssl->f_async_decrypt    = f_async_decrypt;
+    ssl->f_async_resume     = f_async_resume;
+    ssl->f_async_cancel     = f_async_cancel;
+    ssl->p_async            = p_async;
+
+    return( 0 );
+}
+
+void ssl_set_async_operation_data( ssl_context *ssl, void *data )
+{
+    ssl->async_data = data;
+}
+
+void *ssl_get_async_operation_data( const ssl_context *ssl )
+{
+    return( ssl->async_data );
+}
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+/*
+ * State of the out of line private key operation: a queued one may be
+ * completed by another thread, a started asynchronous one is polled
+ */
+int ssl_priv_op_state( ssl_context *ssl )
+{
+    int state = ssl->handshake->priv_op_state;
+
+#if defined(POLARSSL_RSA_C)
+    if( ssl->rsa_batch != NULL )
+    {
+#if defined(POLARSSL_THREADING_C)
+        if( polarssl_mutex_lock( &ssl->rsa_batch->mutex ) != 0 )
+            return( SSL_PRIV_OP_QUEUED );
+#endif
+
+        state = ssl->handshake->priv_op_state;
+
+#if defined(POLARSSL_THREADING_C)
+        if( polarssl_mutex_unlock( &ssl->rsa_batch->mutex ) != 0 )
+            return( SSL_PRIV_OP_QUEUED );
+#endif
+    }
+#endif /* POLARSSL_RSA_C */
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+    if( state == SSL_PRIV_OP_ASYNC )
+    {
+        int ret;
+        size_t len = 0;
+        ssl_handshake_params *handshake = ssl->handshake;
+
+        ret = ssl->f_async_resume( ssl->p_async, ssl, handshake->priv_op_out,
+                                   &len, handshake->priv_op_out_max );
+        if( ret == POLARSSL_ERR_SSL_PRIVATE_PENDING )
+            return( state );
+
+        SSL_DEBUG_RET( 3, "f_async_resume", ret );
+
+        handshake->priv_op_ret = ret;
+        handshake->priv_op_len = len;
+        handshake->priv_op_state = state = SSL_PRIV_OP_DONE;
+        ssl->async_data = NULL;
+    }
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
+    return( state );
+}
+#endif /* POLARSSL_X509_CRT_PARSE_C */
+
+#if defined(POLARSSL_SSL_SESSION_TICKETS)
+int ssl_set_session_tickets( ssl_context *ssl, int use_tickets )
+{
+    ssl->session_tickets = use_tickets;
+
+    if( ssl->endpoint == SSL_IS_CLIENT || ssl->ticket_store != NULL )
+        return( 0 );
+
+    if( ssl->f_rng == NULL )
+        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+
+    return( ssl_ticket_keys_init( ssl ) );
+}
+
+void ssl_set_session_ticket_lifetime( ssl_context *ssl, int lifetime )
+{
+    ssl->ticket_lifetime = lifetime;
+}
+
+void ssl_set_session_ticket_store( ssl_context *ssl,
+                                   ssl_ticket_key_store *store )
+{
+    if( ssl->ticket_store_own_alloc )
+    {
+        ssl_ticket_store_free( ssl->ticket_store );
+        polarssl_free( ssl->ticket_store );
+    }
+
+    ssl->ticket_store = store;
+    ssl->ticket_store_own_alloc = 0;
+}
+#endif /* POLARSSL_SSL_SESSION_TICKETS */
+
+/*
+ * SSL get accessors
+ */
+size_t ssl_get_bytes_avail( const ssl_context *ssl )
+{
+    return( ssl->in_offt == NULL ? 0 : ssl->in_msglen );
+}
+
+int ssl_get_verify_result( const ssl_context *ssl )
+{
+    return( ssl->session->verify_result );
+}
+
+const char *ssl_get_ciphersuite( const ssl_context *ssl )
+{
+    if( ssl == NULL || ssl->session == NULL )
+        return NULL;
+
+    return ssl_get_ciphersuite_name( ssl->session->ciphersuite );
+}
+
+const char *ssl_get_version( const ssl_context *ssl )
+{
+    switch( ssl->minor_ver )
+    {
+        case SSL_MINOR_VERSION_0:
+            return( "SSLv3.0" );
+
+        case SSL_MINOR_VERSION_1:
+            return( "TLSv1.0" );
+
+        case SSL_MINOR_VERSION_2:
+            return( "TLSv1.1" );
+
+        case SSL_MINOR_VERSION_3:
+            return( "TLSv1.2" );
+
+        default:
+            break;
+    }
+    return( "unknown" );
+}
+
+#if defined(POLARSSL_X509_CRT_PARSE_C)
+const x509_crt *ssl_get_peer_cert( const ssl_context *ssl )
+{
+    if( ssl == NULL || ssl->session == NULL )
+        return NULL;
+
+    return ssl->session->peer_cert;
+}
+#endif /* POLARSSL_X509_CRT_PARSE_C */
+
+int ssl_get_session( const ssl_context *ssl, ssl_session *dst )
+{
+    if( ssl == NULL ||
+        dst == NULL ||
+        ssl->session == NULL ||
+        ssl->endpoint != SSL_IS_CLIENT )
+    {
+        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    return( ssl_session_copy( dst, ssl->session ) );
+}
+
+/*
+ * Perform a single step of the SSL handshake
+ */
+int ssl_handshake_step( ssl_context *ssl )
+{
+    int ret = POLARSSL_ERR_SSL_FEATURE_UNAVAILABLE;
+
+#if defined(POLARSSL_SSL_CLI_C)
+    if( ssl->endpoint == SSL_IS_CLIENT )
+        ret = ssl_handshake_client_step( ssl );
+#endif
+
+#if defined(POLARSSL_SSL_SRV_C)
+    if( ssl->endpoint == SSL_IS_SERVER )
+        ret = ssl_handshake_server_step( ssl );
+#endif
+
+    return( ret );
+}
+
+/*
+ * Perform the SSL handshake
+ */
+int ssl_handshake( ssl_context *ssl )
+{
+    int ret = 0;
+
+    SSL_DEBUG_MSG( 2, ( "=> handshake" ) );
+
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
+    while( ssl->state != SSL_HANDSHAKE_OVER )
+    {
+        ret = ssl_handshake_step( ssl );
+
+        if( ret != 0 )
             break;
     }
 
+#if defined(POLARSSL_SSL_MAX_FRAGMENT_LENGTH)
+    /*
+     * From now on records are limited to the negotiated maximum fragment
+     * length in both directions: shrink the buffers to it
+     */
+    if( ret == 0 && ssl_buffers_idle( ssl ) &&
+        mfl_code_to_length[ssl->session->mfl_code] < ssl->in_content_len )
+    {
+        SSL_DEBUG_MSG( 3, ( "shrinking record buffers to %d bytes",
+                       mfl_code_to_length[ssl->session->mfl_code] ) );
+
+        ret = ssl_resize_buffers( ssl,
+                                  mfl_code_to_length[ssl->session->mfl_code],
+                                  mfl_code_to_length[ssl->session->mfl_code],
+                                  ssl->out_records );
+    }
+#endif /* POLARSSL_SSL_MAX_FRAGMENT_LENGTH */
+
     SSL_DEBUG_MSG( 2, ( "<= handshake" ) );
 
     return( ret );
@@ -4200,6 +5273,16 @@ static int ssl_start_renegotiation( ssl_context *ssl )
 
     SSL_DEBUG_MSG( 2, ( "=> renegotiate" ) );
 
+    /*
+     * The new handshake may need the full buffers again
+     */
+    if( ( ret = ssl_resize_buffers( ssl, ssl->max_content_len,
+                                    ssl->max_content_len,
+                                    ssl->out_records ) ) != 0 )
+    {
+        return( ret );
+    }
+
     if( ( ret = ssl_handshake_init( ssl ) ) != 0 )
         return( ret );
 
@@ -4225,6 +5308,9 @@ int ssl_renegotiate( ssl_context *ssl )
 {
     int ret = POLARSSL_ERR_SSL_FEATURE_UNAVAILABLE;
 
+    if( ssl_buffers_acquire( ssl ) != 0 )
+        return( POLARSSL_ERR_SSL_MALLOC_FAILED );
+
 #if defined(POLARSSL_SSL_SRV_C)
     /* On server, just send the request */
     if( ssl->endpoint == SSL_IS_SERVER )
@@ -4266,14 +5352,15 @@ int ssl_renegotiate( ssl_context *ssl )
 }
 
 /*
- * Receive application data decrypted from the SSL layer
+ * Make sure decrypted application data is available at ssl->in_offt,
+ * reading a new record if needed. Returns POLARSSL_ERR_SSL_CONN_EOF on EOF.
  */
-int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
+static int ssl_read_app_data( ssl_context *ssl )
 {
     int ret;
-    size_t n;
 
-    SSL_DEBUG_MSG( 2, ( "=> read" ) );
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
 
     if( ssl->state != SSL_HANDSHAKE_OVER )
     {
@@ -4289,7 +5376,7 @@ int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
         if( ( ret = ssl_read_record( ssl ) ) != 0 )
         {
             if( ret == POLARSSL_ERR_SSL_CONN_EOF )
-                return( 0 );
+                return( ret );
 
             SSL_DEBUG_RET( 1, "ssl_read_record", ret );
             return( ret );
@@ -4304,7 +5391,7 @@ int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
             if( ( ret = ssl_read_record( ssl ) ) != 0 )
             {
                 if( ret == POLARSSL_ERR_SSL_CONN_EOF )
-                    return( 0 );
+                    return( ret );
 
                 SSL_DEBUG_RET( 1, "ssl_read_record", ret );
                 return( ret );
@@ -4384,6 +5471,30 @@ int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
         ssl->in_offt = ssl->in_msg;
     }
 
+    return( 0 );
+}
+
+/*
+ * Receive application data decrypted from the SSL layer
+ */
+int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
+{
+    int ret;
+    size_t n;
+
+    SSL_DEBUG_MSG( 2, ( "=> read" ) );
+
+    if( ( ret = ssl_read_app_data( ssl ) ) != 0 )
+    {
+        /* Typically nothing to read on an idle connection */
+        ssl_buffers_release( ssl );
+
+        if( ret == POLARSSL_ERR_SSL_CONN_EOF )
+            return( 0 );
+
+        return( ret );
+    }
+
     n = ( len < ssl->in_msglen )
         ? len : ssl->in_msglen;
 
@@ -4397,36 +5508,75 @@ int ssl_read( ssl_context *ssl, unsigned char *buf, size_t len )
         /* more data available */
         ssl->in_offt += n;
 
+    ssl_buffers_release( ssl );
+
     SSL_DEBUG_MSG( 2, ( "<= read" ) );
 
     return( (int) n );
 }
 
 /*
- * Send application data to be encrypted by the SSL layer
+ * Zero-copy read: lend the decrypted record to the caller
  */
-int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len )
+int ssl_read_get_buf( ssl_context *ssl, const unsigned char **buf,
+                      size_t *len )
 {
     int ret;
-    size_t n;
-    unsigned int max_len = SSL_MAX_CONTENT_LEN;
 
-    SSL_DEBUG_MSG( 2, ( "=> write" ) );
+    SSL_DEBUG_MSG( 2, ( "=> read get buf" ) );
 
-    if( ssl->state != SSL_HANDSHAKE_OVER )
+    *buf = NULL;
+    *len = 0;
+
+    if( ( ret = ssl_read_app_data( ssl ) ) != 0 )
     {
-        if( ( ret = ssl_handshake( ssl ) ) != 0 )
-        {
-            SSL_DEBUG_RET( 1, "ssl_handshake", ret );
-            return( ret );
-        }
+        ssl_buffers_release( ssl );
+
+        if( ret == POLARSSL_ERR_SSL_CONN_EOF )
+            return( 0 );
+
+        return( ret );
     }
 
+    *buf = ssl->in_offt;
+    *len = ssl->in_msglen;
+
+    SSL_DEBUG_MSG( 2, ( "<= read get buf" ) );
+
+    return( 0 );
+}
+
+int ssl_read_release( ssl_context *ssl, size_t len )
+{
+    if( ssl->in_offt == NULL || len > ssl->in_msglen )
+        return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+
+    ssl->in_msglen -= len;
+
+    if( ssl->in_msglen == 0 )
+        ssl->in_offt = NULL;
+    else
+        ssl->in_offt += len;
+
+    ssl_buffers_release( ssl );
+
+    return( 0 );
+}
+
+/*
+ * Maximum payload of an outgoing record, taking a negotiated maximum
+ * fragment length into account
+ */
+static size_t ssl_get_max_out_len( const ssl_context *ssl )
+{
+    size_t max_len = ssl->out_content_len;
+
 #if defined(POLARSSL_SSL_MAX_FRAGMENT_LENGTH)
     /*
      * Assume mfl_code is correct since it was checked when set
      */
-    max_len = mfl_code_to_length[ssl->mfl_code];
+    if( mfl_code_to_length[ssl->mfl_code] < max_len )
+        max_len = mfl_code_to_length[ssl->mfl_code];
 
     /*
      * Check if a smaller max length was negotiated
@@ -4438,7 +5588,59 @@ int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len )
     }
 #endif /* POLARSSL_SSL_MAX_FRAGMENT_LENGTH */
 
-    n = ( len < max_len) ? len : max_len;
+    return( max_len );
+}
+
+/*
+ * Send application data to be encrypted by the SSL layer
+ */
+int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len )
+{
+    int ret;
+    ssl_iovec iov;
+
+    SSL_DEBUG_MSG( 2, ( "=> write" ) );
+
+    iov.buf = buf;
+    iov.len = len;
+
+    ret = ssl_writev( ssl, &iov, 1 );
+
+    SSL_DEBUG_MSG( 2, ( "<= write" ) );
+
+    return( ret );
+}
+
+/*
+ * Send application data gathered from several buffers, packing it into
+ * maximal records and flushing them together
+ */
+int ssl_writev( ssl_context *ssl, const ssl_iovec *iov, size_t iovcnt )
+{
+    int ret;
+    size_t i, n, max_len, off = 0, written = 0, use_len;
+
+    SSL_DEBUG_MSG( 2, ( "=> writev" ) );
+
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
+    if( ssl->state != SSL_HANDSHAKE_OVER )
+    {
+        if( ( ret = ssl_handshake( ssl ) ) != 0 )
+        {
+            SSL_DEBUG_RET( 1, "ssl_handshake", ret );
+            return( ret );
+        }
+    }
+
+    max_len = ssl_get_max_out_len( ssl );
+
+    for( n = 0, i = 0; i < iovcnt; i++ )
+        n += iov[i].len;
+
+    if( n > ssl->out_records * max_len )
+        n = ssl->out_records * max_len;
 
     if( ssl->out_left != 0 )
     {
@@ -4447,12 +5649,126 @@ int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len )
             SSL_DEBUG_RET( 1, "ssl_flush_output", ret );
             return( ret );
         }
+
+        SSL_DEBUG_MSG( 2, ( "<= writev" ) );
+
+        return( (int) n );
+    }
+
+    i = 0;
+
+    do
+    {
+        /*
+         * Gather the next record from the buffers
+         */
+        ssl->out_msglen = 0;
+
+        while( ssl->out_msglen < max_len && written + ssl->out_msglen < n )
+        {
+            if( off == iov[i].len )
+            {
+                i++;
+                off = 0;
+                continue;
+            }
+
+            use_len = iov[i].len - off;
+            if( use_len > max_len - ssl->out_msglen )
+                use_len = max_len - ssl->out_msglen;
+            if( use_len > n - written - ssl->out_msglen )
+                use_len = n - written - ssl->out_msglen;
+
+            memcpy( ssl->out_msg + ssl->out_msglen, iov[i].buf + off, use_len );
+            ssl->out_msglen += use_len;
+            off += use_len;
+        }
+
+        written += ssl->out_msglen;
+        ssl->out_msgtype = SSL_MSG_APPLICATION_DATA;
+
+        /* Queue all records but the last one, which flushes them all */
+        if( ( ret = ssl_write_record_int( ssl, written < n ) ) != 0 )
+        {
+            SSL_DEBUG_RET( 1, "ssl_write_record", ret );
+            return( ret );
+        }
+    }
+    while( written < n );
+
+    ssl_buffers_release( ssl );
+
+    SSL_DEBUG_MSG( 2, ( "<= writev" ) );
+
+    return( (int) n );
+}
+
+/*
+ * Zero-copy write: lend the payload area of the outgoing record
+ */
+int ssl_write_get_buf( ssl_context *ssl, unsigned char **buf, size_t *len )
+{
+    int ret;
+
+    SSL_DEBUG_MSG( 2, ( "=> write get buf" ) );
+
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
+    if( ssl->state != SSL_HANDSHAKE_OVER )
+    {
+        if( ( ret = ssl_handshake( ssl ) ) != 0 )
+        {
+            SSL_DEBUG_RET( 1, "ssl_handshake", ret );
+            return( ret );
+        }
+    }
+
+    if( ( ret = ssl_flush_output( ssl ) ) != 0 )
+    {
+        SSL_DEBUG_RET( 1, "ssl_flush_output", ret );
+        return( ret );
+    }
+
+    *buf = ssl->out_msg;
+    *len = ssl_get_max_out_len( ssl );
+
+    SSL_DEBUG_MSG( 2, ( "<= write get buf" ) );
+
+    return( 0 );
+}
+
+/*
+ * Zero-copy write: seal the lent buffer in place and send it
+ */
+int ssl_write_commit( ssl_context *ssl, size_t len )
+{
+    int ret;
+
+    SSL_DEBUG_MSG( 2, ( "=> write commit" ) );
+
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
+    if( ssl->out_left != 0 )
+    {
+        /* Record already sealed by a previous call, finish sending it */
+        if( ( ret = ssl_flush_output( ssl ) ) != 0 )
+        {
+            SSL_DEBUG_RET( 1, "ssl_flush_output", ret );
+            return( ret );
+        }
     }
     else
     {
-        ssl->out_msglen  = n;
+        if( ssl->state != SSL_HANDSHAKE_OVER ||
+            len > ssl_get_max_out_len( ssl ) )
+        {
+            return( POLARSSL_ERR_SSL_BAD_INPUT_DATA );
+        }
+
+        ssl->out_msglen  = len;
         ssl->out_msgtype = SSL_MSG_APPLICATION_DATA;
-        memcpy( ssl->out_msg, buf, n );
 
         if( ( ret = ssl_write_record( ssl ) ) != 0 )
         {
@@ -4461,9 +5777,11 @@ int ssl_write( ssl_context *ssl, const unsigned char *buf, size_t len )
         }
     }
 
-    SSL_DEBUG_MSG( 2, ( "<= write" ) );
+    ssl_buffers_release( ssl );
 
-    return( (int) n );
+    SSL_DEBUG_MSG( 2, ( "<= write commit" ) );
+
+    return( (int) len );
 }
 
 /*
@@ -4475,6 +5793,9 @@ int ssl_close_notify( ssl_context *ssl )
 
     SSL_DEBUG_MSG( 2, ( "=> write close notify" ) );
 
+    if( ( ret = ssl_buffers_acquire( ssl ) ) != 0 )
+        return( ret );
+
     if( ( ret = ssl_flush_output( ssl ) ) != 0 )
     {
         SSL_DEBUG_RET( 1, "ssl_flush_output", ret );
@@ -4593,16 +5914,36 @@ void ssl_free( ssl_context *ssl )
 {
     SSL_DEBUG_MSG( 2, ( "=> free" ) );
 
-    if( ssl->out_ctr != NULL )
+    /*
+     * First take back a pending private key operation, which may still be
+     * reading from or writing to the record buffers
+     */
+    if( ssl->handshake )
+    {
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+        ssl_async_cancel( ssl );
+#endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+        ssl_rsa_batch_cancel( ssl );
+#endif
+        ssl_handshake_free( ssl->handshake );
+        ssl_transform_free( ssl->transform_negotiate );
+        ssl_session_free( ssl->session_negotiate );
+
+        polarssl_free( ssl->handshake );
+        polarssl_free( ssl->transform_negotiate );
+        polarssl_free( ssl->session_negotiate );
+    }
+
+    if( ssl->out_buf != NULL )
     {
-        memset( ssl->out_ctr, 0, SSL_BUFFER_LEN );
-        polarssl_free( ssl->out_ctr );
+        ssl_buffer_put( ssl, ssl->out_buf,
+                        ssl->out_records * SSL_OUT_BUFFER_LEN( ssl ) );
     }
 
     if( ssl->in_ctr != NULL )
     {
-        memset( ssl->in_ctr, 0, SSL_BUFFER_LEN );
-        polarssl_free( ssl->in_ctr );
+        ssl_buffer_put( ssl, ssl->in_ctr, SSL_IN_BUFFER_LEN( ssl ) );
     }
 
 #if defined(POLARSSL_ZLIB_SUPPORT)
@@ -4624,17 +5965,6 @@ void ssl_free( ssl_context *ssl )
         polarssl_free( ssl->transform );
     }
 
-    if( ssl->handshake )
-    {
-        ssl_handshake_free( ssl->handshake );
-        ssl_transform_free( ssl->transform_negotiate );
-        ssl_session_free( ssl->session_negotiate );
-
-        polarssl_free( ssl->handshake );
-        polarssl_free( ssl->transform_negotiate );
-        polarssl_free( ssl->session_negotiate );
-    }
-
     if( ssl->session )
     {
         ssl_session_free( ssl->session );
@@ -4642,7 +5972,11 @@ void ssl_free( ssl_context *ssl )
     }
 
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
-    polarssl_free( ssl->ticket_keys );
+    if( ssl->ticket_store_own_alloc )
+    {
+        ssl_ticket_store_free( ssl->ticket_store );
+        polarssl_free( ssl->ticket_store );
+    }
 #endif
 
 #if defined(POLARSSL_SSL_SERVER_NAME_INDICATION)
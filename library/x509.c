@@ -173,8 +173,6 @@ static int x509_get_attr_type_value( unsigned char **p,
     val->p = *p;
     *p += val->len;
 
-    cur->next = NULL;
-
     return( 0 );
 }
 
@@ -194,53 +192,105 @@ int x509_get_name( unsigned char **p, const unsigned char *end,
                    x509_name *cur )
 {
     int ret;
-    size_t len;
+    size_t len, count = 1, i;
+    unsigned char *q;
     const unsigned char *end2;
-    x509_name *use;
-
-    if( ( ret = asn1_get_tag( p, end, &len,
-            ASN1_CONSTRUCTED | ASN1_SET ) ) != 0 )
-        return( POLARSSL_ERR_X509_INVALID_NAME + ret );
+    x509_name tmp;
 
-    end2 = end;
-    end  = *p + len;
-    use = cur;
+    /*
+     * Walk the name once without storing it, to count the attributes so
+     * that the ones after cur can all be allocated at once. Errors are
+     * reported by the second walk below, which takes the same steps.
+     */
+    q = *p;
 
     do
     {
-        if( ( ret = x509_get_attr_type_value( p, end, use ) ) != 0 )
-            return( ret );
+        if( ( ret = asn1_get_tag( &q, end, &len,
+                ASN1_CONSTRUCTED | ASN1_SET ) ) != 0 )
+            break;
 
-        if( *p != end )
+        end2 = q + len;
+
+        do
         {
-            use->next = (x509_name *) polarssl_malloc(
-                    sizeof( x509_name ) );
+            if( ( ret = x509_get_attr_type_value( &q, end2, &tmp ) ) != 0 )
+                break;
 
-            if( use->next == NULL )
-                return( POLARSSL_ERR_X509_MALLOC_FAILED );
+            if( q != end )
+                count++;
+        }
+        while( q != end2 );
+    }
+    while( ret == 0 && q != end );
 
-            memset( use->next, 0, sizeof( x509_name ) );
+    if( count > 1 )
+    {
+        cur->next = (x509_name *) polarssl_malloc(
+                ( count - 1 ) * sizeof( x509_name ) );
 
-            use = use->next;
-        }
+        if( cur->next == NULL )
+            return( POLARSSL_ERR_X509_MALLOC_FAILED );
+
+        memset( cur->next, 0, ( count - 1 ) * sizeof( x509_name ) );
+
+        for( i = 0; i + 2 < count; i++ )
+            cur->next[i].next = &cur->next[i + 1];
     }
-    while( *p != end );
 
     /*
-     * recurse until end of SEQUENCE is reached
+     * Each RelativeDistinguishedName is a SET of attributes; the attributes
+     * of all of them are chained in order of appearance.
      */
-    if( *p == end2 )
-        return( 0 );
+    do
+    {
+        if( ( ret = asn1_get_tag( p, end, &len,
+                ASN1_CONSTRUCTED | ASN1_SET ) ) != 0 )
+            return( POLARSSL_ERR_X509_INVALID_NAME + ret );
 
-    cur->next = (x509_name *) polarssl_malloc(
-         sizeof( x509_name ) );
+        end2 = *p + len;
 
-    if( cur->next == NULL )
-        return( POLARSSL_ERR_X509_MALLOC_FAILED );
+        do
+        {
+            if( ( ret = x509_get_attr_type_value( p, end2, cur ) ) != 0 )
+                return( ret );
+
+            if( *p != end )
+            {
+                if( cur->next == NULL )
+                    return( POLARSSL_ERR_X509_INVALID_NAME +
+                            POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
+
+                cur = cur->next;
+            }
+        }
+        while( *p != end2 );
+    }
+    while( *p != end );
+
+    return( 0 );
+}
+
+/*
+ * Free the attributes following the first one of a name, which
+ * x509_get_name() allocates in a single block
+ */
+void x509_free_name( x509_name *name )
+{
+    size_t count = 0;
+    x509_name *cur;
+
+    if( name->next == NULL )
+        return;
+
+    for( cur = name->next; cur != NULL; cur = cur->next )
+        count++;
 
-    memset( cur->next, 0, sizeof( x509_name ) );
+    cur = name->next;
+    memset( cur, 0, count * sizeof( x509_name ) );
+    polarssl_free( cur );
 
-    return( x509_get_name( p, end2, cur->next ) );
+    name->next = NULL;
 }
 
 /*
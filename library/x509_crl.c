@@ -181,11 +181,12 @@ static int x509_get_crl_entry_ext( unsigned char **p,
  */
 static int x509_get_entries( unsigned char **p,
                              const unsigned char *end,
-                             x509_crl_entry *entry )
+                             x509_crl *crl )
 {
     int ret;
-    size_t entry_len;
-    x509_crl_entry *cur_entry = entry;
+    size_t entry_len, count = 0, i;
+    unsigned char *q;
+    x509_crl_entry *cur_entry = &crl->entry;
 
     if( *p == end )
         return( 0 );
@@ -201,6 +202,34 @@ static int x509_get_entries( unsigned char **p,
 
     end = *p + entry_len;
 
+    /*
+     * Count the entries first, so that they can all be allocated at once
+     */
+    for( q = *p; q < end; q += entry_len, count++ )
+    {
+        if( ( ret = asn1_get_tag( &q, end, &entry_len,
+                ASN1_SEQUENCE | ASN1_CONSTRUCTED ) ) != 0 )
+        {
+            return( ret );
+        }
+    }
+
+    if( count > 1 )
+    {
+        crl->entry.next = (x509_crl_entry *) polarssl_malloc(
+                                ( count - 1 ) * sizeof( x509_crl_entry ) );
+        if( crl->entry.next == NULL )
+            return( POLARSSL_ERR_X509_MALLOC_FAILED );
+
+        memset( crl->entry.next, 0, ( count - 1 ) * sizeof( x509_crl_entry ) );
+
+        /* Link the entries in order of appearance */
+        for( i = 0; i + 2 < count; i++ )
+            crl->entry.next[i].next = &crl->entry.next[i + 1];
+    }
+
+    crl->entry_count = count;
+
     while( *p < end )
     {
         size_t len2;
@@ -228,19 +257,56 @@ static int x509_get_entries( unsigned char **p,
 
         if ( *p < end )
         {
-            cur_entry->next = polarssl_malloc( sizeof( x509_crl_entry ) );
-
             if( cur_entry->next == NULL )
-                return( POLARSSL_ERR_X509_MALLOC_FAILED );
+                return( POLARSSL_ERR_X509_INVALID_FORMAT +
+                        POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
 
             cur_entry = cur_entry->next;
-            memset( cur_entry, 0, sizeof( x509_crl_entry ) );
         }
     }
 
     return( 0 );
 }
 
+/*
+ * Order of CRL entries by serial: by length, then by value
+ */
+static int x509_crl_entry_cmp( const void *a, const void *b )
+{
+    const x509_crl_entry *e1 = *(const x509_crl_entry **) a;
+    const x509_crl_entry *e2 = *(const x509_crl_entry **) b;
+
+    if( e1->serial.len != e2->serial.len )
+        return( e1->serial.len < e2->serial.len ? -1 : 1 );
+
+    return( memcmp( e1->serial.p, e2->serial.p, e1->serial.len ) );
+}
+
+/*
+ * Build the index of the entries sorted by serial
+ */
+static int x509_crl_index_entries( x509_crl *crl )
+{
+    size_t i;
+    x509_crl_entry *cur;
+
+    if( crl->entry_count == 0 )
+        return( 0 );
+
+    crl->entry_index = (x509_crl_entry **) polarssl_malloc(
+                            crl->entry_count * sizeof( x509_crl_entry * ) );
+    if( crl->entry_index == NULL )
+        return( POLARSSL_ERR_X509_MALLOC_FAILED );
+
+    for( i = 0, cur = &crl->entry; i < crl->entry_count; i++, cur = cur->next )
+        crl->entry_index[i] = cur;
+
+    qsort( crl->entry_index, crl->entry_count, sizeof( x509_crl_entry * ),
+           x509_crl_entry_cmp );
+
+    return( 0 );
+}
+
 /*
  * Parse one or more CRLs and add them to the chained list
  */
@@ -444,7 +510,8 @@ int x509_crl_parse( x509_crl *chain, const unsigned char *buf, size_t buflen )
      *                                   -- if present, MUST be v2
      *                        } OPTIONAL
      */
-    if( ( ret = x509_get_entries( &p, end, &crl->entry ) ) != 0 )
+    if( ( ret = x509_get_entries( &p, end, crl ) ) != 0 ||
+        ( ret = x509_crl_index_entries( crl ) ) != 0 )
     {
         x509_crl_free( crl );
         return( ret );
@@ -696,34 +763,23 @@ void x509_crl_free( x509_crl *crl )
 {
     x509_crl *crl_cur = crl;
     x509_crl *crl_prv;
-    x509_name *name_cur;
-    x509_name *name_prv;
-    x509_crl_entry *entry_cur;
-    x509_crl_entry *entry_prv;
 
     if( crl == NULL )
         return;
 
     do
     {
-        name_cur = crl_cur->issuer.next;
-        while( name_cur != NULL )
-        {
-            name_prv = name_cur;
-            name_cur = name_cur->next;
-            memset( name_prv, 0, sizeof( x509_name ) );
-            polarssl_free( name_prv );
-        }
+        x509_free_name( &crl_cur->issuer );
 
-        entry_cur = crl_cur->entry.next;
-        while( entry_cur != NULL )
+        if( crl_cur->entry.next != NULL )
         {
-            entry_prv = entry_cur;
-            entry_cur = entry_cur->next;
-            memset( entry_prv, 0, sizeof( x509_crl_entry ) );
-            polarssl_free( entry_prv );
+            memset( crl_cur->entry.next, 0,
+                    ( crl_cur->entry_count - 1 ) * sizeof( x509_crl_entry ) );
+            polarssl_free( crl_cur->entry.next );
         }
 
+        polarssl_free( crl_cur->entry_index );
+
         if( crl_cur->raw.p != NULL )
         {
             memset( crl_cur->raw.p, 0, crl_cur->raw.len );
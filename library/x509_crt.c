@@ -55,6 +55,10 @@
 #include "polarssl/threading.h"
 #endif
 
+#if defined(POLARSSL_SHA256_C)
+#include "polarssl/sha256.h"
+#endif
+
 #include <string.h>
 #include <stdlib.h>
 #if defined(_WIN32) && !defined(EFIX64) && !defined(EFI32)
@@ -379,6 +383,73 @@ static int x509_get_subject_alt_name( unsigned char **p,
     return( 0 );
 }
 
+/*
+ * SubjectKeyIdentifier ::= KeyIdentifier
+ *
+ * KeyIdentifier ::= OCTET STRING
+ */
+static int x509_get_subject_key_id( unsigned char **p,
+                                    const unsigned char *end,
+                                    x509_buf *key_id )
+{
+    int ret;
+    size_t len;
+
+    if( ( ret = asn1_get_tag( p, end, &len, ASN1_OCTET_STRING ) ) != 0 )
+        return( POLARSSL_ERR_X509_INVALID_EXTENSIONS + ret );
+
+    if( *p + len != end )
+        return( POLARSSL_ERR_X509_INVALID_EXTENSIONS +
+                POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
+
+    key_id->tag = ASN1_OCTET_STRING;
+    key_id->len = len;
+    key_id->p = *p;
+    *p += len;
+
+    return( 0 );
+}
+
+/*
+ * AuthorityKeyIdentifier ::= SEQUENCE {
+ *      keyIdentifier             [0] KeyIdentifier           OPTIONAL,
+ *      authorityCertIssuer       [1] GeneralNames            OPTIONAL,
+ *      authorityCertSerialNumber [2] CertificateSerialNumber OPTIONAL  }
+ *
+ * NOTE: only keyIdentifier is kept.
+ */
+static int x509_get_authority_key_id( unsigned char **p,
+                                      const unsigned char *end,
+                                      x509_buf *key_id )
+{
+    int ret;
+    size_t len;
+
+    if( ( ret = asn1_get_tag( p, end, &len,
+            ASN1_CONSTRUCTED | ASN1_SEQUENCE ) ) != 0 )
+        return( POLARSSL_ERR_X509_INVALID_EXTENSIONS + ret );
+
+    if( *p + len != end )
+        return( POLARSSL_ERR_X509_INVALID_EXTENSIONS +
+                POLARSSL_ERR_ASN1_LENGTH_MISMATCH );
+
+    if( *p < end && **p == ( ASN1_CONTEXT_SPECIFIC | 0 ) )
+    {
+        if( ( ret = asn1_get_tag( p, end, &len,
+                ASN1_CONTEXT_SPECIFIC | 0 ) ) != 0 )
+            return( POLARSSL_ERR_X509_INVALID_EXTENSIONS + ret );
+
+        key_id->tag = ASN1_CONTEXT_SPECIFIC;
+        key_id->len = len;
+        key_id->p = *p;
+    }
+
+    /* Skip authorityCertIssuer and authorityCertSerialNumber */
+    *p = (unsigned char *) end;
+
+    return( 0 );
+}
+
 /*
  * X.509 v3 extensions
  *
@@ -509,6 +580,20 @@ static int x509_get_crt_ext( unsigned char **p,
                 return ( ret );
             break;
 
+        case EXT_SUBJECT_KEY_IDENTIFIER:
+            /* Parse subject key identifier */
+            if( ( ret = x509_get_subject_key_id( p, end_ext_octet,
+                    &crt->subject_key_id ) ) != 0 )
+                return ( ret );
+            break;
+
+        case EXT_AUTHORITY_KEY_IDENTIFIER:
+            /* Parse authority key identifier */
+            if( ( ret = x509_get_authority_key_id( p, end_ext_octet,
+                    &crt->authority_key_id ) ) != 0 )
+                return ( ret );
+            break;
+
         default:
             return( POLARSSL_ERR_X509_FEATURE_UNAVAILABLE );
         }
@@ -525,7 +610,7 @@ static int x509_get_crt_ext( unsigned char **p,
  * Parse and fill a single X.509 certificate in DER format
  */
 static int x509_crt_parse_der_core( x509_crt *crt, const unsigned char *buf,
-                                    size_t buflen )
+                                    size_t buflen, int make_copy )
 {
     int ret;
     size_t len;
@@ -537,13 +622,21 @@ static int x509_crt_parse_der_core( x509_crt *crt, const unsigned char *buf,
     if( crt == NULL || buf == NULL )
         return( POLARSSL_ERR_X509_BAD_INPUT_DATA );
 
-    p = (unsigned char *) polarssl_malloc( len = buflen );
+    len = buflen;
 
-    if( p == NULL )
-        return( POLARSSL_ERR_X509_MALLOC_FAILED );
+    if( make_copy != 0 )
+    {
+        p = (unsigned char *) polarssl_malloc( len );
+
+        if( p == NULL )
+            return( POLARSSL_ERR_X509_MALLOC_FAILED );
 
-    memcpy( p, buf, buflen );
+        memcpy( p, buf, buflen );
+    }
+    else
+        p = (unsigned char *) buf;
 
+    crt->own_buffer = make_copy;
     crt->raw.p = p;
     crt->raw.len = len;
     end = p + len;
@@ -763,12 +856,114 @@ static int x509_crt_parse_der_core( x509_crt *crt, const unsigned char *buf,
     return( 0 );
 }
 
+/*
+ * FNV-1a hash of a name or key identifier, with a final avalanche step so
+ * that the low bits used for slot selection depend on every byte
+ */
+static uint32_t x509_crt_hash( const unsigned char *p, size_t len )
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return( h );
+}
+
+static void x509_crt_index_free( x509_crt *chain )
+{
+    x509_crt_index *index = chain->index;
+
+    if( index == NULL )
+        return;
+
+    polarssl_free( index->subject );
+    polarssl_free( index->key_id );
+    memset( index, 0, sizeof( x509_crt_index ) );
+    polarssl_free( index );
+
+    chain->index = NULL;
+}
+
+/*
+ * Put crt in the first free slot for key, after the certificates with the
+ * same key that are already there
+ */
+static void x509_crt_index_insert( x509_crt **table, size_t size,
+                                   const x509_buf *key, x509_crt *crt )
+{
+    size_t i = x509_crt_hash( key->p, key->len ) & ( size - 1 );
+
+    while( table[i] != NULL )
+        i = ( i + 1 ) & ( size - 1 );
+
+    table[i] = crt;
+}
+
+int x509_crt_index_build( x509_crt *chain )
+{
+    size_t count = 0, size = 1;
+    x509_crt *cur;
+    x509_crt_index *index;
+
+    x509_crt_index_free( chain );
+
+    for( cur = chain; cur != NULL && cur->version != 0; cur = cur->next )
+        count++;
+
+    /* At most half full, so that probe sequences stay short */
+    while( size < 2 * count )
+        size <<= 1;
+
+    index = (x509_crt_index *) polarssl_malloc( sizeof( x509_crt_index ) );
+    if( index == NULL )
+        return( POLARSSL_ERR_X509_MALLOC_FAILED );
+
+    memset( index, 0, sizeof( x509_crt_index ) );
+    index->size = size;
+    chain->index = index;
+
+    index->subject = (x509_crt **) polarssl_malloc( size * sizeof( x509_crt * ) );
+    index->key_id  = (x509_crt **) polarssl_malloc( size * sizeof( x509_crt * ) );
+
+    if( index->subject == NULL || index->key_id == NULL )
+    {
+        x509_crt_index_free( chain );
+        return( POLARSSL_ERR_X509_MALLOC_FAILED );
+    }
+
+    memset( index->subject, 0, size * sizeof( x509_crt * ) );
+    memset( index->key_id,  0, size * sizeof( x509_crt * ) );
+
+    for( cur = chain; cur != NULL && cur->version != 0; cur = cur->next )
+    {
+        x509_crt_index_insert( index->subject, size, &cur->subject_raw, cur );
+
+        if( cur->subject_key_id.len != 0 )
+            x509_crt_index_insert( index->key_id, size,
+                                   &cur->subject_key_id, cur );
+    }
+
+    return( 0 );
+}
+
 /*
  * Parse one X.509 certificate in DER format from a buffer and add them to a
- * chained list
+ * chained list, referencing the buffer or a copy of it
  */
-int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
-                        size_t buflen )
+static int x509_crt_parse_der_internal( x509_crt *chain,
+                                        const unsigned char *buf,
+                                        size_t buflen, int make_copy )
 {
     int ret;
     x509_crt *crt = chain, *prev = NULL;
@@ -779,6 +974,10 @@ int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
     if( crt == NULL || buf == NULL )
         return( POLARSSL_ERR_X509_BAD_INPUT_DATA );
 
+    /* The index would miss the new certificate */
+    if( chain->index != NULL )
+        x509_crt_index_free( chain );
+
     while( crt->version != 0 && crt->next != NULL )
     {
         prev = crt;
@@ -800,7 +999,7 @@ int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
         x509_crt_init( crt );
     }
 
-    if( ( ret = x509_crt_parse_der_core( crt, buf, buflen ) ) != 0 )
+    if( ( ret = x509_crt_parse_der_core( crt, buf, buflen, make_copy ) ) != 0 )
     {
         if( prev )
             prev->next = NULL;
@@ -814,6 +1013,18 @@ int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
     return( 0 );
 }
 
+int x509_crt_parse_der( x509_crt *chain, const unsigned char *buf,
+                        size_t buflen )
+{
+    return( x509_crt_parse_der_internal( chain, buf, buflen, 1 ) );
+}
+
+int x509_crt_parse_der_nocopy( x509_crt *chain, const unsigned char *buf,
+                               size_t buflen )
+{
+    return( x509_crt_parse_der_internal( chain, buf, buflen, 0 ) );
+}
+
 /*
  * Parse one or more PEM certificates from a buffer and add them to the chained list
  */
@@ -1046,121 +1257,469 @@ cleanup:
 
     return( ret );
 }
-#endif /* POLARSSL_FS_IO */
 
-#if defined(_MSC_VER) && !defined snprintf && !defined(EFIX64) && \
-    !defined(EFI32)
-#include <stdarg.h>
+#if defined(POLARSSL_THREADING_PTHREAD) && \
+    ( !defined(_WIN32) || defined(EFIX64) || defined(EFI32) )
+/*
+ * Free a list of file names
+ */
+static void x509_crt_path_names_free( char **names, size_t count )
+{
+    size_t i;
 
-#if !defined vsnprintf
-#define vsnprintf _vsnprintf
-#endif // vsnprintf
+    for( i = 0; i < count; i++ )
+        polarssl_free( names[i] );
+
+    polarssl_free( names );
+}
 
 /*
- * Windows _snprintf and _vsnprintf are not compatible to linux versions.
- * Result value is not size of buffer needed, but -1 if no fit is possible.
- *
- * This fuction tries to 'fix' this by at least suggesting enlarging the
- * size by 20.
+ * List the regular files of a directory, in directory order
  */
-static int compat_snprintf(char *str, size_t size, const char *format, ...)
+static int x509_crt_path_names( const char *path,
+                                char ***names, size_t *count )
 {
-    va_list ap;
-    int res = -1;
+    int ret = 0;
+    struct stat sb;
+    struct dirent *entry;
+    char entry_name[255];
+    char **list = NULL, **tmp;
+    size_t size = 0, n = 0, len;
+    DIR *dir = opendir( path );
 
-    va_start( ap, format );
+    if( dir == NULL)
+        return( POLARSSL_ERR_X509_FILE_IO_ERROR );
 
-    res = vsnprintf( str, size, format, ap );
+    if( ( ret = polarssl_mutex_lock( &readdir_mutex ) ) != 0 )
+    {
+        closedir( dir );
+        return( ret );
+    }
 
-    va_end( ap );
+    while( ( entry = readdir( dir ) ) != NULL )
+    {
+        snprintf( entry_name, sizeof entry_name, "%s/%s", path, entry->d_name );
 
-    // No quick fix possible
-    if ( res < 0 )
-        return( (int) size + 20 );
+        if( stat( entry_name, &sb ) == -1 )
+        {
+            ret = POLARSSL_ERR_X509_FILE_IO_ERROR;
+            break;
+        }
 
-    return res;
-}
+        if( !S_ISREG( sb.st_mode ) )
+            continue;
 
-#define snprintf compat_snprintf
-#endif
+        if( n == size )
+        {
+            size = ( size == 0 ) ? 64 : 2 * size;
 
-#define POLARSSL_ERR_DEBUG_BUF_TOO_SMALL    -2
+            tmp = (char **) polarssl_malloc( size * sizeof( char * ) );
+            if( tmp == NULL )
+            {
+                ret = POLARSSL_ERR_X509_MALLOC_FAILED;
+                break;
+            }
 
-#define SAFE_SNPRINTF()                         \
-{                                               \
-    if( ret == -1 )                             \
-        return( -1 );                           \
-                                                \
-    if ( (unsigned int) ret > n ) {             \
-        p[n - 1] = '\0';                        \
-        return POLARSSL_ERR_DEBUG_BUF_TOO_SMALL;\
-    }                                           \
-                                                \
-    n -= (unsigned int) ret;                    \
-    p += (unsigned int) ret;                    \
-}
+            if( n != 0 )
+                memcpy( tmp, list, n * sizeof( char * ) );
 
-static int x509_info_subject_alt_name( char **buf, size_t *size,
-                                       const x509_sequence *subject_alt_name )
-{
-    size_t i;
-    size_t n = *size;
-    char *p = *buf;
-    const x509_sequence *cur = subject_alt_name;
-    const char *sep = "";
-    size_t sep_len = 0;
+            polarssl_free( list );
+            list = tmp;
+        }
 
-    while( cur != NULL )
-    {
-        if( cur->buf.len + sep_len >= n )
+        len = strlen( entry_name ) + 1;
+
+        if( ( list[n] = (char *) polarssl_malloc( len ) ) == NULL )
         {
-            *p = '\0';
-            return( POLARSSL_ERR_DEBUG_BUF_TOO_SMALL );
+            ret = POLARSSL_ERR_X509_MALLOC_FAILED;
+            break;
         }
 
-        n -= cur->buf.len + sep_len;
-        for( i = 0; i < sep_len; i++ )
-            *p++ = sep[i];
-        for( i = 0; i < cur->buf.len; i++ )
-            *p++ = cur->buf.p[i];
+        memcpy( list[n++], entry_name, len );
+    }
+    closedir( dir );
 
-        sep = ", ";
-        sep_len = 2;
+    if( polarssl_mutex_unlock( &readdir_mutex ) != 0 )
+        ret = POLARSSL_ERR_THREADING_MUTEX_ERROR;
 
-        cur = cur->next;
+    if( ret != 0 )
+    {
+        x509_crt_path_names_free( list, n );
+        return( ret );
     }
 
-    *p = '\0';
-
-    *size = n;
-    *buf = p;
+    *names = list;
+    *count = n;
 
     return( 0 );
 }
 
-#define PRINT_ITEM(i)                           \
-    {                                           \
-        ret = snprintf( p, n, "%s" i, sep );    \
-        SAFE_SNPRINTF();                        \
-        sep = ", ";                             \
+/*
+ * Range of files parsed by one thread into its own chain
+ */
+typedef struct
+{
+    char **names;
+    size_t count;
+    x509_crt *chain;
+    int ret;
+}
+x509_crt_path_job;
+
+static void *x509_crt_path_worker( void *arg )
+{
+    x509_crt_path_job *job = (x509_crt_path_job *) arg;
+    x509_crt *tail = job->chain;
+    size_t i;
+    int t_ret;
+
+    for( i = 0; i < job->count; i++ )
+    {
+        /* Append from the tail, not from the head of the chain */
+        while( tail->next != NULL )
+            tail = tail->next;
+
+        // Ignore parse errors
+        //
+        t_ret = x509_crt_parse_file( tail, job->names[i] );
+        if( t_ret < 0 )
+            job->ret++;
+        else
+            job->ret += t_ret;
     }
 
-#define CERT_TYPE(type,name)                    \
-    if( ns_cert_type & type )                   \
-        PRINT_ITEM( name );
+    return( NULL );
+}
+#endif /* POLARSSL_THREADING_PTHREAD && !_WIN32 */
 
-static int x509_info_cert_type( char **buf, size_t *size,
-                                unsigned char ns_cert_type )
+int x509_crt_parse_path_parallel( x509_crt *chain, const char *path,
+                                  int threads )
 {
+#if defined(POLARSSL_THREADING_PTHREAD) && \
+    ( !defined(_WIN32) || defined(EFIX64) || defined(EFI32) )
     int ret;
-    size_t n = *size;
-    char *p = *buf;
-    const char *sep = "";
+    size_t count, i, n;
+    char **names;
+    x509_crt *tail;
+    x509_crt_path_job *jobs;
+    pthread_t *tids;
+    int *started;
+
+    if( ( ret = x509_crt_path_names( path, &names, &count ) ) != 0 )
+        return( ret );
 
-    CERT_TYPE( NS_CERT_TYPE_SSL_CLIENT,         "SSL Client" );
-    CERT_TYPE( NS_CERT_TYPE_SSL_SERVER,         "SSL Server" );
-    CERT_TYPE( NS_CERT_TYPE_EMAIL,              "Email" );
-    CERT_TYPE( NS_CERT_TYPE_OBJECT_SIGNING,     "Object Signing" );
+    n = ( threads < 1 ) ? 1 : (size_t) threads;
+    if( n > count )
+        n = ( count == 0 ) ? 1 : count;
+
+    jobs = (x509_crt_path_job *) polarssl_malloc( n * sizeof( *jobs ) );
+    tids = (pthread_t *) polarssl_malloc( n * sizeof( *tids ) );
+    started = (int *) polarssl_malloc( n * sizeof( *started ) );
+
+    if( jobs == NULL || tids == NULL || started == NULL )
+    {
+        ret = POLARSSL_ERR_X509_MALLOC_FAILED;
+        n = 0;
+        goto cleanup;
+    }
+
+    for( i = 0; i < n; i++ )
+    {
+        jobs[i].names = names + i * count / n;
+        jobs[i].count = ( i + 1 ) * count / n - i * count / n;
+        jobs[i].ret = 0;
+        jobs[i].chain = (x509_crt *) polarssl_malloc( sizeof( x509_crt ) );
+
+        if( jobs[i].chain == NULL )
+        {
+            ret = POLARSSL_ERR_X509_MALLOC_FAILED;
+            n = i;
+            goto cleanup;
+        }
+
+        x509_crt_init( jobs[i].chain );
+    }
+
+    /*
+     * The calling thread takes the first range, and any range that a
+     * thread could not be created for
+     */
+    for( i = 1; i < n; i++ )
+        started[i] = pthread_create( &tids[i], NULL, x509_crt_path_worker,
+                                     &jobs[i] ) == 0;
+
+    x509_crt_path_worker( &jobs[0] );
+
+    for( i = 1; i < n; i++ )
+    {
+        if( started[i] )
+            pthread_join( tids[i], NULL );
+        else
+            x509_crt_path_worker( &jobs[i] );
+    }
+
+    /*
+     * Append the chains in the order of the ranges
+     */
+    if( chain->index != NULL )
+        x509_crt_index_free( chain );
+
+    tail = chain;
+    while( tail->next != NULL )
+        tail = tail->next;
+
+    for( i = 0; i < n; i++ )
+    {
+        ret += jobs[i].ret;
+
+        if( jobs[i].chain->version == 0 )
+        {
+            x509_crt_free( jobs[i].chain );
+            polarssl_free( jobs[i].chain );
+        }
+        else if( tail->version == 0 )
+        {
+            *tail = *jobs[i].chain;
+            polarssl_free( jobs[i].chain );
+        }
+        else
+            tail->next = jobs[i].chain;
+
+        while( tail->next != NULL )
+            tail = tail->next;
+    }
+
+    n = 0;
+
+cleanup:
+    for( i = 0; i < n; i++ )
+    {
+        x509_crt_free( jobs[i].chain );
+        polarssl_free( jobs[i].chain );
+    }
+
+    polarssl_free( started );
+    polarssl_free( tids );
+    polarssl_free( jobs );
+    x509_crt_path_names_free( names, count );
+
+    return( ret );
+#else
+    ((void) threads);
+    return( x509_crt_parse_path( chain, path ) );
+#endif /* POLARSSL_THREADING_PTHREAD && !_WIN32 */
+}
+
+int x509_crt_save_bundle( const x509_crt *chain, const char *path )
+{
+    int ret = 0;
+    FILE *f;
+    size_t len;
+    unsigned char *p;
+    const x509_crt *cur;
+
+    if( ( f = fopen( path, "wb" ) ) == NULL )
+        return( POLARSSL_ERR_X509_FILE_IO_ERROR );
+
+    for( cur = chain; cur != NULL && cur->version != 0; cur = cur->next )
+    {
+        /* Only the certificate, not what followed it in the parsed buffer */
+        p = cur->raw.p;
+        if( asn1_get_tag( &p, cur->raw.p + cur->raw.len, &len,
+                          ASN1_CONSTRUCTED | ASN1_SEQUENCE ) != 0 )
+        {
+            ret = POLARSSL_ERR_X509_FILE_IO_ERROR;
+            break;
+        }
+
+        len += p - cur->raw.p;
+
+        if( fwrite( cur->raw.p, 1, len, f ) != len )
+        {
+            ret = POLARSSL_ERR_X509_FILE_IO_ERROR;
+            break;
+        }
+    }
+
+    fclose( f );
+
+    return( ret );
+}
+
+int x509_crt_parse_bundle( x509_crt *chain, const char *path )
+{
+    int ret;
+    size_t n, len;
+    unsigned char *buf, *p, *q, *end;
+    x509_crt *tail, *first = NULL;
+
+    if( chain == NULL )
+        return( POLARSSL_ERR_X509_BAD_INPUT_DATA );
+
+    if( ( ret = x509_load_file( path, &buf, &n ) ) != 0 )
+        return( ret );
+
+    if( chain->index != NULL )
+        x509_crt_index_free( chain );
+
+    tail = chain;
+    while( tail->next != NULL )
+        tail = tail->next;
+
+    p = buf;
+    end = buf + n;
+
+    while( p < end )
+    {
+        q = p;
+        if( ( ret = asn1_get_tag( &q, end, &len,
+                ASN1_CONSTRUCTED | ASN1_SEQUENCE ) ) != 0 )
+        {
+            ret = POLARSSL_ERR_X509_INVALID_FORMAT + ret;
+            break;
+        }
+
+        len += q - p;
+
+        if( ( ret = x509_crt_parse_der_nocopy( tail, p, len ) ) != 0 )
+            break;
+
+        while( tail->next != NULL )
+            tail = tail->next;
+
+        /* The first certificate owns the buffer */
+        if( first == NULL )
+        {
+            first = tail;
+            first->own_buffer = 1;
+        }
+
+        p += len;
+    }
+
+    if( first == NULL )
+    {
+        memset( buf, 0, n );
+        polarssl_free( buf );
+    }
+
+    return( ret );
+}
+#endif /* POLARSSL_FS_IO */
+
+#if defined(_MSC_VER) && !defined snprintf && !defined(EFIX64) && \
+    !defined(EFI32)
+#include <stdarg.h>
+
+#if !defined vsnprintf
+#define vsnprintf _vsnprintf
+#endif // vsnprintf
+
+/*
+ * Windows _snprintf and _vsnprintf are not compatible to linux versions.
+ * Result value is not size of buffer needed, but -1 if no fit is possible.
+ *
+ * This fuction tries to 'fix' this by at least suggesting enlarging the
+ * size by 20.
+ */
+static int compat_snprintf(char *str, size_t size, const char *format, ...)
+{
+    va_list ap;
+    int res = -1;
+
+    va_start( ap, format );
+
+    res = vsnprintf( str, size, format, ap );
+
+    va_end( ap );
+
+    // No quick fix possible
+    if ( res < 0 )
+        return( (int) size + 20 );
+
+    return res;
+}
+
+#define snprintf compat_snprintf
+#endif
+
+#define POLARSSL_ERR_DEBUG_BUF_TOO_SMALL    -2
+
+#define SAFE_SNPRINTF()                         \
+{                                               \
+    if( ret == -1 )                             \
+        return( -1 );                           \
+                                                \
+    if ( (unsigned int) ret > n ) {             \
+        p[n - 1] = '\0';                        \
+        return POLARSSL_ERR_DEBUG_BUF_TOO_SMALL;\
+    }                                           \
+                                                \
+    n -= (unsigned int) ret;                    \
+    p += (unsigned int) ret;                    \
+}
+
+static int x509_info_subject_alt_name( char **buf, size_t *size,
+                                       const x509_sequence *subject_alt_name )
+{
+    size_t i;
+    size_t n = *size;
+    char *p = *buf;
+    const x509_sequence *cur = subject_alt_name;
+    const char *sep = "";
+    size_t sep_len = 0;
+
+    while( cur != NULL )
+    {
+        if( cur->buf.len + sep_len >= n )
+        {
+            *p = '\0';
+            return( POLARSSL_ERR_DEBUG_BUF_TOO_SMALL );
+        }
+
+        n -= cur->buf.len + sep_len;
+        for( i = 0; i < sep_len; i++ )
+            *p++ = sep[i];
+        for( i = 0; i < cur->buf.len; i++ )
+            *p++ = cur->buf.p[i];
+
+        sep = ", ";
+        sep_len = 2;
+
+        cur = cur->next;
+    }
+
+    *p = '\0';
+
+    *size = n;
+    *buf = p;
+
+    return( 0 );
+}
+
+#define PRINT_ITEM(i)                           \
+    {                                           \
+        ret = snprintf( p, n, "%s" i, sep );    \
+        SAFE_SNPRINTF();                        \
+        sep = ", ";                             \
+    }
+
+#define CERT_TYPE(type,name)                    \
+    if( ns_cert_type & type )                   \
+        PRINT_ITEM( name );
+
+static int x509_info_cert_type( char **buf, size_t *size,
+                                unsigned char ns_cert_type )
+{
+    int ret;
+    size_t n = *size;
+    char *p = *buf;
+    const char *sep = "";
+
+    CERT_TYPE( NS_CERT_TYPE_SSL_CLIENT,         "SSL Client" );
+    CERT_TYPE( NS_CERT_TYPE_SSL_SERVER,         "SSL Server" );
+    CERT_TYPE( NS_CERT_TYPE_EMAIL,              "Email" );
+    CERT_TYPE( NS_CERT_TYPE_OBJECT_SIGNING,     "Object Signing" );
     CERT_TYPE( NS_CERT_TYPE_RESERVED,           "Reserved" );
     CERT_TYPE( NS_CERT_TYPE_SSL_CA,             "SSL CA" );
     CERT_TYPE( NS_CERT_TYPE_EMAIL_CA,           "Email CA" );
@@ -1410,6 +1969,48 @@ int x509_crt_check_extended_key_usage( const x509_crt *crt,
 int x509_crt_revoked( const x509_crt *crt, const x509_crl *crl )
 {
     const x509_crl_entry *cur = &crl->entry;
+    size_t lo, hi, mid;
+    int cmp;
+
+    if( crl->entry_index != NULL )
+    {
+        /*
+         * Binary search for the first entry with the serial of crt, in the
+         * order of x509_crl_parse(): by length, then by value
+         */
+        lo = 0;
+        hi = crl->entry_count;
+
+        while( lo < hi )
+        {
+            mid = lo + ( hi - lo ) / 2;
+            cur = crl->entry_index[mid];
+
+            if( cur->serial.len != crt->serial.len )
+                cmp = cur->serial.len < crt->serial.len ? -1 : 1;
+            else
+                cmp = memcmp( cur->serial.p, crt->serial.p, crt->serial.len );
+
+            if( cmp < 0 )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        for( ; lo < crl->entry_count; lo++ )
+        {
+            cur = crl->entry_index[lo];
+
+            if( crt->serial.len != cur->serial.len ||
+                memcmp( crt->serial.p, cur->serial.p, crt->serial.len ) != 0 )
+                break;
+
+            if( x509_time_expired( &cur->revocation_date ) )
+                return( 1 );
+        }
+
+        return( 0 );
+    }
 
     while( cur != NULL && cur->serial.len != 0 )
     {
@@ -1594,11 +2195,109 @@ static int x509_crt_check_parent( const x509_crt *child,
     return( 0 );
 }
 
+/*
+ * Check if trust_ca is a trusted parent of child and signed it.
+ * Return 0 if yes, -1 if not.
+ */
+static int x509_crt_check_trusted( const x509_crt *child, x509_crt *trust_ca,
+                                   const unsigned char *hash,
+                                   const md_info_t *md_info,
+                                   int *check_path_cnt )
+{
+    if( x509_crt_check_parent( child, trust_ca ) != 0 )
+        return( -1 );
+
+    /*
+     * Reduce path_len to check against if top of the chain is
+     * the same as the trusted CA
+     */
+    if( child->subject_raw.len == trust_ca->subject_raw.len &&
+        memcmp( child->subject_raw.p, trust_ca->subject_raw.p,
+                        child->issuer_raw.len ) == 0 )
+    {
+        (*check_path_cnt)--;
+    }
+
+    if( trust_ca->max_pathlen > 0 &&
+        trust_ca->max_pathlen < *check_path_cnt )
+    {
+        return( -1 );
+    }
+
+    if( pk_can_do( &trust_ca->pk, child->sig_pk ) == 0 ||
+        pk_verify( &trust_ca->pk, child->sig_md, hash, md_info->size,
+                   child->sig.p, child->sig.len ) != 0 )
+    {
+        return( -1 );
+    }
+
+    return( 0 );
+}
+
+/*
+ * Find the trusted CA that signed child with the index of the trusted chain:
+ * first among the CAs whose subject key identifier is the authority key
+ * identifier of child, then among the other ones with the right subject.
+ */
+static x509_crt *x509_crt_find_trusted_indexed( const x509_crt *child,
+                                                const x509_crt_index *index,
+                                                const unsigned char *hash,
+                                                const md_info_t *md_info,
+                                                int *check_path_cnt )
+{
+    size_t i, mask = index->size - 1;
+    x509_crt *cur;
+    const x509_buf *aki = &child->authority_key_id;
+
+    if( aki->len != 0 )
+    {
+        for( i = x509_crt_hash( aki->p, aki->len ) & mask;
+             ( cur = index->key_id[i] ) != NULL;
+             i = ( i + 1 ) & mask )
+        {
+            if( cur->subject_key_id.len == aki->len &&
+                memcmp( cur->subject_key_id.p, aki->p, aki->len ) == 0 &&
+                x509_crt_check_trusted( child, cur, hash, md_info,
+                                        check_path_cnt ) == 0 )
+            {
+                return( cur );
+            }
+        }
+    }
+
+    for( i = x509_crt_hash( child->issuer_raw.p, child->issuer_raw.len ) & mask;
+         ( cur = index->subject[i] ) != NULL;
+         i = ( i + 1 ) & mask )
+    {
+        if( cur->subject_raw.len != child->issuer_raw.len ||
+            memcmp( cur->subject_raw.p, child->issuer_raw.p,
+                    child->issuer_raw.len ) != 0 )
+        {
+            continue;
+        }
+
+        /* Already tried above */
+        if( aki->len != 0 && cur->subject_key_id.len == aki->len &&
+            memcmp( cur->subject_key_id.p, aki->p, aki->len ) == 0 )
+        {
+            continue;
+        }
+
+        if( x509_crt_check_trusted( child, cur, hash, md_info,
+                                    check_path_cnt ) == 0 )
+        {
+            return( cur );
+        }
+    }
+
+    return( NULL );
+}
+
 static int x509_crt_verify_top(
                 x509_crt *child, x509_crt *trust_ca,
                 x509_crl *ca_crl, int path_cnt, int *flags,
                 int (*f_vrfy)(void *, x509_crt *, int, int *),
-                void *p_vrfy )
+                void *p_vrfy, x509_crt **trusted )
 {
     int ret;
     int ca_flags = 0, check_path_cnt = path_cnt + 1;
@@ -1627,41 +2326,27 @@ static int x509_crt_verify_top(
     else
         md( md_info, child->tbs.p, child->tbs.len, hash );
 
-    for( /* trust_ca */ ; trust_ca != NULL; trust_ca = trust_ca->next )
+    if( trust_ca != NULL && trust_ca->index != NULL )
+        trust_ca = x509_crt_find_trusted_indexed( child, trust_ca->index,
+                                                  hash, md_info,
+                                                  &check_path_cnt );
+    else
     {
-        if( x509_crt_check_parent( child, trust_ca ) != 0 )
-            continue;
-
-        /*
-         * Reduce path_len to check against if top of the chain is
-         * the same as the trusted CA
-         */
-        if( child->subject_raw.len == trust_ca->subject_raw.len &&
-            memcmp( child->subject_raw.p, trust_ca->subject_raw.p,
-                            child->issuer_raw.len ) == 0 )
-        {
-            check_path_cnt--;
-        }
-
-        if( trust_ca->max_pathlen > 0 &&
-            trust_ca->max_pathlen < check_path_cnt )
-        {
-            continue;
-        }
-
-        if( pk_can_do( &trust_ca->pk, child->sig_pk ) == 0 ||
-            pk_verify( &trust_ca->pk, child->sig_md, hash, md_info->size,
-                       child->sig.p, child->sig.len ) != 0 )
+        for( /* trust_ca */ ; trust_ca != NULL; trust_ca = trust_ca->next )
         {
-            continue;
+            if( x509_crt_check_trusted( child, trust_ca, hash, md_info,
+                                        &check_path_cnt ) == 0 )
+                break;
         }
+    }
 
-        /*
-         * Top of chain is signed by a trusted CA
-         */
+    /*
+     * Top of chain is signed by a trusted CA
+     */
+    if( trust_ca != NULL )
         *flags &= ~BADCERT_NOT_TRUSTED;
-        break;
-    }
+
+    *trusted = trust_ca;
 
     /*
      * If top of chain is not the same as the trusted CA send a verify request
@@ -1709,7 +2394,7 @@ static int x509_crt_verify_child(
                 x509_crt *child, x509_crt *parent, x509_crt *trust_ca,
                 x509_crl *ca_crl, int path_cnt, int *flags,
                 int (*f_vrfy)(void *, x509_crt *, int, int *),
-                void *p_vrfy )
+                void *p_vrfy, x509_crt **trusted )
 {
     int ret;
     int parent_flags = 0;
@@ -1761,14 +2446,16 @@ static int x509_crt_verify_child(
     if( grandparent != NULL )
     {
         ret = x509_crt_verify_child( parent, grandparent, trust_ca, ca_crl,
-                                path_cnt + 1, &parent_flags, f_vrfy, p_vrfy );
+                                path_cnt + 1, &parent_flags, f_vrfy, p_vrfy,
+                                trusted );
         if( ret != 0 )
             return( ret );
     }
     else
     {
         ret = x509_crt_verify_top( parent, trust_ca, ca_crl,
-                                path_cnt + 1, &parent_flags, f_vrfy, p_vrfy );
+                                path_cnt + 1, &parent_flags, f_vrfy, p_vrfy,
+                                trusted );
         if( ret != 0 )
             return( ret );
     }
@@ -1784,24 +2471,16 @@ static int x509_crt_verify_child(
 }
 
 /*
- * Verify the certificate validity
+ * Check the expected CN against the names of the certificate.
+ * Return the verification flags.
  */
-int x509_crt_verify( x509_crt *crt,
-                     x509_crt *trust_ca,
-                     x509_crl *ca_crl,
-                     const char *cn, int *flags,
-                     int (*f_vrfy)(void *, x509_crt *, int, int *),
-                     void *p_vrfy )
+static int x509_crt_verify_name( x509_crt *crt, const char *cn )
 {
     size_t cn_len;
-    int ret;
-    int pathlen = 0;
-    x509_crt *parent;
+    int flags = 0;
     x509_name *name;
     x509_sequence *cur = NULL;
 
-    *flags = 0;
-
     if( cn != NULL )
     {
         name = &crt->subject;
@@ -1826,7 +2505,7 @@ int x509_crt_verify( x509_crt *crt,
             }
 
             if( cur == NULL )
-                *flags |= BADCERT_CN_MISMATCH;
+                flags |= BADCERT_CN_MISMATCH;
         }
         else
         {
@@ -1848,10 +2527,31 @@ int x509_crt_verify( x509_crt *crt,
             }
 
             if( name == NULL )
-                *flags |= BADCERT_CN_MISMATCH;
+                flags |= BADCERT_CN_MISMATCH;
         }
     }
 
+    return( flags );
+}
+
+/*
+ * Verify the certificate validity, and return the trusted CA at the top of
+ * the path
+ */
+static int x509_crt_verify_path( x509_crt *crt,
+                                 x509_crt *trust_ca,
+                                 x509_crl *ca_crl,
+                                 const char *cn, int *flags,
+                                 int (*f_vrfy)(void *, x509_crt *, int, int *),
+                                 void *p_vrfy, x509_crt **trusted )
+{
+    int ret;
+    int pathlen = 0;
+    x509_crt *parent;
+
+    *flags = x509_crt_verify_name( crt, cn );
+    *trusted = NULL;
+
     /* Look for a parent upwards the chain */
     for( parent = crt->next; parent != NULL; parent = parent->next )
     {
@@ -1863,14 +2563,16 @@ int x509_crt_verify( x509_crt *crt,
     if( parent != NULL )
     {
         ret = x509_crt_verify_child( crt, parent, trust_ca, ca_crl,
-                                     pathlen, flags, f_vrfy, p_vrfy );
+                                     pathlen, flags, f_vrfy, p_vrfy,
+                                     trusted );
         if( ret != 0 )
             return( ret );
     }
     else
     {
         ret = x509_crt_verify_top( crt, trust_ca, ca_crl,
-                                   pathlen, flags, f_vrfy, p_vrfy );
+                                   pathlen, flags, f_vrfy, p_vrfy,
+                                   trusted );
         if( ret != 0 )
             return( ret );
     }
@@ -1881,6 +2583,309 @@ int x509_crt_verify( x509_crt *crt,
     return( 0 );
 }
 
+/*
+ * Verify the certificate validity
+ */
+int x509_crt_verify( x509_crt *crt,
+                     x509_crt *trust_ca,
+                     x509_crl *ca_crl,
+                     const char *cn, int *flags,
+                     int (*f_vrfy)(void *, x509_crt *, int, int *),
+                     void *p_vrfy )
+{
+    x509_crt *trusted;
+
+    return( x509_crt_verify_path( crt, trust_ca, ca_crl, cn, flags,
+                                  f_vrfy, p_vrfy, &trusted ) );
+}
+
+#if defined(POLARSSL_SHA256_C)
+/*
+ * Return 1 if a is later than b, 0 otherwise
+ */
+static int x509_time_later( const x509_time *a, const x509_time *b )
+{
+    if( a->year != b->year )
+        return( a->year > b->year );
+    if( a->mon != b->mon )
+        return( a->mon > b->mon );
+    if( a->day != b->day )
+        return( a->day > b->day );
+    if( a->hour != b->hour )
+        return( a->hour > b->hour );
+    if( a->min != b->min )
+        return( a->min > b->min );
+
+    return( a->sec > b->sec );
+}
+
+/*
+ * Narrow the window of an entry to the [from, to] period
+ */
+static void x509_verify_cache_window( x509_verify_cache_entry *entry,
+                                      const x509_time *from,
+                                      const x509_time *to )
+{
+    if( x509_time_later( from, &entry->valid_from ) )
+        entry->valid_from = *from;
+
+    if( x509_time_later( &entry->valid_to, to ) )
+        entry->valid_to = *to;
+}
+
+/*
+ * Digest the trusted CAs and CRLs not seen before (cache mutex held), so
+ * that certificates that are never used as a trust anchor are not hashed
+ */
+static void x509_verify_cache_digests( x509_crt *trust_ca, x509_crl *ca_crl )
+{
+    for( ; trust_ca != NULL && trust_ca->version != 0; trust_ca = trust_ca->next )
+    {
+        if( ! trust_ca->raw_sha256_set )
+        {
+            sha256( trust_ca->raw.p, trust_ca->raw.len,
+                    trust_ca->raw_sha256, 0 );
+            trust_ca->raw_sha256_set = 1;
+        }
+    }
+
+#if defined(POLARSSL_X509_CRL_PARSE_C)
+    for( ; ca_crl != NULL && ca_crl->version != 0; ca_crl = ca_crl->next )
+    {
+        if( ! ca_crl->raw_sha256_set )
+        {
+            sha256( ca_crl->raw.p, ca_crl->raw.len, ca_crl->raw_sha256, 0 );
+            ca_crl->raw_sha256_set = 1;
+        }
+    }
+#else
+    ((void) ca_crl);
+#endif
+}
+
+/*
+ * Fingerprint of a chain verification: every certificate presented, and
+ * the contents of the trusted CA and CRL chains, through their digests
+ */
+static void x509_verify_cache_fingerprint( const x509_crt *crt,
+                                           const x509_crt *trust_ca,
+                                           const x509_crl *ca_crl,
+                                           unsigned char fingerprint[32] )
+{
+    sha256_context ctx;
+    unsigned char len[4];
+    size_t count = 0;
+
+    sha256_starts( &ctx, 0 );
+
+    for( ; trust_ca != NULL && trust_ca->version != 0; trust_ca = trust_ca->next )
+    {
+        sha256_update( &ctx, trust_ca->raw_sha256, 32 );
+        count++;
+    }
+
+#if defined(POLARSSL_X509_CRL_PARSE_C)
+    for( ; ca_crl != NULL && ca_crl->version != 0; ca_crl = ca_crl->next )
+        sha256_update( &ctx, ca_crl->raw_sha256, 32 );
+#else
+    ((void) ca_crl);
+#endif
+
+    /* Where the CA digests end and the CRL ones start */
+    len[0] = (unsigned char)( count >> 24 );
+    len[1] = (unsigned char)( count >> 16 );
+    len[2] = (unsigned char)( count >>  8 );
+    len[3] = (unsigned char)( count       );
+
+    sha256_update( &ctx, len, 4 );
+
+    for( ; crt != NULL && crt->version != 0; crt = crt->next )
+    {
+        len[0] = (unsigned char)( crt->raw.len >> 24 );
+        len[1] = (unsigned char)( crt->raw.len >> 16 );
+        len[2] = (unsigned char)( crt->raw.len >>  8 );
+        len[3] = (unsigned char)( crt->raw.len       );
+
+        sha256_update( &ctx, len, 4 );
+        sha256_update( &ctx, crt->raw.p, crt->raw.len );
+    }
+
+    sha256_finish( &ctx, fingerprint );
+
+    memset( &ctx, 0, sizeof( sha256_context ) );
+}
+
+/*
+ * Verify the certificate validity, using and filling the cache
+ */
+int x509_crt_verify_cached( x509_crt *crt,
+                            x509_crt *trust_ca,
+                            x509_crl *ca_crl,
+                            const char *cn, int *flags,
+                            int (*f_vrfy)(void *, x509_crt *, int, int *),
+                            void *p_vrfy,
+                            x509_verify_cache *cache )
+{
+    int ret, hit;
+    unsigned char fingerprint[32];
+    x509_verify_cache_entry *entry, fresh;
+    x509_crt *trusted, *cur;
+#if defined(POLARSSL_X509_CRL_PARSE_C)
+    x509_crl *crl;
+#endif
+
+    if( cache == NULL || cache->size == 0 || f_vrfy != NULL )
+        return( x509_crt_verify( crt, trust_ca, ca_crl, cn, flags,
+                                 f_vrfy, p_vrfy ) );
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    x509_verify_cache_digests( trust_ca, ca_crl );
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_unlock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    x509_verify_cache_fingerprint( crt, trust_ca, ca_crl, fingerprint );
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    entry = &cache->entries[ ( ( (size_t) fingerprint[0] << 24 ) |
+                               ( (size_t) fingerprint[1] << 16 ) |
+                               ( (size_t) fingerprint[2] <<  8 ) |
+                               ( (size_t) fingerprint[3]       ) )
+                             % cache->size ];
+
+    hit = entry->generation == cache->generation &&
+          memcmp( entry->fingerprint, fingerprint, 32 ) == 0 &&
+          ! x509_time_expired( &entry->valid_to ) &&
+          ! x509_time_future( &entry->valid_from );
+
+    if( hit )
+        cache->hits++;
+    else
+        cache->misses++;
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_unlock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    if( hit )
+    {
+        *flags = x509_crt_verify_name( crt, cn );
+
+        if( *flags != 0 )
+            return( POLARSSL_ERR_X509_CERT_VERIFY_FAILED );
+
+        return( 0 );
+    }
+
+    ret = x509_crt_verify_path( crt, trust_ca, ca_crl, cn, flags,
+                                f_vrfy, p_vrfy, &trusted );
+    if( ret != 0 || trusted == NULL )
+        return( ret );
+
+    /*
+     * The result holds as long as every certificate presented, the trusted
+     * CA and every CRL are within their validity period
+     */
+    memcpy( fresh.fingerprint, fingerprint, 32 );
+    fresh.valid_from = trusted->valid_from;
+    fresh.valid_to = trusted->valid_to;
+
+    for( cur = crt; cur != NULL && cur->version != 0; cur = cur->next )
+        x509_verify_cache_window( &fresh, &cur->valid_from, &cur->valid_to );
+
+#if defined(POLARSSL_X509_CRL_PARSE_C)
+    for( crl = ca_crl; crl != NULL && crl->version != 0; crl = crl->next )
+        x509_verify_cache_window( &fresh, &crl->this_update,
+                                  &crl->next_update );
+#endif
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_lock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    fresh.generation = cache->generation;
+    *entry = fresh;
+
+#if defined(POLARSSL_THREADING_C)
+    if( ( ret = polarssl_mutex_unlock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    return( 0 );
+}
+
+int x509_verify_cache_init( x509_verify_cache *cache, size_t size )
+{
+    memset( cache, 0, sizeof( x509_verify_cache ) );
+
+    if( size != 0 )
+    {
+        cache->entries = (x509_verify_cache_entry *) polarssl_malloc(
+                                size * sizeof( x509_verify_cache_entry ) );
+        if( cache->entries == NULL )
+            return( POLARSSL_ERR_X509_MALLOC_FAILED );
+
+        memset( cache->entries, 0, size * sizeof( x509_verify_cache_entry ) );
+    }
+
+    cache->size = size;
+    cache->generation = 1;
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_init( &cache->mutex );
+#endif
+
+    return( 0 );
+}
+
+void x509_verify_cache_flush( x509_verify_cache *cache )
+{
+#if defined(POLARSSL_THREADING_C)
+    if( polarssl_mutex_lock( &cache->mutex ) != 0 )
+        return;
+#endif
+
+    /* Generation 0 is the one of empty entries, never use it */
+    if( ++cache->generation == 0 )
+    {
+        if( cache->entries != NULL )
+            memset( cache->entries, 0,
+                    cache->size * sizeof( x509_verify_cache_entry ) );
+        cache->generation = 1;
+    }
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_unlock( &cache->mutex );
+#endif
+}
+
+void x509_verify_cache_free( x509_verify_cache *cache )
+{
+    if( cache == NULL )
+        return;
+
+    polarssl_free( cache->entries );
+
+#if defined(POLARSSL_THREADING_C)
+    polarssl_mutex_free( &cache->mutex );
+#endif
+
+    memset( cache, 0, sizeof( x509_verify_cache ) );
+}
+#endif /* POLARSSL_SHA256_C */
+
 /*
  * Initialize a certificate chain
  */
@@ -1896,8 +2901,6 @@ void x509_crt_free( x509_crt *crt )
 {
     x509_crt *cert_cur = crt;
     x509_crt *cert_prv;
-    x509_name *name_cur;
-    x509_name *name_prv;
     x509_sequence *seq_cur;
     x509_sequence *seq_prv;
 
@@ -1908,23 +2911,8 @@ void x509_crt_free( x509_crt *crt )
     {
         pk_free( &cert_cur->pk );
 
-        name_cur = cert_cur->issuer.next;
-        while( name_cur != NULL )
-        {
-            name_prv = name_cur;
-            name_cur = name_cur->next;
-            memset( name_prv, 0, sizeof( x509_name ) );
-            polarssl_free( name_prv );
-        }
-
-        name_cur = cert_cur->subject.next;
-        while( name_cur != NULL )
-        {
-            name_prv = name_cur;
-            name_cur = name_cur->next;
-            memset( name_prv, 0, sizeof( x509_name ) );
-            polarssl_free( name_prv );
-        }
+        x509_free_name( &cert_cur->issuer );
+        x509_free_name( &cert_cur->subject );
 
         seq_cur = cert_cur->ext_key_usage.next;
         while( seq_cur != NULL )
@@ -1944,12 +2932,14 @@ void x509_crt_free( x509_crt *crt )
             polarssl_free( seq_prv );
         }
 
-        if( cert_cur->raw.p != NULL )
+        if( cert_cur->raw.p != NULL && cert_cur->own_buffer )
         {
             memset( cert_cur->raw.p, 0, cert_cur->raw.len );
             polarssl_free( cert_cur->raw.p );
         }
 
+        x509_crt_index_free( cert_cur );
+
         cert_cur = cert_cur->next;
     }
     while( cert_cur != NULL );
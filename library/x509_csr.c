@@ -408,22 +408,13 @@ void x509_csr_init( x509_csr *csr )
  */
 void x509_csr_free( x509_csr *csr )
 {
-    x509_name *name_cur;
-    x509_name *name_prv;
 
     if( csr == NULL )
         return;
 
     pk_free( &csr->pk );
 
-    name_cur = csr->subject.next;
-    while( name_cur != NULL )
-    {
-        name_prv = name_cur;
-        name_cur = name_cur->next;
-        memset( name_prv, 0, sizeof( x509_name ) );
-        polarssl_free( name_prv );
-    }
+    x509_free_name( &csr->subject );
 
     if( csr->raw.p != NULL )
     {
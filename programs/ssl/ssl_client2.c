@@ -66,6 +66,13 @@
 #define DFL_RECO_DELAY          0
 #define DFL_TICKETS             SSL_SESSION_TICKETS_ENABLED
 #define DFL_ALPN_STRING         NULL
+#define DFL_ZERO_COPY           0
+#define DFL_WRITEV              0
+#define DFL_OUTPUT_QUEUE        1
+#define DFL_BIO_VEC             0
+#define DFL_MAX_CONTENT_LEN     SSL_MAX_CONTENT_LEN
+#define DFL_BUFFER_POOL         0
+#define DFL_VERIFY_CACHE        0
 
 #define LONG_HEADER "User-agent: blah-blah-blah-blah-blah-blah-blah-blah-"   \
     "-01--blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-" \
@@ -110,6 +117,13 @@ struct options
     int reco_delay;             /* delay in seconds before resuming session */
     int tickets;                /* enable / disable session tickets         */
     const char *alpn_string;    /* ALPN supported protocols                 */
+    int zero_copy;              /* use the zero-copy record API             */
+    int writev;                 /* write the request with ssl_writev()      */
+    int output_queue;           /* records queued before being sent         */
+    int bio_vec;                /* send queued records with one call        */
+    int max_content_len;        /* size of the record buffers               */
+    int buffer_pool;            /* release the buffers while idle           */
+    int verify_cache;           /* cache verified server chains             */
 } opt;
 
 static void my_debug( void *ctx, int level, const char *str )
@@ -159,6 +173,34 @@ static int my_send( void *ctx, const unsigned char *buf, size_t len )
     return( ret );
 }
 
+/*
+ * Test vectored send function that only writes half of the data, so that
+ * the next call starts in the middle of a record
+ */
+static int my_sendv( void *ctx, const ssl_iovec *iov, size_t iovcnt )
+{
+    ssl_iovec half[POLARSSL_NET_MAX_IOV];
+    size_t i, len;
+
+    if( iovcnt > POLARSSL_NET_MAX_IOV )
+        iovcnt = POLARSSL_NET_MAX_IOV;
+
+    for( len = 0, i = 0; i < iovcnt; i++ )
+        len += iov[i].len;
+
+    len = ( len + 1 ) / 2;
+
+    for( i = 0; i < iovcnt && len > 0; i++ )
+    {
+        half[i] = iov[i];
+        if( half[i].len > len )
+            half[i].len = len;
+        len -= half[i].len;
+    }
+
+    return( net_sendv( ctx, half, i ) );
+}
+
 #if defined(POLARSSL_X509_CRT_PARSE_C)
 /*
  * Enabled if debug_level > 1 in code below
@@ -263,6 +305,13 @@ static int my_verify( void *data, x509_crt *crt, int depth, int *flags )
 #define USAGE_ALPN ""
 #endif /* POLARSSL_SSL_ALPN */
 
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+#define USAGE_VERIFY_CACHE \
+    "    verify_cache=%%d     default: 0 (disabled)\n"
+#else
+#define USAGE_VERIFY_CACHE ""
+#endif /* POLARSSL_X509_CRT_PARSE_C && POLARSSL_SHA256_C */
+
 #define USAGE \
     "\n usage: ssl_client2 param=<>...\n"                   \
     "\n acceptable parameters:\n"                           \
@@ -284,6 +333,14 @@ static int my_verify( void *data, x509_crt *crt, int depth, int *flags )
     "    allow_legacy=%%d     default: 0 (disabled)\n"      \
     "    renegotiate=%%d      default: 0 (disabled)\n"      \
     "    reconnect=%%d        default: 0 (disabled)\n"      \
+    "    zero_copy=%%d        default: 0 (ssl_write/ssl_read)\n" \
+    "    writev=%%d           default: 0 (ssl_write)\n"     \
+    "    output_queue=%%d     default: 1 (records sent one by one)\n" \
+    "    bio_vec=%%d          default: 0 (disabled)\n"      \
+    "                        options: 1 (net_sendv), 2 (short writes)\n" \
+    "    max_content_len=%%d  default: 16384 (record buffer size)\n" \
+    "    buffer_pool=%%d      default: 0 (buffers kept while idle)\n" \
+    USAGE_VERIFY_CACHE                                      \
     USAGE_TIME                                              \
     USAGE_TICKETS                                           \
     USAGE_MAX_FRAG_LEN                                      \
@@ -316,8 +373,13 @@ int main( int argc, char *argv[] )
 #else
 int main( int argc, char *argv[] )
 {
-    int ret = 0, len, server_fd, i, written, frags;
+    int ret = 0, len, server_fd, i, written, frags, part, in_headers;
     unsigned char buf[1024];
+    unsigned char *wbuf;
+    const unsigned char *rbuf;
+    size_t wlen, rlen, n, iovcnt;
+    ssl_iovec iov[3];
+    int cuts[3];
 #if defined(POLARSSL_KEY_EXCHANGE__SOME__PSK_ENABLED)
     unsigned char psk[256];
     size_t psk_len = 0;
@@ -330,11 +392,15 @@ int main( int argc, char *argv[] )
     entropy_context entropy;
     ctr_drbg_context ctr_drbg;
     ssl_context ssl;
+    ssl_buffer_pool buf_pool;
     ssl_session saved_session;
 #if defined(POLARSSL_X509_CRT_PARSE_C)
     x509_crt cacert;
     x509_crt clicert;
     pk_context pkey;
+#endif
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache vcache;
 #endif
     char *p, *q;
     const int *list;
@@ -345,6 +411,10 @@ int main( int argc, char *argv[] )
     server_fd = 0;
     memset( &ssl, 0, sizeof( ssl_context ) );
     memset( &saved_session, 0, sizeof( ssl_session ) );
+    ssl_buffer_pool_init( &buf_pool, 4 );
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache_init( &vcache, 0 );
+#endif
 #if defined(POLARSSL_X509_CRT_PARSE_C)
     x509_crt_init( &cacert );
     x509_crt_init( &clicert );
@@ -401,6 +471,13 @@ int main( int argc, char *argv[] )
     opt.reco_delay          = DFL_RECO_DELAY;
     opt.tickets             = DFL_TICKETS;
     opt.alpn_string         = DFL_ALPN_STRING;
+    opt.zero_copy           = DFL_ZERO_COPY;
+    opt.writev              = DFL_WRITEV;
+    opt.output_queue        = DFL_OUTPUT_QUEUE;
+    opt.bio_vec             = DFL_BIO_VEC;
+    opt.max_content_len     = DFL_MAX_CONTENT_LEN;
+    opt.buffer_pool         = DFL_BUFFER_POOL;
+    opt.verify_cache        = DFL_VERIFY_CACHE;
 
     for( i = 1; i < argc; i++ )
     {
@@ -481,6 +558,49 @@ int main( int argc, char *argv[] )
             if( opt.reconnect < 0 || opt.reconnect > 2 )
                 goto usage;
         }
+        else if( strcmp( p, "zero_copy" ) == 0 )
+        {
+            opt.zero_copy = atoi( q );
+            if( opt.zero_copy < 0 || opt.zero_copy > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "writev" ) == 0 )
+        {
+            opt.writev = atoi( q );
+            if( opt.writev < 0 || opt.writev > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "output_queue" ) == 0 )
+        {
+            opt.output_queue = atoi( q );
+            if( opt.output_queue < 1 || opt.output_queue > SSL_MAX_OUT_RECORDS )
+                goto usage;
+        }
+        else if( strcmp( p, "bio_vec" ) == 0 )
+        {
+            opt.bio_vec = atoi( q );
+            if( opt.bio_vec < 0 || opt.bio_vec > 2 )
+                goto usage;
+        }
+        else if( strcmp( p, "max_content_len" ) == 0 )
+        {
+            opt.max_content_len = atoi( q );
+            if( opt.max_content_len < SSL_MIN_CONTENT_LEN ||
+                opt.max_content_len > SSL_MAX_CONTENT_LEN )
+                goto usage;
+        }
+        else if( strcmp( p, "buffer_pool" ) == 0 )
+        {
+            opt.buffer_pool = atoi( q );
+            if( opt.buffer_pool < 0 || opt.buffer_pool > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "verify_cache" ) == 0 )
+        {
+            opt.verify_cache = atoi( q );
+            if( opt.verify_cache < 0 || opt.verify_cache > 1 )
+                goto usage;
+        }
         else if( strcmp( p, "reco_delay" ) == 0 )
         {
             opt.reco_delay = atoi( q );
@@ -829,6 +949,39 @@ int main( int argc, char *argv[] )
         goto exit;
     }
 
+    if( opt.max_content_len != DFL_MAX_CONTENT_LEN &&
+        ( ret = ssl_set_max_content_len( &ssl, opt.max_content_len ) ) != 0 )
+    {
+        printf( " failed\n  ! ssl_set_max_content_len returned -0x%x\n\n", -ret );
+        goto exit;
+    }
+
+    /* Buffers released by an idle connection are reused by the next one */
+    if( opt.buffer_pool != 0 )
+        ssl_set_buffer_pool( &ssl, &buf_pool );
+
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    /* Server chains verified once are not verified again */
+    if( opt.verify_cache != 0 )
+    {
+        x509_verify_cache_free( &vcache );
+        if( ( ret = x509_verify_cache_init( &vcache, 64 ) ) != 0 )
+        {
+            printf( " failed\n  ! x509_verify_cache_init returned -0x%x\n\n",
+                    -ret );
+            goto exit;
+        }
+
+        ssl_set_verify_cache( &ssl, &vcache );
+    }
+#endif
+
+    if( ( ret = ssl_set_output_queue( &ssl, opt.output_queue ) ) != 0 )
+    {
+        printf( " failed\n  ! ssl_set_output_queue returned -0x%x\n\n", -ret );
+        goto exit;
+    }
+
     printf( " ok\n" );
 
 #if defined(POLARSSL_X509_CRT_PARSE_C)
@@ -861,6 +1014,11 @@ int main( int argc, char *argv[] )
     else
         ssl_set_bio( &ssl, net_recv, &server_fd, net_send, &server_fd );
 
+    if( opt.bio_vec == 1 )
+        ssl_set_bio_vec( &ssl, net_sendv );
+    else if( opt.bio_vec == 2 )
+        ssl_set_bio_vec( &ssl, my_sendv );
+
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
     ssl_set_session_tickets( &ssl, opt.tickets );
 #endif
@@ -975,6 +1133,12 @@ int main( int argc, char *argv[] )
     else
         printf( " ok\n" );
 
+#if defined(POLARSSL_SHA256_C)
+    if( opt.verify_cache != 0 )
+        printf( "  . Verify cache: %u hits, %u misses\n",
+                (unsigned int) vcache.hits, (unsigned int) vcache.misses );
+#endif
+
     if( ssl_get_peer_cert( &ssl ) != NULL )
     {
         printf( "  . Peer certificate information    ...\n" );
@@ -1016,13 +1180,81 @@ send_request:
     else
         len = sprintf( (char *) buf, GET_REQUEST, opt.request_page );
 
+    /*
+     * With zero_copy, the request line and the final empty line are
+     * committed as two records, each shorter than the slice obtained
+     */
+    part = len;
+    if( opt.zero_copy != 0 && strcmp( opt.request_page, "SERVERQUIT" ) != 0 )
+        part = len - 2;
+
+    /* With writev, the method, the rest of the request line and the final
+     * empty line are given as separate buffers */
+    cuts[0] = 4;
+    cuts[1] = len - 2;
+    cuts[2] = len;
+
     for( written = 0, frags = 0; written < len; written += ret, frags++ )
     {
-        while( ( ret = ssl_write( &ssl, buf + written, len - written ) ) <= 0 )
+        if( opt.writev != 0 )
+        {
+            for( n = written, iovcnt = 0, i = 0; i < 3; i++ )
+            {
+                if( cuts[i] <= (int) n )
+                    continue;
+
+                iov[iovcnt].buf = buf + n;
+                iov[iovcnt].len = cuts[i] - n;
+                n = cuts[i];
+                iovcnt++;
+            }
+
+            while( ( ret = ssl_writev( &ssl, iov, iovcnt ) ) <= 0 )
+            {
+                if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
+                {
+                    printf( " failed\n  ! ssl_writev returned -0x%x\n\n", -ret );
+                    goto exit;
+                }
+            }
+
+            continue;
+        }
+
+        if( opt.zero_copy == 0 )
+        {
+            while( ( ret = ssl_write( &ssl, buf + written, len - written ) ) <= 0 )
+            {
+                if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
+                {
+                    printf( " failed\n  ! ssl_write returned -0x%x\n\n", -ret );
+                    goto exit;
+                }
+            }
+
+            continue;
+        }
+
+        while( ( ret = ssl_write_get_buf( &ssl, &wbuf, &wlen ) ) != 0 )
+        {
+            if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
+            {
+                printf( " failed\n  ! ssl_write_get_buf returned -0x%x\n\n", -ret );
+                goto exit;
+            }
+        }
+
+        n = ( written < part ? part : len ) - written;
+        if( n > wlen )
+            n = wlen;
+
+        memcpy( wbuf, buf + written, n );
+
+        while( ( ret = ssl_write_commit( &ssl, n ) ) <= 0 )
         {
             if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
             {
-                printf( " failed\n  ! ssl_write returned -0x%x\n\n", -ret );
+                printf( " failed\n  ! ssl_write_commit returned -0x%x\n\n", -ret );
                 goto exit;
             }
         }
@@ -1037,8 +1269,57 @@ send_request:
     printf( "  < Read from server:" );
     fflush( stdout );
 
+    in_headers = 1;
+
     do
     {
+        if( opt.zero_copy != 0 )
+        {
+            ret = ssl_read_get_buf( &ssl, &rbuf, &rlen );
+
+            if( ret == POLARSSL_ERR_NET_WANT_READ || ret == POLARSSL_ERR_NET_WANT_WRITE )
+                continue;
+
+            if( ret == POLARSSL_ERR_SSL_PEER_CLOSE_NOTIFY )
+                break;
+
+            if( ret < 0 )
+            {
+                printf( "failed\n  ! ssl_read_get_buf returned -0x%x\n\n", -ret );
+                break;
+            }
+
+            if( rlen == 0 )
+            {
+                printf("\n\nEOF\n\n");
+                ssl_close_notify( &ssl );
+                break;
+            }
+
+            len = ( rlen < sizeof( buf ) - 1 ) ? (int) rlen
+                                                : (int) sizeof( buf ) - 1;
+            memcpy( buf, rbuf, len );
+            buf[len] = '\0';
+
+            /* Consume the headers alone, the body stays in the record */
+            if( in_headers != 0 &&
+                ( p = strstr( (char *) buf, "\r\n\r\n" ) ) != NULL )
+            {
+                len = (int)( p + 4 - (char *) buf );
+                buf[len] = '\0';
+                in_headers = 0;
+            }
+
+            if( ( ret = ssl_read_release( &ssl, len ) ) != 0 )
+            {
+                printf( "failed\n  ! ssl_read_release returned -0x%x\n\n", -ret );
+                break;
+            }
+
+            printf( " %d bytes read\n\n%s", len, (char *) buf );
+            continue;
+        }
+
         len = sizeof( buf ) - 1;
         memset( buf, 0, sizeof( buf ) );
         ret = ssl_read( &ssl, buf, len );
@@ -1108,6 +1389,12 @@ send_request:
 
         printf( " ok\n" );
 
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+        if( opt.verify_cache != 0 )
+            printf( "  . Verify cache: %u hits, %u misses\n",
+                    (unsigned int) vcache.hits, (unsigned int) vcache.misses );
+#endif
+
         goto send_request;
     }
 
@@ -1134,6 +1421,10 @@ exit:
     ssl_session_free( &saved_session );
     ssl_free( &ssl );
     entropy_free( &entropy );
+    ssl_buffer_pool_free( &buf_pool );
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache_free( &vcache );
+#endif
 
     memset( &ssl, 0, sizeof( ssl ) );
 
@@ -50,6 +50,10 @@
 #include "polarssl/memory.h"
 #endif
 
+#if defined(POLARSSL_ECP_C)
+#include "polarssl/ecp.h"
+#endif
+
 #if !defined(POLARSSL_BIGNUM_C) || !defined(POLARSSL_CERTS_C) ||            \
     !defined(POLARSSL_ENTROPY_C) || !defined(POLARSSL_SSL_TLS_C) ||         \
     !defined(POLARSSL_SSL_SRV_C) || !defined(POLARSSL_NET_C) ||             \
@@ -96,7 +100,7 @@ typedef struct {
     int thread_complete;
     entropy_context *entropy;
 #if defined(POLARSSL_SSL_CACHE_C)
-    ssl_cache_context *cache;
+    ssl_cache_sharded_context *cache;
 #endif
     x509_crt *ca_chain;
     x509_crt *server_cert;
@@ -160,12 +164,12 @@ static void *handle_ssl_connection( void *data )
     ssl_set_rng( &ssl, ctr_drbg_random, &ctr_drbg );
     ssl_set_dbg( &ssl, my_mutexed_debug, stdout );
 
-    /* ssl_cache_get() and ssl_cache_set() are thread-safe if
-     * POLARSSL_THREADING_C is set.
+    /* ssl_cache_sharded_get() and ssl_cache_sharded_set() are thread-safe
+     * if POLARSSL_THREADING_C is set.
      */
 #if defined(POLARSSL_SSL_CACHE_C)
-    ssl_set_session_cache( &ssl, ssl_cache_get, thread_info->cache,
-                                 ssl_cache_set, thread_info->cache );
+    ssl_set_session_cache( &ssl, ssl_cache_sharded_get, thread_info->cache,
+                                 ssl_cache_sharded_set, thread_info->cache );
 #endif
 
     ssl_set_ca_chain( &ssl, thread_info->ca_chain, NULL, NULL );
@@ -302,6 +306,10 @@ thread_exit:
     net_close( client_fd );
     ssl_free( &ssl );
 
+#if defined(POLARSSL_MEMORY_THREAD_CACHE)
+    memory_buffer_alloc_thread_flush();
+#endif
+
     thread_info->thread_complete = 1;
 
     return( NULL );
@@ -359,7 +367,7 @@ int main( int argc, char *argv[] )
     unsigned char alloc_buf[100000];
 #endif
 #if defined(POLARSSL_SSL_CACHE_C)
-    ssl_cache_context cache;
+    ssl_cache_sharded_context cache;
 #endif
 
     ((void) argc);
@@ -370,7 +378,11 @@ int main( int argc, char *argv[] )
 #endif
 
 #if defined(POLARSSL_SSL_CACHE_C)
-    ssl_cache_init( &cache );
+    if( ( ret = ssl_cache_sharded_init( &cache, 0, 0 ) ) != 0 )
+    {
+        printf( "  ! ssl_cache_sharded_init returned -0x%04x\n\n", -ret );
+        return( ret );
+    }
     base_info.cache = &cache;
 #endif
 
@@ -428,6 +440,34 @@ int main( int argc, char *argv[] )
 
     printf( " ok\n" );
 
+#if defined(POLARSSL_ECP_C)
+    /*
+     * Pre-compute the generator tables of all curves once, so that they
+     * are shared by all threads for ECDHE and ECDSA.
+     */
+    printf( "  . Pre-computing EC generator tables..." );
+    fflush( stdout );
+
+    {
+        const ecp_curve_info *curve;
+
+        for( curve = ecp_curve_list();
+             curve->grp_id != POLARSSL_ECP_DP_NONE;
+             curve++ )
+        {
+            ret = ecp_comb_cache_add( curve->grp_id );
+            if( ret != 0 && ret != POLARSSL_ERR_ECP_FEATURE_UNAVAILABLE )
+            {
+                printf( " failed\n  !  ecp_comb_cache_add returned %d\n\n",
+                        ret );
+                goto exit;
+            }
+        }
+    }
+
+    printf( " ok\n" );
+#endif
+
     /*
      * 2. Setup the listening TCP socket
      */
@@ -482,9 +522,12 @@ exit:
     x509_crt_free( &srvcert );
     pk_free( &pkey );
 #if defined(POLARSSL_SSL_CACHE_C)
-    ssl_cache_free( &cache );
+    ssl_cache_sharded_free( &cache );
 #endif
     entropy_free( &entropy );
+#if defined(POLARSSL_ECP_C)
+    ecp_comb_cache_free();
+#endif
 
     polarssl_mutex_free( &debug_mutex );
 
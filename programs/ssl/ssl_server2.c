@@ -86,6 +86,12 @@
 #define DFL_CACHE_TIMEOUT       -1
 #define DFL_SNI                 NULL
 #define DFL_ALPN_STRING         NULL
+#define DFL_RSA_BATCH           0
+#define DFL_ASYNC_PRIVATE       0
+#define DFL_ZERO_COPY           0
+#define DFL_MAX_CONTENT_LEN     SSL_MAX_CONTENT_LEN
+#define DFL_BUFFER_POOL         0
+#define DFL_VERIFY_CACHE        0
 
 #define LONG_RESPONSE "<p>01-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n" \
     "02-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n"  \
@@ -133,6 +139,12 @@ struct options
     int cache_timeout;          /* expiration delay of session cache entries */
     char *sni;                  /* string decribing sni information         */
     const char *alpn_string;    /* ALPN supported protocols                 */
+    int rsa_batch;              /* batch RSA private key operations         */
+    int async_private;          /* asynchronous private key operations      */
+    int zero_copy;              /* use the zero-copy record API             */
+    int max_content_len;        /* size of the record buffers               */
+    int buffer_pool;            /* release the buffers while idle           */
+    int verify_cache;           /* cache verified client chains             */
 } opt;
 
 static void my_debug( void *ctx, int level, const char *str )
@@ -223,6 +235,29 @@ static int my_send( void *ctx, const unsigned char *buf, size_t len )
 #define USAGE_TICKETS ""
 #endif /* POLARSSL_SSL_SESSION_TICKETS */
 
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+#define USAGE_RSA_BATCH                                     \
+    "    rsa_batch=%%d        default: 0 (disabled)\n"
+#else
+#define USAGE_RSA_BATCH ""
+#endif /* POLARSSL_RSA_C && POLARSSL_X509_CRT_PARSE_C */
+
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+#define USAGE_VERIFY_CACHE                                  \
+    "    verify_cache=%%d     default: 0 (disabled)\n"
+#else
+#define USAGE_VERIFY_CACHE ""
+#endif /* POLARSSL_X509_CRT_PARSE_C && POLARSSL_SHA256_C */
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+#define USAGE_ASYNC                                         \
+    "    async_private=%%d    default: 0 (disabled)\n"      \
+    "                        options: 1 (resumed once),\n"  \
+    "                        2 (not handled), 3 (first one abandoned)\n"
+#else
+#define USAGE_ASYNC ""
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
 #if defined(POLARSSL_SSL_CACHE_C)
 #define USAGE_CACHE                                             \
     "    cache_max=%%d        default: cache default (50)\n"    \
@@ -263,11 +298,17 @@ static int my_send( void *ctx, const unsigned char *buf, size_t len )
     "    debug_level=%%d      default: 0 (disabled)\n"      \
     "    nbio=%%d             default: 0 (blocking I/O)\n"  \
     "                        options: 1 (non-blocking), 2 (added delays)\n" \
+    "    zero_copy=%%d        default: 0 (ssl_read/ssl_write)\n" \
+    "    max_content_len=%%d  default: 16384 (record buffer size)\n" \
+    "    buffer_pool=%%d      default: 0 (buffers kept while idle)\n" \
     "\n"                                                    \
     "    auth_mode=%%s        default: \"optional\"\n"      \
     "                        options: none, optional, required\n" \
     USAGE_IO                                                \
     USAGE_SNI                                               \
+    USAGE_RSA_BATCH                                         \
+    USAGE_VERIFY_CACHE                                      \
+    USAGE_ASYNC                                             \
     "\n"                                                    \
     USAGE_PSK                                               \
     "\n"                                                    \
@@ -411,12 +452,93 @@ int sni_callback( void *p_info, ssl_context *ssl,
 
 #endif /* POLARSSL_SNI */
 
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+/*
+ * Asynchronous private key operations: the operation is recorded when it
+ * is started and done when it is resumed the second time, the way a
+ * worker thread or a key server would do it in the meantime.
+ */
+typedef struct
+{
+    pk_context *key;
+    int sign;                   /* signature or decryption  */
+    md_type_t md_alg;           /* signature only           */
+    unsigned char input[POLARSSL_MPI_MAX_SIZE];
+    size_t input_len;
+    int resumed;
+} async_operation;
+
+static async_operation async_op;
+
+static int async_start( ssl_context *ssl, pk_context *key, int sign,
+                        md_type_t md_alg,
+                        const unsigned char *input, size_t input_len )
+{
+    if( opt.async_private == 2 || input_len > sizeof( async_op.input ) )
+        return( POLARSSL_ERR_SSL_HW_ACCEL_FALLTHROUGH );
+
+    async_op.key = key;
+    async_op.sign = sign;
+    async_op.md_alg = md_alg;
+    memcpy( async_op.input, input, input_len );
+    async_op.input_len = input_len;
+    async_op.resumed = 0;
+
+    ssl_set_async_operation_data( ssl, &async_op );
+
+    return( 0 );
+}
+
+static int async_sign( void *p_rng, ssl_context *ssl, pk_context *key,
+                       md_type_t md_alg, const unsigned char *hash,
+                       size_t hash_len )
+{
+    ((void) p_rng);
+    return( async_start( ssl, key, 1, md_alg, hash, hash_len ) );
+}
+
+static int async_decrypt( void *p_rng, ssl_context *ssl, pk_context *key,
+                          const unsigned char *input, size_t input_len )
+{
+    ((void) p_rng);
+    return( async_start( ssl, key, 0, POLARSSL_MD_NONE, input, input_len ) );
+}
+
+static int async_resume( void *p_rng, ssl_context *ssl,
+                         unsigned char *output, size_t *output_len,
+                         size_t output_max_len )
+{
+    async_operation *op = ssl_get_async_operation_data( ssl );
+
+    if( op->resumed++ == 0 )
+        return( POLARSSL_ERR_SSL_PRIVATE_PENDING );
+
+    if( op->sign )
+        return( pk_sign( op->key, op->md_alg, op->input, op->input_len,
+                         output, output_len, ctr_drbg_random, p_rng ) );
+
+    return( pk_decrypt( op->key, op->input, op->input_len,
+                        output, output_len, output_max_len,
+                        ctr_drbg_random, p_rng ) );
+}
+
+static void async_cancel( void *p_rng, ssl_context *ssl )
+{
+    ((void) p_rng);
+    ((void) ssl);
+    printf( "  ! private key operation cancelled\n" );
+}
+#endif /* POLARSSL_SSL_ASYNC_PRIVATE */
+
 int main( int argc, char *argv[] )
 {
-    int ret = 0, len, written, frags;
+    int ret = 0, len, written, frags, records;
     int listen_fd;
     int client_fd = -1;
     unsigned char buf[1024];
+    unsigned char *wbuf;
+    const unsigned char *rbuf;
+    size_t wlen, rlen, n;
 #if defined(POLARSSL_KEY_EXCHANGE__SOME__PSK_ENABLED)
     unsigned char psk[256];
     size_t psk_len = 0;
@@ -426,6 +548,7 @@ int main( int argc, char *argv[] )
     entropy_context entropy;
     ctr_drbg_context ctr_drbg;
     ssl_context ssl;
+    ssl_buffer_pool buf_pool;
 #if defined(POLARSSL_X509_CRT_PARSE_C)
     x509_crt cacert;
     x509_crt srvcert;
@@ -437,6 +560,12 @@ int main( int argc, char *argv[] )
 #if defined(POLARSSL_SSL_CACHE_C)
     ssl_cache_context cache;
 #endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    ssl_rsa_batch rsa_batch;
+#endif
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache vcache;
+#endif
 #if defined(POLARSSL_SNI)
     sni_entry *sni_info = NULL;
 #endif
@@ -460,6 +589,7 @@ int main( int argc, char *argv[] )
      */
     listen_fd = 0;
     memset( &ssl, 0, sizeof( ssl_context ) );
+    ssl_buffer_pool_init( &buf_pool, 4 );
 #if defined(POLARSSL_X509_CRT_PARSE_C)
     x509_crt_init( &cacert );
     x509_crt_init( &srvcert );
@@ -470,6 +600,12 @@ int main( int argc, char *argv[] )
 #if defined(POLARSSL_SSL_CACHE_C)
     ssl_cache_init( &cache );
 #endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    ssl_rsa_batch_init( &rsa_batch, ctr_drbg_random, &ctr_drbg );
+#endif
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache_init( &vcache, 0 );
+#endif
 #if defined(POLARSSL_SSL_ALPN)
     memset( alpn_list, 0, sizeof alpn_list );
 #endif
@@ -520,6 +656,12 @@ int main( int argc, char *argv[] )
     opt.ticket_timeout      = DFL_TICKET_TIMEOUT;
     opt.cache_max           = DFL_CACHE_MAX;
     opt.cache_timeout       = DFL_CACHE_TIMEOUT;
+    opt.rsa_batch           = DFL_RSA_BATCH;
+    opt.async_private       = DFL_ASYNC_PRIVATE;
+    opt.zero_copy           = DFL_ZERO_COPY;
+    opt.max_content_len     = DFL_MAX_CONTENT_LEN;
+    opt.buffer_pool         = DFL_BUFFER_POOL;
+    opt.verify_cache        = DFL_VERIFY_CACHE;
     opt.sni                 = DFL_SNI;
     opt.alpn_string         = DFL_ALPN_STRING;
 
@@ -675,6 +817,43 @@ int main( int argc, char *argv[] )
         {
             opt.alpn_string = q;
         }
+        else if( strcmp( p, "rsa_batch" ) == 0 )
+        {
+            opt.rsa_batch = atoi( q );
+            if( opt.rsa_batch < 0 || opt.rsa_batch > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "async_private" ) == 0 )
+        {
+            opt.async_private = atoi( q );
+            if( opt.async_private < 0 || opt.async_private > 3 )
+                goto usage;
+        }
+        else if( strcmp( p, "zero_copy" ) == 0 )
+        {
+            opt.zero_copy = atoi( q );
+            if( opt.zero_copy < 0 || opt.zero_copy > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "max_content_len" ) == 0 )
+        {
+            opt.max_content_len = atoi( q );
+            if( opt.max_content_len < SSL_MIN_CONTENT_LEN ||
+                opt.max_content_len > SSL_MAX_CONTENT_LEN )
+                goto usage;
+        }
+        else if( strcmp( p, "buffer_pool" ) == 0 )
+        {
+            opt.buffer_pool = atoi( q );
+            if( opt.buffer_pool < 0 || opt.buffer_pool > 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "verify_cache" ) == 0 )
+        {
+            opt.verify_cache = atoi( q );
+            if( opt.verify_cache < 0 || opt.verify_cache > 1 )
+                goto usage;
+        }
         else if( strcmp( p, "tickets" ) == 0 )
         {
             opt.tickets = atoi( q );
@@ -1009,6 +1188,33 @@ int main( int argc, char *argv[] )
         goto exit;
     }
 
+    if( opt.max_content_len != DFL_MAX_CONTENT_LEN &&
+        ( ret = ssl_set_max_content_len( &ssl, opt.max_content_len ) ) != 0 )
+    {
+        printf( " failed\n  ! ssl_set_max_content_len returned -0x%x\n\n", -ret );
+        goto exit;
+    }
+
+    /* Buffers released by an idle connection are reused by the next one */
+    if( opt.buffer_pool != 0 )
+        ssl_set_buffer_pool( &ssl, &buf_pool );
+
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    /* Client chains verified once are not verified again */
+    if( opt.verify_cache != 0 )
+    {
+        x509_verify_cache_free( &vcache );
+        if( ( ret = x509_verify_cache_init( &vcache, 64 ) ) != 0 )
+        {
+            printf( " failed\n  ! x509_verify_cache_init returned -0x%x\n\n",
+                    -ret );
+            goto exit;
+        }
+
+        ssl_set_verify_cache( &ssl, &vcache );
+    }
+#endif
+
     ssl_set_endpoint( &ssl, SSL_IS_SERVER );
     ssl_set_authmode( &ssl, opt.auth_mode );
 
@@ -1035,6 +1241,23 @@ int main( int argc, char *argv[] )
                                  ssl_cache_set, &cache );
 #endif
 
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    if( opt.rsa_batch != 0 )
+        ssl_set_rsa_batch( &ssl, &rsa_batch );
+#endif
+
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+    if( opt.async_private != 0 &&
+        ( ret = ssl_set_async_private( &ssl, async_sign, async_decrypt,
+                                       async_resume, async_cancel,
+                                       &ctr_drbg ) ) != 0 )
+    {
+        printf( " failed\n  ! ssl_set_async_private returned -0x%x\n\n",
+                -ret );
+        goto exit;
+    }
+#endif
+
 #if defined(POLARSSL_SSL_SESSION_TICKETS)
     ssl_set_session_tickets( &ssl, opt.tickets );
 
@@ -1140,6 +1363,31 @@ reset:
 
     while( ( ret = ssl_handshake( &ssl ) ) != 0 )
     {
+        /* Single connection: run a queued operation right away, or just
+         * try again until an asynchronous one is done */
+        if( ret == POLARSSL_ERR_SSL_PRIVATE_PENDING )
+        {
+#if defined(POLARSSL_SSL_ASYNC_PRIVATE)
+            if( opt.async_private == 3 )
+            {
+                /* Only the first one, so that the next client gets in */
+                printf( " abandoned\n" );
+                opt.async_private = 1;
+                goto reset;
+            }
+#endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+            if( opt.rsa_batch != 0 &&
+                ( ret = ssl_rsa_batch_run( &rsa_batch ) ) != 0 )
+            {
+                printf( " failed\n  ! ssl_rsa_batch_run returned -0x%x\n\n",
+                        -ret );
+                goto reset;
+            }
+#endif
+            continue;
+        }
+
         if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
         {
             printf( " failed\n  ! ssl_handshake returned -0x%x\n\n", -ret );
@@ -1186,6 +1434,12 @@ reset:
     else
         printf( " ok\n" );
 
+#if defined(POLARSSL_SHA256_C)
+    if( opt.verify_cache != 0 )
+        printf( "  . Verify cache: %u hits, %u misses\n",
+                (unsigned int) vcache.hits, (unsigned int) vcache.misses );
+#endif
+
     if( ssl_get_peer_cert( &ssl ) )
     {
         printf( "  . Peer certificate information    ...\n" );
@@ -1201,7 +1455,58 @@ reset:
     printf( "  < Read from client:" );
     fflush( stdout );
 
-    do
+    /*
+     * With zero_copy, gather the request straight from the record buffer
+     * until the end of the headers, across as many records as needed
+     */
+    len = 0;
+    records = 0;
+    memset( buf, 0, sizeof( buf ) );
+
+    while( opt.zero_copy != 0 )
+    {
+        ret = ssl_read_get_buf( &ssl, &rbuf, &rlen );
+
+        if( ret == POLARSSL_ERR_NET_WANT_READ || ret == POLARSSL_ERR_NET_WANT_WRITE )
+            continue;
+
+        if( ret != 0 || rlen == 0 )
+        {
+            printf( " ssl_read_get_buf returned -0x%x\n", -ret );
+            goto reset;
+        }
+
+        n = sizeof( buf ) - 1 - len;
+        if( n > rlen )
+            n = rlen;
+
+        memcpy( buf + len, rbuf, n );
+        len += (int) n;
+        records++;
+
+        if( ( ret = ssl_read_release( &ssl, n ) ) != 0 )
+        {
+            printf( " ssl_read_release returned -0x%x\n", -ret );
+            goto reset;
+        }
+
+        if( memcmp( buf, "SERVERQUIT", 10 ) == 0 )
+        {
+            printf( " %d bytes read\n\n%s\n", len, (char *) buf );
+            ret = 0;
+            goto exit;
+        }
+
+        if( strstr( (char *) buf, "\r\n\r\n" ) != NULL ||
+            len == sizeof( buf ) - 1 )
+        {
+            printf( " %d bytes read from %d record(s)\n\n%s\n",
+                    len, records, (char *) buf );
+            break;
+        }
+    }
+
+    while( opt.zero_copy == 0 )
     {
         len = sizeof( buf ) - 1;
         memset( buf, 0, sizeof( buf ) );
@@ -1242,7 +1547,6 @@ reset:
         if( ret > 0 )
             break;
     }
-    while( 1 );
 
     /*
      * 7. Write the 200 Response
@@ -1255,18 +1559,48 @@ reset:
 
     for( written = 0, frags = 0; written < len; written += ret, frags++ )
     {
-        while( ( ret = ssl_write( &ssl, buf + written, len - written ) ) <= 0 )
+        if( opt.zero_copy == 0 )
+        {
+            while( ( ret = ssl_write( &ssl, buf + written, len - written ) ) <= 0 )
+            {
+                if( ret == POLARSSL_ERR_NET_CONN_RESET )
+                {
+                    printf( " failed\n  ! peer closed the connection\n\n" );
+                    goto reset;
+                }
+
+                if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
+                {
+                    printf( " failed\n  ! ssl_write returned %d\n\n", ret );
+                    goto exit;
+                }
+            }
+
+            continue;
+        }
+
+        while( ( ret = ssl_write_get_buf( &ssl, &wbuf, &wlen ) ) != 0 )
         {
-            if( ret == POLARSSL_ERR_NET_CONN_RESET )
+            if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
             {
-                printf( " failed\n  ! peer closed the connection\n\n" );
+                printf( " failed\n  ! ssl_write_get_buf returned %d\n\n", ret );
                 goto reset;
             }
+        }
+
+        /* Usually less than the slice obtained */
+        n = len - written;
+        if( n > wlen )
+            n = wlen;
 
+        memcpy( wbuf, buf + written, n );
+
+        while( ( ret = ssl_write_commit( &ssl, n ) ) <= 0 )
+        {
             if( ret != POLARSSL_ERR_NET_WANT_READ && ret != POLARSSL_ERR_NET_WANT_WRITE )
             {
-                printf( " failed\n  ! ssl_write returned %d\n\n", ret );
-                goto exit;
+                printf( " failed\n  ! ssl_write_commit returned %d\n\n", ret );
+                goto reset;
             }
         }
     }
@@ -1359,10 +1693,17 @@ exit:
 
     ssl_free( &ssl );
     entropy_free( &entropy );
+    ssl_buffer_pool_free( &buf_pool );
 
 #if defined(POLARSSL_SSL_CACHE_C)
     ssl_cache_free( &cache );
 #endif
+#if defined(POLARSSL_RSA_C) && defined(POLARSSL_X509_CRT_PARSE_C)
+    ssl_rsa_batch_free( &rsa_batch );
+#endif
+#if defined(POLARSSL_X509_CRT_PARSE_C) && defined(POLARSSL_SHA256_C)
+    x509_verify_cache_free( &vcache );
+#endif
 
 #if defined(POLARSSL_MEMORY_BUFFER_ALLOC_C)
 #if defined(POLARSSL_MEMORY_DEBUG)
@@ -1243,6 +1243,359 @@ run_test    "extKeyUsage cli-auth #4b (codeSign -> fail (hard))" \
             -s "bad certificate (usage extensions)" \
             -s "Processing of the Certificate handshake message failed"
 
+# Tests for batched RSA private key operations
+
+run_test    "RSA batch #1 (RSA key exchange)" \
+            "$P_SRV debug_level=4 rsa_batch=1" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "parse client key exchange (pending)" \
+            -s "decryption done" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "RSA batch #2 (DHE-RSA key exchange)" \
+            "$P_SRV debug_level=4 rsa_batch=1" \
+            "$P_CLI force_ciphersuite=TLS-DHE-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "write server key exchange (pending)" \
+            -s "pending signature done" \
+            -S "parse client key exchange (pending)" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "RSA batch #3 (ECDHE-RSA key exchange)" \
+            "$P_SRV debug_level=4 rsa_batch=1" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "write server key exchange (pending)" \
+            -s "pending signature done" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "RSA batch #4 (ECDHE-RSA, TLS 1.0, non-blocking I/O)" \
+            "$P_SRV debug_level=4 rsa_batch=1 nbio=2" \
+            "$P_CLI nbio=2 force_version=tls1 \
+             force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "write server key exchange (pending)" \
+            -s "pending signature done" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "RSA batch #5 (ECDHE-ECDSA, not batched)" \
+            "$P_SRV debug_level=4 rsa_batch=1 crt_file=data_files/server5.crt \
+             key_file=data_files/server5.key" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-ECDSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -S "(pending)" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+# Tests for asynchronous private key operations
+
+run_test    "Async private key #1 (RSA decryption)" \
+            "$P_SRV debug_level=4 async_private=1" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "parse client key exchange (pending)" \
+            -s "pending decryption done" \
+            -S "private key operation cancelled" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "Async private key #2 (ECDHE-RSA signature)" \
+            "$P_SRV debug_level=4 async_private=1" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "write server key exchange (pending)" \
+            -s "pending signature done" \
+            -S "private key operation cancelled" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "Async private key #3 (ECDHE-ECDSA signature)" \
+            "$P_SRV debug_level=4 async_private=1 \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-ECDSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "write server key exchange (pending)" \
+            -s "pending signature done" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "Async private key #4 (not handled by the callbacks)" \
+            "$P_SRV debug_level=4 async_private=2" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -S "(pending)" \
+            -S "ssl_handshake returned" \
+            -C "ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+run_test    "Async private key #5 (signature cancelled)" \
+            "$P_SRV debug_level=4 async_private=3" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-CBC-SHA" \
+            1 \
+            -s "write server key exchange (pending)" \
+            -s "private key operation cancelled" \
+            -s "abandoned" \
+            -c "ssl_handshake returned"
+
+run_test    "Async private key #6 (decryption cancelled)" \
+            "$P_SRV debug_level=4 async_private=3" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA" \
+            1 \
+            -s "parse client key exchange (pending)" \
+            -s "private key operation cancelled" \
+            -s "abandoned" \
+            -c "ssl_handshake returned"
+
+# Tests for the zero-copy record API
+
+run_test    "Zero-copy #1 (client and server)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI zero_copy=1" \
+            0 \
+            -s "Read from client: 18 bytes read from 2 record(s)" \
+            -s "bytes written in 1 fragments" \
+            -c "18 bytes written in 2 fragments" \
+            -c "Read from server: 44 bytes read" \
+            -c "Successful connection using"
+
+run_test    "Zero-copy #2 (client only)" \
+            "$P_SRV" \
+            "$P_CLI zero_copy=1" \
+            0 \
+            -s "Read from client: 16 bytes read" \
+            -c "18 bytes written in 2 fragments" \
+            -c "Read from server: 44 bytes read" \
+            -c "Successful connection using"
+
+run_test    "Zero-copy #3 (server only)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI" \
+            0 \
+            -s "Read from client: 18 bytes read from 1 record(s)" \
+            -c "18 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Zero-copy #4 (non-blocking with delays)" \
+            "$P_SRV zero_copy=1 nbio=2" \
+            "$P_CLI zero_copy=1 nbio=2" \
+            0 \
+            -s "Read from client: 18 bytes read from 2 record(s)" \
+            -c "18 bytes written in 2 fragments" \
+            -c "Read from server: 44 bytes read" \
+            -c "Successful connection using"
+
+run_test    "Zero-copy #5 (reduced maximum fragment length)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI zero_copy=1 max_frag_len=512" \
+            0 \
+            -s "Read from client: 18 bytes read from 2 record(s)" \
+            -c "18 bytes written in 2 fragments" \
+            -c "Read from server: 44 bytes read" \
+            -c "Successful connection using"
+
+# Tests for vectored and queued writes
+
+LONG_PAGE="/$( printf '%0900d' 0 )"
+
+run_test    "Writev #1 (one record)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI writev=1" \
+            0 \
+            -s "Read from client: 18 bytes read from 1 record(s)" \
+            -s "GET / HTTP/1.0" \
+            -c "18 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Writev #2 (records sent one by one)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI writev=1 max_frag_len=512 request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "918 bytes written in 2 fragments" \
+            -c "Successful connection using"
+
+run_test    "Writev #3 (coalesced records)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI debug_level=3 writev=1 output_queue=2 max_frag_len=512 \
+             request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "queued records: 2" \
+            -c "918 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Writev #4 (coalesced records, non-blocking with delays)" \
+            "$P_SRV zero_copy=1 nbio=2" \
+            "$P_CLI writev=1 output_queue=4 max_frag_len=512 nbio=2 \
+             request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "918 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+# Tests for vectored sends of queued records
+
+run_test    "Bio vec #1 (net_sendv)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI debug_level=3 bio_vec=1 writev=1 output_queue=2 \
+             max_frag_len=512 request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "f_send_vec() returned" \
+            -c "918 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Bio vec #2 (short writes)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI debug_level=3 bio_vec=2 writev=1 output_queue=2 \
+             max_frag_len=512 request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "f_send_vec() returned" \
+            -c "918 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Bio vec #3 (short writes, non-blocking with delays)" \
+            "$P_SRV zero_copy=1 nbio=2" \
+            "$P_CLI debug_level=3 bio_vec=2 writev=1 output_queue=4 nbio=2 \
+             max_frag_len=512 request_page=$LONG_PAGE" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "f_send_vec() returned" \
+            -c "918 bytes written in 1 fragments" \
+            -c "Successful connection using"
+
+run_test    "Bio vec #4 (single record, not used)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI debug_level=3 bio_vec=1 writev=1 output_queue=2" \
+            0 \
+            -s "Read from client: 18 bytes read from 1 record(s)" \
+            -C "f_send_vec() returned" \
+            -c "Successful connection using"
+
+# Tests for record buffer size and pooling
+
+run_test    "Max content len #1 (client, large enough)" \
+            "$P_SRV" \
+            "$P_CLI max_content_len=4096" \
+            0 \
+            -C "bad message length" \
+            -c "Successful connection using"
+
+run_test    "Max content len #2 (client, certificate too large)" \
+            "$P_SRV" \
+            "$P_CLI debug_level=2 max_content_len=1024" \
+            1 \
+            -c "bad message length" \
+            -c "ssl_handshake returned"
+
+run_test    "Max content len #3 (server, records spanning)" \
+            "$P_SRV max_content_len=512 zero_copy=1 psk=abc123 \
+             force_ciphersuite=TLS-PSK-WITH-AES-128-CBC-SHA" \
+            "$P_CLI max_frag_len=512 psk=abc123 request_page=$LONG_PAGE \
+             force_ciphersuite=TLS-PSK-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "Successful connection using"
+
+run_test    "Max content len #4 (full CBC records after MFL shrinking)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI max_frag_len=512 request_page=$LONG_PAGE \
+             force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "Successful connection using"
+
+run_test    "Max content len #5 (full CBC records, SHA-384 MAC)" \
+            "$P_SRV zero_copy=1" \
+            "$P_CLI max_frag_len=512 request_page=$LONG_PAGE \
+             force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-256-CBC-SHA384" \
+            0 \
+            -s "Read from client: 918 bytes read from 2 record(s)" \
+            -s "GET $LONG_PAGE HTTP/1.0" \
+            -c "Successful connection using"
+
+run_test    "Buffer pool #1 (server, sequential connections)" \
+            "$P_SRV debug_level=4 buffer_pool=1" \
+            "$P_CLI reconnect=1" \
+            0 \
+            -s "releasing idle record buffers" \
+            -s "taken from pool" \
+            -c "Reconnecting with saved session... ok" \
+            -c "Successful connection using"
+
+run_test    "Buffer pool #2 (client, sequential connections)" \
+            "$P_SRV" \
+            "$P_CLI debug_level=4 buffer_pool=1 reconnect=1" \
+            0 \
+            -c "releasing idle record buffers" \
+            -c "taken from pool" \
+            -c "Reconnecting with saved session" \
+            -C "failed" \
+            -c "Successful connection using"
+
+run_test    "Buffer pool #3 (zero-copy on both sides)" \
+            "$P_SRV debug_level=4 buffer_pool=1 zero_copy=1" \
+            "$P_CLI debug_level=4 buffer_pool=1 zero_copy=1 reconnect=1" \
+            0 \
+            -s "releasing idle record buffers" \
+            -s "18 bytes read from 2 record(s)" \
+            -c "releasing idle record buffers" \
+            -c "Reconnecting with saved session" \
+            -C "failed" \
+            -c "Successful connection using"
+
+# Tests for the verified chain cache: resumption is disabled so that
+# the second connection performs a full mutual-TLS handshake
+
+run_test    "Verify cache #1 (server, client chain)" \
+            "$P_SRV verify_cache=1 auth_mode=required tickets=0 cache_max=0" \
+            "$P_CLI tickets=0 reconnect=1" \
+            0 \
+            -s "Verify cache: 0 hits, 1 misses" \
+            -s "Verify cache: 1 hits, 1 misses" \
+            -S "Verifying peer X.509 certificate... failed" \
+            -c "Reconnecting with saved session... ok" \
+            -C "failed"
+
+run_test    "Verify cache #2 (client, server chain)" \
+            "$P_SRV auth_mode=required tickets=0 cache_max=0" \
+            "$P_CLI verify_cache=1 tickets=0 reconnect=1" \
+            0 \
+            -c "Verify cache: 0 hits, 1 misses" \
+            -c "Verify cache: 1 hits, 1 misses" \
+            -c "Reconnecting with saved session... ok" \
+            -C "failed"
+
+run_test    "Verify cache #3 (disabled)" \
+            "$P_SRV auth_mode=required tickets=0 cache_max=0" \
+            "$P_CLI tickets=0 reconnect=1" \
+            0 \
+            -S "Verify cache:" \
+            -C "Verify cache:" \
+            -c "Reconnecting with saved session... ok"
+
 # Final report
 
 echo "------------------------------------------------------------------------"
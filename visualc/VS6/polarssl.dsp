@@ -165,6 +165,14 @@ SOURCE=..\..\library\ecp_curves.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\library\ecp_p256.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\library\ecp_x25519.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\library\entropy.c
 # End Source File
 # Begin Source File
@@ -441,6 +449,14 @@ SOURCE=..\..\include\polarssl\ecp.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\polarssl\ecp_p256.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\polarssl\ecp_x25519.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\polarssl\entropy.h
 # End Source File
 # Begin Source File